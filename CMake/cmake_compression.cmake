@@ -0,0 +1,36 @@
+# Optional support for reading gzip and zstd compressed input files.
+find_package(ZLIB)
+if (ZLIB_FOUND)
+  set (SKYLARK_HAVE_ZLIB
+       1
+       CACHE
+       STRING
+       "Enables reading gzip compressed files"
+       FORCE)
+  include_directories (${ZLIB_INCLUDE_DIRS})
+else (ZLIB_FOUND)
+  set (SKYLARK_HAVE_ZLIB
+       0
+       CACHE
+       STRING
+       "Enables reading gzip compressed files"
+       FORCE)
+endif (ZLIB_FOUND)
+
+find_package(ZSTD)
+if (ZSTD_FOUND)
+  set (SKYLARK_HAVE_ZSTD
+       1
+       CACHE
+       STRING
+       "Enables reading zstd compressed files"
+       FORCE)
+  include_directories (${ZSTD_INCLUDE_DIR})
+else (ZSTD_FOUND)
+  set (SKYLARK_HAVE_ZSTD
+       0
+       CACHE
+       STRING
+       "Enables reading zstd compressed files"
+       FORCE)
+endif (ZSTD_FOUND)
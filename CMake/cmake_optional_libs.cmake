@@ -14,6 +14,14 @@ if (SKYLARK_HAVE_HDF5)
   set(OPTIONAL_LIBS "${HDF5_LIBRARIES};${ZLIB_LIBRARIES};${OPTIONAL_LIBS}")
 endif (SKYLARK_HAVE_HDF5)
 
+if (SKYLARK_HAVE_ZLIB)
+  set(OPTIONAL_LIBS "${ZLIB_LIBRARIES};${OPTIONAL_LIBS}")
+endif (SKYLARK_HAVE_ZLIB)
+
+if (SKYLARK_HAVE_ZSTD)
+  set(OPTIONAL_LIBS "${ZSTD_LIBRARY};${OPTIONAL_LIBS}")
+endif (SKYLARK_HAVE_ZSTD)
+
 if (SKYLARK_HAVE_LIBHDFS)
   set(OPTIONAL_LIBS "${LIBHDFS_LIBRARIES};${JAVA_JVM_LIBRARY};${OPTIONAL_LIBS}")
 endif (SKYLARK_HAVE_LIBHDFS)
@@ -0,0 +1,45 @@
+#
+# Find zstd includes and library
+#
+# zstd
+# It can be found at:
+#
+# ZSTD_INCLUDE_DIR - where to find zstd.h.
+# ZSTD_LIBRARY     - qualified libraries to link against.
+# ZSTD_FOUND       - do not attempt to use if "no" or undefined.
+
+FIND_PATH(ZSTD_INCLUDE_DIR zstd.h
+  $ENV{ZSTD_ROOT}/include
+  $ENV{HOME}/.local/include
+  $ENV{HOME}/local/include
+  /usr/local/include
+  /usr/include
+  NO_DEFAULT_PATH
+)
+
+FIND_LIBRARY(ZSTD_LIBRARY zstd
+   $ENV{ZSTD_ROOT}/lib
+   $ENV{HOME}/.local/lib
+   $ENV{HOME}/local/lib
+   /usr/local/lib
+   /usr/lib
+   /usr/lib/x86_64-linux-gnu
+   NO_DEFAULT_PATH
+)
+
+IF(ZSTD_INCLUDE_DIR AND ZSTD_LIBRARY)
+  SET( ZSTD_FOUND "YES")
+ENDIF(ZSTD_INCLUDE_DIR AND ZSTD_LIBRARY)
+
+IF (ZSTD_FOUND)
+  IF (NOT ZSTD_FIND_QUIETLY)
+    MESSAGE(STATUS
+            "Found zstd:${ZSTD_LIBRARY}")
+  ENDIF (NOT ZSTD_FIND_QUIETLY)
+ELSE (ZSTD_FOUND)
+  IF (ZSTD_FIND_REQUIRED)
+    MESSAGE(STATUS "zstd not found!")
+  ELSE(ZSTD_FIND_REQUIRED)
+    MESSAGE(STATUS "Warning: zstd not found.")
+  ENDIF (ZSTD_FIND_REQUIRED)
+ENDIF (ZSTD_FOUND)
@@ -7,9 +7,183 @@
 #include "../../utility/external/print.hpp"
 #include "internal.hpp"
 #include "precond.hpp"
+#include "krylov_iter_params.hpp"
 
 namespace skylark { namespace algorithms {
 
+namespace internal {
+
+/**
+ * Pipelined CG (Ghysels and Vanroose): the dot products of an iteration are
+ * reduced together, and the reduction overlaps with the preconditioner and
+ * the matrix product of the iteration. The residual norm checked at an
+ * iteration is that of the current X, so one more product is done than in
+ * CG, and only the last one is wasted.
+ */
+template<typename MatrixType, typename RhsType, typename SolType>
+int PipelinedCG(El::UpperOrLower uplo, const MatrixType& A, const RhsType& B,
+    SolType& X, krylov_iter_params_t params,
+    const outplace_precond_t<RhsType, SolType>& M, std::true_type) {
+
+    int ret;
+
+    typedef typename utility::typer_t<MatrixType>::value_type value_type;
+    typedef typename utility::typer_t<MatrixType>::index_type index_type;
+
+    typedef RhsType rhs_type;
+    typedef SolType sol_type;
+
+    typedef utility::elem_extender_t<
+        typename internal::scalar_cont_typer_t<rhs_type>::type >
+        scalar_cont_type;
+
+    bool log_lev1 = params.am_i_printing && params.log_level >= 1;
+    bool log_lev2 = params.am_i_printing && params.log_level >= 2;
+
+    index_type k = base::Width(B);
+
+    const value_type eps = 32*std::numeric_limits<value_type>::epsilon();
+    if (params.tolerance<eps) params.tolerance=eps;
+    else if (params.tolerance>=1.0) params.tolerance=(1-eps);
+    else {} /* nothing */
+
+    // Without a preconditioner U = R, M = W and Q = S.
+    bool isprecond = !M.is_id();
+    rhs_type R(B), W(B), N(B), S(B), Z(B);
+    sol_type P(X);
+    sol_type &U = !isprecond ? R : *(new sol_type(X));
+    sol_type &Mw = !isprecond ? W : *(new sol_type(X));
+    sol_type &Q = !isprecond ? S : *(new sol_type(X));
+
+    // TODO should be Hemm
+    base::Symm(El::LEFT, uplo, value_type(-1.0), A, X, value_type(1.0), R);
+    if (isprecond)
+        M.apply(R, U);
+    base::Symm(El::LEFT, uplo, value_type(1.0), A, U, value_type(0.0), W);
+
+    scalar_cont_type
+        nrmb(internal::scalar_cont_typer_t<rhs_type>::build_compatible(k, 1, B));
+    base::ColumnNrm2(B, nrmb);
+    double total_nrmb = 0.0;
+    for(index_type i = 0; i < k; i++)
+        total_nrmb += nrmb[i] * nrmb[i];
+    total_nrmb = sqrt(total_nrmb);
+    scalar_cont_type ressqr(nrmb), gamma(nrmb), gamma0(nrmb), delta(nrmb),
+        alpha(nrmb), malpha(nrmb), beta(nrmb);
+
+    internal::fused_column_dots_t<rhs_type> dots(isprecond ? 3 : 2, k);
+
+    for (index_type itn=0; ; ++itn) {
+        dots.set(0, R, R);
+        dots.set(1, W, U);
+        if (isprecond)
+            dots.set(2, R, U);
+        dots.start();
+
+        if (itn < params.iter_lim) {
+            if (isprecond)
+                M.apply(W, Mw);
+            // TODO should be Hemm
+            base::Symm(El::LEFT, uplo, value_type(1.0), A, Mw,
+                value_type(0.0), N);
+        }
+
+        dots.wait();
+        dots.get(0, ressqr);
+        dots.get(1, delta);
+        dots.get(isprecond ? 2 : 0, gamma);
+
+        int convg = 0;
+        for(index_type i = 0; i < k; i++) {
+            if (sqrt(ressqr[i]) < (params.tolerance*nrmb[i]))
+                convg++;
+        }
+
+        if (log_lev2 && itn > 0 &&
+            ((itn - 1) % params.res_print == 0 || convg == k)) {
+            double total_ressqr = 0.0;
+            for(index_type i = 0; i < k; i++)
+                total_ressqr += ressqr[i];
+            double relres = sqrt(total_ressqr) / total_nrmb;
+            params.log_stream << params.prefix << "CG: Iteration " << itn - 1
+                              << ", Relres = "
+                              << boost::format("%.2e") % relres
+                              << ", " << convg << " rhs converged" << std::endl;
+        }
+
+        if(convg == k) {
+            if (log_lev1)
+                params.log_stream << params.prefix
+                                  << "CG: Convergence!" << std::endl;
+            ret = -1;
+            goto cleanup;
+        }
+
+        if (itn == params.iter_lim)
+            break;
+
+        for(index_type i = 0; i < k; i++) {
+            if (itn == 0) {
+                beta[i] = 0.0;
+                alpha[i] = gamma[i] / delta[i];
+            } else {
+                beta[i] = gamma[i] / gamma0[i];
+                alpha[i] = gamma[i] /
+                    (delta[i] - beta[i] * gamma[i] / alpha[i]);
+            }
+            malpha[i] = -alpha[i];
+        }
+        gamma0 = gamma;
+
+        El::DiagonalScale(El::RIGHT, El::NORMAL, beta, Z);
+        base::Axpy(value_type(1.0), N, Z);
+        if (isprecond) {
+            El::DiagonalScale(El::RIGHT, El::NORMAL, beta, Q);
+            base::Axpy(value_type(1.0), Mw, Q);
+        }
+        El::DiagonalScale(El::RIGHT, El::NORMAL, beta, S);
+        base::Axpy(value_type(1.0), W, S);
+        El::DiagonalScale(El::RIGHT, El::NORMAL, beta, P);
+        base::Axpy(value_type(1.0), U, P);
+
+        base::Axpy(alpha, P, X);
+        base::Axpy(malpha, S, R);
+        if (isprecond)
+            base::Axpy(malpha, Q, U);
+        base::Axpy(malpha, Z, W);
+    }
+
+    ret = -6;
+    if (log_lev1)
+        params.log_stream << params.prefix
+                          << "CG: No convergence within iteration limit."
+                          << std::endl;
+
+ cleanup:
+    if (isprecond) {
+        delete &U;
+        delete &Mw;
+        delete &Q;
+    }
+
+    return ret;
+}
+
+template<typename MatrixType, typename RhsType, typename SolType>
+int PipelinedCG(El::UpperOrLower uplo, const MatrixType& A, const RhsType& B,
+    SolType& X, krylov_iter_params_t params,
+    const outplace_precond_t<RhsType, SolType>& M, std::false_type) {
+
+    SKYLARK_THROW_EXCEPTION (
+        base::invalid_parameters()
+        << base::error_msg("Pipelined CG requires the right-hand side "
+            "and the solution to have the same type"));
+
+    return -6;
+}
+
+} // namespace internal
+
 /**
  * CG method.
  *
@@ -18,6 +192,14 @@ namespace skylark { namespace algorithms {
  * that the code will operate actually on A^T in that case.
  *
  * X should be allocated, and we use it as initial value.
+ *
+ * With params.pipelined the pipelined variant is used (see
+ * internal::PipelinedCG), which needs three more vectors (six with a
+ * preconditioner) but only one reduction per iteration.
+ *
+ * With params.deflate (the default) right-hand sides that converge are
+ * dropped from the block, so the remaining iterations only cost as much
+ * as the columns still active.
  */
 template<typename MatrixType, typename RhsType, typename SolType>
 int CG(El::UpperOrLower uplo, const MatrixType& A, const RhsType& B, SolType& X,
@@ -25,6 +207,10 @@ int CG(El::UpperOrLower uplo, const MatrixType& A, const RhsType& B, SolType& X,
     const outplace_precond_t<RhsType, SolType>& M =
     outplace_id_precond_t<RhsType, SolType>()) {
 
+    if (params.pipelined)
+        return internal::PipelinedCG(uplo, A, B, X, params, M,
+            typename std::is_same<RhsType, SolType>::type());
+
     int ret;
 
     typedef typename utility::typer_t<MatrixType>::value_type value_type;
@@ -73,7 +259,14 @@ int CG(El::UpperOrLower uplo, const MatrixType& A, const RhsType& B, SolType& X,
         alpha(nrmb), malpha(nrmb), beta(nrmb);
     base::ColumnDot(R, R, ressqr);
 
-    for (index_type itn=0; itn<params.iter_lim; ++itn) {
+    // Deflated (converged) right-hand sides: their number and residuals.
+    internal::active_columns_t<sol_type> columns(X);
+    sol_type *Xw = &X;
+    index_type ndone = 0;
+    double done_ressqr = 0.0;
+    index_type itn;
+
+    for (itn=0; itn<params.iter_lim; ++itn) {
         if (isprecond) {
             M.apply(R, Z);
             base::ColumnDot(R, Z, rho);
@@ -98,7 +291,7 @@ int CG(El::UpperOrLower uplo, const MatrixType& A, const RhsType& B, SolType& X,
             malpha[i] = -alpha[i];
         }
 
-        base::Axpy(alpha, P, X);
+        base::Axpy(alpha, P, *Xw);
         base::Axpy(malpha, Q, R);
 
         rho0 = rho;
@@ -106,20 +299,23 @@ int CG(El::UpperOrLower uplo, const MatrixType& A, const RhsType& B, SolType& X,
         base::ColumnDot(R, R, ressqr);
 
         int convg = 0;
+        std::vector<bool> done(k);
         for(index_type i = 0; i < k; i++) {
-            if (sqrt(ressqr[i]) < (params.tolerance*nrmb[i]))
+            done[i] = sqrt(ressqr[i]) < (params.tolerance*nrmb[i]);
+            if (done[i])
                 convg++;
         }
 
         if (log_lev2 && (itn % params.res_print == 0 || convg == k)) {
-            double total_ressqr = 0.0;
+            double total_ressqr = done_ressqr;
             for(index_type i = 0; i < k; i++)
                 total_ressqr += ressqr[i];
             double relres = sqrt(total_ressqr) / total_nrmb;
             params.log_stream << params.prefix << "CG: Iteration " << itn
                               << ", Relres = "
                               << boost::format("%.2e") % relres
-                              << ", " << convg << " rhs converged" << std::endl;
+                              << ", " << ndone + convg << " rhs converged"
+                              << std::endl;
         }
 
         if(convg == k) {
@@ -127,8 +323,28 @@ int CG(El::UpperOrLower uplo, const MatrixType& A, const RhsType& B, SolType& X,
                 params.log_stream << params.prefix
                                   << "CG: Convergence!" << std::endl;
             ret = -1;
+            ++itn;
             goto cleanup;
         }
+
+        if (params.deflate && convg > 0) {
+            for(index_type i = 0; i < k; i++)
+                if (done[i])
+                    done_ressqr += ressqr[i];
+            std::vector<El::Int> keep = columns.deflate(done, itn);
+            Xw = &columns.solution();
+            internal::KeepColumns(keep, P);
+            internal::KeepColumns(keep, R);
+            internal::KeepColumns(keep, Q);
+            if (isprecond)
+                internal::KeepColumns(keep, Z);
+            scalar_cont_type *scalars[] =
+                {&nrmb, &ressqr, &rho, &rho0, &rhotmp, &alpha, &malpha, &beta};
+            for(scalar_cont_type *c : scalars)
+                internal::KeepEntries(keep, *c);
+            ndone += convg;
+            k -= convg;
+        }
     }
 
     ret = -6;
@@ -138,6 +354,7 @@ int CG(El::UpperOrLower uplo, const MatrixType& A, const RhsType& B, SolType& X,
                           << std::endl;
 
  cleanup:
+    columns.finish(itn, params.column_iterations);
     if (isprecond)
         delete &Z;
 
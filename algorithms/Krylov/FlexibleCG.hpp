@@ -18,6 +18,9 @@ namespace skylark { namespace algorithms {
  * that the code will operate actually on A^T in that case.
  *
  * X should be allocated, and we use it as initial value.
+ *
+ * With params.deflate (the default) right-hand sides that converge are
+ * dropped from the block, along with their past directions.
  */
 template<typename MatrixType, typename RhsType, typename SolType>
 int FlexibleCG(const MatrixType& A, const RhsType& B, SolType& X,
@@ -77,7 +80,14 @@ int FlexibleCG(const MatrixType& A, const RhsType& B, SolType& X,
     total_nrmb = sqrt(total_nrmb);
     base::ColumnDot(R, R, ressqr);
 
-    for (index_t itn=0; itn<params.iter_lim; ++itn) {
+    // Deflated (converged) right-hand sides: their number and residuals.
+    internal::active_columns_t<sol_type> columns(X);
+    sol_type *Xw = &X;
+    index_t ndone = 0;
+    double done_ressqr = 0.0;
+    index_t itn;
+
+    for (itn=0; itn<params.iter_lim; ++itn) {
         sol_type &d = D[itn];
         rhs_type &l = L[itn];
 
@@ -107,18 +117,21 @@ int FlexibleCG(const MatrixType& A, const RhsType& B, SolType& X,
         El::DiagonalScale(El::RIGHT, El::NORMAL, beta, d);
         El::DiagonalScale(El::RIGHT, El::NORMAL, beta, l);
 
-        base::Axpy(alpha, d, X);
+        base::Axpy(alpha, d, *Xw);
         base::Axpy(malpha, l, R);
 
         base::ColumnDot(R, R, ressqr);
 
         int convg = 0;
-        for(index_t i = 0; i < k; i++)
-            if (sqrt(ressqr[i]) < (params.tolerance*nrmb[i]))
+        std::vector<bool> done(k);
+        for(index_t i = 0; i < k; i++) {
+            done[i] = sqrt(ressqr[i]) < (params.tolerance*nrmb[i]);
+            if (done[i])
                 convg++;
+        }
 
         if (log_lev2 && (itn % params.res_print == 0 || convg == k)) {
-            double total_ressqr = 0.0;
+            double total_ressqr = done_ressqr;
             for(index_t i = 0; i < k; i++)
                 total_ressqr += ressqr[i];
             double relres = sqrt(total_ressqr) / total_nrmb;
@@ -126,7 +139,8 @@ int FlexibleCG(const MatrixType& A, const RhsType& B, SolType& X,
                               << "FlexibleCG: Iteration " << itn
                               << ", Relres = "
                               << boost::format("%.2e") % relres
-                              << ", " << convg << " rhs converged" << std::endl;
+                              << ", " << ndone + convg << " rhs converged"
+                              << std::endl;
         }
 
         if(convg == k) {
@@ -134,8 +148,32 @@ int FlexibleCG(const MatrixType& A, const RhsType& B, SolType& X,
                 params.log_stream << params.prefix
                                   << "FlexibleCG: Convergence!" << std::endl;
             ret = -1;
+            ++itn;
             goto cleanup;
         }
+
+        if (params.deflate && convg > 0) {
+            for(index_t i = 0; i < k; i++)
+                if (done[i])
+                    done_ressqr += ressqr[i];
+            std::vector<El::Int> keep = columns.deflate(done, itn);
+            Xw = &columns.solution();
+            internal::KeepColumns(keep, R);
+            for(index_t i = 0; i <= itn; i++) {
+                internal::KeepColumns(keep, D[i]);
+                internal::KeepColumns(keep, L[i]);
+            }
+            for(index_t i = itn + 1; i < maxit; i++) {
+                D[i].Resize(base::Height(D[i]), keep.size());
+                L[i].Resize(base::Height(L[i]), keep.size());
+            }
+            scalar_cont_type *scalars[] =
+                {&nrmb, &ressqr, &beta, &alpha, &malpha, &gamma, &mgamma};
+            for(scalar_cont_type *c : scalars)
+                internal::KeepEntries(keep, *c);
+            ndone += convg;
+            k -= convg;
+        }
     }
 
 
@@ -146,6 +184,7 @@ int FlexibleCG(const MatrixType& A, const RhsType& B, SolType& X,
    ret = -6;
 
  cleanup:
+   columns.finish(itn, params.column_iterations);
    delete []D;
    delete []L;
 
@@ -12,16 +12,303 @@
 namespace skylark {
 namespace algorithms {
 
+namespace internal {
+
+/**
+ * Pipelined LSQR: the same iteration as LSQR, but the three reductions of
+ * an iteration (beta, alpha and the norm of W) are replaced by two fused
+ * ones, each started before a product with A or A' that does not depend on
+ * it and waited for after. The products are done on the unnormalized
+ * vectors and scaled afterwards, and the norm of W is updated by
+ * recurrence from the fused (Z, Z) and (Z, W).
+ */
+template<typename MatrixType, typename RhsType, typename SolType>
+int PipelinedLSQR(const MatrixType& A, const RhsType& B, SolType& X,
+    krylov_iter_params_t params, const inplace_precond_t<SolType>& R) {
+
+    typedef typename utility::typer_t<MatrixType>::value_type value_type;
+    typedef typename utility::typer_t<MatrixType>::index_type index_type;
+
+    typedef RhsType rhs_type;        // Also serves as "long" vector type.
+    typedef SolType sol_type;        // Also serves as "short" vector type.
+
+    typedef utility::print_t<rhs_type> rhs_print_t;
+    typedef utility::print_t<sol_type> sol_print_t;
+
+    typedef utility::elem_extender_t<
+        typename internal::scalar_cont_typer_t<rhs_type>::type >
+        scalar_cont_type;
+
+    bool log_lev1 = params.am_i_printing && params.log_level >= 1;
+    bool log_lev2 = params.am_i_printing && params.log_level >= 2;
+
+    index_type m = base::Height(A);
+    index_type n = base::Width(A);
+    index_type k = base::Width(B);
+
+    const value_type eps = 32*std::numeric_limits<value_type>::epsilon();
+    if (params.tolerance<eps) params.tolerance=eps;
+    else if (params.tolerance>=1.0) params.tolerance=(1-eps);
+    else {} /* nothing */
+
+    /** Initialize everything (as in LSQR) */
+    rhs_type U(B);
+    scalar_cont_type
+        beta(internal::scalar_cont_typer_t<rhs_type>::build_compatible(k, 1, U));
+    scalar_cont_type i_beta(beta);
+    base::ColumnNrm2(U, beta);
+    for (index_type i=0; i<k; ++i)
+        i_beta[i] = 1 / beta[i];
+    El::DiagonalScale(El::RIGHT, El::NORMAL, i_beta, U);
+    rhs_print_t::apply(U, "U Init", params.am_i_printing, params.debug_level);
+
+    sol_type V(X);
+    base::Gemm(El::ADJOINT, El::NORMAL, value_type(1.0), A, U, V);
+    R.apply_adjoint(V);
+    scalar_cont_type alpha(beta), i_alpha(beta);
+    base::ColumnNrm2(V, alpha);
+    for (index_type i=0; i<k; ++i)
+        i_alpha[i] = 1 / alpha[i];
+    El::DiagonalScale(El::RIGHT, El::NORMAL, i_alpha, V);
+    sol_type Z(V);
+    R.apply(Z);
+    sol_print_t::apply(V, "V Init", params.am_i_printing, params.debug_level);
+
+    El::Zero(X);
+    sol_type W(Z);
+    scalar_cont_type phibar(beta), rhobar(alpha), nrm_r(beta);
+    scalar_cont_type nrm_a(beta), cnd_a(beta), sq_d(beta), nrm_ar_0(beta);
+    El::Zero(nrm_a); El::Zero(cnd_a); El::Zero(sq_d);
+    El::Hadamard(alpha, beta, nrm_ar_0);
+
+    for (index_type i=0; i<k; ++i)
+        if (nrm_ar_0[i]==0)
+            return 0;
+
+    scalar_cont_type nrm_x(beta), sq_x(beta), z(beta), cs2(beta), sn2(beta);
+    El::Zero(nrm_x); El::Zero(sq_x); El::Zero(z); El::Zero(sn2);
+    for (index_type i=0; i<k; ++i)
+        cs2[i] = -1.0;
+
+    int max_n_stag = 3;
+    std::vector<int> stag(k, 0);
+
+    if (0>params.iter_lim)
+        params.iter_lim = std::max(static_cast<index_type>(20), 2*std::min(m,n));
+
+    // AZ = A * Z and AU = R' * A' * U are kept one step ahead.
+    rhs_type AZ(B);
+    base::Gemm(El::NORMAL, El::NORMAL, value_type(1.0), A, Z,
+        value_type(0.0), AZ);
+    sol_type AU(X);
+
+    scalar_cont_type minus_beta(beta), rho(beta);
+    scalar_cont_type cs(beta), sn(beta), theta(beta), phi(beta);
+    scalar_cont_type phi_by_rho(beta), minus_theta_by_rho(beta), nrm_ar(beta);
+    scalar_cont_type nrm_w(beta), sq_w(beta), gamma(beta);
+    scalar_cont_type delta(beta), gambar(beta), rhs(beta), zbar(beta);
+    scalar_cont_type sq_z(beta), zw(beta);
+
+    base::ColumnNrm2(W, nrm_w);
+    for (index_type i=0; i<k; ++i)
+        sq_w[i] = nrm_w[i]*nrm_w[i];
+
+    internal::fused_column_dots_t<rhs_type> beta_dots(1, k);
+    internal::fused_column_dots_t<sol_type> alpha_dots(3, k);
+
+    /** Main iteration loop */
+    for (index_type itn=0; itn<params.iter_lim; ++itn) {
+
+        /** 1. Update u and beta, overlapped with A' * u */
+        El::Scale(value_type(-1.0), alpha);
+        El::DiagonalScale(El::RIGHT, El::NORMAL, alpha, U);
+        base::Axpy(value_type(1.0), AZ, U);
+        beta_dots.set(0, U, U);
+        beta_dots.start();
+
+        base::Gemm(El::ADJOINT, El::NORMAL, value_type(1.0), A, U, AU);
+        R.apply_adjoint(AU);
+
+        beta_dots.wait();
+        beta_dots.get(0, beta);
+        for (index_type i=0; i<k; ++i) {
+            beta[i] = sqrt(beta[i]);
+            i_beta[i] = 1 / beta[i];
+        }
+        El::DiagonalScale(El::RIGHT, El::NORMAL, i_beta, U);
+        El::DiagonalScale(El::RIGHT, El::NORMAL, i_beta, AU);
+
+        /** 2. Estimate norm of A */
+        for (index_type i=0; i<k; ++i) {
+            double a = nrm_a[i], b = alpha[i], c = beta[i];
+            nrm_a[i] = sqrt(a*a + b*b + c*c);
+        }
+
+        /** 3. Update v and alpha, overlapped with A * z */
+        for (index_type i=0; i<k; ++i)
+            minus_beta[i] = -beta[i];
+        El::DiagonalScale(El::RIGHT, El::NORMAL, minus_beta, V);
+        base::Axpy(value_type(1.0), AU, V);
+        Z = V; R.apply(Z);
+        alpha_dots.set(0, V, V);
+        alpha_dots.set(1, Z, Z);
+        alpha_dots.set(2, Z, W);
+        alpha_dots.start();
+
+        base::Gemm(El::NORMAL, El::NORMAL, value_type(1.0), A, Z,
+            value_type(0.0), AZ);
+
+        alpha_dots.wait();
+        alpha_dots.get(0, alpha);
+        alpha_dots.get(1, sq_z);
+        alpha_dots.get(2, zw);
+        for (index_type i=0; i<k; ++i) {
+            alpha[i] = sqrt(alpha[i]);
+            i_alpha[i] = 1 / alpha[i];
+            sq_z[i] *= i_alpha[i]*i_alpha[i];
+            zw[i] *= i_alpha[i];
+        }
+        El::DiagonalScale(El::RIGHT, El::NORMAL, i_alpha, V);
+        El::DiagonalScale(El::RIGHT, El::NORMAL, i_alpha, Z);
+        El::DiagonalScale(El::RIGHT, El::NORMAL, i_alpha, AZ);
+
+       /** 4. Define some variables */
+        for (index_type i=0; i<k; ++i) {
+            rho[i] = sqrt((rhobar[i]*rhobar[i]) + (beta[i]*beta[i]));
+            cs[i] = rhobar[i]/rho[i];
+            sn[i] =  beta[i]/rho[i];
+            theta[i] = sn[i]*alpha[i];
+            rhobar[i] = -cs[i]*alpha[i];
+            phi[i] = cs[i]*phibar[i];
+            phibar[i] =  sn[i]*phibar[i];
+        }
+
+        /** 5. Update X and W (and the norm of W) */
+        for (index_type i=0; i<k; ++i)
+            phi_by_rho[i] = phi[i]/rho[i];
+        base::Axpy(phi_by_rho, W, X);
+        sol_print_t::apply(X, "X", params.am_i_printing, params.debug_level);
+
+        for (index_type i=0; i<k; ++i) {
+            minus_theta_by_rho[i] = -theta[i]/rho[i];
+            double c = minus_theta_by_rho[i];
+            double sq = sq_z[i] + 2*c*zw[i] + c*c*sq_w[i];
+            sq_w[i] = std::max(0.0, sq);
+            nrm_w[i] = sqrt(sq_w[i]);
+        }
+        El::DiagonalScale(El::RIGHT, El::NORMAL, minus_theta_by_rho, W);
+        base::Axpy(value_type(1.0), Z, W);
+        sol_print_t::apply(W, "W", params.am_i_printing, params.debug_level);
+
+        /** 6. Estimate norm(r) */
+        nrm_r = phibar;
+
+        /** 7. estimate of norm(A'*r) */
+        index_type cond_s1 = 0, cond_s2 = 0;
+        for (index_type i=0; i<k; ++i) {
+            nrm_ar[i] = std::abs(phibar[i]*alpha[i]*cs[i]);
+
+            if (log_lev2)
+                params.log_stream << params.prefix
+                                  << "LSQR: Iteration " << i << "/" << itn
+                                  << ": " << nrm_ar[i]
+                                  << std::endl;
+
+            if (nrm_ar[i]<(params.tolerance*nrm_ar_0[i]))
+                cond_s1++;
+            if (nrm_ar[i]<(eps*nrm_a[i]*nrm_r[i]))
+                cond_s2++;
+        }
+
+        /** 8. check convergence */
+        if (cond_s1 == k) {
+            if (log_lev1)
+                params.log_stream << params.prefix
+                                  << "LSQR: Convergence (S1)!" << std::endl;
+            return -2;
+        }
+
+        if (cond_s2 == k) {
+            if (log_lev1)
+                params.log_stream << params.prefix
+                                  << "LSQR: Convergence (S2)!" << std::endl;
+            return -3;
+        }
+
+        /** 9. estimate of cond(A) */
+        for (index_type i=0; i<k; ++i) {
+            sq_d[i] += sq_w[i]/(rho[i]*rho[i]);
+            cnd_a[i] = nrm_a[i]*sqrt(sq_d[i]);
+
+            /** 10. check condition number */
+            if (cnd_a[i]>(1.0/eps)) {
+                if (log_lev1)
+                    params.log_stream << params.prefix
+                                      << "LSQR: Stopping (S3)!" << std::endl;
+                return -4;
+            }
+        }
+
+        /** 11. check stagnation */
+        for (index_type i=0; i<k; ++i) {
+            if (std::abs(phi[i]/rho[i])*nrm_w[i] < (eps*nrm_x[i]))
+                stag[i]++;
+            else
+                stag[i] = 0;
+
+            if (stag[i] >= max_n_stag) {
+                if (log_lev1)
+                    params.log_stream << params.prefix
+                                      << "LSQR: Stagnation." << std::endl;
+                return -5;
+            }
+        }
+
+        /** 12. estimate of norm(X) */
+        for (index_type i=0; i<k; ++i) {
+            delta[i] =  sn2[i]*rho[i];
+            gambar[i] = -cs2[i]*rho[i];
+            rhs[i] = phi[i] - delta[i]*z[i];
+            zbar[i] = rhs[i]/gambar[i];
+            nrm_x[i] = sqrt(sq_x[i] + (zbar[i]*zbar[i]));
+            gamma[i] = sqrt((gambar[i]*gambar[i]) + (theta[i]*theta[i]));
+            cs2[i] = gambar[i]/gamma[i];
+            sn2[i] = theta[i]/gamma[i];
+            z[i] = rhs[i]/gamma[i];
+            sq_x[i] += z[i]*z[i];
+        }
+    }
+    if (log_lev1)
+        params.log_stream << params.prefix
+                          << "LSQR: No convergence within iteration limit."
+                          << std::endl;
+
+    return -6;
+}
+
+} // namespace internal
+
 /**
  * LSQR method.
  *
  * X should be allocated, but we zero it on start. (not set as X_0).
+ *
+ * With params.pipelined the pipelined variant is used (see
+ * internal::PipelinedLSQR): two reductions per iteration instead of three,
+ * each overlapped with a product with A, for two more vectors.
+ *
+ * With params.deflate (the default) a right-hand side is dropped from the
+ * block once it meets S1 or S2. The block then returns -2 if all of them
+ * met S1, and -3 otherwise.
  */
 template<typename MatrixType, typename RhsType, typename SolType>
 int LSQR(const MatrixType& A, const RhsType& B, SolType& X,
     krylov_iter_params_t params = krylov_iter_params_t(),
     const inplace_precond_t<SolType>& R = inplace_id_precond_t<SolType>()) {
 
+    if (params.pipelined)
+        return internal::PipelinedLSQR(A, B, X, params, R);
+
     typedef typename utility::typer_t<MatrixType>::value_type value_type;
     typedef typename utility::typer_t<MatrixType>::index_type index_type;
 
@@ -109,8 +396,15 @@ int LSQR(const MatrixType& A, const RhsType& B, SolType& X,
     scalar_cont_type nrm_w(beta), sq_w(beta), gamma(beta);
     scalar_cont_type delta(beta), gambar(beta), rhs(beta), zbar(beta);
 
+    /* Deflation of converged right-hand sides */
+    internal::active_columns_t<sol_type> columns(X);
+    sol_type *Xw = &X;
+    bool all_s1 = true;
+    int ret;
+    index_type itn;
+
     /** Main iteration loop */
-    for (index_type itn=0; itn<params.iter_lim; ++itn) {
+    for (itn=0; itn<params.iter_lim; ++itn) {
 
         /** 1. Update u and beta */
         El::Scale(value_type(-1.0), alpha);
@@ -156,8 +450,8 @@ int LSQR(const MatrixType& A, const RhsType& B, SolType& X,
         /** 5. Update X and W */
         for (index_type i=0; i<k; ++i)
             phi_by_rho[i] = phi[i]/rho[i];
-        base::Axpy(phi_by_rho, W, X);
-        sol_print_t::apply(X, "X", params.am_i_printing, params.debug_level);
+        base::Axpy(phi_by_rho, W, *Xw);
+        sol_print_t::apply(*Xw, "X", params.am_i_printing, params.debug_level);
 
         for (index_type i=0; i<k; ++i)
             minus_theta_by_rho[i] = -theta[i]/rho[i];
@@ -169,36 +463,45 @@ int LSQR(const MatrixType& A, const RhsType& B, SolType& X,
         nrm_r = phibar;
 
         /** 7. estimate of norm(A'*r) */
-        index_type cond_s1 = 0, cond_s2 = 0;
+        index_type cond_s1 = 0, cond_s2 = 0, convg = 0;
+        std::vector<bool> s1(k), done(k);
         for (index_type i=0; i<k; ++i) {
             nrm_ar[i] = std::abs(phibar[i]*alpha[i]*cs[i]);
 
             if (log_lev2)
                 params.log_stream << params.prefix
-                                  << "LSQR: Iteration " << i << "/" << itn
-                                  << ": " << nrm_ar[i]
+                                  << "LSQR: Iteration " << columns.active[i]
+                                  << "/" << itn << ": " << nrm_ar[i]
                                   << std::endl;
 
 
-            if (nrm_ar[i]<(params.tolerance*nrm_ar_0[i]))
+            s1[i] = nrm_ar[i]<(params.tolerance*nrm_ar_0[i]);
+            done[i] = s1[i] || nrm_ar[i]<(eps*nrm_a[i]*nrm_r[i]);
+            if (s1[i])
                 cond_s1++;
             if (nrm_ar[i]<(eps*nrm_a[i]*nrm_r[i]))
                 cond_s2++;
+            if (done[i])
+                convg++;
         }
 
-        /** 8. check convergence */
-        if (cond_s1 == k) {
+        /** 8. check convergence (of the columns not deflated before) */
+        if (cond_s1 == k && all_s1) {
             if (log_lev1)
                 params.log_stream << params.prefix
                                   << "LSQR: Convergence (S1)!" << std::endl;
-            return -2;
+            ret = -2;
+            ++itn;
+            goto cleanup;
         }
 
-        if (cond_s2 == k) {
+        if (cond_s2 == k || (params.deflate && convg == k)) {
             if (log_lev1)
                 params.log_stream << params.prefix
                                   << "LSQR: Convergence (S2)!" << std::endl;
-            return -3;
+            ret = -3;
+            ++itn;
+            goto cleanup;
         }
 
         /** 9. estimate of cond(A) */
@@ -213,7 +516,9 @@ int LSQR(const MatrixType& A, const RhsType& B, SolType& X,
                 if (log_lev1)
                     params.log_stream << params.prefix
                                       << "LSQR: Stopping (S3)!" << std::endl;
-                return -4;
+                ret = -4;
+                ++itn;
+                goto cleanup;
             }
         }
 
@@ -228,7 +533,9 @@ int LSQR(const MatrixType& A, const RhsType& B, SolType& X,
                 if (log_lev1)
                     params.log_stream << params.prefix
                                       << "LSQR: Stagnation." << std::endl;
-                return -5;
+                ret = -5;
+                ++itn;
+                goto cleanup;
             }
         }
 
@@ -245,13 +552,42 @@ int LSQR(const MatrixType& A, const RhsType& B, SolType& X,
             z[i] = rhs[i]/gamma[i];
             sq_x[i] += z[i]*z[i];
         }
+
+        /** 13. deflate the columns that converged */
+        if (params.deflate && convg > 0) {
+            for (index_type i=0; i<k; ++i)
+                if (done[i] && !s1[i])
+                    all_s1 = false;
+
+            std::vector<El::Int> keep = columns.deflate(done, itn);
+            Xw = &columns.solution();
+            internal::KeepColumns(keep, U);
+            internal::KeepColumns(keep, V);
+            internal::KeepColumns(keep, Z);
+            internal::KeepColumns(keep, W);
+            internal::KeepColumns(keep, AU);
+            scalar_cont_type *scalars[] = {&beta, &i_beta, &alpha, &i_alpha,
+                &phibar, &rhobar, &nrm_r, &nrm_a, &cnd_a, &sq_d, &nrm_ar_0,
+                &nrm_x, &sq_x, &z, &cs2, &sn2, &minus_beta, &rho, &cs, &sn,
+                &theta, &phi, &phi_by_rho, &minus_theta_by_rho, &nrm_ar,
+                &nrm_w, &sq_w, &gamma, &delta, &gambar, &rhs, &zbar};
+            for(scalar_cont_type *c : scalars)
+                internal::KeepEntries(keep, *c);
+            for(size_t i = 0; i < keep.size(); i++)
+                stag[i] = stag[keep[i]];
+            stag.resize(keep.size());
+            k = keep.size();
+        }
     }
     if (log_lev1)
         params.log_stream << params.prefix
                           << "LSQR: No convergence within iteration limit."
                           << std::endl;
+    ret = -6;
 
-    return -6;
+ cleanup:
+    columns.finish(itn, params.column_iterations);
+    return ret;
 }
 
 } } /** namespace skylark::algorithms */
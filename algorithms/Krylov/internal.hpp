@@ -1,6 +1,12 @@
 #ifndef SKYLARK_KRYLOV_INTERNAL_HPP
 #define SKYLARK_KRYLOV_INTERNAL_HPP
 
+#include <algorithm>
+#include <vector>
+
+#include <boost/mpi.hpp>
+#include <boost/scoped_ptr.hpp>
+
 #include "../../base/base.hpp"
 #include "../../utility/elem_extender.hpp"
 #include "../../utility/typer.hpp"
@@ -41,6 +47,221 @@ struct scalar_cont_typer_t<base::sparse_matrix_t<F> > {
     }
 };
 
+/**
+ * Keeps only the columns keep[0] < keep[1] < ... of A, in that order
+ * (deflation of the right-hand sides that converged).
+ */
+template<typename MatrixType>
+void KeepColumns(const std::vector<El::Int>& keep, MatrixType& A) {
+    El::Int h = A.Height(), kk = keep.size();
+    for(El::Int i = 0; i < kk; i++)
+        if (keep[i] != i) {
+            MatrixType Ai, Aj;
+            El::View(Ai, A, 0, i, h, 1);
+            El::LockedView(Aj, A, 0, keep[i], h, 1);
+            El::Copy(Aj, Ai);
+        }
+
+    MatrixType Av;
+    El::LockedView(Av, A, 0, 0, h, kk);
+    MatrixType C(Av);
+    A = C;
+}
+
+/**
+ * Keeps only the entries keep[0] < keep[1] < ... of a scalar container.
+ */
+template<typename ScalarContType>
+void KeepEntries(const std::vector<El::Int>& keep, ScalarContType& s) {
+    std::vector<double> values(keep.size());
+    for(size_t i = 0; i < keep.size(); i++)
+        values[i] = s[keep[i]];
+    s.Resize(keep.size(), 1);
+    for(size_t i = 0; i < keep.size(); i++)
+        s[i] = values[i];
+}
+
+/** B(:, l) = A(:, j) */
+template<typename MatrixType>
+void CopyColumn(const MatrixType& A, El::Int j, MatrixType& B, El::Int l) {
+    MatrixType Aj, Bl;
+    El::LockedView(Aj, A, 0, j, A.Height(), 1);
+    El::View(Bl, B, 0, l, B.Height(), 1);
+    El::Copy(Aj, Bl);
+}
+
+/**
+ * Bookkeeping of the right-hand sides still iterated on: active[i] is the
+ * original column of working column i. Until some column is deflated the
+ * solver works on X itself; deflate() writes the solution of the working
+ * columns that converged to X, compacts the working solution() and
+ * returns the working columns to keep, and finish() writes back the rest.
+ */
+template<typename SolType>
+struct active_columns_t {
+
+    std::vector<El::Int> active;
+    std::vector<int> iterations;
+
+    active_columns_t(SolType& X) :
+        active(base::Width(X)), iterations(base::Width(X), 0), _X(X) {
+        for(size_t i = 0; i < active.size(); i++)
+            active[i] = i;
+    }
+
+    SolType& solution() { return _work ? *_work : _X; }
+
+    std::vector<El::Int> deflate(const std::vector<bool>& done, int itn) {
+        if (!_work)
+            _work.reset(new SolType(_X));
+        else
+            for(size_t i = 0; i < active.size(); i++)
+                if (done[i])
+                    CopyColumn(*_work, i, _X, active[i]);
+
+        std::vector<El::Int> keep, stillactive;
+        for(size_t i = 0; i < active.size(); i++)
+            if (done[i])
+                iterations[active[i]] = itn + 1;
+            else {
+                keep.push_back(i);
+                stillactive.push_back(active[i]);
+            }
+        active.swap(stillactive);
+        KeepColumns(keep, *_work);
+        return keep;
+    }
+
+    /** itn iterations were done on the columns still active. */
+    void finish(int itn, std::vector<int> *column_iterations) {
+        for(size_t i = 0; i < active.size(); i++) {
+            iterations[active[i]] = itn;
+            if (_work)
+                CopyColumn(*_work, i, _X, active[i]);
+        }
+
+        if (column_iterations != nullptr)
+            *column_iterations = iterations;
+    }
+
+private:
+    SolType& _X;
+    boost::scoped_ptr<SolType> _work;
+};
+
+/**
+ * Column dot products of several pairs of matrices, reduced together: set()
+ * computes the local part of product i, start() starts a single reduction
+ * for all of them (non-blocking with MPI-3), and after wait() get() returns
+ * product i, one value per column. Whatever is done between start() and
+ * wait() overlaps with the reduction.
+ */
+template<typename MatrixType>
+struct fused_column_dots_t {
+
+};
+
+template<typename F>
+struct fused_column_dots_t<El::Matrix<F> > {
+
+    fused_column_dots_t(int num, int k) : _k(k), _dots(num * k) { }
+
+    void set(int i, const El::Matrix<F>& A, const El::Matrix<F>& B) {
+        const F *a = A.LockedBuffer(), *b = B.LockedBuffer();
+        for(El::Int j = 0; j < A.Width(); j++) {
+            F d = 0.0;
+            for(El::Int l = 0; l < A.Height(); l++)
+                d += a[j * A.LDim() + l] * El::Conj(b[j * B.LDim() + l]);
+            _dots[i * _k + j] = d;
+        }
+    }
+
+    void start() { }
+    void wait() { }
+
+    template<typename ScalarContType>
+    void get(int i, ScalarContType& dots) const {
+        for(int j = 0; j < _k; j++)
+            dots[j] = _dots[i * _k + j];
+    }
+
+private:
+    const int _k;
+    std::vector<F> _dots;
+};
+
+template<typename F>
+struct fused_column_dots_t<El::DistMatrix<F, El::STAR, El::STAR> > {
+
+    fused_column_dots_t(int num, int k) : _local(num, k) { }
+
+    void set(int i, const El::DistMatrix<F, El::STAR, El::STAR>& A,
+        const El::DistMatrix<F, El::STAR, El::STAR>& B) {
+        _local.set(i, A.LockedMatrix(), B.LockedMatrix());
+    }
+
+    void start() { }
+    void wait() { }
+
+    template<typename ScalarContType>
+    void get(int i, ScalarContType& dots) const { _local.get(i, dots); }
+
+private:
+    fused_column_dots_t<El::Matrix<F> > _local;
+};
+
+template<typename F, El::Distribution U, El::Distribution V>
+struct fused_column_dots_t<El::DistMatrix<F, U, V> > {
+
+    fused_column_dots_t(int num, int k) :
+        _k(k), _local(num * k), _dots(num * k),
+        _comm(MPI_COMM_NULL), _request(MPI_REQUEST_NULL) { }
+
+    ~fused_column_dots_t() { wait(); }
+
+    void set(int i, const El::DistMatrix<F, U, V>& A,
+        const El::DistMatrix<F, U, V>& B) {
+
+        // Assumes A and B are aligned.
+        const El::Matrix<F> &Al = A.LockedMatrix(), &Bl = B.LockedMatrix();
+        const F *a = Al.LockedBuffer(), *b = Bl.LockedBuffer();
+        std::fill(_local.begin() + i * _k, _local.begin() + (i + 1) * _k, 0);
+        for(El::Int j = 0; j < Al.Width(); j++)
+            for(El::Int l = 0; l < Al.Height(); l++)
+                _local[i * _k + A.GlobalCol(j)] +=
+                    a[j * Al.LDim() + l] * El::Conj(b[j * Bl.LDim() + l]);
+        _comm = A.DistComm().comm;
+    }
+
+    void start() {
+        MPI_Datatype type = boost::mpi::get_mpi_datatype<F>(F());
+#if MPI_VERSION >= 3
+        MPI_Iallreduce(_local.data(), _dots.data(), _local.size(), type,
+            MPI_SUM, _comm, &_request);
+#else
+        MPI_Allreduce(_local.data(), _dots.data(), _local.size(), type,
+            MPI_SUM, _comm);
+#endif
+    }
+
+    void wait() {
+        if (_request != MPI_REQUEST_NULL)
+            MPI_Wait(&_request, MPI_STATUS_IGNORE);
+    }
+
+    template<typename ScalarContType>
+    void get(int i, ScalarContType& dots) const {
+        for(int j = 0; j < _k; j++)
+            dots[j] = _dots[i * _k + j];
+    }
+
+private:
+    const int _k;
+    std::vector<F> _local, _dots;
+    MPI_Comm _comm;
+    MPI_Request _request;
+};
+
 } // namespace internal
 
 } } // namespace skylark::algorithms
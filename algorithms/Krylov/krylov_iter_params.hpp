@@ -2,6 +2,7 @@
 #define SKYLARK_KRYLOV_ITER_PARAMS_HPP
 
 #include <ostream>
+#include <vector>
 
 namespace skylark { namespace algorithms {
 
@@ -11,6 +12,23 @@ struct krylov_iter_params_t : public base::params_t {
     int iter_lim;
     int res_print;
 
+    /**
+     * Use the pipelined variants (CG, LSQR): the reductions of an iteration
+     * are fused and overlapped with the matrix products, at the price of a
+     * few extra vectors and slightly different rounding behavior.
+     */
+    bool pipelined;
+
+    /**
+     * Stop iterating on the right-hand sides that converged (CG, LSQR,
+     * FlexibleCG): only the others are multiplied, reduced and updated.
+     * Not done by the pipelined variants.
+     */
+    bool deflate;
+
+    /** If set, receives the number of iterations of each right-hand side */
+    std::vector<int> *column_iterations;
+
     krylov_iter_params_t(double tolerance = 1e-14,
         int iter_lim = 100,
         bool am_i_printing = 0,
@@ -22,7 +40,10 @@ struct krylov_iter_params_t : public base::params_t {
         base::params_t(am_i_printing, log_level, log_stream, prefix, debug_level),
         tolerance(tolerance),
         iter_lim(iter_lim),
-        res_print(res_print) {
+        res_print(res_print),
+        pipelined(false),
+        deflate(true),
+        column_iterations(nullptr) {
 
   }
 
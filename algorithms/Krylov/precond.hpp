@@ -115,6 +115,35 @@ struct inplace_tri_inverse_precond_t : public inplace_precond_t<XType> {
     }
 };
 
+/**
+ * A preconditioner that lives in another distribution than the vectors it is
+ * applied to (e.g. a distributed [MC,MR] factor applied to a replicated
+ * [STAR,STAR] solution): X is redistributed to PXType, P is applied, and the
+ * result is copied back. Takes ownership of P.
+ */
+template<typename XType, typename PXType>
+struct inplace_redist_precond_t : public inplace_precond_t<XType> {
+    const inplace_precond_t<PXType> *P;
+
+    inplace_redist_precond_t(const inplace_precond_t<PXType> *P) : P(P) { }
+
+    ~inplace_redist_precond_t() { delete P; }
+
+    bool is_id() const { return P->is_id(); }
+
+    void apply(XType& X) const {
+        PXType PX(X);
+        P->apply(PX);
+        X = PX;
+    }
+
+    void apply_adjoint(XType& X) const {
+        PXType PX(X);
+        P->apply_adjoint(PX);
+        X = PX;
+    }
+};
+
 } } /** namespace skylark::algorithms */
 
 #endif // SKYLARK_PRECOND_HPP
@@ -20,6 +20,8 @@ void AsyFCG(const MatType& A, const RhsType& B, SolType& X,
     asy_params.tolerance = 0;
     asy_params.sweeps_lim = params.sweeps_lim;
     asy_params.syn_sweeps = params.syn_sweeps;
+    asy_params.relaxed = params.relaxed;
+    asy_params.staleness = params.staleness;
 
     FlexibleCG(A, B, X, krylov_params,
         asy_precond_t<MatType, RhsType, SolType>(A, asy_params, context));
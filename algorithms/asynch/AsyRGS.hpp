@@ -8,9 +8,9 @@ namespace algorithms {
 
 namespace internal {
 
-template<typename T1, typename T2, typename T3>
+template<bool Atomic, typename T1, typename T2, typename T3>
 inline void jstep(const int *colptr, const int *rowind, const T1 *vals,
-    T2 *B, T3 *X, int k, T3 *xvals, int i) {
+    const T2 *B, T3 *X, int k, T3 *xvals, int i) {
 
     double diag = 1.0, v;
 
@@ -24,7 +24,7 @@ inline void jstep(const int *colptr, const int *rowind, const T1 *vals,
         if (rowind[j] == i)
             diag = vals[j];
         v = vals[j];
-        double *xx = X + rowind[j] * k;
+        const T3 *xx = X + rowind[j] * k;
         for (int r = 0; r < k; r++)
             xvals[r] -= v * xx[r];
     }
@@ -32,14 +32,17 @@ inline void jstep(const int *colptr, const int *rowind, const T1 *vals,
     for(int r = 0; r < k; r++) {
         int idx = i * k + r;
         v = xvals[r] / diag;
-#       pragma omp atomic
-        X[idx] += v;
+        if (Atomic) {
+#           pragma omp atomic
+            X[idx] += v;
+        } else
+            X[idx] += v;
     }
 }
 
-template<typename T1, typename T2, typename T3>
+template<bool Atomic, typename T1, typename T2, typename T3>
 inline void jstep1(const int *colptr, const int *rowind, const T1 *vals,
-    T2 *b, T3 *x, int i) {
+    const T2 *b, T3 *x, int i) {
 
     double diag = 1.0, v;
 
@@ -54,10 +57,71 @@ inline void jstep1(const int *colptr, const int *rowind, const T1 *vals,
     }
 
     v /= diag;
-#   pragma omp atomic
-    x[i] += v;
+    if (Atomic) {
+#       pragma omp atomic
+        x[i] += v;
+    } else
+        x[i] += v;
 }
 
+/** Number of steps whose indices are drawn at once (one stream each). */
+const int asyrgs_chunk = 1 << 14;
+
+/**
+ * Runs steps asynchronous Gauss-Seidel steps on the row-major n x k matrix X.
+ * Steps are cut in chunks of asyrgs_chunk, and the indices of the c-th chunk
+ * are drawn in bulk from the c-th element of stepidxs. Chunks are assigned
+ * statically, so each thread draws and walks its own block of indices, and
+ * the sequence of indices does not depend on the number of threads.
+ */
+template<bool Atomic, typename T1, typename T2, typename T3,
+         typename ArrayType>
+void AsyRGSSteps(const int *colptr, const int *rowind, const T1 *vals,
+    const T2 *B, T3 *X, int k, size_t steps, const ArrayType& stepidxs) {
+
+    int nchunks = (steps + asyrgs_chunk - 1) / asyrgs_chunk;
+
+#   pragma omp parallel default(shared)
+    {
+        std::vector<int> idxs(asyrgs_chunk);
+        std::vector<T3> d(k);
+
+#       pragma omp for schedule(static)
+        for(int c = 0; c < nchunks; c++) {
+            size_t len = std::min<size_t>(asyrgs_chunk,
+                steps - size_t(c) * asyrgs_chunk);
+            stepidxs.generate(c, len, idxs.data());
+
+            if (k == 1)
+                for(size_t j = 0; j < len; j++)
+                    jstep1<Atomic>(colptr, rowind, vals, B, X, idxs[j]);
+            else
+                for(size_t j = 0; j < len; j++)
+                    jstep<Atomic>(colptr, rowind, vals, B, X, k, d.data(),
+                        idxs[j]);
+        }
+    }
+}
+
+/**
+ * AT = A^T, written by all threads in the static order AsyRGSSteps uses, so
+ * that with first-touch placement the rows of AT are spread over the NUMA
+ * nodes of the threads instead of all landing on the master's node.
+ */
+template<typename T>
+void FirstTouchTranspose(const El::Matrix<T>& A, El::Matrix<T>& AT) {
+    int n = A.Height(), k = A.Width();
+    AT.Resize(k, n);
+
+    const T *Ad = A.LockedBuffer();
+    T *ATd = AT.Buffer();
+    int ldA = A.LDim(), ldAT = AT.LDim();
+
+#   pragma omp parallel for schedule(static)
+    for(int i = 0; i < n; i++)
+        for(int r = 0; r < k; r++)
+            ATd[i * ldAT + r] = Ad[r * ldA + i];
+}
 
 } // namespace internal
 
@@ -68,6 +132,11 @@ inline void jstep1(const int *colptr, const int *rowind, const T1 *vals,
  * attempt to apply it even for a non-Hermitian matrix, but be aware
  * that the code will operate actually on A^* in that case.
  *
+ * X and B are copied, in parallel, to row-major working copies placed by
+ * first touch on the NUMA nodes of the threads. Updates are atomic, unless
+ * params.relaxed is set (see asy_iter_params_t), which requires
+ * params.syn_sweeps > 0.
+ *
  * Reference:
  * Avron, Druinsky and Gupta
  * Revisiting Asynchronous Linear Solvers:
@@ -83,12 +152,20 @@ int AsyRGS(const base::sparse_matrix_t<T1>& A, const El::Matrix<T2>& B,
     El::Matrix<T3>& X, base::context_t& context,
     asy_iter_params_t params = asy_iter_params_t()) {
 
-    int ret;
+    int ret = -6;
+
+    // Relaxed updates are only safe with a residual check between them.
+    if (params.relaxed && params.syn_sweeps <= 0)
+        SKYLARK_THROW_EXCEPTION (
+            base::invalid_parameters()
+            << base::error_msg("AsyRGS: relaxed updates require "
+                "syn_sweeps > 0"));
 
     bool log_lev1 = params.am_i_printing && params.log_level >= 1;
     bool log_lev2 = params.am_i_printing && params.log_level >= 2;
 
     int n = A.height();   // We assume A is square. TODO assert it.
+    int k = B.Width();
 
     const int *colptr = A.indptr();
     const int *rowind = A.indices();
@@ -97,139 +174,106 @@ int AsyRGS(const base::sparse_matrix_t<T1>& A, const El::Matrix<T2>& B,
     typedef boost::random::uniform_int_distribution<int> dtype;
     dtype distribution(0, n-1);
 
-    if (B.Width() == 1) {
-       int j;
-
-       double nrmb = base::Nrm2(B);
-
-       const T2 *Bd = B.LockedBuffer();
-       T3 *Xd = X.Buffer();
-
-       int sweeps_left = params.sweeps_lim;
-       int done_sweeps = 0;
-       while (sweeps_left > 0) {
-
-           int sweeps = params.syn_sweeps > 0 ?
-               std::min(params.syn_sweeps, sweeps_left) : sweeps_left;
-
-           base::random_samples_array_t<dtype> stepidxs =
-               context.allocate_random_samples_array(sweeps * n, distribution);
-
-#          pragma omp parallel for default(shared) private(j)
-           for(j = 0; j < sweeps * n ; j++)
-               internal::jstep1(colptr, rowind, vals, Bd, Xd, stepidxs[j]);
-
-           sweeps_left -= sweeps;
-           done_sweeps += sweeps;
-
-           if (params.tolerance > 0) {
-               El::Matrix<double> R(B);
-               base::Gemv(El::ADJOINT, -1.0, A, X, 1.0, R);
-               double res = base::Nrm2(R);
-               double relres = res / nrmb;
-
-               if (log_lev2)
-                   params.log_stream << "AsyRGS: Sweeps = " << done_sweeps
-                                     << ", Relres = "
-                                     << boost::format("%.2e") % relres << std::endl;
-
-               if(res < nrmb * params.tolerance) {
-                   if (log_lev1)
-                       params.log_stream << "AsyRGS: Convergence!" << std::endl;
-                   ret = -1;
-                   goto cleanup;
-               }
-           }
-       }
-     } else {
-        int j;
-
-        El::Matrix<T2> BT;
-        El::Transpose(B, BT);
-        El::Matrix<T3> XT;
-        El::Transpose(X, XT);
-
-        const T2 *Bd = BT.LockedBuffer();
-        T3 *Xd = XT.Buffer();
-
-        int k = B.Width();
-        T3 d[k];
-
-        typedef El::Matrix<T2> rhs_type;
-        typedef utility::elem_extender_t<
-            typename internal::scalar_cont_typer_t<rhs_type>::type >
-            scalar_cont_type;
-        scalar_cont_type
-            nrmb(internal::scalar_cont_typer_t<rhs_type>::build_compatible(k, 1, B));
-        double total_nrmb = 0.0;
-        if (params.tolerance > 0) {
-            base::ColumnNrm2(B, nrmb);
-            for(int i = 0; i < k; i++)
-                total_nrmb += nrmb[i] * nrmb[i];
-        }
-        total_nrmb = sqrt(total_nrmb);
-        scalar_cont_type ressqr(nrmb);
-
-        int sweeps_left = params.sweeps_lim;
-        int done_sweeps = 0;
-        while (sweeps_left > 0) {
-
-            int sweeps = params.syn_sweeps > 0 ?
-                std::min(params.syn_sweeps, sweeps_left) : sweeps_left;
-
-            base::random_samples_array_t<dtype> stepidxs =
-                context.allocate_random_samples_array(sweeps * n, distribution);
-
-#           pragma omp parallel for default(shared) private(j, d)
-            for(j = 0; j < sweeps * n ; j++)
-                internal::jstep(colptr, rowind, vals, Bd, Xd, k, d, stepidxs[j]);
-
-           sweeps_left -= sweeps;
-           done_sweeps += sweeps;
-
-           if (params.tolerance > 0) {
-
-               El::Matrix<double> RT(BT);
-               base::Gemm(El::NORMAL, El::NORMAL, -1.0, XT, A, 1.0, RT);
-               base::RowDot(RT, RT, ressqr);
-
-               int convg = 0;
-               for(int i = 0; i < k; i++) {
-                   if (sqrt(ressqr[i]) < (params.tolerance*nrmb[i]))
-                       convg++;
-               }
-
-               if (log_lev2) {
-                   double total_ressqr = 0.0;
-                   for(int i = 0; i < k; i++)
-                       total_ressqr += ressqr[i];
-                   double relres = sqrt(total_ressqr) / total_nrmb;
-                   params.log_stream << "AsyRGS: Sweeps = " << done_sweeps
-                                     << ", Relres = "
-                                     << boost::format("%.2e") % relres
-                                     << ", " << convg << " rhs converged" << std::endl;
-               }
-
-               if(convg == k) {
-                   if (log_lev1)
-                       params.log_stream << "AsyRGS: Convergence!" << std::endl;
-                   ret = -1;
-                   El::Transpose(XT, X);
-                   goto cleanup;
-               }
-           }
+    El::Matrix<T2> BT;
+    internal::FirstTouchTranspose(B, BT);
+    El::Matrix<T3> XT;
+    internal::FirstTouchTranspose(X, XT);
+
+    const T2 *Bd = BT.LockedBuffer();
+    T3 *Xd = XT.Buffer();
+
+    typedef El::Matrix<T2> rhs_type;
+    typedef utility::elem_extender_t<
+        typename internal::scalar_cont_typer_t<rhs_type>::type >
+        scalar_cont_type;
+    scalar_cont_type
+        nrmb(internal::scalar_cont_typer_t<rhs_type>::build_compatible(k, 1, B));
+    double total_nrmb = 0.0;
+    bool check = params.tolerance > 0 || params.relaxed;
+    if (check) {
+        base::ColumnNrm2(B, nrmb);
+        for(int i = 0; i < k; i++)
+            total_nrmb += nrmb[i] * nrmb[i];
+    }
+    total_nrmb = sqrt(total_nrmb);
+    scalar_cont_type ressqr(nrmb);
+
+    bool atomic = !params.relaxed;
+    double last_relres = std::numeric_limits<double>::infinity();
+
+    int sweeps_left = params.sweeps_lim;
+    int done_sweeps = 0;
+    while (sweeps_left > 0) {
+
+        int sweeps = params.syn_sweeps > 0 ?
+            std::min(params.syn_sweeps, sweeps_left) : sweeps_left;
+
+        size_t steps = size_t(sweeps) * n;
+        base::random_samples_array_t<dtype> stepidxs =
+            context.allocate_random_samples_array(
+                (steps + internal::asyrgs_chunk - 1) / internal::asyrgs_chunk,
+                distribution);
+
+        if (atomic)
+            internal::AsyRGSSteps<true>(colptr, rowind, vals, Bd, Xd, k,
+                steps, stepidxs);
+        else
+            internal::AsyRGSSteps<false>(colptr, rowind, vals, Bd, Xd, k,
+                steps, stepidxs);
+
+        sweeps_left -= sweeps;
+        done_sweeps += sweeps;
+
+        if (check) {
+
+            El::Matrix<double> RT(BT);
+            base::Gemm(El::NORMAL, El::NORMAL, -1.0, XT, A, 1.0, RT);
+            base::RowDot(RT, RT, ressqr);
+
+            int convg = 0;
+            double total_ressqr = 0.0;
+            for(int i = 0; i < k; i++) {
+                if (sqrt(ressqr[i]) < (params.tolerance*nrmb[i]))
+                    convg++;
+                total_ressqr += ressqr[i];
+            }
+            double relres = sqrt(total_ressqr) / total_nrmb;
+
+            if (log_lev2) {
+                params.log_stream << "AsyRGS: Sweeps = " << done_sweeps
+                                  << ", Relres = "
+                                  << boost::format("%.2e") % relres;
+                if (k > 1)
+                    params.log_stream << ", " << convg << " rhs converged";
+                params.log_stream << std::endl;
+            }
+
+            if(params.tolerance > 0 && convg == k) {
+                if (log_lev1)
+                    params.log_stream << "AsyRGS: Convergence!" << std::endl;
+                ret = -1;
+                break;
+            }
+
+            // Synchronizations are sweeps apart, so the residual should go
+            // down between them; if it does not, updates are being lost.
+            if (!atomic && !(relres < last_relres)) {
+                if (log_lev1)
+                    params.log_stream << "AsyRGS: Residual grew with relaxed "
+                                      << "updates, switching to atomic ones."
+                                      << std::endl;
+                atomic = true;
+            }
+            last_relres = relres;
         }
-
-        El::Transpose(XT, X);
     }
 
-    ret = -6;
-    if (log_lev1)
+    El::Transpose(XT, X);
+
+    if (ret == -6 && log_lev1)
         params.log_stream << "AsyRGS: No convergence within iteration limit."
                           << std::endl;
 
- cleanup:
-
     return ret;
 }
 
@@ -0,0 +1,456 @@
+#ifndef SKYLARK_ASYRGS_ELEMENTAL_HPP
+#define SKYLARK_ASYRGS_ELEMENTAL_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <El.hpp>
+#include <boost/mpi.hpp>
+#include <boost/serialization/vector.hpp>
+
+#if MPI_VERSION >= 3
+
+namespace skylark {
+namespace algorithms {
+
+namespace internal {
+
+/** Number of local steps whose indices are drawn at once. */
+const int asyrgs_vc_star_chunk = 1 << 14;
+
+/**
+ * State of an asynchronous Gauss-Seidel on a [VC,STAR] sparse matrix: every
+ * rank updates only the rows it owns, and keeps ghost copies of the remote
+ * components its rows touch.
+ *
+ * The ghost copies live in an MPI-3 window, under a single passive-target
+ * epoch (MPI_Win_lock_all) that lasts as long as the object. The owner of a
+ * boundary component adds its updates into every ghost copy with
+ * MPI_Accumulate (MPI_SUM, so concurrent and reordered deltas are all
+ * applied), and a rank reads its own ghosts back with the atomic form of
+ * MPI_Get (MPI_Get_accumulate with MPI_NO_OP). Both happen in exchange(),
+ * so the remote values read are at most the number of local steps between
+ * exchanges stale.
+ *
+ * X is held row-major (local rows first, then ghosts), one row per
+ * component, k values per row.
+ */
+template<typename T1, typename T3>
+class asyrgs_vc_star_t {
+
+public:
+
+    asyrgs_vc_star_t(const base::sparse_vc_star_matrix_t<T1>& A,
+        const El::DistMatrix<T3, El::VC, El::STAR>& X) :
+        _comm(X.DistComm().comm), _k(X.Width()), _nl(X.LocalHeight()),
+        _type(boost::mpi::get_mpi_datatype<T3>(T3())) {
+
+        if (X.ColAlign() != 0)
+            SKYLARK_THROW_EXCEPTION (
+                base::unsupported_base_operation()
+                    << base::error_msg("AsyRGS needs X aligned at zero"));
+
+        MPI_Comm_rank(_comm, &_rank);
+        MPI_Comm_size(_comm, &_p);
+
+        build_rows(A);
+        build_exchange();
+
+        // Fill ghosts with the initial X: add it to the zeroed window.
+        for(int i = 0; i < _nl; i++)
+            for(int r = 0; r < _k; r++)
+                _xw[i * _k + r] = X.LockedMatrix().Get(i, r);
+
+        MPI_Win_lock_all(0, _win);
+        std::fill(_wbuf, _wbuf + _ng * _k, T3(0));
+        MPI_Win_sync(_win);
+        MPI_Barrier(_comm);
+        for(int i = 0; i < _nl; i++)
+            add_to_pending(i, &_xw[i * _k]);
+        sync();
+    }
+
+    ~asyrgs_vc_star_t() {
+        MPI_Win_unlock_all(_win);
+        MPI_Win_free(&_win);
+        for(size_t q = 0; q < _ttype.size(); q++)
+            if (_ttype[q] != MPI_DATATYPE_NULL)
+                MPI_Type_free(&_ttype[q]);
+    }
+
+    int local_height() const { return _nl; }
+
+    /** One Gauss-Seidel step on local row i; d is scratch of size k. */
+    template<typename T2>
+    void step(int i, const T2 *B, T3 *d) {
+        if (_rowptr[i] == _rowptr[i + 1])
+            return;
+
+        double diag = 1.0;
+        for(int r = 0; r < _k; r++)
+            d[r] = B[i * _k + r];
+
+        for(int e = _rowptr[i]; e < _rowptr[i + 1]; e++) {
+            int c = _cols[e];
+            if (c == i)
+                diag = _vals[e];
+            const T3 *xx = &_xw[size_t(c) * _k];
+            for(int r = 0; r < _k; r++)
+                d[r] -= _vals[e] * xx[r];
+        }
+
+        for(int r = 0; r < _k; r++) {
+            d[r] /= diag;
+            _xw[i * _k + r] += d[r];
+        }
+
+        add_to_pending(i, d);
+    }
+
+    /**
+     * Sends the pending updates of boundary components, and reads the
+     * ghosts back.
+     */
+    void exchange() {
+        if (_dirty) {
+            for(int q = 0; q < _p; q++)
+                if (_pcount[q] > 0)
+                    MPI_Accumulate(&_pending[size_t(_poff[q]) * _k],
+                        _pcount[q] * _k, _type, q, 0, 1, _ttype[q],
+                        MPI_SUM, _win);
+            MPI_Win_flush_local_all(_win);
+            std::fill(_pending.begin(), _pending.end(), T3(0));
+            _dirty = false;
+        }
+
+        if (_ng > 0) {
+            MPI_Get_accumulate(nullptr, 0, _type,
+                &_xw[size_t(_nl) * _k], _ng * _k, _type,
+                _rank, 0, _ng * _k, _type, MPI_NO_OP, _win);
+            MPI_Win_flush(_rank, _win);
+        }
+    }
+
+    /**
+     * Global synchronization: after it, every ghost holds the current value
+     * of its component.
+     */
+    void sync() {
+        exchange();
+        MPI_Win_flush_all(_win);
+        MPI_Barrier(_comm);
+        exchange();
+    }
+
+    /**
+     * Squared residual norms ||B - A X||^2 (one per column), summed over
+     * all ranks. Call after sync().
+     */
+    template<typename T2>
+    void residual(const T2 *B, std::vector<double>& ressqr) const {
+        std::vector<double> d(_k);
+        ressqr.assign(_k, 0.0);
+        for(int i = 0; i < _nl; i++) {
+            for(int r = 0; r < _k; r++)
+                d[r] = B[i * _k + r];
+            for(int e = _rowptr[i]; e < _rowptr[i + 1]; e++)
+                for(int r = 0; r < _k; r++)
+                    d[r] -= _vals[e] * _xw[size_t(_cols[e]) * _k + r];
+            for(int r = 0; r < _k; r++)
+                ressqr[r] += d[r] * d[r];
+        }
+        MPI_Allreduce(MPI_IN_PLACE, ressqr.data(), _k, MPI_DOUBLE, MPI_SUM,
+            _comm);
+    }
+
+    void get(El::DistMatrix<T3, El::VC, El::STAR>& X) const {
+        for(int i = 0; i < _nl; i++)
+            for(int r = 0; r < _k; r++)
+                X.Matrix().Set(i, r, _xw[i * _k + r]);
+    }
+
+private:
+
+    MPI_Comm _comm;
+    int _rank, _p;
+    const int _k;
+    const int _nl;
+    int _ng;
+    MPI_Datatype _type;
+
+    // Local rows (CSR); columns are rows of _xw.
+    std::vector<int> _rowptr, _cols;
+    std::vector<T1> _vals;
+    std::vector<T3> _xw;
+
+    // Ghosts are sorted by owner, then global index.
+    std::vector<std::pair<int, El::Int> > _ghosts;
+
+    // Pending updates for the ghosts of other ranks: _pcount[q] rows for
+    // rank q from row _poff[q]; local row i feeds rows
+    // _sends[_sendptr[i].._sendptr[i+1]).
+    std::vector<int> _poff, _pcount, _sendptr, _sends;
+    std::vector<T3> _pending;
+    std::vector<MPI_Datatype> _ttype;
+    bool _dirty;
+
+    MPI_Win _win;
+    T3 *_wbuf;
+
+    void build_rows(const base::sparse_vc_star_matrix_t<T1>& A) {
+        const int *indptr = A.indptr();
+        const int *indices = A.indices();
+        const T1 *values = A.locked_values();
+
+        _rowptr.assign(_nl + 1, 0);
+        for(int col = 0; col < A.local_width(); col++)
+            for(int e = indptr[col]; e < indptr[col + 1]; e++)
+                _rowptr[indices[e] + 1]++;
+        for(int i = 0; i < _nl; i++)
+            _rowptr[i + 1] += _rowptr[i];
+
+        std::vector<El::Int> gcols(_rowptr[_nl]);
+        _vals.resize(_rowptr[_nl]);
+        std::vector<int> next(_rowptr.begin(), _rowptr.end() - 1);
+        for(int col = 0; col < A.local_width(); col++)
+            for(int e = indptr[col]; e < indptr[col + 1]; e++) {
+                int pos = next[indices[e]]++;
+                gcols[pos] = A.global_col(col);
+                _vals[pos] = values[e];
+            }
+
+        for(size_t e = 0; e < gcols.size(); e++)
+            if (gcols[e] % _p != _rank)
+                _ghosts.push_back(std::make_pair(int(gcols[e] % _p), gcols[e]));
+        std::sort(_ghosts.begin(), _ghosts.end());
+        _ghosts.erase(std::unique(_ghosts.begin(), _ghosts.end()),
+            _ghosts.end());
+        _ng = _ghosts.size();
+
+        _cols.resize(gcols.size());
+        for(size_t e = 0; e < gcols.size(); e++) {
+            int owner = gcols[e] % _p;
+            if (owner == _rank)
+                _cols[e] = gcols[e] / _p;
+            else
+                _cols[e] = _nl + (std::lower_bound(_ghosts.begin(),
+                        _ghosts.end(), std::make_pair(owner, gcols[e])) -
+                    _ghosts.begin());
+        }
+
+        _xw.assign(size_t(_nl + _ng) * _k, T3(0));
+    }
+
+    void build_exchange() {
+        boost::mpi::communicator comm(_comm, boost::mpi::comm_attach);
+
+        // Tell every owner which of its rows we hold ghosts of, and where.
+        std::vector<std::vector<El::Int> > requests(_p), needed(_p);
+        for(int g = 0; g < _ng; g++) {
+            requests[_ghosts[g].first].push_back(_ghosts[g].second);
+            requests[_ghosts[g].first].push_back(g);
+        }
+        boost::mpi::all_to_all(comm, requests, needed);
+
+        _poff.assign(_p, 0);
+        _pcount.assign(_p, 0);
+        _ttype.assign(_p, MPI_DATATYPE_NULL);
+        std::vector<std::pair<int, int> > rowpos;
+        int total = 0;
+        for(int q = 0; q < _p; q++) {
+            int c = needed[q].size() / 2;
+            _poff[q] = total;
+            _pcount[q] = c;
+            if (c == 0)
+                continue;
+
+            std::vector<int> disps(c);
+            for(int s = 0; s < c; s++) {
+                int i = needed[q][2 * s] / _p;
+                disps[s] = needed[q][2 * s + 1] * _k;
+                rowpos.push_back(std::make_pair(i, total + s));
+            }
+            MPI_Type_create_indexed_block(c, _k, disps.data(), _type,
+                &_ttype[q]);
+            MPI_Type_commit(&_ttype[q]);
+            total += c;
+        }
+        _pending.assign(size_t(total) * _k, T3(0));
+        _dirty = false;
+
+        std::sort(rowpos.begin(), rowpos.end());
+        _sendptr.assign(_nl + 1, 0);
+        _sends.resize(rowpos.size());
+        for(size_t s = 0; s < rowpos.size(); s++) {
+            _sendptr[rowpos[s].first + 1]++;
+            _sends[s] = rowpos[s].second;
+        }
+        for(int i = 0; i < _nl; i++)
+            _sendptr[i + 1] += _sendptr[i];
+
+        MPI_Info info;
+        MPI_Info_create(&info);
+        MPI_Info_set(info, const_cast<char *>("accumulate_ops"),
+            const_cast<char *>("same_op_no_op"));
+        MPI_Win_allocate(MPI_Aint(_ng) * _k * sizeof(T3), sizeof(T3), info,
+            _comm, &_wbuf, &_win);
+        MPI_Info_free(&info);
+    }
+
+    void add_to_pending(int i, const T3 *d) {
+        for(int s = _sendptr[i]; s < _sendptr[i + 1]; s++) {
+            T3 *pp = &_pending[size_t(_sends[s]) * _k];
+            for(int r = 0; r < _k; r++)
+                pp[r] += d[r];
+            _dirty = true;
+        }
+    }
+};
+
+} // namespace internal
+
+/**
+ * Distributed Asynchronous Randomized Gauss-Seidel for solving A * X = B,
+ * A being a [VC,STAR] sparse matrix and B, X distributed alike (see the
+ * single node AsyRGS for the method).
+ *
+ * Every rank runs randomized Gauss-Seidel steps on the rows it owns, with
+ * no synchronization in between: boundary components are exchanged with
+ * MPI-3 one-sided communication every params.staleness local steps (see
+ * internal::asyrgs_vc_star_t). A sweep is Height(A) steps over all ranks.
+ * Ranks synchronize every params.syn_sweeps sweeps, when the global
+ * residual is checked if params.tolerance > 0. Each rank runs a single
+ * thread; params.relaxed does not apply.
+ *
+ * @param A input matrix
+ * @param B right hand side.
+ * @param X output - must be preallocated. The content is used as initial X.
+ */
+template<typename T1, typename T2, typename T3>
+int AsyRGS(const base::sparse_vc_star_matrix_t<T1>& A,
+    const El::DistMatrix<T2, El::VC, El::STAR>& B,
+    El::DistMatrix<T3, El::VC, El::STAR>& X, base::context_t& context,
+    asy_iter_params_t params = asy_iter_params_t()) {
+
+    int ret = -6;
+
+    bool log_lev1 = params.am_i_printing && params.log_level >= 1;
+    bool log_lev2 = params.am_i_printing && params.log_level >= 2;
+
+    int n = A.height();   // We assume A is square. TODO assert it.
+    int k = B.Width();
+    int p = El::mpi::Size(X.DistComm());
+    int rank = El::mpi::Rank(X.DistComm());
+
+    internal::asyrgs_vc_star_t<T1, T3> state(A, X);
+    int nl = state.local_height();
+
+    std::vector<T2> Bw(size_t(nl) * k);
+    for(int i = 0; i < nl; i++)
+        for(int r = 0; r < k; r++)
+            Bw[i * k + r] = B.LockedMatrix().Get(i, r);
+
+    std::vector<double> nrmb(k, 0.0), ressqr(k);
+    double total_nrmb = 0.0;
+    if (params.tolerance > 0) {
+        for(int i = 0; i < nl; i++)
+            for(int r = 0; r < k; r++)
+                nrmb[r] += Bw[i * k + r] * Bw[i * k + r];
+        MPI_Allreduce(MPI_IN_PLACE, nrmb.data(), k, MPI_DOUBLE, MPI_SUM,
+            X.DistComm().comm);
+        for(int r = 0; r < k; r++) {
+            total_nrmb += nrmb[r];
+            nrmb[r] = sqrt(nrmb[r]);
+        }
+    }
+    total_nrmb = sqrt(total_nrmb);
+
+    typedef boost::random::uniform_int_distribution<int> dtype;
+    dtype distribution(0, std::max(nl, 1) - 1);
+    int maxnl = (n + p - 1) / p;
+
+    std::vector<int> idxs(internal::asyrgs_vc_star_chunk);
+    std::vector<T3> d(k);
+    int since = 0;
+
+    int sweeps_left = params.sweeps_lim;
+    int done_sweeps = 0;
+    while (sweeps_left > 0) {
+
+        int sweeps = params.syn_sweeps > 0 ?
+            std::min(params.syn_sweeps, sweeps_left) : sweeps_left;
+
+        // Same number of chunks reserved for every rank, so that all keep
+        // the context in the same state.
+        size_t steps = size_t(sweeps) * nl;
+        size_t chunks = (size_t(sweeps) * maxnl +
+            internal::asyrgs_vc_star_chunk - 1) /
+            internal::asyrgs_vc_star_chunk;
+        base::random_samples_array_t<dtype> stepidxs =
+            context.allocate_random_samples_array(p * chunks, distribution);
+
+        for(size_t c = 0; c * internal::asyrgs_vc_star_chunk < steps; c++) {
+            size_t len = std::min<size_t>(internal::asyrgs_vc_star_chunk,
+                steps - c * internal::asyrgs_vc_star_chunk);
+            stepidxs.generate(rank * chunks + c, len, idxs.data());
+            for(size_t j = 0; j < len; j++) {
+                state.step(idxs[j], Bw.data(), d.data());
+                if (++since >= params.staleness) {
+                    state.exchange();
+                    since = 0;
+                }
+            }
+        }
+
+        state.sync();
+        since = 0;
+        sweeps_left -= sweeps;
+        done_sweeps += sweeps;
+
+        if (params.tolerance > 0) {
+            state.residual(Bw.data(), ressqr);
+
+            int convg = 0;
+            double total_ressqr = 0.0;
+            for(int r = 0; r < k; r++) {
+                if (sqrt(ressqr[r]) < (params.tolerance*nrmb[r]))
+                    convg++;
+                total_ressqr += ressqr[r];
+            }
+
+            if (log_lev2) {
+                params.log_stream << "AsyRGS: Sweeps = " << done_sweeps
+                                  << ", Relres = "
+                                  << boost::format("%.2e") %
+                    (sqrt(total_ressqr) / total_nrmb);
+                if (k > 1)
+                    params.log_stream << ", " << convg << " rhs converged";
+                params.log_stream << std::endl;
+            }
+
+            if(convg == k) {
+                if (log_lev1)
+                    params.log_stream << "AsyRGS: Convergence!" << std::endl;
+                ret = -1;
+                break;
+            }
+        }
+    }
+
+    state.get(X);
+
+    if (ret == -6 && log_lev1)
+        params.log_stream << "AsyRGS: No convergence within iteration limit."
+                          << std::endl;
+
+    return ret;
+}
+
+} } // namespace skylark::algorithms
+
+#endif  // if MPI_VERSION >= 3
+
+#endif
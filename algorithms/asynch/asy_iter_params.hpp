@@ -18,6 +18,16 @@ struct asy_iter_params_t : public base::params_t {
                               method; number of internal preconditioner sweeps
                               in  flexible method. */
 
+    bool relaxed;        /**< Update X without atomics (Hogwild style):
+                              faster, but concurrent updates of the same
+                              component may be lost. The residual is then
+                              checked at every synchronization, and atomic
+                              updates resume if it grows. Requires
+                              syn_sweeps > 0. */
+    int staleness;       /**< Distributed solvers: number of local steps
+                              between exchanges of boundary components, i.e.
+                              how stale the remote values read may be. */
+
     // Parameters for an outer flexible Krylov method
     int iter_lim;
     int iter_res_print;
@@ -31,11 +41,15 @@ struct asy_iter_params_t : public base::params_t {
         int log_level = 0,
         std::ostream &log_stream = std::cout,
         std::string prefix = "", 
-        int debug_level = 0) :
+        int debug_level = 0,
+        bool relaxed = false,
+        int staleness = 1000) :
         base::params_t(am_i_printing, log_level, log_stream, prefix, debug_level),
         tolerance(tolerance),
         syn_sweeps(syn_sweeps),
         sweeps_lim(sweeps_lim),
+        relaxed(relaxed),
+        staleness(staleness),
         iter_lim(iter_lim),
         iter_res_print(iter_res_print) {
     }
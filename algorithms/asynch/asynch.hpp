@@ -3,6 +3,7 @@
 
 #include "asy_iter_params.hpp"
 #include "AsyRGS.hpp"
+#include "AsyRGS_Elemental.hpp"
 #include "precond.hpp"
 #include "AsyFCG.hpp"
 
@@ -13,6 +13,13 @@ struct qr_precond_tag : precond_alg_tag { };
 
 struct svd_precond_tag : precond_alg_tag { };
 
+// Same as above, but for [VC/VR,STAR] inputs the sketch and the factor are
+// kept distributed ([MC,MR]) instead of being replicated on every rank, so
+// Width(A)^2 need not fit in the memory of a single node.
+struct dist_qr_precond_tag : precond_alg_tag { };
+
+struct dist_svd_precond_tag : precond_alg_tag { };
+
 //****** Tags for algorithm for fast linear L2 regresssion.
 struct linearl2_reg_fast_alg_tag { };
 
@@ -33,5 +40,6 @@ struct lsrn_tag : public linearl2_reg_fast_alg_tag { };
 } }
 
 #include "accelerated_linearl2_regression_solver_Elemental.hpp"
+#include "sketch_precond.hpp"
 
 #endif // SKYLARK_ACCELERATED_LINEARL2_REGRESSION_SOLVER_HPP
@@ -1,6 +1,8 @@
 #ifndef SKYLARK_ACCELERATED_LINEARL2_REGRESSION_SOLVER_ELEMENTAL_HPP
 #define SKYLARK_ACCELERATED_LINEARL2_REGRESSION_SOLVER_ELEMENTAL_HPP
 
+#include <limits>
+
 #include <El.hpp>
 
 #include "regression_problem.hpp"
@@ -64,6 +66,41 @@ inline double utcondest(const El::DistMatrix<T>& A) {
     return El::OneNorm(A) * El::OneNorm(invA);
 }
 
+/**
+ * Replaces the singular values s (in decreasing order) by their inverses,
+ * and the negligible ones (at most n * eps * s(0)) by zero, so V diag(s)
+ * stays finite on rank deficient sketches. Returns the condition number
+ * s(0) / s(n-1) of the sketch (infinite if it is rank deficient).
+ */
+template<typename T>
+double invert_singular_values(El::Matrix<T>& s) {
+    int n = s.Height();
+    if (n == 0)
+        return 1.0;
+
+    T tol = n * std::numeric_limits<T>::epsilon() * s.Get(0, 0);
+    double cond = s.Get(n - 1, 0) > 0 ?
+        double(s.Get(0, 0)) / double(s.Get(n - 1, 0)) :
+        std::numeric_limits<double>::infinity();
+    for(int i = 0; i < n; i++)
+        s.Set(i, 0, s.Get(i, 0) > tol ? 1 / s.Get(i, 0) : T(0));
+    return cond;
+}
+
+template<typename T>
+double invert_singular_values(El::DistMatrix<T, El::STAR, El::STAR>& s) {
+    return invert_singular_values(s.Matrix());
+}
+
+template<typename T, El::Distribution U, El::Distribution V>
+double invert_singular_values(El::DistMatrix<T, U, V>& s) {
+    // Only n numbers: invert them on every rank, not one Get at a time.
+    El::DistMatrix<T, El::STAR, El::STAR> s_STAR_STAR(s);
+    double cond = invert_singular_values(s_STAR_STAR.Matrix());
+    s = s_STAR_STAR;
+    return cond;
+}
+
 template<typename SolType, typename SketchType, typename PrecondType>
 double build_precond(SketchType& SA,
     PrecondType& R, algorithms::inplace_precond_t<SolType> *&P, qr_precond_tag) {
@@ -83,14 +120,67 @@ double build_precond(SketchType& SA,
     PrecondType s(SA); // TODO should s be PrecondType or STAR,STAR ?
     s.Resize(n, 1);
     El::SVD(SA, s, V);
-    for(int i = 0; i < n; i++)
-        s.Set(i, 0, 1 / s.Get(i, 0));
+    double cond = invert_singular_values(s);
     El::DiagonalScale(El::RIGHT, El::NORMAL, s, V);
     P =
         new algorithms::inplace_mat_precond_t<SolType, PrecondType>(V);
-    return s.Get(0,0) / s.Get(n-1, 0);
+    return cond;
+}
+
+/**
+ * The distributed variants factor the [MC,MR] sketch in place and apply the
+ * factor to the replicated solution through inplace_redist_precond_t, so
+ * neither the sketch nor the factor is ever gathered on one rank.
+ */
+template<typename SolType, typename SketchType, typename PrecondType>
+double build_precond(SketchType& SA,
+    PrecondType& R, algorithms::inplace_precond_t<SolType> *&P,
+    dist_qr_precond_tag) {
+
+    algorithms::inplace_precond_t<PrecondType> *PR;
+    double condest = build_precond(SA, R, PR, qr_precond_tag());
+    P = new algorithms::inplace_redist_precond_t<SolType, PrecondType>(PR);
+    return condest;
 }
 
+template<typename SolType, typename SketchType, typename PrecondType>
+double build_precond(SketchType& SA,
+    PrecondType& V, algorithms::inplace_precond_t<SolType> *&P,
+    dist_svd_precond_tag) {
+
+    typedef typename utility::typer_t<PrecondType>::value_type value_type;
+
+    El::DistMatrix<value_type, El::VR, El::STAR> s_VR_STAR(SA.Grid());
+    El::SVD(SA, s_VR_STAR, V);
+
+    El::DistMatrix<value_type, El::STAR, El::STAR> s(s_VR_STAR);
+    double cond = invert_singular_values(s);
+    El::DiagonalScale(El::RIGHT, El::NORMAL, s, V);
+
+    P = new algorithms::inplace_redist_precond_t<SolType, PrecondType>(
+        new algorithms::inplace_mat_precond_t<PrecondType, PrecondType>(V));
+    return cond;
+}
+
+/**
+ * Type of the sketch and the preconditioner of the [VC/VR,STAR] solvers:
+ * replicated, unless a distributed PrecondTag asks for [MC,MR].
+ */
+template<typename ValueType, typename PrecondTag>
+struct precond_matrix_t {
+    typedef El::DistMatrix<ValueType, El::STAR, El::STAR> type;
+};
+
+template<typename ValueType>
+struct precond_matrix_t<ValueType, dist_qr_precond_tag> {
+    typedef El::DistMatrix<ValueType> type;
+};
+
+template<typename ValueType>
+struct precond_matrix_t<ValueType, dist_svd_precond_tag> {
+    typedef El::DistMatrix<ValueType> type;
+};
+
 }  // namespace flinl2_internal
 
 /// Specialization for simplified Blendenpik algorithm
@@ -117,7 +207,9 @@ public:
 
 private:
 
-    typedef El::DistMatrix<ValueType, El::STAR, El::STAR> precond_type;
+    typedef typename flinl2_internal::precond_matrix_t<ValueType,
+                                                       PrecondTag>::type
+    precond_type;
     typedef precond_type sketch_type;
     // The assumption is that the sketch is not much bigger than the
     // preconditioner, so we should use the same matrix distribution.
@@ -144,7 +236,7 @@ public:
         int t = 4 * _n;    // TODO parameter.
 
         TransformType<matrix_type, sketch_type> S(_m, t, context);
-        sketch_type SA(t, _n);
+        sketch_type SA(t, _n, _A.Grid());
         S.apply(_A, SA, sketch::columnwise_tag());
 
         flinl2_internal::build_precond(SA, _R, _precond_R, PrecondTag());
@@ -184,7 +276,9 @@ public:
 
 private:
 
-    typedef El::DistMatrix<ValueType, El::STAR, El::STAR> precond_type;
+    typedef typename flinl2_internal::precond_matrix_t<ValueType,
+                                                       PrecondTag>::type
+    precond_type;
     typedef precond_type sketch_type;
     // The assumption is that the sketch is not much bigger than the
     // preconditioner, so we should use the same matrix distribution.
@@ -427,7 +521,9 @@ public:
 
 private:
 
-    typedef El::DistMatrix<ValueType, El::STAR, El::STAR> precond_type;
+    typedef typename flinl2_internal::precond_matrix_t<ValueType,
+                                                       PrecondTag>::type
+    precond_type;
     typedef precond_type sketch_type;
     // The assumption is that the sketch is not much bigger than the
     // preconditioner, so we should use the same matrix distribution.
@@ -458,7 +554,7 @@ public:
         double delta = 1e-6; // TODO parameter
 
         sketch::JLT_t<matrix_type, sketch_type> S(_m, t, context);
-        sketch_type SA(t, _n);
+        sketch_type SA(t, _n, _A.Grid());
         S.apply(_A, SA, sketch::columnwise_tag());
         flinl2_internal::build_precond(SA, _R, _precond_R, PrecondTag());
 
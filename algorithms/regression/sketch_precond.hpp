@@ -0,0 +1,248 @@
+#ifndef SKYLARK_SKETCH_PRECOND_HPP
+#define SKYLARK_SKETCH_PRECOND_HPP
+
+#include <El.hpp>
+
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <string>
+
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+#include "../Krylov/precond.hpp"
+#include "accelerated_linearl2_regression_solver_Elemental.hpp"
+
+namespace skylark {
+namespace algorithms {
+
+namespace sketch_precond_internal {
+
+template<typename T>
+void GetLocal(const El::Matrix<T>& A, El::Matrix<T>& L) {
+    El::Copy(A, L);
+}
+
+template<typename T, El::Distribution U, El::Distribution V>
+void GetLocal(const El::DistMatrix<T, U, V>& A, El::Matrix<T>& L) {
+    El::DistMatrix<T, El::STAR, El::STAR> A_STAR_STAR(A);
+    El::Copy(A_STAR_STAR.LockedMatrix(), L);
+}
+
+template<typename T>
+void SetFromLocal(const El::Matrix<T>& L, El::Matrix<T>& A) {
+    El::Copy(L, A);
+}
+
+template<typename T, El::Distribution U, El::Distribution V>
+void SetFromLocal(const El::Matrix<T>& L, El::DistMatrix<T, U, V>& A) {
+    El::DistMatrix<T, El::STAR, El::STAR> A_STAR_STAR(L.Height(), L.Width());
+    El::Copy(L, A_STAR_STAR.Matrix());
+    A = A_STAR_STAR;
+}
+
+} // namespace sketch_precond_internal
+
+/**
+ * Sketch-and-precondition preconditioner for least squares with a fixed A
+ * (as in Blendenpik): R from the QR factorization of S A, S being a sketch
+ * with t rows. LSQR on A R^{-1} then converges in a number of iterations
+ * that does not depend on the conditioning of A.
+ *
+ * Unlike accelerated_regression_solver_t, which builds the preconditioner
+ * in its constructor, this is a standalone object: build it once, pass it
+ * to LSQR (or nla::FastLeastSquares) for every new right-hand side or block
+ * of right-hand sides, save it to disk and load it back. Only when A
+ * changes does it need a refresh(), which re-sketches A with the same
+ * transform.
+ *
+ * @tparam SolType type of the solution (n x k) the preconditioner applies to.
+ * @tparam PrecondType type of R (n x n) and of the sketch of A.
+ * @tparam TransformType sketch transform (columnwise, m -> t).
+ */
+template<typename SolType, typename PrecondType,
+         template <typename, typename> class TransformType = sketch::JLT_t>
+class sketch_precond_t : public inplace_precond_t<SolType> {
+
+public:
+
+    typedef PrecondType precond_type;
+    typedef typename utility::typer_t<PrecondType>::value_type value_type;
+
+    sketch_precond_t() : _ready(false), _m(0), _n(0), _t(0), _condest(0) {
+
+    }
+
+    /** Loads a preconditioner saved by save(). */
+    sketch_precond_t(const std::string& fname) {
+        std::ifstream is(fname);
+        boost::property_tree::ptree pt;
+        boost::property_tree::read_json(is, pt);
+        build_from_ptree(pt);
+    }
+
+    sketch_precond_t(const boost::property_tree::ptree& pt) {
+        build_from_ptree(pt);
+    }
+
+    /**
+     * Builds the preconditioner for A (m x n), with a new sketch of t rows
+     * (default 4 n). If R is numerically singular, retries with a fresh
+     * sketch (at most three attempts).
+     *
+     * @returns estimated condition number of R.
+     */
+    template<typename MatrixType>
+    double build(const MatrixType& A, base::context_t& context,
+        int t = -1) {
+
+        _m = base::Height(A);
+        _n = base::Width(A);
+        _t = (t == -1) ? 4 * _n : t;
+
+        int attempts = 0;
+        do {
+            TransformType<MatrixType, precond_type> S(_m, _t, context);
+            _sketch = S.to_ptree();
+            factor(A, S);
+            attempts++;
+        } while (_condest > 1e14 && attempts < 3); // TODO parameters
+
+        return _condest;
+    }
+
+    /**
+     * Recomputes R for a changed A (of the same size), with the same sketch
+     * transform, so no new random numbers are drawn.
+     *
+     * @returns estimated condition number of R.
+     */
+    template<typename MatrixType>
+    double refresh(const MatrixType& A) {
+        if (!_ready)
+            SKYLARK_THROW_EXCEPTION (
+                base::invalid_parameters()
+                    << base::error_msg(
+                        "refresh() needs a preconditioner that was built"));
+
+        if (!fits(A))
+            SKYLARK_THROW_EXCEPTION (
+                base::invalid_parameters()
+                    << base::error_msg(
+                        "refresh() needs a matrix of the same size; "
+                        "use build() instead"));
+
+        TransformType<MatrixType, precond_type> S(_sketch);
+        factor(A, S);
+        return _condest;
+    }
+
+    bool ready() const { return _ready; }
+
+    /** Size of the matrix the preconditioner was built for. */
+    int height() const { return _m; }
+    int width() const { return _n; }
+
+    /** Whether A has the size the preconditioner was built (or loaded) for. */
+    template<typename MatrixType>
+    bool fits(const MatrixType& A) const {
+        return base::Height(A) == _m && base::Width(A) == _n;
+    }
+
+    /** Estimated condition number of R (large: do not use). */
+    double condest() const { return _condest; }
+
+    const precond_type& R() const { return _R; }
+
+    bool is_id() const { return false; }
+
+    void apply(SolType& X) const {
+        base::Trsm(El::LEFT, El::UPPER, El::NORMAL, El::NON_UNIT,
+            value_type(1.0), _R, X);
+    }
+
+    void apply_adjoint(SolType& X) const {
+        base::Trsm(El::LEFT, El::UPPER, El::ADJOINT, El::NON_UNIT,
+            value_type(1.0), _R, X);
+    }
+
+    boost::property_tree::ptree to_ptree() const {
+        boost::property_tree::ptree pt;
+        pt.put("skylark_object_type", "preconditioner:sketch");
+        pt.put("skylark_version", VERSION);
+        pt.put("m", _m);
+        pt.put("n", _n);
+        pt.put("sketch_size", _t);
+        pt.put("condest", _condest);
+        pt.add_child("sketch", _sketch);
+
+        El::Matrix<value_type> R;
+        sketch_precond_internal::GetLocal(_R, R);
+        std::ostringstream sR;
+        sR << std::setprecision(std::numeric_limits<value_type>::digits10 + 2);
+        for(int i = 0; i < _n; i++) {
+            for(int j = 0; j < _n; j++)
+                sR << (j > 0 ? " " : "") << R.Get(i, j);
+            sR << "\n";
+        }
+        pt.put("R", sR.str());
+
+        return pt;
+    }
+
+    /**
+     * Saves the preconditioner to a file named fname. When R is distributed
+     * to_ptree() gathers it, so this is collective: call it on all ranks.
+     * Only the ranks with write set (e.g. rank == 0) write the file.
+     */
+    void save(const std::string& fname, bool write = true) const {
+        boost::property_tree::ptree pt = to_ptree();
+        if (!write)
+            return;
+        std::ofstream of(fname);
+        boost::property_tree::write_json(of, pt);
+        of.close();
+    }
+
+private:
+
+    bool _ready;
+    int _m, _n, _t;
+    double _condest;
+    precond_type _R;
+    boost::property_tree::ptree _sketch;
+
+    template<typename MatrixType, typename SketchTransform>
+    void factor(const MatrixType& A, const SketchTransform& S) {
+        precond_type SA(_t, _n);
+        S.apply(A, SA, sketch::columnwise_tag());
+        El::qr::Explicit(SA, _R);
+        _condest = flinl2_internal::utcondest(_R);
+        _ready = true;
+    }
+
+    void build_from_ptree(const boost::property_tree::ptree& pt) {
+        _m = pt.get<int>("m");
+        _n = pt.get<int>("n");
+        _t = pt.get<int>("sketch_size");
+        _condest = pt.get<double>("condest");
+        _sketch = pt.get_child("sketch");
+
+        El::Matrix<value_type> R(_n, _n);
+        std::istringstream sR(pt.get<std::string>("R"));
+        for(int i = 0; i < _n; i++)
+            for(int j = 0; j < _n; j++) {
+                value_type v;
+                sR >> v;
+                R.Set(i, j, v);
+            }
+        sketch_precond_internal::SetFromLocal(R, _R);
+        _ready = true;
+    }
+};
+
+} } /** namespace skylark::algorithms */
+
+#endif // SKYLARK_SKETCH_PRECOND_HPP
@@ -297,12 +297,14 @@ inline void Gemm(El::Orientation oA, El::Orientation oB,
 #       endif
         for (int j = 0; j < n; j++)
             for(int row = 0; row < m; row++) {
-                c[j * ldc + row] *= beta;
+                T sum = 0;
                  for (int l = indptr[j]; l < indptr[j + 1]; l++) {
                      int rr = indices[l];
                      T val = values[l];
-                     c[j * ldc + row] += val * a[row * lda + rr];
+                     sum += val * a[row * lda + rr];
                  }
+                 c[j * ldc + row] = (beta == T(0) ? T(0) :
+                     beta * c[j * ldc + row]) + alpha * sum;
             }
     }
 
@@ -399,7 +401,7 @@ inline void Gemm(El::Orientation oA, El::Orientation oB,
         }
     }
 
-    // TN - TODO: Not tested!
+    // TN
     if (oA == El::TRANSPOSE && oB == El::NORMAL) {
         T *c = C.Buffer();
         int ldc = C.LDim();
@@ -412,16 +414,18 @@ inline void Gemm(El::Orientation oA, El::Orientation oB,
 #       endif
         for (int j = 0; j < n; j++)
             for(int row = 0; row < k; row++) {
-                c[j * ldc + row] *= beta;
+                T sum = 0;
                  for (int l = indptr[row]; l < indptr[row + 1]; l++) {
                      int col = indices[l];
                      T val = values[l];
-                     c[j * ldc + row] += val * b[j * ldb + col];
+                     sum += val * b[j * ldb + col];
                  }
+                 c[j * ldc + row] = (beta == T(0) ? T(0) :
+                     beta * c[j * ldc + row]) + alpha * sum;
             }
     }
 
-    // AN - TODO: Not tested!
+    // AN
     if (oA == El::ADJOINT && oB == El::NORMAL) {
         T *c = C.Buffer();
         int ldc = C.LDim();
@@ -434,12 +438,14 @@ inline void Gemm(El::Orientation oA, El::Orientation oB,
 #       endif
         for (int j = 0; j < n; j++)
             for(int row = 0; row < k; row++) {
-                c[j * ldc + row] *= beta;
+                T sum = 0;
                  for (int l = indptr[row]; l < indptr[row + 1]; l++) {
                      int col = indices[l];
                      T val = El::Conj(values[l]);
-                     c[j * ldc + row] += val * b[j * ldb + col];
+                     sum += val * b[j * ldb + col];
                  }
+                 c[j * ldc + row] = (beta == T(0) ? T(0) :
+                     beta * c[j * ldc + row]) + alpha * sum;
             }
     }
 
@@ -3,6 +3,12 @@
 
 #include <El.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <vector>
+
+#include <boost/mpi.hpp>
 
 namespace skylark { namespace base { namespace qr {
 
@@ -35,6 +41,165 @@ void ExplicitUnitary(El::DistMatrix<T, El::VR, El::STAR>& A) {
     El::qr::ExplicitTS(A, R);
 }
 
+/**
+ * Orthonormalizes the columns of A with a tall-skinny QR: one reduction
+ * tree for the whole panel instead of collectives per column. Layouts
+ * other than [VC,*] and [VR,*] are redistributed to [VC,*] and back;
+ * local and [*,*] matrices use Householder QR.
+ */
+template<typename T>
+void ExplicitTS(El::Matrix<T>& A) {
+
+    El::qr::ExplicitUnitary(A);
+}
+
+template<typename T>
+void ExplicitTS(El::DistMatrix<T, El::STAR, El::STAR>& A) {
+
+    El::qr::ExplicitUnitary(A.Matrix());
+}
+
+template<typename T>
+void ExplicitTS(El::DistMatrix<T, El::VC, El::STAR>& A) {
+
+    ExplicitUnitary(A);
+}
+
+template<typename T>
+void ExplicitTS(El::DistMatrix<T, El::VR, El::STAR>& A) {
+
+    ExplicitUnitary(A);
+}
+
+template<typename T, El::Distribution U, El::Distribution V>
+void ExplicitTS(El::DistMatrix<T, U, V>& A) {
+
+    El::DistMatrix<T, El::VC, El::STAR> A_VC_STAR(A);
+    ExplicitUnitary(A_VC_STAR);
+    A = A_VC_STAR;
+}
+
+namespace internal {
+
+/**
+ * One CholeskyQR pass on the local rows of A: A = A R^{-1} where
+ * R^T R = A^T A, with the Gram matrix summed over comm (if not null).
+ * Returns false, leaving A untouched, if the Gram matrix is not
+ * numerically positive definite.
+ */
+template<typename T>
+bool CholeskyQRPass(El::Matrix<T>& A, MPI_Comm comm) {
+
+    El::Int k = A.Width();
+    El::Matrix<T> G;
+    El::Zeros(G, k, k);
+    if (A.Height() > 0)
+        El::Herk(El::UPPER, El::ADJOINT, T(1.0), A, T(0.0), G);
+    if (comm != MPI_COMM_NULL) {
+        std::vector<T> sum(k * k);
+        for(El::Int j = 0; j < k; j++)
+            for(El::Int i = 0; i < k; i++)
+                sum[j * k + i] = G.Get(i, j);
+        MPI_Allreduce(MPI_IN_PLACE, sum.data(), k * k,
+            boost::mpi::get_mpi_datatype<T>(T()), MPI_SUM, comm);
+        for(El::Int j = 0; j < k; j++)
+            for(El::Int i = 0; i < k; i++)
+                G.Set(i, j, sum[j * k + i]);
+    }
+
+    try {
+        El::Cholesky(El::UPPER, G);
+    } catch(const std::exception&) {
+        return false;
+    }
+
+    if (A.Height() > 0)
+        El::Trsm(El::RIGHT, El::UPPER, El::NORMAL, El::NON_UNIT, T(1.0),
+            G, A);
+    return true;
+}
+
+} // namespace internal
+
+/**
+ * Orthonormalizes the columns of A with CholeskyQR2: two CholeskyQR passes,
+ * each a single k x k reduction. Falls back to a tall-skinny QR when A is
+ * too ill-conditioned for the Cholesky factorization. With passes = 1 the
+ * columns are only approximately orthonormal, which is enough for the
+ * intermediate iterates of a power iteration.
+ */
+template<typename T>
+void CholeskyQR2(El::Matrix<T>& A, int passes = 2) {
+
+    for(int p = 0; p < passes; p++)
+        if (!internal::CholeskyQRPass(A, MPI_COMM_NULL)) {
+            ExplicitTS(A);
+            return;
+        }
+}
+
+template<typename T, El::Distribution U>
+void CholeskyQR2(El::DistMatrix<T, U, El::STAR>& A, int passes = 2) {
+
+    // Every row is on one rank of DistComm (and replicated across the
+    // others), so summing over DistComm gives the Gram matrix everywhere.
+    for(int p = 0; p < passes; p++)
+        if (!internal::CholeskyQRPass(A.Matrix(), A.DistComm().comm)) {
+            ExplicitTS(A);
+            return;
+        }
+}
+
+template<typename T, El::Distribution U, El::Distribution V>
+void CholeskyQR2(El::DistMatrix<T, U, V>& A, int passes = 2) {
+
+    El::DistMatrix<T, El::VC, El::STAR> A_VC_STAR(A);
+    CholeskyQR2(A_VC_STAR, passes);
+    A = A_VC_STAR;
+}
+
+/**
+ * Replaces A (m x k) by P L, where P L U is its LU factorization with
+ * partial pivoting: a well-conditioned, but not orthonormal, basis of the
+ * column space of A, much cheaper than a QR (this is what fbpca uses
+ * between power iterations). Distributed matrices are factored as [MC,MR].
+ */
+template<typename T>
+void ExplicitLU(El::Matrix<T>& A) {
+
+    // El::LU gives Pi A = L U, with L unit lower trapezoidal stored below
+    // the diagonal; keep L, and put its rows back in place (P = Pi^T).
+    El::Permutation Pi;
+    El::LU(A, Pi);
+    El::MakeTrapezoidal(El::LOWER, A);
+    El::FillDiagonal(A, T(1.0));
+    Pi.InversePermuteRows(A);
+}
+
+template<typename T>
+void ExplicitLU(El::DistMatrix<T>& A) {
+
+    El::DistPermutation Pi(A.Grid());
+    El::LU(A, Pi);
+    El::MakeTrapezoidal(El::LOWER, A);
+    El::FillDiagonal(A, T(1.0));
+    Pi.InversePermuteRows(A);
+}
+
+template<typename T>
+void ExplicitLU(El::DistMatrix<T, El::STAR, El::STAR>& A) {
+
+    ExplicitLU(A.Matrix());
+}
+
+template<typename T, El::Distribution U, El::Distribution V>
+void ExplicitLU(El::DistMatrix<T, U, V>& A) {
+
+    El::DistMatrix<T> A_MC_MR(A);
+    ExplicitLU(A_MC_MR);
+    A = A_MC_MR;
+}
+
 } } } // namespace skylark::base::qr
 
 #endif // SKYLARK_QR_HPP
@@ -6,6 +6,7 @@
 #include "exception.hpp"
 #include "sparse_matrix.hpp"
 #include "computed_matrix.hpp"
+#include "symmetric_operator.hpp"
 
 
 // Defines a generic Symm function that receives both dense and sparse matrices.
@@ -279,6 +280,36 @@ inline void Symm(El::LeftOrRight side, El::UpperOrLower uplo,
     base::Symm(side, uplo, alpha, A, B, static_cast<T>(0.0), C);
 }
 
+/**
+ * Symm with a symmetric operator: the product is delegated to the operator.
+ * Only the LEFT side is supported; uplo is ignored since the operator
+ * always acts as the full symmetric matrix.
+ */
+template<typename MatrixType>
+inline void Symm(El::LeftOrRight side, El::UpperOrLower uplo,
+    typename utility::typer_t<MatrixType>::value_type alpha,
+    const symmetric_operator_t<MatrixType>& A, const MatrixType& B,
+    typename utility::typer_t<MatrixType>::value_type beta, MatrixType& C) {
+
+    if (side != El::LEFT)
+        SKYLARK_THROW_EXCEPTION (
+            base::unsupported_base_operation()
+              << base::error_msg("Symm with a symmetric operator supports "
+                  "only the LEFT side"));
+
+    A.apply(alpha, B, beta, C);
+}
+
+template<typename MatrixType>
+inline void Symm(El::LeftOrRight side, El::UpperOrLower uplo,
+    typename utility::typer_t<MatrixType>::value_type alpha,
+    const symmetric_operator_t<MatrixType>& A, const MatrixType& B,
+    MatrixType& C) {
+
+    typedef typename utility::typer_t<MatrixType>::value_type value_type;
+    base::Symm(side, uplo, alpha, A, B, value_type(0.0), C);
+}
+
 }  // namespace base
 }  // namespace skylark
 
@@ -16,6 +16,7 @@
 #include "sparse_vc_star_matrix.hpp"
 #include "sparse_star_vr_matrix.hpp"
 #include "computed_matrix.hpp"
+#include "symmetric_operator.hpp"
 #include "graph_adapters.hpp"
 #include "basic.hpp"
 #include "query.hpp"
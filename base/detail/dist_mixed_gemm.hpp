@@ -18,8 +18,28 @@ void Gemm(El::Orientation oA, El::Orientation oB, value_type alpha,
           value_type beta,
           El::DistMatrix<value_type, El::VC, El::STAR> &C) {
 
-    //TODO:
-    SKYLARK_THROW_EXCEPTION(base::unsupported_base_operation());
+    if (oA == El::NORMAL && oB == El::NORMAL) {
+        // Local rows of A times all of B: B is replicated on every rank,
+        // so this needs memory for the whole of B (n x k) on each rank.
+        // Fine for the few right-hand sides of the iterative solvers.
+        El::DistMatrix<value_type, El::STAR, El::STAR> B_STAR_STAR(B);
+        base::Gemm(oA, oB, alpha, A.locked_matrix(),
+            B_STAR_STAR.LockedMatrix(), beta, C.Matrix());
+    } else if ((oA == El::ADJOINT || oA == El::TRANSPOSE) &&
+        oB == El::NORMAL) {
+        // Partial products of the local rows, then reduce-scatter.
+        El::DistMatrix<value_type, El::STAR, El::STAR>
+            C_STAR_STAR(C.Height(), C.Width(), C.Grid());
+        El::Zero(C_STAR_STAR);
+        base::Gemm(oA, oB, value_type(1.0), A.locked_matrix(),
+            B.LockedMatrix(), value_type(0.0), C_STAR_STAR.Matrix());
+        if (beta == value_type(0.0))
+            El::Zero(C);
+        else
+            El::Scale(beta, C);
+        El::AxpyContract(alpha, C_STAR_STAR, C);
+    } else
+        SKYLARK_THROW_EXCEPTION(base::unsupported_base_operation());
 }
 
 // sparse(VC/STAR) * dense(VC/STAR) -> dense(VC/STAR)
@@ -1,338 +1,473 @@
 #ifndef SKYLARK_DISTANCE_HPP
 #define SKYLARK_DISTANCE_HPP
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 namespace skylark { namespace base {
 
-/**
- * C = beta * C + alpha * square_euclidean_distance_matrix(A, B)
+/*
+ * In all distance routines points are the columns of a matrix if the
+ * direction is base::COLUMNS and its rows if it is base::ROWS. Entry (i, j)
+ * of the output is the distance between the i-th point of A and the j-th
+ * point of B.
  */
-template<typename T>
-void EuclideanDistanceMatrix(direction_t dirA, direction_t dirB, T alpha,
-    const El::Matrix<T> &A, const El::Matrix<T> &B,
-    T beta, El::Matrix<T> &C) {
-
-    T *c = C.Buffer();
-    El::Int ldC = C.LDim();
-
-    if (dirA == base::COLUMNS && dirB == base::COLUMNS) {
-        base::Gemm(El::ADJOINT, El::NORMAL, T(-2.0) * alpha, A, B, beta, C);
-
-        El::Matrix<T> NA, NB;
-        ColumnNrm2(A, NA);
-        ColumnNrm2(B, NB);
-        T *na = NA.Buffer(), *nb = NB.Buffer();
 
-        El::Int m = base::Width(A);
-        El::Int n = base::Width(B);
+namespace internal {
 
-        for(El::Int j = 0; j < n; j++)
-            for(El::Int i = 0; i < m; i++)
-                c[j * ldC + i] += alpha * (na[i] * na[i] + nb[j] * nb[j]);
+/** Tile size (output rows and columns) for the elementwise distances. */
+const El::Int distance_tile_size = 128;
 
-    }
+/** Feature block size for the elementwise distances. */
+const El::Int distance_feature_block = 256;
 
-    // TODO the rest of the cases.
+template<typename T>
+inline El::Int NumPoints(direction_t dir, const El::Matrix<T>& A) {
+    return dir == base::COLUMNS ? A.Width() : A.Height();
 }
 
 template<typename T>
-void EuclideanDistanceMatrix(direction_t dirA, direction_t dirB, T alpha,
-    const El::ElementalMatrix<T> &A, const El::ElementalMatrix<T> &B,
-    T beta, El::ElementalMatrix<T> &C) {
-
-    T *c = C.Buffer();
-    El::Int ldC = C.LDim();
+inline El::Int NumPoints(direction_t dir, const El::ElementalMatrix<T>& A) {
+    return dir == base::COLUMNS ? A.Width() : A.Height();
+}
 
-    if (dirA == base::COLUMNS && dirB == base::COLUMNS) {
-        El::Gemm(El::ADJOINT, El::NORMAL, T(-2.0) * alpha, A, B, T(beta), C);
+/**
+ * n[i] = squared norm of the i-th point of A.
+ */
+template<typename T>
+void SquaredPointNorms(direction_t dir, const El::Matrix<T>& A,
+    std::vector<T>& n) {
 
-        El::DistMatrix<T, El::STAR, El::STAR> NA, NB;
-        ColumnNrm2(A, NA);
-        ColumnNrm2(B, NB);
-        T *na = NA.Buffer(), *nb = NB.Buffer();
+    const T *a = A.LockedBuffer();
+    const El::Int ldA = A.LDim();
 
-        El::Int m = C.LocalHeight();
-        El::Int n = C.LocalWidth();
+    if (dir == base::COLUMNS) {
+        n.assign(A.Width(), T(0));
+
+#       ifdef SKYLARK_HAVE_OPENMP
+#       pragma omp parallel for
+#       endif
+        for(El::Int j = 0; j < A.Width(); j++) {
+            T v = 0;
+            for(El::Int i = 0; i < A.Height(); i++)
+                v += a[j * ldA + i] * a[j * ldA + i];
+            n[j] = v;
+        }
+    } else {
+        n.assign(A.Height(), T(0));
+        for(El::Int j = 0; j < A.Width(); j++)
+            for(El::Int i = 0; i < A.Height(); i++)
+                n[i] += a[j * ldA + i] * a[j * ldA + i];
+    }
+}
 
-        for(El::Int j = 0; j < n; j++)
-            for(El::Int i = 0; i < m; i++) {
-                T a = na[C.GlobalRow(i)];
-                T b = nb[C.GlobalCol(j)];
-                c[j * ldC + i] += alpha * (a * a + b * b);
+/**
+ * Distributed version: every rank gets all the norms.
+ */
+template<typename T>
+void SquaredPointNorms(direction_t dir, const El::ElementalMatrix<T>& A,
+    std::vector<T>& n) {
+
+    n.assign(NumPoints(dir, A), T(0));
+
+    if (A.Participating()) {
+        std::vector<T> local(n.size(), T(0));
+        const El::Matrix<T> &Al = A.LockedMatrix();
+        const T *a = Al.LockedBuffer();
+        for(El::Int j = 0; j < Al.Width(); j++)
+            for(El::Int i = 0; i < Al.Height(); i++) {
+                T v = a[j * Al.LDim() + i];
+                local[dir == base::COLUMNS ?
+                    A.GlobalCol(j) : A.GlobalRow(i)] += v * v;
             }
+
+        El::mpi::AllReduce(local.data(), n.data(), n.size(), MPI_SUM,
+            A.DistComm());
     }
 
-    // TODO the rest of the cases.
+    El::mpi::Broadcast(n.data(), n.size(), A.Root(), A.CrossComm());
 }
 
 /**
- * C = beta * C + alpha * square_euclidean_distance_matrix(A, A)
- * Update only lower part.
+ * Features [k0, k0 + kb) of points [i0, i0 + cnt) of A, stored point by
+ * point with leading dimension ld. If the points are rows they are packed
+ * into buf, otherwise A is referenced directly.
  */
 template<typename T>
-void SymmetricEuclideanDistanceMatrix(El::UpperOrLower uplo, direction_t dir,
-    T alpha, const El::Matrix<T> &A, T beta, El::Matrix<T> &C) {
+const T *PointBlock(direction_t dir, const El::Matrix<T>& A,
+    El::Int i0, El::Int cnt, El::Int k0, El::Int kb,
+    std::vector<T>& buf, El::Int& ld) {
 
-    T *c = C.Buffer();
-    int ldC = C.LDim();
+    const T *a = A.LockedBuffer();
+    const El::Int ldA = A.LDim();
 
     if (dir == base::COLUMNS) {
-        El::Herk(uplo, El::ADJOINT, -2.0 * alpha, A, beta, C);
-        //El::Gemm(El::ADJOINT, El::NORMAL, T(-2.0) * alpha, A, A, beta, C);
-
-        El::Matrix<T> N;
-        ColumnNrm2(A, N);
-        T *nn = N.Buffer();;
+        ld = ldA;
+        return a + i0 * ldA + k0;
+    }
 
-        int n = base::Width(A);
+    buf.resize(cnt * kb);
+    for(El::Int k = 0; k < kb; k++)
+        for(El::Int t = 0; t < cnt; t++)
+            buf[t * kb + k] = a[(k0 + k) * ldA + i0 + t];
+    ld = kb;
+    return buf.data();
+}
 
-        for(El::Int j = 0; j < n; j++)
-            for(El::Int i = ((uplo == El::UPPER) ? 0 : j);
-                i < ((uplo == El::UPPER) ? (j + 1) : n); i++)
-                c[j * ldC + i] += alpha * (nn[i] * nn[i] + nn[j] * nn[j]);
+template<typename T>
+struct abs_diff_t {
+    T operator()(T a, T b) const { return std::abs(a - b); }
+};
 
+/**
+ * V(i, j) += sum_k f(A_k(i0 + i), B_k(j0 + j)) for an mt x nt tile, with
+ * the features traversed in cache sized blocks and the inner sums
+ * vectorized. abuf and bbuf are scratch space.
+ */
+template<typename T, typename F>
+void ElementwiseDistanceTile(direction_t dirA, direction_t dirB,
+    const El::Matrix<T>& A, const El::Matrix<T>& B,
+    El::Int i0, El::Int mt, El::Int j0, El::Int nt, T *v, El::Int ldV,
+    std::vector<T>& abuf, std::vector<T>& bbuf, F f) {
+
+    const El::Int d = dirA == base::COLUMNS ? A.Height() : A.Width();
+
+    for(El::Int k0 = 0; k0 < d; k0 += distance_feature_block) {
+        const El::Int kb = std::min(distance_feature_block, d - k0);
+
+        El::Int lda, ldb;
+        const T *a = PointBlock(dirA, A, i0, mt, k0, kb, abuf, lda);
+        const T *b = PointBlock(dirB, B, j0, nt, k0, kb, bbuf, ldb);
+
+        for(El::Int j = 0; j < nt; j++) {
+            const T *bj = b + j * ldb;
+            for(El::Int i = 0; i < mt; i++) {
+                const T *ai = a + i * lda;
+                T s = 0;
+#               ifdef SKYLARK_HAVE_OPENMP
+#               pragma omp simd reduction(+:s)
+#               endif
+                for(El::Int k = 0; k < kb; k++)
+                    s += f(ai[k], bj[k]);
+                v[j * ldV + i] += s;
+            }
+        }
     }
-
-    // TODO the rest of the cases.
 }
 
-template<typename T>
-void SymmetricEuclideanDistanceMatrix(El::UpperOrLower uplo, direction_t dir,
-    T alpha, const El::ElementalMatrix<T> &A,
-    T beta, El::ElementalMatrix<T> &C) {
+/**
+ * C = beta * C + alpha * D where D(i, j) = sum_k f(A_k(i), B_k(j)).
+ *
+ * If uplo is given only the entries of that triangle are updated, where
+ * local row i (column j) of C is global row rows[i] (column cols[i]); null
+ * maps mean the identity. The maps must be increasing.
+ */
+template<typename T, typename F>
+void ElementwiseDistanceMatrix(direction_t dirA, direction_t dirB, T alpha,
+    const El::Matrix<T> &A, const El::Matrix<T> &B, T beta, El::Matrix<T> &C,
+    F f, const El::UpperOrLower *uplo = nullptr,
+    const El::Int *rows = nullptr, const El::Int *cols = nullptr) {
+
+    const El::Int m = NumPoints(dirA, A);
+    const El::Int n = NumPoints(dirB, B);
+    const El::Int tb = distance_tile_size;
+    const El::Int mtiles = (m + tb - 1) / tb;
+    const El::Int ntiles = (n + tb - 1) / tb;
 
     T *c = C.Buffer();
-    int ldC = C.LDim();
+    const El::Int ldC = C.LDim();
+
+#   ifdef SKYLARK_HAVE_OPENMP
+#   pragma omp parallel
+#   endif
+    {
+        std::vector<T> abuf, bbuf, vbuf;
+
+#       ifdef SKYLARK_HAVE_OPENMP
+#       pragma omp for schedule(dynamic)
+#       endif
+        for(El::Int t = 0; t < mtiles * ntiles; t++) {
+            const El::Int i0 = (t % mtiles) * tb;
+            const El::Int j0 = (t / mtiles) * tb;
+            const El::Int mt = std::min(tb, m - i0);
+            const El::Int nt = std::min(tb, n - j0);
+
+            if (uplo != nullptr) {
+                El::Int rfirst = rows ? rows[i0] : i0;
+                El::Int rlast = rows ? rows[i0 + mt - 1] : i0 + mt - 1;
+                El::Int cfirst = cols ? cols[j0] : j0;
+                El::Int clast = cols ? cols[j0 + nt - 1] : j0 + nt - 1;
+                if ((*uplo == El::LOWER && rlast < cfirst) ||
+                    (*uplo == El::UPPER && rfirst > clast))
+                    continue;
+            }
 
-    if (dir == base::COLUMNS) {
-        El::Herk(uplo, El::ADJOINT, -2.0 * alpha, A, beta, C);
-        //El::Gemm(El::ADJOINT, El::NORMAL, T(-2.0) * alpha, A, A, beta, C); 
+            vbuf.assign(mt * nt, T(0));
+            ElementwiseDistanceTile(dirA, dirB, A, B, i0, mt, j0, nt,
+                vbuf.data(), mt, abuf, bbuf, f);
+
+            for(El::Int j = 0; j < nt; j++) {
+                El::Int gj = cols ? cols[j0 + j] : j0 + j;
+                for(El::Int i = 0; i < mt; i++) {
+                    if (uplo != nullptr) {
+                        El::Int gi = rows ? rows[i0 + i] : i0 + i;
+                        if ((*uplo == El::LOWER && gi < gj) ||
+                            (*uplo == El::UPPER && gi > gj))
+                            continue;
+                    }
+
+                    T &cij = c[(j0 + j) * ldC + i0 + i];
+                    cij = (beta == T(0) ? T(0) : beta * cij) +
+                        alpha * vbuf[j * mt + i];
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Adds alpha * (na[i] + nb[j]) to the local entries of C, restricted to
+ * the uplo triangle if given. Local indices are mapped to global indices
+ * by rowmap/colmap.
+ */
+template<typename T, typename RowMap, typename ColMap>
+void AddSquaredNorms(T alpha, const std::vector<T>& na,
+    const std::vector<T>& nb, El::Matrix<T>& C, RowMap rowmap, ColMap colmap,
+    const El::UpperOrLower *uplo = nullptr) {
 
-        El::DistMatrix<El::Base<T>, El::STAR, El::STAR > N;
-        ColumnNrm2(A, N);
-        El::Base<T> *nn = N.Buffer();;
+    T *c = C.Buffer();
+    const El::Int ldC = C.LDim();
+
+#   ifdef SKYLARK_HAVE_OPENMP
+#   pragma omp parallel for
+#   endif
+    for(El::Int j = 0; j < C.Width(); j++) {
+        const El::Int gj = colmap(j);
+        for(El::Int i = 0; i < C.Height(); i++) {
+            const El::Int gi = rowmap(i);
+            if (uplo != nullptr &&
+                ((*uplo == El::LOWER && gi < gj) ||
+                 (*uplo == El::UPPER && gi > gj)))
+                continue;
+            c[j * ldC + i] += alpha * (na[gi] + nb[gj]);
+        }
+    }
+}
 
-        El::Int n = C.LocalWidth();
-        El::Int m = C.LocalHeight();
+struct identity_index_t {
+    El::Int operator()(El::Int i) const { return i; }
+};
 
-        for(El::Int j = 0; j < n; j++)
-            for(El::Int i =
-                    ((uplo == El::UPPER) ? 0 : C.LocalRowOffset(A.GlobalCol(j)));
-                i < ((uplo == El::UPPER) ? C.LocalRowOffset(A.GlobalCol(j) + 1) : m); i++) {
+template<typename T>
+struct global_row_t {
+    const El::ElementalMatrix<T> &M;
+    global_row_t(const El::ElementalMatrix<T> &M_) : M(M_) { }
+    El::Int operator()(El::Int i) const { return M.GlobalRow(i); }
+};
 
-                El::Base<T> a = nn[C.GlobalRow(i)];
-                El::Base<T> b = nn[C.GlobalCol(j)];
-                c[j * ldC + i] += alpha * (a * a + b * b);
-            }
-    }
+template<typename T>
+struct global_col_t {
+    const El::ElementalMatrix<T> &M;
+    global_col_t(const El::ElementalMatrix<T> &M_) : M(M_) { }
+    El::Int operator()(El::Int j) const { return M.GlobalCol(j); }
+};
+
+inline El::Orientation LeftOrientation(direction_t dir) {
+    return dir == base::COLUMNS ? El::ADJOINT : El::NORMAL;
+}
 
-    // TODO the rest of the cases.
+inline El::Orientation RightOrientation(direction_t dir) {
+    return dir == base::COLUMNS ? El::NORMAL : El::ADJOINT;
 }
 
+} // namespace internal
+
 /**
- * C = beta * C + alpha * l1_distance_matrix(A, B)
+ * C = beta * C + alpha * square_euclidean_distance_matrix(A, B)
  */
 template<typename T>
-void L1DistanceMatrix(direction_t dirA, direction_t dirB, T alpha,
+void EuclideanDistanceMatrix(direction_t dirA, direction_t dirB, T alpha,
     const El::Matrix<T> &A, const El::Matrix<T> &B,
     T beta, El::Matrix<T> &C) {
 
-    // TODO verify sizes
+    base::Gemm(internal::LeftOrientation(dirA),
+        internal::RightOrientation(dirB), T(-2.0) * alpha, A, B, beta, C);
 
-    const T *a = A.LockedBuffer();
-    El::Int ldA = A.LDim();
+    std::vector<T> na, nb;
+    internal::SquaredPointNorms(dirA, A, na);
+    internal::SquaredPointNorms(dirB, B, nb);
 
-    const T *b = B.LockedBuffer();
-    El::Int ldB = B.LDim();
+    internal::AddSquaredNorms(alpha, na, nb, C,
+        internal::identity_index_t(), internal::identity_index_t());
+}
 
-    T *c = C.Buffer();
-    El::Int ldC = C.LDim();
-
-    El::Int d = A.Height();
-
-    /* Not the most efficient way... but mimicking BLAS is too much work! */
-    if (dirA == base::COLUMNS && dirB == base::COLUMNS) {
-        for (El::Int j = 0; j < B.Width(); j++)
-            for (El::Int i = 0; i < A.Width(); i++) {
-                T v = 0.0;
-                for (El::Int k = 0; k < d; k++)
-                    v += std::abs(b[j * ldB + k] - a[i * ldA + k]);
-                c[j * ldC + i] = beta * c[j * ldC + i] + alpha * v;
-            }
+template<typename T>
+void EuclideanDistanceMatrix(direction_t dirA, direction_t dirB, T alpha,
+    const El::ElementalMatrix<T> &A, const El::ElementalMatrix<T> &B,
+    T beta, El::ElementalMatrix<T> &C) {
 
-    }
+    El::Gemm(internal::LeftOrientation(dirA),
+        internal::RightOrientation(dirB), T(-2.0) * alpha, A, B, beta, C);
+
+    std::vector<T> na, nb;
+    internal::SquaredPointNorms(dirA, A, na);
+    internal::SquaredPointNorms(dirB, B, nb);
 
-    // TODO the rest of the cases.
+    internal::AddSquaredNorms(alpha, na, nb, C.Matrix(),
+        internal::global_row_t<T>(C), internal::global_col_t<T>(C));
 }
 
+/**
+ * C = beta * C + alpha * square_euclidean_distance_matrix(A, A)
+ * Update only the uplo part.
+ */
 template<typename T>
-void L1DistanceMatrix(direction_t dirA, direction_t dirB, T alpha,
-    const El::ElementalMatrix<T> &APre, const El::ElementalMatrix<T> &BPre,
-    T beta, El::ElementalMatrix<T> &CPre) {
+void SymmetricEuclideanDistanceMatrix(El::UpperOrLower uplo, direction_t dir,
+    T alpha, const El::Matrix<T> &A, T beta, El::Matrix<T> &C) {
 
-    if (dirA == base::COLUMNS && dirB == base::COLUMNS) {
-        // Use a SUMMA-like routine, with C as stationary
-        // Basically an adaptation of Elementals TN case for stationary C.
+    El::Herk(uplo, internal::LeftOrientation(dir), T(-2.0) * alpha, A,
+        beta, C);
 
-        const El::Int m = CPre.Height();
-        const El::Int n = CPre.Width();
-        const El::Int sumDim = BPre.Height();
-        const El::Int bsize = El::Blocksize();
-        const El::Grid& g = APre.Grid();
+    std::vector<T> na;
+    internal::SquaredPointNorms(dir, A, na);
 
-        El::DistMatrixReadProxy<T, T, El::MC, El::MR> AProx(APre);
-        El::DistMatrixReadProxy<T, T, El::MC, El::MR> BProx(BPre);
-        El::DistMatrixReadWriteProxy<T, T, El::MC, El::MR> CProx(CPre);
-        auto& A = AProx.GetLocked();
-        auto& B = BProx.GetLocked();
-        auto& C = CProx.Get();
+    internal::AddSquaredNorms(alpha, na, na, C,
+        internal::identity_index_t(), internal::identity_index_t(), &uplo);
+}
 
-        // Temporary distributions
-        El::DistMatrix<T, El::STAR, El::MC> A1_STAR_MC(g);
-        El::DistMatrix<T, El::STAR, El::MR> B1_STAR_MR(g);
+template<typename T>
+void SymmetricEuclideanDistanceMatrix(El::UpperOrLower uplo, direction_t dir,
+    T alpha, const El::ElementalMatrix<T> &A,
+    T beta, El::ElementalMatrix<T> &C) {
 
-        A1_STAR_MC.AlignWith(C);
-        B1_STAR_MR.AlignWith(C);
+    El::Herk(uplo, internal::LeftOrientation(dir), T(-2.0) * alpha, A,
+        beta, C);
 
-        El::Scale(beta, C);
-        for(El::Int k = 0; k < sumDim; k += bsize) {
-            const El::Int nb = std::min(bsize,sumDim-k);
-            auto A1 = A(El::IR(k,k+nb), El::IR(0,m));
-            auto B1 = B(El::IR(k,k+nb), El::IR(0,n));
-
-            A1_STAR_MC = A1;
-            B1_STAR_MR = B1;
-            L1DistanceMatrix(base::COLUMNS, base::COLUMNS, alpha,
-                A1_STAR_MC.LockedMatrix(), B1_STAR_MR.LockedMatrix(),
-                T(1.0), C.Matrix());
-        }
-    }
+    std::vector<T> na;
+    internal::SquaredPointNorms(dir, A, na);
 
-    // TODO the rest of the cases.
+    internal::AddSquaredNorms(alpha, na, na, C.Matrix(),
+        internal::global_row_t<T>(C), internal::global_col_t<T>(C), &uplo);
 }
 
 /**
- * C = beta * C + alpha * l1_distance_matrix(A, A)
- * Update only lower part.
+ * C = beta * C + alpha * l1_distance_matrix(A, B)
  */
 template<typename T>
-void SymmetricL1DistanceMatrix(El::UpperOrLower uplo, direction_t dir, T alpha,
-    const El::Matrix<T> &A, T beta, El::Matrix<T> &C) {
-
-    const T *a = A.LockedBuffer();
-    El::Int ldA = A.LDim();
-
-    T *c = C.Buffer();
-    El::Int ldC = C.LDim();
-
-    El::Int n = A.Width();
-    El::Int d = A.Height();
-
-    /* Not the most efficient way... but mimicking BLAS is too much work! */
-    if (dir == base::COLUMNS) {
-        for (El::Int j = 0; j < n; j++)
-            for(El::Int i = ((uplo == El::UPPER) ? 0 : j);
-                i < ((uplo == El::UPPER) ? (j + 1) : n); i++)
-            for (El::Int i = 0; i < A.Width(); i++) {
-                T v = 0.0;
-                for (El::Int k = 0; k < d; k++)
-                    v += std::abs(a[j * ldA + k] - a[i * ldA + k]);
-                c[j * ldC + i] = beta * c[j * ldC + i] + alpha * v;
-            }
-
-    }
+void L1DistanceMatrix(direction_t dirA, direction_t dirB, T alpha,
+    const El::Matrix<T> &A, const El::Matrix<T> &B,
+    T beta, El::Matrix<T> &C) {
 
-    // TODO the rest of the cases.
+    internal::ElementwiseDistanceMatrix(dirA, dirB, alpha, A, B, beta, C,
+        internal::abs_diff_t<T>());
 }
 
 namespace internal {
 
 /**
- * Same as L1DistanceMatrix, except only a traingular part is updated
- * (hence the TU)
+ * Distributed elementwise distance with C stationary: feature blocks of A
+ * and B are replicated along the process rows / columns of C (a SUMMA-like
+ * loop, an adaptation of Elemental's TN case) and each rank updates its
+ * local part of C. Only the uplo triangle is updated if uplo is given.
  */
-template<typename T>
-void L1DistanceMatrixTU(El::UpperOrLower uplo,
-    direction_t dirA, direction_t dirB, T alpha,
-    const El::DistMatrix<T, El::STAR, El::MC> &A,
-    const El::DistMatrix<T, El::STAR, El::MR> &B,
-    T beta, El::DistMatrix<T> &C) {
-
-    // TODO verify sizes
+template<typename T, typename F>
+void ElementwiseDistanceMatrix(direction_t dirA, direction_t dirB, T alpha,
+    const El::ElementalMatrix<T> &APre, const El::ElementalMatrix<T> &BPre,
+    T beta, El::ElementalMatrix<T> &CPre, F f,
+    const El::UpperOrLower *uplo = nullptr) {
+
+    const El::Int sumDim =
+        dirA == base::COLUMNS ? APre.Height() : APre.Width();
+    const El::Int bsize = El::Blocksize();
+    const El::Grid& g = APre.Grid();
+
+    El::DistMatrixReadProxy<T, T, El::MC, El::MR> AProx(APre);
+    El::DistMatrixReadProxy<T, T, El::MC, El::MR> BProx(BPre);
+    El::DistMatrixReadWriteProxy<T, T, El::MC, El::MR> CProx(CPre);
+    auto& A = AProx.GetLocked();
+    auto& B = BProx.GetLocked();
+    auto& C = CProx.Get();
+
+    // Temporary distributions: points of A along the process rows of C,
+    // points of B along the process columns.
+    El::DistMatrix<T, El::STAR, El::MC> A1_STAR_MC(g);
+    El::DistMatrix<T, El::MC, El::STAR> A1_MC_STAR(g);
+    El::DistMatrix<T, El::STAR, El::MR> B1_STAR_MR(g);
+    El::DistMatrix<T, El::MR, El::STAR> B1_MR_STAR(g);
+
+    A1_STAR_MC.AlignWith(C);
+    A1_MC_STAR.AlignWith(C);
+    B1_STAR_MR.AlignWith(C);
+    B1_MR_STAR.AlignWith(C);
+
+    std::vector<El::Int> rows, cols;
+    if (uplo != nullptr) {
+        El::ScaleTrapezoid(beta, *uplo, C);
+        for(El::Int i = 0; i < C.LocalHeight(); i++)
+            rows.push_back(C.GlobalRow(i));
+        for(El::Int j = 0; j < C.LocalWidth(); j++)
+            cols.push_back(C.GlobalCol(j));
+    } else
+        El::Scale(beta, C);
 
-    const T *a = A.LockedBuffer();
-    El::Int ldA = A.LDim();
+    for(El::Int k = 0; k < sumDim; k += bsize) {
+        const El::Int nb = std::min(bsize, sumDim - k);
 
-    const T *b = B.LockedBuffer();
-    El::Int ldB = B.LDim();
+        const El::Matrix<T> *A1, *B1;
+        if (dirA == base::COLUMNS) {
+            A1_STAR_MC = A(El::IR(k, k + nb), El::ALL);
+            A1 = &A1_STAR_MC.LockedMatrix();
+        } else {
+            A1_MC_STAR = A(El::ALL, El::IR(k, k + nb));
+            A1 = &A1_MC_STAR.LockedMatrix();
+        }
 
-    T *c = C.Buffer();
-    El::Int ldC = C.LDim();
-
-    El::Int d = A.Height();
-
-    /* Not the most efficient way... but mimicking BLAS is too much work! */
-    if (dirA == base::COLUMNS && dirB == base::COLUMNS) {
-        El::Int n = C.LocalWidth();
-        El::Int m = C.LocalHeight();
-        for (El::Int j = 0; j < n; j++)
-            for(El::Int i =
-                    ((uplo == El::UPPER) ? 0 : C.LocalRowOffset(A.GlobalCol(j)));
-                i < ((uplo == El::UPPER) ? C.LocalRowOffset(A.GlobalCol(j) + 1) : m); i++) {
-
-                T v = 0.0;
-                for (El::Int k = 0; k < d; k++)
-                    v += std::abs(b[j * ldB + k] - a[i * ldA + k]);
-                c[j * ldC + i] = beta * c[j * ldC + i] + alpha * v;
-            }
+        if (dirB == base::COLUMNS) {
+            B1_STAR_MR = B(El::IR(k, k + nb), El::ALL);
+            B1 = &B1_STAR_MR.LockedMatrix();
+        } else {
+            B1_MR_STAR = B(El::ALL, El::IR(k, k + nb));
+            B1 = &B1_MR_STAR.LockedMatrix();
+        }
 
+        ElementwiseDistanceMatrix(dirA, dirB, alpha, *A1, *B1, T(1.0),
+            C.Matrix(), f, uplo,
+            rows.empty() ? nullptr : rows.data(),
+            cols.empty() ? nullptr : cols.data());
     }
-
-    // TODO the rest of the cases.
 }
 
-}
+} // namespace internal
 
 template<typename T>
-void SymmetricL1DistanceMatrix(El::UpperOrLower uplo, direction_t dir, T alpha,
-    const El::ElementalMatrix<T> &APre, T beta, El::ElementalMatrix<T> &CPre) {
-
-    if (dir == base::COLUMNS) {
-
-        const El::Int r = APre.Height();
-        const El::Int bsize = El::Blocksize();
-        const El::Grid& g = APre.Grid();
-
-        El::DistMatrixReadProxy<T, T, El::MC, El::MR> AProx(APre);
-        El::DistMatrixReadWriteProxy<T, T, El::MC, El::MR> CProx(CPre);
-        auto& A = AProx.GetLocked();
-        auto& C = CProx.Get();
-
-        // Temporary distributions
-        El::DistMatrix<T, El::STAR, El::MR> A1_STAR_MR(g);
-        El::DistMatrix<T, El::STAR, El::MC> A1_STAR_MC(g);
-
-        A1_STAR_MC.AlignWith(C);
-        A1_STAR_MR.AlignWith(C);
-
-        El::ScaleTrapezoid(beta, uplo, C);
-        for(El::Int k = 0; k < r; k += bsize) {
-            const El::Int nb = std::min(bsize, r - k);
-            auto A1 = A(El::IR(k, k + nb), El::ALL);
+void L1DistanceMatrix(direction_t dirA, direction_t dirB, T alpha,
+    const El::ElementalMatrix<T> &APre, const El::ElementalMatrix<T> &BPre,
+    T beta, El::ElementalMatrix<T> &CPre) {
 
-            A1_STAR_MC = A1;
-            A1_STAR_MR = A1;
+    internal::ElementwiseDistanceMatrix(dirA, dirB, alpha, APre, BPre,
+        beta, CPre, internal::abs_diff_t<T>());
+}
 
-            internal::L1DistanceMatrixTU(uplo, base::COLUMNS, base::COLUMNS, 
-                alpha, A1_STAR_MC, A1_STAR_MR,
-                T(1.0), C);
-        }
-    }
+/**
+ * C = beta * C + alpha * l1_distance_matrix(A, A)
+ * Update only the uplo part.
+ */
+template<typename T>
+void SymmetricL1DistanceMatrix(El::UpperOrLower uplo, direction_t dir, T alpha,
+    const El::Matrix<T> &A, T beta, El::Matrix<T> &C) {
 
-    // TODO the rest of the cases.
+    internal::ElementwiseDistanceMatrix(dir, dir, alpha, A, A, beta, C,
+        internal::abs_diff_t<T>(), &uplo);
 }
 
+template<typename T>
+void SymmetricL1DistanceMatrix(El::UpperOrLower uplo, direction_t dir, T alpha,
+    const El::ElementalMatrix<T> &APre, T beta, El::ElementalMatrix<T> &CPre) {
 
+    internal::ElementwiseDistanceMatrix(dir, dir, alpha, APre, APre,
+        beta, CPre, internal::abs_diff_t<T>(), &uplo);
+}
 
 } } // namespace skylark::base
 
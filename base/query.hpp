@@ -26,6 +26,16 @@ int Width(const sparse_dist_matrix_t<T>& A) {
 }
 
 
+template<typename MatrixType>
+int Height(const symmetric_operator_t<MatrixType>& A) {
+    return A.height();
+}
+
+template<typename MatrixType>
+int Width(const symmetric_operator_t<MatrixType>& A) {
+    return A.width();
+}
+
 template<typename T>
 int Height(const El::Matrix<T>& A) {
     return A.Height();
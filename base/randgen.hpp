@@ -114,6 +114,39 @@ public:
         return cloned_distribution(urng);
     }
 
+    /**
+     * Draws count samples from the stream of the index-th element into out
+     * (the first one is (*this)[index]). A single generator is instantiated,
+     * so this is much cheaper than count random accesses; use it when many
+     * samples are consumed in order, e.g. one element per thread or block.
+     */
+    void generate(size_t index, size_t count, value_type *out) const {
+        if( index >= _size ) {
+            std::ostringstream msg;
+            msg << "Index is out of bounds:\n";
+            msg << "index = " << index << " not in expected ";
+            msg << "[0, " << _size << ") range\n";
+            SKYLARK_THROW_EXCEPTION (
+                base::random123_exception()
+                << base::error_msg(msg.str()) );
+        }
+        if( count > (static_cast<size_t>(1) << 31) ) {
+            std::ostringstream msg;
+            msg << "Unsupported operation:\n";
+            msg << "A single element cannot supply " << count << " samples\n";
+            SKYLARK_THROW_EXCEPTION (
+                base::random123_exception()
+                << base::error_msg(msg.str()) );
+        }
+        ctr_t ctr;
+        ctr.v[0] = static_cast<ctr_t::value_type>(_base + index);
+        ctr.v[1] = static_cast<ctr_t::value_type>(0);
+	URNG_t urng(ctr, _key);
+        distribution_type cloned_distribution = _distribution;
+        for(size_t i = 0; i < count; i++)
+            out[i] = cloned_distribution(urng);
+    }
+
 private:
     size_t _base;
     size_t _size;
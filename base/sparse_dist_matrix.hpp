@@ -1,8 +1,10 @@
 #ifndef SKYLARK_SPARSE_DIST_MATRIX_HPP
 #define SKYLARK_SPARSE_DIST_MATRIX_HPP
 
+#include <cstdint>
 #include <map>
 #include <memory>
+#include <tuple>
 #include <vector>
 
 #include <boost/mpi.hpp>
@@ -11,6 +13,7 @@
 #include <El.hpp>
 
 #include "sparse_matrix.hpp"
+#include "../utility/radix_sort.hpp"
 
 namespace skylark { namespace base {
 
@@ -152,7 +155,8 @@ struct sparse_dist_matrix_t {
         int indptr_idx = 0;
         _indptr[indptr_idx] = 0;
 
-        typename std::map< std::pair<int, int>, value_type >::const_iterator itr;
+        typename std::map< std::pair<int, int>, value_type,
+                           detail::compare_t >::const_iterator itr;
         for(itr = _temp_buffer.begin(); itr != _temp_buffer.end();
                 itr++, nnz++) {
 
@@ -174,11 +178,87 @@ struct sparse_dist_matrix_t {
         assert(nnz == _nnz);
         _temp_buffer.clear();
 
-        _local_buffer->attach(&_indptr[0], &_indices[0], &_values[0],
-                _nnz, _n_local_rows, _n_local_cols, false, false, false);
+        _attach_local();
+    }
 
-        _global_nnz = 0;
-        boost::mpi::all_reduce(_comm, _nnz, _global_nnz, std::plus<int>());
+    /**
+     * Finalizes the matrix from a list of global coordinates
+     * (row, column, value). Coordinates not owned by the calling rank are
+     * ignored and duplicates are summed, exactly as if every coordinate had
+     * been passed to queue_update before calling finalize().
+     *
+     * The local CSC structure is built with a parallel radix sort instead of
+     * the ordered map used by the queue, which makes this the method of
+     * choice for large coordinate lists (e.g. when reading files).
+     */
+    template<typename IndexType>
+    void finalize(
+        const std::vector<std::tuple<IndexType, IndexType, value_type> >& coords) {
+
+        assert(_finalized == false);
+        _finalized = true;
+
+        typedef std::tuple<int, int, value_type> local_tuple_t;
+        std::vector<local_tuple_t> local;
+        local.reserve(coords.size() + _temp_buffer.size());
+
+        for(size_t k = 0; k < coords.size(); k++) {
+            El::Int i = std::get<0>(coords[k]);
+            El::Int j = std::get<1>(coords[k]);
+            if(!is_local(i, j))
+                continue;
+
+            int li = local_row(i);
+            int lj = local_col(j);
+            _n_local_rows = std::max(_n_local_rows, El::Int(li + 1));
+            _n_local_cols = std::max(_n_local_cols, El::Int(lj + 1));
+            local.push_back(std::make_tuple(li, lj, std::get<2>(coords[k])));
+        }
+
+        typename std::map< std::pair<int, int>, value_type,
+                           detail::compare_t >::const_iterator itr;
+        for(itr = _temp_buffer.begin(); itr != _temp_buffer.end(); itr++)
+            local.push_back(std::make_tuple(
+                    itr->first.first, itr->first.second, itr->second));
+        _temp_buffer.clear();
+
+        // column-major key: sorts by column, then by row
+        const std::uint64_t n_local_rows = _n_local_rows;
+        utility::RadixSort(local, [n_local_rows](const local_tuple_t& t) {
+                return static_cast<std::uint64_t>(std::get<1>(t)) *
+                    n_local_rows + static_cast<std::uint64_t>(std::get<0>(t));
+            });
+
+        _indptr.assign(_n_local_cols + 1, 0);
+        _indices.clear();
+        _values.clear();
+        _indices.reserve(local.size());
+        _values.reserve(local.size());
+
+        for(size_t k = 0; k < local.size(); k++) {
+            int cur_row = std::get<0>(local[k]);
+            int cur_col = std::get<1>(local[k]);
+            value_type cur_val = std::get<2>(local[k]);
+
+            // sum duplicates
+            while(k + 1 < local.size() &&
+                  std::get<0>(local[k + 1]) == cur_row &&
+                  std::get<1>(local[k + 1]) == cur_col) {
+                cur_val += std::get<2>(local[k + 1]);
+                k++;
+            }
+
+            _indptr[cur_col + 1]++;
+            _indices.push_back(cur_row);
+            _values.push_back(cur_val);
+        }
+
+        for(El::Int j = 0; j < _n_local_cols; j++)
+            _indptr[j + 1] += _indptr[j];
+
+        _nnz = _indices.size();
+
+        _attach_local();
     }
 
     /**
@@ -351,6 +431,14 @@ struct sparse_dist_matrix_t {
 
 private:
 
+    void _attach_local() {
+        _local_buffer->attach(&_indptr[0], _indices.data(), _values.data(),
+                _nnz, _n_local_rows, _n_local_cols, false, false, false);
+
+        _global_nnz = 0;
+        boost::mpi::all_reduce(_comm, _nnz, _global_nnz, std::plus<int>());
+    }
+
     std::unique_ptr< sparse_matrix_t<value_type> > _local_buffer;
     std::map< std::pair<int, int>, value_type, detail::compare_t > _temp_buffer;
 
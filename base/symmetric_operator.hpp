@@ -0,0 +1,35 @@
+#ifndef SKYLARK_SYMMETRIC_OPERATOR_HPP
+#define SKYLARK_SYMMETRIC_OPERATOR_HPP
+
+#include "../utility/typer.hpp"
+
+namespace skylark { namespace base {
+
+/**
+ * Defines an interface for symmetric matrices that are only available
+ * through their action on a block of vectors, i.e. that are never
+ * materialized as a whole. Such operators can be passed to the Krylov
+ * solvers in place of an explicit matrix: base::Symm and base::Height /
+ * base::Width are overloaded for them.
+ */
+template<typename MatrixType>
+struct symmetric_operator_t {
+    typedef MatrixType matrix_type;
+    typedef typename utility::typer_t<MatrixType>::value_type value_type;
+    typedef typename utility::typer_t<MatrixType>::index_type index_type;
+
+    virtual ~symmetric_operator_t() { }
+
+    virtual index_type height() const = 0;
+    virtual index_type width() const = 0;
+
+    /**
+     * C = beta * C + alpha * A * B
+     */
+    virtual void apply(value_type alpha, const matrix_type &B,
+        value_type beta, matrix_type &C) const = 0;
+};
+
+} } // namespace skylark::base
+
+#endif // SKYLARK_SYMMETRIC_OPERATOR_HPP
@@ -0,0 +1,95 @@
+#include <iostream>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#include <omp.h>
+
+#include <El.hpp>
+#include <boost/mpi.hpp>
+#include <boost/format.hpp>
+
+#define SKYLARK_NO_ANY
+#include <skylark.hpp>
+
+/**
+ * Times AsyRGS on the 5-point Laplacian of a g x g grid (shifted to be
+ * better conditioned), with atomic and relaxed updates, for 1, 2, 4, ...
+ * threads up to the maximum, and reports sweeps per second.
+ *
+ * Usage: asynch_benchmark [g] [k] [sweeps] [syn_sweeps]
+ *   g: grid size (n = g^2 unknowns); k: number of right-hand sides;
+ *   syn_sweeps: sweeps between synchronizations (residual checks).
+ */
+
+namespace skyb = skylark::base;
+namespace skyalg = skylark::algorithms;
+
+int main(int argc, char **argv) {
+
+    El::Initialize(argc, argv);
+
+    int g = argc > 1 ? std::atoi(argv[1]) : 1000;
+    int k = argc > 2 ? std::atoi(argv[2]) : 1;
+    int sweeps = argc > 3 ? std::atoi(argv[3]) : 20;
+    int n = g * g;
+
+    skyb::context_t context(23234);
+
+    skyb::sparse_matrix_t<double>::coords_t coords;
+    for(int i = 0; i < g; i++)
+        for(int j = 0; j < g; j++) {
+            int r = i * g + j;
+            coords.push_back(std::make_tuple(r, r, 4.5));
+            if (i > 0)
+                coords.push_back(std::make_tuple(r, r - g, -1.0));
+            if (i < g - 1)
+                coords.push_back(std::make_tuple(r, r + g, -1.0));
+            if (j > 0)
+                coords.push_back(std::make_tuple(r, r - 1, -1.0));
+            if (j < g - 1)
+                coords.push_back(std::make_tuple(r, r + 1, -1.0));
+        }
+    skyb::sparse_matrix_t<double> A;
+    A.set(coords, n, n);
+
+    El::Matrix<double> B, X;
+    skyb::GaussianMatrix(B, n, k, context);
+
+    // Relaxed updates need synchronizations to check the residual. Both runs
+    // synchronize, and compute the residual, every syn_sweeps sweeps: the
+    // tolerance is never met, but makes the atomic run check as well.
+    int syn_sweeps = argc > 4 ? std::atoi(argv[4]) : 5;
+    skyalg::asy_iter_params_t params(std::numeric_limits<double>::min(),
+        syn_sweeps, sweeps);
+
+    std::cout << "n = " << n << ", k = " << k << ", " << sweeps << " sweeps"
+              << ", synchronizing every " << syn_sweeps << std::endl
+              << "threads    atomic (sweeps/s)    relaxed (sweeps/s)"
+              << std::endl;
+
+    int max_threads = omp_get_max_threads();
+    for(int t = 1; ; t = std::min(2 * t, max_threads)) {
+        omp_set_num_threads(t);
+
+        double rate[2];
+        for(int r = 0; r < 2; r++) {
+            params.relaxed = r == 1;
+            El::Zeros(X, n, k);
+            boost::mpi::timer timer;
+            skyalg::AsyRGS(A, B, X, context, params);
+            rate[r] = sweeps / timer.elapsed();
+        }
+
+        std::cout << boost::format("%7d") % t
+                  << "    " << boost::format("%17.3f") % rate[0]
+                  << "    " << boost::format("%18.3f") % rate[1]
+                  << std::endl;
+
+        if (t == max_threads)
+            break;
+    }
+
+    El::Finalize();
+    return 0;
+}
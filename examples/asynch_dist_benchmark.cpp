@@ -0,0 +1,114 @@
+#include <iostream>
+#include <cstdlib>
+#include <tuple>
+#include <vector>
+
+#include <El.hpp>
+#include <boost/mpi.hpp>
+#include <boost/format.hpp>
+
+#define SKYLARK_NO_ANY
+#include <skylark.hpp>
+
+/**
+ * Solves the (shifted) 5-point Laplacian of a g x g grid, as a [VC,STAR]
+ * sparse matrix, to a fixed tolerance with the distributed AsyRGS, AsyFCG
+ * and synchronous CG, and reports time and residual. Run with increasing
+ * numbers of ranks for scaling.
+ *
+ * Usage: asynch_dist_benchmark [g] [k] [tolerance] [staleness]
+ *   g: grid size (n = g^2 unknowns); k: number of right-hand sides.
+ */
+
+namespace skyb = skylark::base;
+namespace skyalg = skylark::algorithms;
+
+typedef El::DistMatrix<double, El::VC, El::STAR> dense_type;
+
+double relres(const skyb::sparse_vc_star_matrix_t<double>& A,
+    const dense_type& B, const dense_type& X) {
+    dense_type R(B);
+    skyb::Symm(El::LEFT, El::LOWER, -1.0, A, X, 1.0, R);
+    return El::FrobeniusNorm(R) / El::FrobeniusNorm(B);
+}
+
+template<typename SolveFunction>
+void run(const char *name, const skyb::sparse_vc_star_matrix_t<double>& A,
+    const dense_type& B, dense_type& X, SolveFunction solve) {
+    boost::mpi::communicator world;
+    El::Zeros(X, B.Height(), B.Width());
+    world.barrier();
+    boost::mpi::timer timer;
+    solve();
+    world.barrier();
+    double t = timer.elapsed();
+    double res = relres(A, B, X);
+    if (world.rank() == 0)
+        std::cout << boost::format("%-10s") % name
+                  << boost::format("%.3e") % t << "     "
+                  << boost::format("%.2e") % res << std::endl;
+}
+
+int main(int argc, char **argv) {
+
+    El::Initialize(argc, argv);
+
+    int g = argc > 1 ? std::atoi(argv[1]) : 1000;
+    int k = argc > 2 ? std::atoi(argv[2]) : 1;
+    double tolerance = argc > 3 ? std::atof(argv[3]) : 1e-3;
+    int staleness = argc > 4 ? std::atoi(argv[4]) : 1000;
+    El::Int n = El::Int(g) * g;
+
+    boost::mpi::communicator world;
+    El::Grid grid(world);
+    skyb::context_t context(23234);
+
+    std::vector<std::tuple<El::Int, El::Int, double> > coords;
+    for(El::Int r = world.rank(); r < n; r += world.size()) {
+        El::Int i = r / g, j = r % g;
+        coords.push_back(std::make_tuple(r, r, 4.5));
+        if (i > 0)
+            coords.push_back(std::make_tuple(r, r - g, -1.0));
+        if (i < g - 1)
+            coords.push_back(std::make_tuple(r, r + g, -1.0));
+        if (j > 0)
+            coords.push_back(std::make_tuple(r, r - 1, -1.0));
+        if (j < g - 1)
+            coords.push_back(std::make_tuple(r, r + 1, -1.0));
+    }
+    skyb::sparse_vc_star_matrix_t<double> A(n, n, grid);
+    A.finalize(coords);
+
+    dense_type B(grid), X(grid);
+    skyb::GaussianMatrix(B, n, k, context);
+
+    if (world.rank() == 0)
+        std::cout << "n = " << n << ", k = " << k << ", " << world.size()
+                  << " ranks, tolerance " << tolerance
+                  << ", staleness " << staleness << std::endl
+                  << "solver    time (s)      relres" << std::endl;
+
+    skyalg::asy_iter_params_t asy_params;
+    asy_params.tolerance = tolerance;
+    asy_params.syn_sweeps = 5;
+    asy_params.sweeps_lim = 2000;
+    asy_params.staleness = staleness;
+    run("AsyRGS", A, B, X, [&] {
+            skyalg::AsyRGS(A, B, X, context, asy_params);
+        });
+
+    asy_params.sweeps_lim = 2;
+    asy_params.syn_sweeps = 0;
+    asy_params.iter_lim = 500;
+    run("AsyFCG", A, B, X, [&] {
+            skyalg::AsyFCG(A, B, X, context, asy_params);
+        });
+
+    skyalg::krylov_iter_params_t krylov_params(tolerance, 2000);
+    run("CG", A, B, X, [&] {
+            skyalg::CG(El::LOWER, A, B, X, krylov_params);
+        });
+
+    El::Finalize();
+    return 0;
+}
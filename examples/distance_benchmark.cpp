@@ -0,0 +1,123 @@
+#include <iostream>
+#include <cstdlib>
+#include <string>
+
+#include <El.hpp>
+#include <boost/mpi.hpp>
+#include <boost/format.hpp>
+
+#define SKYLARK_NO_ANY
+#include <skylark.hpp>
+
+/**
+ * Times the Euclidean and L1 distance matrices for all direction
+ * combinations, on local matrices (rank 0) and on [MC,MR] matrices.
+ *
+ * Usage: distance_benchmark [m] [n] [d] [repetitions]
+ */
+
+namespace skyb = skylark::base;
+
+const char *dir_label(skyb::direction_t dir) {
+    return dir == skyb::COLUMNS ? "C" : "R";
+}
+
+template<typename MatrixType>
+void random_points(skyb::direction_t dir, El::Int n, El::Int d,
+    MatrixType &A) {
+    if (dir == skyb::COLUMNS)
+        El::Uniform(A, d, n);
+    else
+        El::Uniform(A, n, d);
+}
+
+template<typename MatrixType, typename DistanceFunction>
+double time_distance(skyb::direction_t dirA, skyb::direction_t dirB,
+    El::Int m, El::Int n, El::Int d, int reps, bool collective,
+    MatrixType &A, MatrixType &B, MatrixType &C, DistanceFunction f) {
+
+    random_points(dirA, m, d, A);
+    random_points(dirB, n, d, B);
+    El::Zeros(C, m, n);
+
+    f(dirA, dirB, A, B, C);      // Warm up
+
+    boost::mpi::communicator world;
+    if (collective)
+        world.barrier();
+    boost::mpi::timer timer;
+    for(int r = 0; r < reps; r++)
+        f(dirA, dirB, A, B, C);
+    if (collective)
+        world.barrier();
+    return timer.elapsed() / reps;
+}
+
+struct euclidean_t {
+    template<typename MatrixType>
+    void operator()(skyb::direction_t dirA, skyb::direction_t dirB,
+        const MatrixType &A, const MatrixType &B, MatrixType &C) const {
+        skyb::EuclideanDistanceMatrix(dirA, dirB, 1.0, A, B, 0.0, C);
+    }
+};
+
+struct l1_t {
+    template<typename MatrixType>
+    void operator()(skyb::direction_t dirA, skyb::direction_t dirB,
+        const MatrixType &A, const MatrixType &B, MatrixType &C) const {
+        skyb::L1DistanceMatrix(dirA, dirB, 1.0, A, B, 0.0, C);
+    }
+};
+
+int main(int argc, char **argv) {
+
+    El::Initialize(argc, argv);
+
+    El::Int m = argc > 1 ? std::atol(argv[1]) : 4000;
+    El::Int n = argc > 2 ? std::atol(argv[2]) : 4000;
+    El::Int d = argc > 3 ? std::atol(argv[3]) : 500;
+    int reps = argc > 4 ? std::atoi(argv[4]) : 3;
+
+    boost::mpi::communicator world;
+    El::Grid grid(world);
+
+    const skyb::direction_t dirs[] = {skyb::COLUMNS, skyb::ROWS};
+
+    if (world.rank() == 0)
+        std::cout << "m = " << m << ", n = " << n << ", d = " << d
+                  << ", " << world.size() << " ranks" << std::endl
+                  << "dirs  kind         local (s)    dist (s)" << std::endl;
+
+    for(int kind = 0; kind < 2; kind++)
+        for(skyb::direction_t dirA : dirs)
+            for(skyb::direction_t dirB : dirs) {
+
+                double tlocal = 0.0;
+                if (world.rank() == 0) {
+                    El::Matrix<double> A, B, C;
+                    tlocal = kind == 0 ?
+                        time_distance(dirA, dirB, m, n, d, reps, false,
+                            A, B, C, euclidean_t()) :
+                        time_distance(dirA, dirB, m, n, d, reps, false,
+                            A, B, C, l1_t());
+                }
+
+                El::DistMatrix<double> A(grid), B(grid), C(grid);
+                double tdist = kind == 0 ?
+                    time_distance(dirA, dirB, m, n, d, reps, true,
+                        A, B, C, euclidean_t()) :
+                    time_distance(dirA, dirB, m, n, d, reps, true,
+                        A, B, C, l1_t());
+
+                if (world.rank() == 0)
+                    std::cout << dir_label(dirA) << dir_label(dirB) << "    "
+                              << (kind == 0 ? "euclidean" : "l1       ")
+                              << "    "
+                              << boost::format("%.3e") % tlocal << "    "
+                              << boost::format("%.3e") % tdist
+                              << std::endl;
+            }
+
+    El::Finalize();
+    return 0;
+}
@@ -38,7 +38,9 @@ int fileformat = FORMAT_LIBSVM;
 int s = 2000, partial = -1, sketch_size = -1, sample = -1, maxit = 0, maxsplit = 0;
 std::string fname, testname, modelname = "model.dat", logfile = "";
 double kp1 = 10.0, kp2 = 0.0, kp3 = 1.0, lambda = 0.01, tolerance=0;
-bool use_single, use_fast;
+double gram_cache_mb = 0.0, z_cache_mb = 0.0;
+int z_cache_precision = skylark::ml::FEATURE_CACHE_BFLOAT16;
+bool use_single, use_fast, use_matrix_free;
 
 #ifndef SKYLARK_AVOID_BOOST_PO
 
@@ -108,6 +110,21 @@ int parse_program_options(int argc, char* argv[]) {
             "Sample the input data. Will use all if -1. ")
         ("single", "Whether to use single precision instead of double.")
         ("fast", "Try using a fast feature transform.")
+        ("matrixfree", "Never form the kernel matrix (for -a 0 and -a 1); "
+            "its products are computed panel by panel.")
+        ("gramcache",
+            bpo::value<double>(&gram_cache_mb)->default_value(0.0),
+            "Memory (MB per process) for caching kernel matrix panels "
+            "with --matrixfree.")
+        ("zcache",
+            bpo::value<double>(&z_cache_mb)->default_value(0.0),
+            "Memory (MB per process) for keeping random features between "
+            "iterations (for -a 5).")
+        ("zcacheprecision",
+            bpo::value<int>(&z_cache_precision)->default_value(
+                skylark::ml::FEATURE_CACHE_BFLOAT16),
+            "Lowest precision for cached random features, used if they do "
+            "not fit otherwise (0: full, 1: float, 2: bfloat16).")
         ("numfeatures,f",
             bpo::value<int>(&s),
             "Number of random features (if relevant).")
@@ -145,6 +162,7 @@ int parse_program_options(int argc, char* argv[]) {
 
         use_single = vm.count("single");
         use_fast = vm.count("fast");
+        use_matrix_free = vm.count("matrixfree");
 
     } catch(bpo::error& e) {
         std::cerr << e.what() << std::endl;
@@ -220,6 +238,20 @@ int parse_program_options(int argc, char* argv[]) {
             i--;
         }
 
+        if (flag == "--matrixfree") {
+            use_matrix_free = true;
+            i--;
+        }
+
+        if (flag == "--gramcache")
+            gram_cache_mb = boost::lexical_cast<double>(value);
+
+        if (flag == "--zcache")
+            z_cache_mb = boost::lexical_cast<double>(value);
+
+        if (flag == "--zcacheprecision")
+            z_cache_precision = boost::lexical_cast<int>(value);
+
         if (flag == "--trainfile")
             fname = value;
 
@@ -374,6 +406,10 @@ int execute(skylark::base::context_t &context) {
 
     skylark::ml::rlsc_params_t rlsc_params(rank == 0, 4, *log_stream, "\t");
     rlsc_params.use_fast = use_fast;
+    rlsc_params.matrix_free = use_matrix_free;
+    rlsc_params.gram_cache_mb = gram_cache_mb;
+    rlsc_params.z_cache_mb = z_cache_mb;
+    rlsc_params.z_cache_precision = z_cache_precision;
 
     skylark::ml::model_t<El::Int, T> *model;
 
@@ -0,0 +1,112 @@
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+
+#include <El.hpp>
+#include <boost/mpi.hpp>
+#include <boost/format.hpp>
+
+#define SKYLARK_NO_ANY
+#include <skylark.hpp>
+
+/**
+ * Times a fixed number of iterations of CG (on a random SPD [MC,MR] matrix)
+ * and of LSQR (on a random [VC,STAR] matrix), standard and pipelined (see
+ * krylov_iter_params_t::pipelined), and reports the time per iteration.
+ * Run with increasing numbers of ranks for scaling.
+ *
+ * Usage: krylov_benchmark [n] [m] [d] [k] [iterations]
+ *   n: size of the CG system; m x d: size of the LSQR matrix;
+ *   k: number of right-hand sides.
+ */
+
+namespace skyb = skylark::base;
+namespace skyalg = skylark::algorithms;
+
+template<typename SolveFunction>
+double time_per_iteration(int iterations, SolveFunction solve) {
+    boost::mpi::communicator world;
+    world.barrier();
+    boost::mpi::timer timer;
+    solve();
+    world.barrier();
+    return timer.elapsed() / iterations;
+}
+
+int main(int argc, char **argv) {
+
+    El::Initialize(argc, argv);
+
+    El::Int n = argc > 1 ? std::atol(argv[1]) : 4000;
+    El::Int m = argc > 2 ? std::atol(argv[2]) : 100000;
+    El::Int d = argc > 3 ? std::atol(argv[3]) : 200;
+    El::Int k = argc > 4 ? std::atol(argv[4]) : 1;
+    int iterations = argc > 5 ? std::atoi(argv[5]) : 50;
+
+    boost::mpi::communicator world;
+    El::Grid grid(world);
+    skyb::context_t context(38734);
+
+    // Ill-conditioned problems, so every run does all the iterations.
+    skyalg::krylov_iter_params_t params(0.0, iterations);
+
+    if (world.rank() == 0)
+        std::cout << "CG n = " << n << ", LSQR " << m << " x " << d
+                  << ", k = " << k << ", " << world.size() << " ranks"
+                  << std::endl
+                  << "solver    standard (s/it)    pipelined (s/it)"
+                  << std::endl;
+
+    {
+        El::DistMatrix<double> G(grid), A(grid), B(grid), X(grid);
+        skyb::GaussianMatrix(G, n, n, context);
+        El::Identity(A, n, n);
+        El::Herk(El::LOWER, El::NORMAL, 1.0 / n, G, 1e-3, A);
+        skyb::GaussianMatrix(B, n, k, context);
+
+        double t[2];
+        for(int p = 0; p < 2; p++) {
+            params.pipelined = p == 1;
+            El::Zeros(X, n, k);
+            t[p] = time_per_iteration(iterations, [&] {
+                    skyalg::CG(El::LOWER, A, B, X, params);
+                });
+        }
+
+        if (world.rank() == 0)
+            std::cout << "CG        " << boost::format("%.3e") % t[0]
+                      << "          " << boost::format("%.3e") % t[1]
+                      << std::endl;
+    }
+
+    {
+        El::DistMatrix<double, El::VC, El::STAR> A(grid), B(grid);
+        El::DistMatrix<double, El::STAR, El::STAR> X(grid);
+        skyb::GaussianMatrix(A, m, d, context);
+        skyb::GaussianMatrix(B, m, k, context);
+
+        // Column scales from 1 to 1e-6, so that LSQR does not converge.
+        El::DistMatrix<double, El::STAR, El::STAR> scales(d, 1, grid);
+        for(El::Int j = 0; j < d; j++)
+            scales.Set(j, 0, std::pow(10.0, -6.0 * j / d));
+        El::DiagonalScale(El::RIGHT, El::NORMAL, scales, A);
+
+        double t[2];
+        for(int p = 0; p < 2; p++) {
+            params.pipelined = p == 1;
+            El::Zeros(X, d, k);
+            t[p] = time_per_iteration(iterations, [&] {
+                    skyalg::LSQR(A, B, X, params);
+                });
+        }
+
+        if (world.rank() == 0)
+            std::cout << "LSQR      " << boost::format("%.3e") % t[0]
+                      << "          " << boost::format("%.3e") % t[1]
+                      << std::endl;
+    }
+
+    El::Finalize();
+    return 0;
+}
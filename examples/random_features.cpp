@@ -1,4 +1,6 @@
+#include <functional>
 #include <iostream>
+#include <memory>
 
 #include <El.hpp>
 #include <boost/mpi.hpp>
@@ -117,37 +119,43 @@ int main(int argc, char* argv[]) {
 
     boost::mpi::timer timer;
 
-    // Load A and Y
+    // Load X and L, and transform every block of examples as soon as it is
+    // distributed, while the next blocks are still being read.
     if (rank == 0) {
-        std::cout << "Reading the matrix... ";
+        std::cout << "Reading and transforming the matrix... ";
         std::cout.flush();
         timer.restart();
     }
 
-    skylark::utility::io::ReadLIBSVM(infile, X, L,
-        skylark::base::COLUMNS, mind);
-
-    if (rank == 0)
-        std::cout <<"took " << boost::format("%.2e") % timer.elapsed()
-                  << " sec\n";
-
-    // Compute kernel matrix
-    if (rank == 0) {
-        std::cout << "Computing the transformed matrix... ";
-        std::cout.flush();
-        timer.restart();
-    }
+    data_matrix_t Z;
+    std::unique_ptr<skylark::sketch::sketch_transform_t<data_matrix_t,
+                                                        data_matrix_t> > S;
+    data_matrix_t Zv;
+    skylark::utility::io::pipeline_stats_t stats;
+
+    std::function<void (data_matrix_t&, label_matrix_t&, int)> transform =
+        [&](data_matrix_t& Xv, label_matrix_t& Lv, int start) {
+            if (!S) {
+                skylark::ml::gaussian_t k(X.Height(), sigma);
+                S.reset(k.create_rft<data_matrix_t, data_matrix_t>(s,
+                        skylark::ml::regular_feature_transform_tag(),
+                        context));
+                Z.Resize(s, X.Width());
+            }
+
+            El::View(Zv, Z, 0, start, s, Xv.Width());
+            S->apply(Xv, Zv, skylark::sketch::columnwise_tag());
+        };
 
-    data_matrix_t Z(s, X.Width());
-    skylark::ml::gaussian_t k(X.Height(), sigma);
-    auto S = k.create_rft<data_matrix_t, data_matrix_t>(s,
-        skylark::ml::regular_feature_transform_tag(), context);
-    S->apply(X, Z, skylark::sketch::columnwise_tag());
+    skylark::utility::io::ReadLIBSVM(infile, X, L,
+        skylark::base::COLUMNS, mind, -1, 10000, transform, 2, &stats);
 
     if (rank == 0)
         std::cout << "took " << boost::format("%.2e") % timer.elapsed()
                   << " sec\n";
 
+    stats.print(world);
+
     // Write output
     if (rank == 0) {
         std::cout << "Writing the matrix... ";
@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <El.hpp>
+#include <boost/mpi.hpp>
+#include <boost/format.hpp>
+#include <boost/random.hpp>
+
+#define SKYLARK_NO_ANY
+#include <skylark.hpp>
+
+/**
+ * Times random feature maps (columnwise) applied to a sparse matrix, on the
+ * sparse path and after densifying the input, and reports the working
+ * memory of each path and the largest difference between the outputs.
+ *
+ * Usage: sparse_features_benchmark [d] [n] [S] [density] [repetitions]
+ */
+
+namespace skyb = skylark::base;
+namespace skys = skylark::sketch;
+
+typedef skyb::sparse_matrix_t<double> sparse_matrix_type;
+typedef El::Matrix<double> dense_matrix_type;
+
+void random_sparse(El::Int d, El::Int n, double density, int seed,
+    sparse_matrix_type &A) {
+
+    boost::random::mt19937 gen(seed);
+    boost::random::uniform_real_distribution<double> value(-1.0, 1.0);
+    boost::random::uniform_int_distribution<int> row(0, d - 1);
+
+    int per_column = std::max(1, int(density * d));
+    int *indptr = new int[n + 1];
+    int *indices = new int[n * per_column];
+    double *values = new double[n * per_column];
+
+    indptr[0] = 0;
+    for(El::Int j = 0; j < n; j++) {
+        std::vector<int> rows(per_column);
+        for(int i = 0; i < per_column; i++)
+            rows[i] = row(gen);
+        std::sort(rows.begin(), rows.end());
+        rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+        indptr[j + 1] = indptr[j] + rows.size();
+        for(size_t i = 0; i < rows.size(); i++) {
+            indices[indptr[j] + i] = rows[i];
+            values[indptr[j] + i] = value(gen);
+        }
+    }
+
+    A.attach(indptr, indices, values, indptr[n], d, n, true);
+}
+
+template<typename SparseTransform, typename DenseTransform>
+void compare(const std::string &name, const SparseTransform &Ss,
+    const DenseTransform &Sd, const sparse_matrix_type &A, El::Int S,
+    int reps, double sparse_mb, double dense_mb) {
+
+    El::Int n = A.width();
+    dense_matrix_type SAs(S, n), SAd(S, n);
+
+    Ss.apply(A, SAs, skys::columnwise_tag());     // Warm up
+    boost::mpi::timer timer;
+    for(int r = 0; r < reps; r++)
+        Ss.apply(A, SAs, skys::columnwise_tag());
+    double sparse_time = timer.elapsed() / reps;
+
+    timer.restart();
+    for(int r = 0; r < reps; r++) {
+        dense_matrix_type Ad;
+        skyb::DenseCopy(A, Ad);
+        Sd.apply(Ad, SAd, skys::columnwise_tag());
+    }
+    double dense_time = timer.elapsed() / reps;
+
+    El::Axpy(-1.0, SAs, SAd);
+    std::cout << boost::format("%-18s sparse %9.4f s %10.1f MB"
+        "   densified %9.4f s %10.1f MB   max diff %.2e")
+        % name % sparse_time % sparse_mb % dense_time % dense_mb
+        % El::MaxNorm(SAd) << std::endl;
+}
+
+int main(int argc, char **argv) {
+
+    El::Initialize(argc, argv);
+
+    El::Int d = argc > 1 ? std::atol(argv[1]) : 100000;
+    El::Int n = argc > 2 ? std::atol(argv[2]) : 1000;
+    El::Int S = argc > 3 ? std::atol(argv[3]) : 1000;
+    double density = argc > 4 ? std::atof(argv[4]) : 0.001;
+    int reps = argc > 5 ? std::atoi(argv[5]) : 3;
+
+    sparse_matrix_type A;
+    random_sparse(d, n, density, 38734, A);
+
+    std::vector<int> rows(A.indices(), A.indices() + A.nonzeros());
+    std::sort(rows.begin(), rows.end());
+    El::Int touched =
+        std::unique(rows.begin(), rows.end()) - rows.begin();
+
+    // Working memory: the input and the realized part of the projection.
+    const double MB = 1024.0 * 1024.0;
+    double sparse_mb = (A.nonzeros() * (sizeof(double) + sizeof(int))
+        + S * touched * sizeof(double)) / MB;
+    double dense_mb = (d * n + S * d) * sizeof(double) / MB;
+
+    std::cout << "d = " << d << ", n = " << n << ", S = " << S
+              << ", nonzeros = " << A.nonzeros()
+              << ", rows touched = " << touched << std::endl;
+
+    skyb::context_t context(38734);
+    double sigma = 10.0;
+
+    {
+        skys::GaussianRFT_t<sparse_matrix_type, dense_matrix_type>
+            Ss(d, S, sigma, context);
+        skys::GaussianRFT_t<dense_matrix_type, dense_matrix_type> Sd(Ss);
+        compare("GaussianRFT", Ss, Sd, A, S, reps, sparse_mb, dense_mb);
+    }
+
+    {
+        skys::LaplacianRFT_t<sparse_matrix_type, dense_matrix_type>
+            Ss(d, S, sigma, context);
+        skys::LaplacianRFT_t<dense_matrix_type, dense_matrix_type> Sd(Ss);
+        compare("LaplacianRFT", Ss, Sd, A, S, reps, sparse_mb, dense_mb);
+    }
+
+    {
+        skyb::leaped_halton_sequence_t<double> sequence(d);
+        skys::GaussianQRFT_t<sparse_matrix_type, dense_matrix_type,
+                             skyb::leaped_halton_sequence_t>
+            Ss(d, S, sigma, sequence, 1000, context);
+        skys::GaussianQRFT_t<dense_matrix_type, dense_matrix_type,
+                             skyb::leaped_halton_sequence_t> Sd(Ss);
+        compare("GaussianQRFT", Ss, Sd, A, S, reps, sparse_mb, dense_mb);
+    }
+
+#if SKYLARK_HAVE_FFTW || SKYLARK_HAVE_SPIRALWHT
+    {
+        // Densifies one column per thread; the projection is implicit.
+        skys::FastGaussianRFT_t<sparse_matrix_type, dense_matrix_type>
+            Ss(d, S, sigma, context);
+        skys::FastGaussianRFT_t<dense_matrix_type, dense_matrix_type> Sd(Ss);
+        compare("FastGaussianRFT", Ss, Sd, A, S, reps,
+            A.nonzeros() * (sizeof(double) + sizeof(int)) / MB,
+            d * n * sizeof(double) / MB);
+    }
+#endif
+
+    El::Finalize();
+    return 0;
+}
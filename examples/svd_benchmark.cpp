@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <El.hpp>
+#include <boost/mpi.hpp>
+#include <boost/format.hpp>
+#include <boost/random.hpp>
+
+#define SKYLARK_NO_ANY
+#include <skylark.hpp>
+
+/**
+ * Accuracy against number of passes over A of the approximate SVDs:
+ * ApproximateSVD (power iteration), BlockKrylovSVD and SinglePassSVD, on a
+ * dense matrix with decaying spectrum and on a random sparse matrix.
+ * Reports the largest relative error of the top singular values and
+ * ||A - U S V^T||_F / ||A - A_r||_F (1 is optimal).
+ *
+ * Usage: svd_benchmark [m] [n] [rank] [density]
+ */
+
+namespace skyb = skylark::base;
+namespace skynla = skylark::nla;
+namespace skys = skylark::sketch;
+
+typedef El::Matrix<double> dense_matrix_type;
+typedef skyb::sparse_matrix_t<double> sparse_matrix_type;
+
+void random_sparse(El::Int m, El::Int n, double density, int seed,
+    sparse_matrix_type &A) {
+
+    boost::random::mt19937 gen(seed);
+    boost::random::uniform_real_distribution<double> value(-1.0, 1.0);
+    boost::random::uniform_int_distribution<int> row(0, m - 1);
+
+    int per_column = std::max(1, int(density * m));
+    int *indptr = new int[n + 1];
+    int *indices = new int[n * per_column];
+    double *values = new double[n * per_column];
+
+    indptr[0] = 0;
+    for(El::Int j = 0; j < n; j++) {
+        std::vector<int> rows(per_column);
+        for(int i = 0; i < per_column; i++)
+            rows[i] = row(gen);
+        std::sort(rows.begin(), rows.end());
+        rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+        indptr[j + 1] = indptr[j] + rows.size();
+        for(size_t i = 0; i < rows.size(); i++) {
+            indices[indptr[j] + i] = rows[i];
+            values[indptr[j] + i] = value(gen);
+        }
+    }
+
+    A.attach(indptr, indices, values, indptr[n], m, n, true);
+}
+
+/** Exact singular values, and the optimal rank r residual. */
+void exact(const dense_matrix_type &Ad, int rank, dense_matrix_type &s,
+    double &optimal) {
+    dense_matrix_type C(Ad);
+    El::SVD(C, s);
+    optimal = 0.0;
+    for(El::Int i = rank; i < s.Height(); i++)
+        optimal += s.Get(i, 0) * s.Get(i, 0);
+    optimal = std::sqrt(optimal);
+}
+
+void report(const std::string &name, int passes, double time,
+    const dense_matrix_type &Ad, const dense_matrix_type &s, double optimal,
+    const dense_matrix_type &U, const dense_matrix_type &S,
+    const dense_matrix_type &V) {
+
+    int rank = S.Height();
+    double sverr = 0.0;
+    for(int i = 0; i < rank; i++)
+        sverr = std::max(sverr,
+            std::abs(S.Get(i, 0) - s.Get(i, 0)) / s.Get(i, 0));
+
+    dense_matrix_type US(U), E(Ad);
+    El::DiagonalScale(El::RIGHT, El::NORMAL, S, US);
+    El::Gemm(El::NORMAL, El::ADJOINT, -1.0, US, V, 1.0, E);
+
+    std::cout << boost::format("%-22s %6d %10.3e %12.3e %12.4f")
+        % name % passes % time % sverr
+        % (El::FrobeniusNorm(E) / optimal) << std::endl;
+}
+
+template<typename InputType>
+void run(const std::string &title, const InputType &A,
+    const dense_matrix_type &Ad, int rank) {
+
+    dense_matrix_type s, U, S, V;
+    double optimal;
+    exact(Ad, rank, s, optimal);
+
+    std::cout << title << std::endl
+              << "method                 passes   time (s)   "
+              << "sv rel err   resid/opt" << std::endl;
+
+    boost::mpi::timer timer;
+    for(int q = 0; q <= 3; q++) {
+        skynla::approximate_svd_params_t params;
+        params.num_iterations = q;
+
+        skyb::context_t context(38734);
+        timer.restart();
+        skynla::ApproximateSVD(A, U, S, V, rank, context, params);
+        report((boost::format("power iteration q=%d") % q).str(), 2 * q + 2,
+            timer.elapsed(), Ad, s, optimal, U, S, V);
+
+        skyb::context_t kcontext(38734);
+        timer.restart();
+        skynla::BlockKrylovSVD(A, U, S, V, rank, kcontext, params);
+        report((boost::format("block Krylov q=%d") % q).str(), 2 * q + 2,
+            timer.elapsed(), Ad, s, optimal, U, S, V);
+    }
+
+    skyb::context_t context(38734);
+    timer.restart();
+    skynla::SinglePassSVD(A, U, S, V, rank, context);
+    report("single pass (JLT)", 1, timer.elapsed(), Ad, s, optimal,
+        U, S, V);
+
+    skyb::context_t ccontext(38734);
+    timer.restart();
+    skynla::SinglePassSVD<skys::JLT_t, skys::CWT_t>(A, U, S, V, rank,
+        ccontext);
+    report("single pass (JLT/CWT)", 1, timer.elapsed(), Ad, s, optimal,
+        U, S, V);
+
+    std::cout << std::endl;
+}
+
+int main(int argc, char **argv) {
+
+    El::Initialize(argc, argv);
+
+    El::Int m = argc > 1 ? std::atol(argv[1]) : 3000;
+    El::Int n = argc > 2 ? std::atol(argv[2]) : 1000;
+    int rank = argc > 3 ? std::atoi(argv[3]) : 20;
+    double density = argc > 4 ? std::atof(argv[4]) : 0.01;
+
+    skyb::context_t context(1234);
+
+    // Dense, with singular values 1 / (1 + i) on top of Gaussian noise.
+    {
+        dense_matrix_type G, H, A;
+        skyb::GaussianMatrix(G, m, n, context);
+        El::qr::ExplicitUnitary(G);
+        skyb::GaussianMatrix(H, n, n, context);
+        El::qr::ExplicitUnitary(H);
+        dense_matrix_type d(n, 1);
+        for(El::Int i = 0; i < n; i++)
+            d.Set(i, 0, 1.0 / (1.0 + i));
+        El::DiagonalScale(El::RIGHT, El::NORMAL, d, G);
+        El::Gemm(El::NORMAL, El::ADJOINT, 1.0, G, H, A);
+        dense_matrix_type N;
+        skyb::GaussianMatrix(N, m, n, context);
+        El::Axpy(1e-3 / std::sqrt(double(m)), N, A);
+
+        run((boost::format("dense %d x %d, rank %d") % m % n % rank).str(),
+            A, A, rank);
+    }
+
+    {
+        sparse_matrix_type A;
+        random_sparse(m, n, density, 38734, A);
+        dense_matrix_type Ad;
+        skyb::DenseCopy(A, Ad);
+
+        run((boost::format("sparse %d x %d, %d nonzeros, rank %d")
+                % m % n % A.nonzeros() % rank).str(), A, Ad, rank);
+    }
+
+    El::Finalize();
+    return 0;
+}
@@ -4,6 +4,9 @@
 #include <El.hpp>
 #include <skylark.hpp>
 #include <cmath>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
 #include <boost/mpi.hpp>
 
 #ifdef SKYLARK_HAVE_OPENMP
@@ -12,10 +15,24 @@
 
 #include "../utility/timer.hpp"
 
-template <class InputType>
+/**
+ * ComputeType is the precision in which the features are kept (and cached),
+ * and in which the products with them are computed. It can be lower than the
+ * precision of the data (e.g. float for double data): W, mu and the other
+ * consensus variables are still kept, and accumulated, in value_type.
+ *
+ * The feature maps themselves are applied in value_type, and their output is
+ * rounded to ComputeType afterwards, so a lower ComputeType does not make
+ * the feature transforms any cheaper. Memory is saved when the features are
+ * cached (CacheTransforms); otherwise the value_type features of a partition
+ * are only held until they are rounded.
+ */
+template <class InputType, class ComputeType =
+          typename skylark::utility::typer_t<InputType>::value_type>
 struct BlockADMMSolver {
 
     typedef typename skylark::utility::typer_t<InputType>::value_type value_type;
+    typedef ComputeType compute_type;
 
     typedef InputType data_matrix_t;
     typedef El::Matrix<value_type> feature_matrix_t;
@@ -35,7 +52,7 @@ struct BlockADMMSolver {
 
     // Easy interface, aka kernel based.
     template<typename Kernel, typename MapTypeTag>
-    BlockADMMSolver<InputType>(skylark::base::context_t& context,
+    BlockADMMSolver(skylark::base::context_t& context,
         const skylark::algorithms::loss_t<value_type>* loss,
         const skylark::algorithms::regularizer_t<value_type>* regularizer,
         double lambda, // regularization parameter
@@ -46,7 +63,7 @@ struct BlockADMMSolver {
 
     // Easy interface, aka kernel based, with quasi-random features.
     template<typename Kernel>
-    BlockADMMSolver<InputType>(skylark::base::context_t& context,
+    BlockADMMSolver(skylark::base::context_t& context,
         const skylark::algorithms::loss_t<value_type>* loss,
         const skylark::algorithms::regularizer_t<value_type>* regularizer,
         double lambda, // regularization parameter
@@ -56,7 +73,7 @@ struct BlockADMMSolver {
         int NumFeaturePartitions);
 
     // Guru interface.
-    BlockADMMSolver<InputType>(const skylark::algorithms::loss_t<value_type>* loss,
+    BlockADMMSolver(const skylark::algorithms::loss_t<value_type>* loss,
         const skylark::algorithms::regularizer_t<value_type>* regularizer,
         const feature_transform_array_t& featureMaps,
         double lambda, // regularization parameter
@@ -68,6 +85,23 @@ struct BlockADMMSolver {
     void set_tol(double TOL) { this->TOL = TOL; }
     void set_cache_transform(bool CacheTransforms) {this->CacheTransforms = CacheTransforms;}
 
+    // Use non-blocking collectives (MPI-3), and overlap them with the
+    // work of the next iteration that does not depend on their result.
+    void set_pipelined(bool Pipelined) { this->Pipelined = Pipelined; }
+
+    // Replace the reduce to rank 0 / broadcast of Wbar by an allreduce,
+    // after which every rank updates its own copy of W, mu and Wbar.
+    void set_allreduce_consensus(bool AllreduceConsensus) {
+        this->AllreduceConsensus = AllreduceConsensus;
+    }
+
+    // 2-D decomposition: groups of FeatureGroups consecutive ranks share
+    // their examples (gathered at the start of train), and split the
+    // feature partitions, with their Cache and TransformCache, among them.
+    void set_feature_groups(int FeatureGroups) {
+        this->FeatureGroups = FeatureGroups;
+    }
+
     ~BlockADMMSolver();
 
     void InitializeFactorizationCache();
@@ -84,6 +118,7 @@ struct BlockADMMSolver {
 private:
 
     typedef El::Matrix<value_type> local_matrix_t;
+    typedef El::Matrix<compute_type> compute_matrix_t;
 
     feature_transform_array_t featureMaps;
     int NumFeatures;
@@ -94,7 +129,7 @@ private:
     bool ScaleFeatureMaps;
     bool OwnFeatureMaps;
     local_matrix_t **Cache;
-    local_matrix_t **TransformCache;
+    compute_matrix_t **TransformCache;
     int NumThreads;
 
     double lambda;
@@ -103,12 +138,29 @@ private:
     double TOL;
 
     bool CacheTransforms;
+    bool Pipelined;
+    bool AllreduceConsensus;
+
+    int FeatureGroups;
+    std::vector<int> OwnedPartitions; // Partitions in the Cache of this rank
+
+    template<typename MatrixType>
+    void DeleteCache(MatrixType **&cache) {
+        if (cache == NULL)
+            return;
+        for(int j = 0; j < NumFeaturePartitions; j++)
+            delete cache[j];
+        delete[] cache;
+        cache = NULL;
+    }
 };
 
-template <class InputType>
-void BlockADMMSolver<InputType>::InitializeFactorizationCache() {
-    Cache = new local_matrix_t*[NumFeaturePartitions];
-    for(int j=0; j<NumFeaturePartitions; j++) {
+template <class InputType, class ComputeType>
+void BlockADMMSolver<InputType, ComputeType>::InitializeFactorizationCache() {
+    DeleteCache(Cache);
+    Cache = new local_matrix_t*[NumFeaturePartitions]();
+    for(size_t jj=0; jj<OwnedPartitions.size(); jj++) {
+        int j = OwnedPartitions[jj];
         int start = starts[j];
         int finish = finishes[j];
         int sj = finish - start  + 1;
@@ -116,21 +168,23 @@ void BlockADMMSolver<InputType>::InitializeFactorizationCache() {
     }
 }
 
-template <class InputType>
-void BlockADMMSolver<InputType>::InitializeTransformCache(int n) {
-    TransformCache = new local_matrix_t*[NumFeaturePartitions];
-    for(int j=0; j<NumFeaturePartitions; j++) {
+template <class InputType, class ComputeType>
+void BlockADMMSolver<InputType, ComputeType>::InitializeTransformCache(int n) {
+    DeleteCache(TransformCache);
+    TransformCache = new compute_matrix_t*[NumFeaturePartitions]();
+    for(size_t jj=0; jj<OwnedPartitions.size(); jj++) {
+        int j = OwnedPartitions[jj];
         int start = starts[j];
         int finish = finishes[j];
         int sj = finish - start  + 1;
-        TransformCache[j]  = new local_matrix_t(sj, n);
+        TransformCache[j]  = new compute_matrix_t(sj, n);
     }
 }
 
 
 // No feature transforms (aka just linear regression).
-template <class InputType>
-BlockADMMSolver<InputType>::BlockADMMSolver(
+template <class InputType, class ComputeType>
+BlockADMMSolver<InputType, ComputeType>::BlockADMMSolver(
         const skylark::algorithms::loss_t<value_type>* loss,
         const skylark::algorithms::regularizer_t<value_type>* regularizer,
         double lambda, // regularization parameter
@@ -153,14 +207,18 @@ BlockADMMSolver<InputType>::BlockADMMSolver(
     }
     this->ScaleFeatureMaps = false;
     OwnFeatureMaps = false;
-    InitializeFactorizationCache();
+    Cache = NULL;
+    TransformCache = NULL;
     CacheTransforms = false;
+    Pipelined = false;
+    AllreduceConsensus = false;
+    FeatureGroups = 1;
 }
 
 // Easy interface, aka kernel based.
-template<class InputType>
+template <class InputType, class ComputeType>
 template<typename Kernel, typename MapTypeTag>
-BlockADMMSolver<InputType>::BlockADMMSolver(skylark::base::context_t& context,
+BlockADMMSolver<InputType, ComputeType>::BlockADMMSolver(skylark::base::context_t& context,
     const skylark::algorithms::loss_t<value_type>* loss,
     const skylark::algorithms::regularizer_t<value_type>* regularizer,
     double lambda, // regularization parameter
@@ -188,14 +246,18 @@ BlockADMMSolver<InputType>::BlockADMMSolver(skylark::base::context_t& context,
     }
     this->ScaleFeatureMaps = true;
     OwnFeatureMaps = true;
-    InitializeFactorizationCache();
+    Cache = NULL;
+    TransformCache = NULL;
     CacheTransforms = false;
+    Pipelined = false;
+    AllreduceConsensus = false;
+    FeatureGroups = 1;
 }
 
 // Easy interface, aka kernel based, with quasi-random features.
-template<class InputType>
+template <class InputType, class ComputeType>
 template<typename Kernel>
-BlockADMMSolver<InputType>::BlockADMMSolver(skylark::base::context_t& context,
+BlockADMMSolver<InputType, ComputeType>::BlockADMMSolver(skylark::base::context_t& context,
     const skylark::algorithms::loss_t<value_type>* loss,
     const skylark::algorithms::regularizer_t<value_type>* regularizer,
     double lambda, // regularization parameter
@@ -227,13 +289,17 @@ BlockADMMSolver<InputType>::BlockADMMSolver(skylark::base::context_t& context,
     }
     this->ScaleFeatureMaps = true;
     OwnFeatureMaps = true;
-    InitializeFactorizationCache();
+    Cache = NULL;
+    TransformCache = NULL;
     CacheTransforms = false;
+    Pipelined = false;
+    AllreduceConsensus = false;
+    FeatureGroups = 1;
 }
 
 // Guru interface
-template <class InputType>
-BlockADMMSolver<InputType>::BlockADMMSolver(
+template <class InputType, class ComputeType>
+BlockADMMSolver<InputType, ComputeType>::BlockADMMSolver(
     const skylark::algorithms::loss_t<value_type>* loss,
     const skylark::algorithms::regularizer_t<value_type>* regularizer,
     const feature_transform_array_t &featureMaps,
@@ -254,18 +320,21 @@ BlockADMMSolver<InputType>::BlockADMMSolver(
     }
     this->ScaleFeatureMaps = ScaleFeatureMaps;
     OwnFeatureMaps = false;
-    InitializeFactorizationCache();
+    Cache = NULL;
+    TransformCache = NULL;
     CacheTransforms = false;
+    Pipelined = false;
+    AllreduceConsensus = false;
+    FeatureGroups = 1;
 }
 
-template <class InputType>
-BlockADMMSolver<InputType>::~BlockADMMSolver() {
-    for(int i=0; i  < NumFeaturePartitions; i++) {
-        delete Cache[i];
-        if (OwnFeatureMaps)
+template <class InputType, class ComputeType>
+BlockADMMSolver<InputType, ComputeType>::~BlockADMMSolver() {
+    DeleteCache(Cache);
+    DeleteCache(TransformCache);
+    if (OwnFeatureMaps)
+        for(int i=0; i  < NumFeaturePartitions; i++)
             delete featureMaps[i];
-    }
-    delete[] Cache;
 }
 
 
@@ -285,20 +354,232 @@ void GetSlice(skylark::base::sparse_matrix_t<T> &X, El::Matrix<T> &Z,
     skylark::base::DenseSubmatrixCopy(X, Z, i, j, height, width);
 }
 
+// The features, and the products with them, are in compute precision;
+// everything else is in the precision of the data. The overloads for equal
+// types do no conversion.
+
+template<typename T>
+void ToCompute(El::Matrix<T> &A, El::Matrix<T> &Ac) {
+    El::View(Ac, A);
+}
+
+template<typename S, typename T>
+void ToCompute(const El::Matrix<S> &A, El::Matrix<T> &Ac) {
+    El::Copy(A, Ac);
+}
+
+// C = beta * C + alpha * op(A) * op(B); the product itself is computed in
+// the precision of A and B (into work, if C has another one).
+template<typename T>
+void MixedGemm(El::Orientation oA, El::Orientation oB, double alpha,
+    const El::Matrix<T> &A, const El::Matrix<T> &B, double beta,
+    El::Matrix<T> &C, El::Matrix<T> &work) {
+
+    El::Gemm(oA, oB, T(alpha), A, B, T(beta), C);
+}
+
+template<typename S, typename T>
+void MixedGemm(El::Orientation oA, El::Orientation oB, double alpha,
+    const El::Matrix<S> &A, const El::Matrix<S> &B, double beta,
+    El::Matrix<T> &C, El::Matrix<S> &work) {
+
+    work.Resize(C.Height(), C.Width());
+    El::Gemm(oA, oB, S(alpha), A, B, S(0), work);
+
+    const El::Int m = C.Height(), n = C.Width();
+    for(El::Int j = 0; j < n; j++) {
+        T *c = C.Buffer() + j * C.LDim();
+        const S *w = work.LockedBuffer() + j * work.LDim();
+        for(El::Int i = 0; i < m; i++)
+            c[i] = T(beta) * c[i] + T(w[i]);
+    }
+}
+
+// Y = Y + alpha * X
+template<typename T>
+void MixedAxpy(double alpha, const El::Matrix<T> &X, El::Matrix<T> &Y) {
+    El::Axpy(T(alpha), X, Y);
 }
 
-template <class InputType>
-skylark::ml::hilbert_model_t* BlockADMMSolver<InputType>::train(data_matrix_t& X, target_matrix_t& Y,
+template<typename S, typename T>
+void MixedAxpy(double alpha, const El::Matrix<S> &X, El::Matrix<T> &Y) {
+    const El::Int m = Y.Height(), n = Y.Width();
+    for(El::Int j = 0; j < n; j++) {
+        T *y = Y.Buffer() + j * Y.LDim();
+        const S *x = X.LockedBuffer() + j * X.LDim();
+        for(El::Int i = 0; i < m; i++)
+            y[i] += T(alpha) * T(x[i]);
+    }
+}
+
+// Collectives of the training loop (root is always 0). With MPI-3 they are
+// only started, and complete at MPI_Wait on the request; otherwise they
+// complete right away and the request is set to MPI_REQUEST_NULL.
+
+template<typename T>
+void StartSumReduce(const T *in, T *out, int n, bool all,
+    MPI_Comm comm, MPI_Request *request) {
+
+    MPI_Datatype type = boost::mpi::get_mpi_datatype<T>(T());
+    T *sendbuf = const_cast<T *>(in);
+
+#if MPI_VERSION >= 3
+    if (all)
+        MPI_Iallreduce(sendbuf, out, n, type, MPI_SUM, comm, request);
+    else
+        MPI_Ireduce(sendbuf, out, n, type, MPI_SUM, 0, comm, request);
+#else
+    if (all)
+        MPI_Allreduce(sendbuf, out, n, type, MPI_SUM, comm);
+    else
+        MPI_Reduce(sendbuf, out, n, type, MPI_SUM, 0, comm);
+    *request = MPI_REQUEST_NULL;
+#endif
+}
+
+template<typename T>
+void SumAllReduceInPlace(T *buffer, int n, MPI_Comm comm) {
+
+    MPI_Datatype type = boost::mpi::get_mpi_datatype<T>(T());
+    MPI_Allreduce(MPI_IN_PLACE, buffer, n, type, MPI_SUM, comm);
+}
+
+template<typename T>
+void StartBroadcast(T *buffer, int n, MPI_Comm comm, MPI_Request *request) {
+
+    MPI_Datatype type = boost::mpi::get_mpi_datatype<T>(T());
+
+#if MPI_VERSION >= 3
+    MPI_Ibcast(buffer, n, type, 0, comm, request);
+#else
+    MPI_Bcast(buffer, n, type, 0, comm);
+    *request = MPI_REQUEST_NULL;
+#endif
+}
+
+// Gathers, on every rank of comm, the examples of all of them (in rank
+// order): the columns of X, or the rows of Y.
+
+template<typename T>
+void AllGatherBuffers(const boost::mpi::communicator &comm,
+    const std::vector<T> &local, std::vector<T> &all) {
+
+    std::vector<int> counts, displs(comm.size() + 1, 0);
+    boost::mpi::all_gather(comm, int(local.size()), counts);
+    for(int r = 0; r < comm.size(); r++)
+        displs[r + 1] = displs[r] + counts[r];
+
+    all.resize(displs[comm.size()]);
+    MPI_Datatype type = boost::mpi::get_mpi_datatype<T>(T());
+    MPI_Allgatherv(const_cast<T *>(local.data()), local.size(), type,
+        all.data(), counts.data(), displs.data(), type, comm);
+}
+
+template<typename T>
+void AllGatherExamples(const boost::mpi::communicator &comm,
+    const El::Matrix<T> &X, El::Matrix<T> &Xall) {
+
+    const El::Int m = X.Height(), n = X.Width();
+    std::vector<T> local(m * n), all;
+    for(El::Int j = 0; j < n; j++)
+        std::copy(X.LockedBuffer() + j * X.LDim(),
+            X.LockedBuffer() + j * X.LDim() + m, local.begin() + j * m);
+
+    AllGatherBuffers(comm, local, all);
+
+    Xall.Resize(m, m > 0 ? all.size() / m : 0);
+    for(El::Int j = 0; j < Xall.Width(); j++)
+        std::copy(all.begin() + j * m, all.begin() + (j + 1) * m,
+            Xall.Buffer() + j * Xall.LDim());
+}
+
+template<typename T>
+void AllGatherExamples(const boost::mpi::communicator &comm,
+    const skylark::base::sparse_matrix_t<T> &X,
+    skylark::base::sparse_matrix_t<T> &Xall) {
+
+    const int *indptr = X.indptr();
+    const int n = X.width(), nnz = indptr[n];
+
+    std::vector<int> colnnz(n), indices(X.indices(), X.indices() + nnz);
+    for(int j = 0; j < n; j++)
+        colnnz[j] = indptr[j + 1] - indptr[j];
+    std::vector<T> values(X.locked_values(), X.locked_values() + nnz);
+
+    std::vector<int> allcolnnz, allindices;
+    std::vector<T> allvalues;
+    AllGatherBuffers(comm, colnnz, allcolnnz);
+    AllGatherBuffers(comm, indices, allindices);
+    AllGatherBuffers(comm, values, allvalues);
+
+    const int N = allcolnnz.size();
+    int *newindptr = new int[N + 1];
+    int *newindices = new int[allindices.size()];
+    T *newvalues = new T[allvalues.size()];
+    newindptr[0] = 0;
+    for(int j = 0; j < N; j++)
+        newindptr[j + 1] = newindptr[j] + allcolnnz[j];
+    std::copy(allindices.begin(), allindices.end(), newindices);
+    std::copy(allvalues.begin(), allvalues.end(), newvalues);
+
+    Xall.attach(newindptr, newindices, newvalues, allindices.size(),
+        X.height(), N, true);
+}
+
+template<typename T>
+void AllGatherExampleRows(const boost::mpi::communicator &comm,
+    const El::Matrix<T> &Y, El::Matrix<T> &Yall) {
+
+    El::Matrix<T> Yt, Ytall;
+    El::Transpose(Y, Yt);
+    AllGatherExamples(comm, Yt, Ytall);
+    El::Transpose(Ytall, Yall);
+}
+
+}
+
+template <class InputType, class ComputeType>
+skylark::ml::hilbert_model_t* BlockADMMSolver<InputType, ComputeType>::train(data_matrix_t& X, target_matrix_t& Y,
     data_matrix_t& Xv, target_matrix_t& Yv,
     bool regression, const boost::mpi::communicator& comm) {
 
     int rank = comm.rank();
     int size = comm.size();
 
-    int P = size;
+    if (FeatureGroups < 1 || size % FeatureGroups != 0)
+        SKYLARK_THROW_EXCEPTION (
+            skylark::base::invalid_parameters()
+                << skylark::base::error_msg(
+                    "The number of ranks must be a multiple of the number "
+                    "of feature groups"));
+
+    // Each group of FeatureGroups consecutive ranks is an example block:
+    // its ranks gather the examples of the whole group, and each takes the
+    // partitions j with j % FeatureGroups equal to its place in the group.
+    int group = rank % FeatureGroups;
+    int P = size / FeatureGroups;
+
+    boost::mpi::communicator groupcomm =
+        (FeatureGroups > 1) ? comm.split(rank / FeatureGroups) : comm;
+    MPI_Comm mpigroupcomm = groupcomm;
+
+    data_matrix_t Xgroup;
+    target_matrix_t Ygroup;
+    if (FeatureGroups > 1) {
+        internal::AllGatherExamples(groupcomm, X, Xgroup);
+        internal::AllGatherExampleRows(groupcomm, Y, Ygroup);
+    }
+    data_matrix_t &Xblock = (FeatureGroups > 1) ? Xgroup : X;
+    target_matrix_t &Yblock = (FeatureGroups > 1) ? Ygroup : Y;
+
+    OwnedPartitions.clear();
+    for(int j = group; j < NumFeaturePartitions; j += FeatureGroups)
+        OwnedPartitions.push_back(j);
+    int numowned = OwnedPartitions.size();
+    InitializeFactorizationCache();
 
-    int ni = skylark::base::Width(X);
-    int d = skylark::base::Height(X);
+    int ni = skylark::base::Width(Xblock);
+    int d = skylark::base::Height(Xblock);
     int targets = regression ? 1 : GetNumTargets(comm, Y);
 
     skylark::ml::hilbert_model_t* model =
@@ -325,11 +606,16 @@ skylark::ml::hilbert_model_t* BlockADMMSolver<InputType>::train(data_matrix_t& X
     local_matrix_t nu(k, ni);
     El::Zero(nu);
 
-    local_matrix_t W, mu, Wi, mu_ij, ZtObar_ij;
+    // Ranks that keep (and update) W and mu: rank 0, or all of them when
+    // the consensus is formed with an allreduce.
+    bool holdsW = (rank == 0) || AllreduceConsensus;
+
+    local_matrix_t W, mu, Wi, Wisum, mu_ij, ZtObar_ij;
 
-    if(rank==0) {
+    if(holdsW) {
         El::Zeros(W,  D, k);
         El::Zeros(mu, D, k);
+        El::Zeros(Wisum, D, k);
     }
     El::Zeros(Wi, D, k);
     El::Zeros(mu_ij, D, k);
@@ -337,7 +623,7 @@ skylark::ml::hilbert_model_t* BlockADMMSolver<InputType>::train(data_matrix_t& X
 
     int iter = 0;
 
-    value_type localloss = loss->evaluate(O, Y);
+    value_type localloss = loss->evaluate(O, Yblock);
     value_type totalloss, accuracy, obj;
 
     int Dk = D*k;
@@ -354,6 +640,16 @@ skylark::ml::hilbert_model_t* BlockADMMSolver<InputType>::train(data_matrix_t& X
     if (CacheTransforms)
         InitializeTransformCache(ni);
 
+    MPI_Comm mpicomm = comm;
+    MPI_Request wbarreq = MPI_REQUEST_NULL, wireq = MPI_REQUEST_NULL,
+        lossreq = MPI_REQUEST_NULL;
+
+    // Features of the first partitions (at most one per thread, i.e. no
+    // more than the partition loop has in flight), computed while waiting.
+    int numprefetch = std::min(NumThreads, numowned);
+    std::vector<local_matrix_t> Zprefetch(numprefetch);
+    bool prefetched = false;
+
     SKYLARK_TIMER_INITIALIZE(ITERATIONS_PROFILE);
     SKYLARK_TIMER_INITIALIZE(COMMUNICATION_PROFILE);
     SKYLARK_TIMER_INITIALIZE(TRANSFORM_PROFILE);
@@ -363,97 +659,190 @@ skylark::ml::hilbert_model_t* BlockADMMSolver<InputType>::train(data_matrix_t& X
     SKYLARK_TIMER_INITIALIZE(BARRIER_PROFILE);
     SKYLARK_TIMER_INITIALIZE(PREDICTION_PROFILE);
 
-    while(iter<MAXITER) {
+    auto prefetch_features = [&]() {
+        prefetched = Pipelined && (featureMaps.size() > 0) &&
+            !(CacheTransforms && (iter > 1));
+        if (!prefetched)
+            return;
 
-        SKYLARK_TIMER_RESTART(ITERATIONS_PROFILE);
+        SKYLARK_TIMER_RESTART(ZTRANSFORM_PROFILE);
+#       ifdef SKYLARK_HAVE_OPENMP
+#       pragma omp parallel for if(numprefetch > 1) num_threads(numprefetch)
+#       endif
+        for(int p = 0; p < numprefetch; p++) {
+            int jp = OwnedPartitions[p];
+            int sp = finishes[jp] - starts[jp] + 1;
+            Zprefetch[p].Resize(sp, ni);
+            featureMaps[jp]->apply(Xblock, Zprefetch[p],
+                skylark::sketch::columnwise_tag());
+            if (ScaleFeatureMaps)
+                El::Scale(sqrt(double(sp) / d), Zprefetch[p]);
+        }
+        SKYLARK_TIMER_ACCUMULATE(ZTRANSFORM_PROFILE);
+    };
 
-        iter++;
+    // Completes the reductions started at the end of iteration it: reports
+    // the objective, then forms Wbar = (Wisum + W)/(P+1) and updates mu.
+    auto complete_iteration = [&](int it) {
+        SKYLARK_TIMER_RESTART(COMMUNICATION_PROFILE);
+        MPI_Wait(&lossreq, MPI_STATUS_IGNORE);
+        SKYLARK_TIMER_ACCUMULATE(COMMUNICATION_PROFILE);
+
+        if(rank == 0) {
+            obj = totalloss + lambda * regularizer->evaluate(Wbar);
+
+            if (skylark::base::Width(Xv) <=0) {
+                std::cout << "iteration " << it
+                          << " objective " << obj
+                          << " time " << timer.elapsed()
+                          << " seconds" << std::endl;
+            }
+            else {
+                std::cout << "iteration " << it
+                          << " objective " << obj
+                          << " accuracy " << accuracy
+                          << " time " << timer.elapsed()
+                          << " seconds" << std::endl;
+            }
+        }
 
         SKYLARK_TIMER_RESTART(COMMUNICATION_PROFILE);
-        broadcast(comm, Wbar.Buffer(), Dk, 0);
+        MPI_Wait(&wireq, MPI_STATUS_IGNORE);
+        SKYLARK_TIMER_ACCUMULATE(COMMUNICATION_PROFILE);
 
-        SKYLARK_TIMER_ACCUMULATE(COMMUNICATION_PROFILE)
+        if(holdsW) {
+            //Wbar = (Wisum + W)/(P+1)
+            El::Copy(Wisum, Wbar);
+            El::Axpy(1.0, W, Wbar);
+            El::Scale(1.0/(P+1), Wbar);
 
-            // mu_ij = mu_ij - Wbar
-            El::Axpy(-1.0, Wbar, mu_ij);
+            // mu = mu + W - Wbar;
+            El::Axpy(+1.0, W, mu);
+            El::Axpy(-1.0, Wbar, mu);
+        }
+    };
+
+    while(iter<MAXITER) {
+
+        SKYLARK_TIMER_RESTART(ITERATIONS_PROFILE);
+
+        iter++;
+
+        // The loss proximal step only needs local data, so when pipelined it
+        // overlaps the reductions of the previous iteration.
 
         // Obar = Obar - nu
         El::Axpy(-1.0, nu, Obar);
 
         SKYLARK_TIMER_RESTART(PROXLOSS_PROFILE);
-        loss->proxoperator(Obar, 1.0/RHO, Y, O);
+        loss->proxoperator(Obar, 1.0/RHO, Yblock, O);
         SKYLARK_TIMER_ACCUMULATE(PROXLOSS_PROFILE);
 
-        if(rank==0) {
+        if (AllreduceConsensus)
+            prefetch_features();
+
+        if (Pipelined && (iter > 1))
+            complete_iteration(iter - 1);
+
+        // With the allreduce consensus every rank already has Wbar.
+        if (!AllreduceConsensus) {
+            SKYLARK_TIMER_RESTART(COMMUNICATION_PROFILE);
+            internal::StartBroadcast(Wbar.Buffer(), Dk, mpicomm, &wbarreq);
+            SKYLARK_TIMER_ACCUMULATE(COMMUNICATION_PROFILE);
+
+            prefetch_features();
+
+            SKYLARK_TIMER_RESTART(COMMUNICATION_PROFILE);
+            MPI_Wait(&wbarreq, MPI_STATUS_IGNORE);
+            SKYLARK_TIMER_ACCUMULATE(COMMUNICATION_PROFILE);
+        }
+
+        // mu_ij = mu_ij - Wbar
+        El::Axpy(-1.0, Wbar, mu_ij);
+
+        if(holdsW) {
             regularizer->proxoperator(Wbar, lambda/RHO, mu, W);
         }
 
         El::Zeros(sum_o, k, ni);
         El::Zeros(wbar_output, k, ni);
 
-        int j;
+        // Per-thread partial sums, instead of a critical section per partition.
+        skylark::ml::detail::thread_partial_sums_t<value_type>
+            wbar_output_sum(wbar_output, NumThreads),
+            sum_o_sum(sum_o, NumThreads);
+
+        // dsum = del_o + (n+1) * nu is the same for all partitions.
+        local_matrix_t dsum = del_o;
+        El::Axpy(NumFeaturePartitions + 1.0, nu, dsum);
+        compute_matrix_t dsumc;
+        internal::ToCompute(dsum, dsumc);
+
+        int jj, j;
         const feature_transform_t* featureMap;
 
         SKYLARK_TIMER_RESTART(TRANSFORM_PROFILE);
 
 #       ifdef SKYLARK_HAVE_OPENMP
-#       pragma omp parallel for if(NumThreads > 1) private(j, start, finish, sj, featureMap) num_threads(NumThreads)
+#       pragma omp parallel for if(NumThreads > 1) private(jj, j, start, finish, sj, featureMap) num_threads(NumThreads)
 #       endif
-        for(j = 0; j < NumFeaturePartitions; j++) {
+        for(jj = 0; jj < numowned; jj++) {
+            j = OwnedPartitions[jj];
             start = starts[j];
             finish = finishes[j];
             sj = finish - start  + 1;
 
             local_matrix_t Z;
+            compute_matrix_t Zc, work;
 
-            // Get the Z matrix
+            // Get the Z matrix (Zc, in compute precision)
             if (CacheTransforms && (iter > 1))
-                El::View(Z, *TransformCache[j], 0, 0, sj, ni);
+                El::View(Zc, *TransformCache[j], 0, 0, sj, ni);
             else {
-                if (featureMaps.size() > 0) {
+                if (prefetched && (jj < numprefetch))
+                    El::View(Z, Zprefetch[jj]);
+                else if (featureMaps.size() > 0) {
                     featureMap = featureMaps[j];
 
                     SKYLARK_TIMER_RESTART(ZTRANSFORM_PROFILE);
                     Z.Resize(sj, ni); // TODO do we need this?
-                    featureMap->apply(X, Z, skylark::sketch::columnwise_tag());
+                    featureMap->apply(Xblock, Z, skylark::sketch::columnwise_tag());
                     SKYLARK_TIMER_ACCUMULATE(ZTRANSFORM_PROFILE);
 
                     if (ScaleFeatureMaps)
                         El::Scale(sqrt(double(sj) / d), Z);
                 } else
-                    internal::GetSlice(X, Z, start, 0, sj, ni);
+                    internal::GetSlice(Xblock, Z, start, 0, sj, ni);
+
+                internal::ToCompute(Z, Zc);
+
+                // Zc is a copy (not a view of Z) if the precisions differ.
+                if (!std::is_same<value_type, compute_type>::value)
+                    Z.Empty();
             }
 
             local_matrix_t tmp(sj, k);
             local_matrix_t rhs(sj, k);
-            local_matrix_t o(k, ni);
+            compute_matrix_t tmpc, o(k, ni);
 
             if(iter==1) {
 
                 local_matrix_t Ones;
                 El::Ones(Ones, sj, 1);
-                El::Gemm(El::NORMAL, El::TRANSPOSE, 1.0, Z, Z, 0.0, *Cache[j]);
+                internal::MixedGemm(El::NORMAL, El::TRANSPOSE,
+                    1.0, Zc, Zc, 0.0, *Cache[j], work);
                 El::UpdateDiagonal(*Cache[j], 1.0, Ones);
                 El::Inverse(*Cache[j]);
 
                 if (CacheTransforms)
-                    *TransformCache[j] = Z;
+                    *TransformCache[j] = Zc;
             }
 
             El::View(tmp, Wbar, start, 0, sj, k); //tmp = Wbar[J,:]
+            internal::ToCompute(tmp, tmpc);
 
-            local_matrix_t wbar_tmp;
-            El::Zeros(wbar_tmp, k, ni);
-
-            if (NumThreads > 1) {
-                El::Gemm(El::TRANSPOSE, El::NORMAL, 1.0, tmp, Z, 0.0, wbar_tmp);
-
-#               ifdef SKYLARK_HAVE_OPENMP
-#               pragma omp critical
-#               endif
-                El::Axpy(1.0, wbar_tmp, wbar_output);
-            } else
-                El::Gemm(El::TRANSPOSE, El::NORMAL, 1.0, tmp, Z, 1.0, wbar_output);
+            internal::MixedGemm(El::TRANSPOSE, El::NORMAL, 1.0, tmpc, Zc, 1.0,
+                wbar_output_sum.local(), work);
 
             rhs = tmp; //rhs = Wbar[J,:]
             El::View(tmp, mu_ij, start, 0, sj, k); //tmp = mu_ij[J,:]
@@ -462,17 +851,17 @@ skylark::ml::hilbert_model_t* BlockADMMSolver<InputType>::train(data_matrix_t& X
             El::Axpy(+1.0, tmp, rhs); // rhs = rhs + ZtObar_ij[J,:]
 
             SKYLARK_TIMER_RESTART(ZMULT_PROFILE);
-            local_matrix_t dsum = del_o;
-            El::Axpy(NumFeaturePartitions + 1.0, nu, dsum);
-            El::Gemm(El::NORMAL, El::TRANSPOSE, 
-                1.0/(NumFeaturePartitions + 1.0), Z, dsum, 1.0, rhs); // rhs = rhs + z'*(1/(n+1) * del_o + nu)
+            internal::MixedGemm(El::NORMAL, El::TRANSPOSE,
+                1.0/(NumFeaturePartitions + 1.0), Zc, dsumc, 1.0, rhs, work); // rhs = rhs + z'*(1/(n+1) * del_o + nu)
             SKYLARK_TIMER_ACCUMULATE(ZMULT_PROFILE);
 
             El::View(tmp, Wi, start, 0, sj, k);
             El::Gemm(El::NORMAL, El::NORMAL, 1.0, *Cache[j], rhs, 0.0, tmp); // ]tmp = Wi[J,:] = Cache[j]*rhs
+            internal::ToCompute(tmp, tmpc);
 
             SKYLARK_TIMER_RESTART(ZMULT_PROFILE);
-            El::Gemm(El::TRANSPOSE, El::NORMAL, 1.0, tmp, Z, 0.0, o); // o = (z*tmp)' = (z*Wi[J,:])'
+            El::Gemm(El::TRANSPOSE, El::NORMAL, compute_type(1.0), tmpc, Zc,
+                compute_type(0.0), o); // o = (z*tmp)' = (z*Wi[J,:])'
             SKYLARK_TIMER_ACCUMULATE(ZMULT_PROFILE);
 
             // mu_ij[JJ,:] = mu_ij[JJ,:] + Wi[JJ,:];
@@ -482,20 +871,27 @@ skylark::ml::hilbert_model_t* BlockADMMSolver<InputType>::train(data_matrix_t& X
 
             //ZtObar_ij[JJ,:] = numpy.dot(Z.T, o);
             El::View(tmp, ZtObar_ij, start, 0, sj, k);
-            El::Gemm(El::NORMAL, El::TRANSPOSE, 1.0, Z, o, 0.0, tmp);
+            internal::MixedGemm(El::NORMAL, El::TRANSPOSE, 1.0, Zc, o, 0.0,
+                tmp, work);
 
             //  sum_o += o
-            if (NumThreads > 1) {
-#               ifdef SKYLARK_HAVE_OPENMP
-#               pragma omp critical
-#               endif
-                El::Axpy(1.0, o, sum_o);
-            } else
-                El::Axpy(1.0, o, sum_o);
+            internal::MixedAxpy(1.0, o, sum_o_sum.local());
 
             Z.Empty(); // TODO do we need this?
         }
 
+        wbar_output_sum.reduce();
+        sum_o_sum.reduce();
+
+        // Sums over the partitions of the other ranks of the group.
+        if (FeatureGroups > 1) {
+            SKYLARK_TIMER_RESTART(COMMUNICATION_PROFILE);
+            internal::SumAllReduceInPlace(wbar_output.Buffer(), nik,
+                mpigroupcomm);
+            internal::SumAllReduceInPlace(sum_o.Buffer(), nik, mpigroupcomm);
+            SKYLARK_TIMER_ACCUMULATE(COMMUNICATION_PROFILE);
+        }
+
         SKYLARK_TIMER_ACCUMULATE(TRANSFORM_PROFILE);
 
         localloss = 0.0 ;
@@ -538,30 +934,15 @@ skylark::ml::hilbert_model_t* BlockADMMSolver<InputType>::train(data_matrix_t& X
         }
         SKYLARK_TIMER_ACCUMULATE(PREDICTION_PROFILE);
 
-        localloss += loss->evaluate(wbar_output, Y);
+        // The ranks of a group share the loss of their examples.
+        if (group == 0)
+            localloss += loss->evaluate(wbar_output, Yblock);
 
         SKYLARK_TIMER_RESTART(COMMUNICATION_PROFILE);
-        reduce(comm, localloss, totalloss, std::plus<value_type>(), 0);
+        internal::StartSumReduce(&localloss, &totalloss, 1, false,
+            mpicomm, &lossreq);
         SKYLARK_TIMER_ACCUMULATE(COMMUNICATION_PROFILE);
 
-        if(rank == 0) {
-            obj = totalloss + lambda * regularizer->evaluate(Wbar);
-
-            if (skylark::base::Width(Xv) <=0) {
-                std::cout << "iteration " << iter
-                          << " objective " << obj
-                          << " time " << timer.elapsed()
-                          << " seconds" << std::endl;
-            }
-            else {
-                std::cout << "iteration " << iter
-                          << " objective " << obj
-                          << " accuracy " << accuracy
-                          << " time " << timer.elapsed()
-                          << " seconds" << std::endl;
-            }
-        }
-
         El::Copy(O, Obar);
         El::Scale(1.0/(NumFeaturePartitions+1.0), sum_o);
         El::Axpy(-1.0, sum_o, Obar);
@@ -570,31 +951,24 @@ skylark::ml::hilbert_model_t* BlockADMMSolver<InputType>::train(data_matrix_t& X
         El::Axpy(-1.0, Obar, nu);
 
         SKYLARK_TIMER_RESTART(COMMUNICATION_PROFILE);
-        boost::mpi::reduce (comm,
-            Wi.LockedBuffer(),
-            Wi.MemorySize(),
-            Wbar.Buffer(),
-            std::plus<value_type>(),
-            0);
+        internal::StartSumReduce(Wi.LockedBuffer(), Wisum.Buffer(), Dk,
+            AllreduceConsensus, mpicomm, &wireq);
         SKYLARK_TIMER_ACCUMULATE(COMMUNICATION_PROFILE);
 
-        if(rank==0) {
-            //Wbar = (Wisum + W)/(P+1)
-            El::Axpy(1.0, W, Wbar);
-            El::Scale(1.0/(P+1), Wbar);
+        if (!Pipelined) {
+            complete_iteration(iter);
 
-            // mu = mu + W - Wbar;
-            El::Axpy(+1.0, W, mu);
-            El::Axpy(-1.0, Wbar, mu);
+            SKYLARK_TIMER_RESTART(BARRIER_PROFILE);
+            comm.barrier();
+            SKYLARK_TIMER_ACCUMULATE(BARRIER_PROFILE);
         }
 
-        SKYLARK_TIMER_RESTART(BARRIER_PROFILE);
-        comm.barrier();
-        SKYLARK_TIMER_ACCUMULATE(BARRIER_PROFILE);
-
         SKYLARK_TIMER_ACCUMULATE(ITERATIONS_PROFILE);
     }
 
+    if (Pipelined && (iter > 0))
+        complete_iteration(iter);
+
     SKYLARK_TIMER_PRINT(ITERATIONS_PROFILE, comm);
     SKYLARK_TIMER_PRINT(COMMUNICATION_PROFILE, comm);
     SKYLARK_TIMER_PRINT(TRANSFORM_PROFILE, comm);
@@ -0,0 +1,241 @@
+#ifndef SKYLARK_FEATURE_CACHE_HPP
+#define SKYLARK_FEATURE_CACHE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <boost/mpi.hpp>
+
+#ifdef SKYLARK_HAVE_OPENMP
+#include <omp.h>
+#endif
+
+namespace skylark { namespace ml {
+
+/**
+ * Storage precision of cached feature blocks. Lower precisions allow more
+ * blocks to fit in a budget, at the price of perturbing the features used
+ * after the first iteration.
+ */
+enum feature_cache_precision_t {
+    FEATURE_CACHE_FULL = 0,
+    FEATURE_CACHE_FLOAT = 1,
+    FEATURE_CACHE_BFLOAT16 = 2
+};
+
+namespace detail {
+
+/** float -> bfloat16, rounding to nearest even. */
+inline std::uint16_t float_to_bfloat16(float f) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    bits += 0x7FFF + ((bits >> 16) & 1);
+    return static_cast<std::uint16_t>(bits >> 16);
+}
+
+inline float bfloat16_to_float(std::uint16_t h) {
+    std::uint32_t bits = static_cast<std::uint32_t>(h) << 16;
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+inline const char *feature_cache_precision_name(int precision) {
+    switch(precision) {
+    case FEATURE_CACHE_FULL:
+        return "full";
+    case FEATURE_CACHE_FLOAT:
+        return "float";
+    default:
+        return "bfloat16";
+    }
+}
+
+} // namespace detail
+
+/**
+ * Memory budgeted cache of the local parts of feature blocks Z_c (the
+ * outputs of a list of feature transforms applied to the same input).
+ *
+ * plan() decides, collectively, which blocks are kept and at which
+ * precision: full precision if all blocks fit the budget, otherwise the
+ * highest precision (down to the lowest allowed) at which they all fit,
+ * otherwise as many leading blocks as fit at the lowest allowed precision.
+ * Blocks that are not kept have to be recomputed. Since recomputation is
+ * collective, the decision uses the largest local size over all ranks.
+ */
+template<typename T>
+class feature_block_cache_t {
+
+public:
+
+    /**
+     * @param budget_mb memory budget per rank, in MB (0 disables caching).
+     * @param lowest lowest precision allowed for storage.
+     */
+    feature_block_cache_t(double budget_mb,
+        feature_cache_precision_t lowest = FEATURE_CACHE_BFLOAT16) :
+        _budget(budget_mb * 1024.0 * 1024.0), _lowest(lowest),
+        _precision(FEATURE_CACHE_FULL), _hits(0), _misses(0) {
+
+    }
+
+    /**
+     * Plans the cache for blocks with the given local sizes (number of
+     * entries). Collective over comm.
+     */
+    void plan(const std::vector<El::Int> &local_sizes, MPI_Comm comm) {
+
+        std::vector<El::Int> sizes(local_sizes.size());
+        boost::mpi::communicator world(comm, boost::mpi::comm_attach);
+        boost::mpi::all_reduce(world, local_sizes.data(), local_sizes.size(),
+            sizes.data(), boost::mpi::maximum<El::Int>());
+
+        double total = 0.0;
+        for(size_t c = 0; c < sizes.size(); c++)
+            total += sizes[c];
+
+        _blocks.assign(sizes.size(), block_t());
+        _precision = FEATURE_CACHE_FULL;
+        while (_precision < _lowest && total * entry_size(_precision) > _budget)
+            _precision++;
+
+        double used = 0.0;
+        for(size_t c = 0; c < sizes.size(); c++) {
+            double bytes = sizes[c] * entry_size(_precision);
+            if (used + bytes > _budget)
+                break;
+            _blocks[c].keep = true;
+            used += bytes;
+        }
+    }
+
+    /**
+     * Restores block c into the local matrix Z (already sized). Returns
+     * false, and counts a miss, if the block is not available.
+     */
+    bool fetch(int c, El::Matrix<T> &Z) {
+        if (c >= static_cast<int>(_blocks.size()) || !_blocks[c].stored) {
+            _misses++;
+            return false;
+        }
+
+        const block_t &b = _blocks[c];
+        const El::Int m = Z.Height(), n = Z.Width(), ld = Z.LDim();
+        T *z = Z.Buffer();
+
+#       ifdef SKYLARK_HAVE_OPENMP
+#       pragma omp parallel for
+#       endif
+        for(El::Int j = 0; j < n; j++) {
+            T *zj = z + j * ld;
+            if (_precision == FEATURE_CACHE_FULL)
+                std::copy(b.full.begin() + j * m,
+                    b.full.begin() + (j + 1) * m, zj);
+            else if (_precision == FEATURE_CACHE_FLOAT)
+                for(El::Int i = 0; i < m; i++)
+                    zj[i] = static_cast<T>(b.single[j * m + i]);
+            else
+                for(El::Int i = 0; i < m; i++)
+                    zj[i] = static_cast<T>(
+                        detail::bfloat16_to_float(b.half[j * m + i]));
+        }
+
+        _hits++;
+        return true;
+    }
+
+    /**
+     * Stores the local matrix Z as block c, if the plan keeps it.
+     */
+    void store(int c, const El::Matrix<T> &Z) {
+        if (c >= static_cast<int>(_blocks.size()) || !_blocks[c].keep)
+            return;
+
+        block_t &b = _blocks[c];
+        const El::Int m = Z.Height(), n = Z.Width(), ld = Z.LDim();
+        const T *z = Z.LockedBuffer();
+
+        if (_precision == FEATURE_CACHE_FULL)
+            b.full.resize(m * n);
+        else if (_precision == FEATURE_CACHE_FLOAT)
+            b.single.resize(m * n);
+        else
+            b.half.resize(m * n);
+
+#       ifdef SKYLARK_HAVE_OPENMP
+#       pragma omp parallel for
+#       endif
+        for(El::Int j = 0; j < n; j++) {
+            const T *zj = z + j * ld;
+            if (_precision == FEATURE_CACHE_FULL)
+                std::copy(zj, zj + m, b.full.begin() + j * m);
+            else if (_precision == FEATURE_CACHE_FLOAT)
+                for(El::Int i = 0; i < m; i++)
+                    b.single[j * m + i] = static_cast<float>(zj[i]);
+            else
+                for(El::Int i = 0; i < m; i++)
+                    b.half[j * m + i] =
+                        detail::float_to_bfloat16(static_cast<float>(zj[i]));
+        }
+
+        b.stored = true;
+    }
+
+    /** Number of blocks kept by the plan. */
+    int num_cached() const {
+        int count = 0;
+        for(size_t c = 0; c < _blocks.size(); c++)
+            count += _blocks[c].keep ? 1 : 0;
+        return count;
+    }
+
+    int num_blocks() const { return _blocks.size(); }
+
+    int precision() const { return _precision; }
+
+    std::string precision_name() const {
+        return detail::feature_cache_precision_name(_precision);
+    }
+
+    /** Fraction of fetches that were served from the cache. */
+    double hit_rate() const {
+        El::Int total = _hits + _misses;
+        return total == 0 ? 0.0 : double(_hits) / total;
+    }
+
+private:
+
+    struct block_t {
+        bool keep, stored;
+        std::vector<T> full;
+        std::vector<float> single;
+        std::vector<std::uint16_t> half;
+
+        block_t() : keep(false), stored(false) { }
+    };
+
+    const double _budget;
+    const int _lowest;
+    int _precision;
+    std::vector<block_t> _blocks;
+    El::Int _hits, _misses;
+
+    double entry_size(int precision) const {
+        switch(precision) {
+        case FEATURE_CACHE_FULL:
+            return sizeof(T);
+        case FEATURE_CACHE_FLOAT:
+            return std::min(sizeof(T), sizeof(float));
+        default:
+            return sizeof(std::uint16_t);
+        }
+    }
+};
+
+} } // namespace skylark::ml
+
+#endif // SKYLARK_FEATURE_CACHE_HPP
@@ -0,0 +1,500 @@
+#ifndef SKYLARK_FUSED_GRAM_HPP
+#define SKYLARK_FUSED_GRAM_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#ifdef SKYLARK_HAVE_OPENMP
+#include <omp.h>
+#endif
+
+#if defined(SKYLARK_HAVE_OPENMP) && defined(__GNUC__)
+// Resolved only if the BLAS Elemental links against is OpenBLAS.
+extern "C" {
+void openblas_set_num_threads(int) __attribute__((weak));
+int openblas_get_num_threads(void) __attribute__((weak));
+}
+#endif
+
+namespace skylark { namespace ml { namespace detail {
+
+/**
+ * Fused, tiled Gram matrix computation.
+ *
+ * The Gram matrix is computed one tile at a time: a tile of "base" values
+ * (inner products, L1 distances or sums of square roots) is computed and the
+ * kernel function is immediately applied to it while it is still in cache.
+ * Tiles are distributed among threads; inner product tiles use Gemm on the
+ * corresponding slices of the inputs (with BLAS kept single threaded, see
+ * blas_single_thread_t), the others use the blocked kernel of
+ * base/distance.hpp.
+ */
+
+/**
+ * Keeps a threaded BLAS single threaded while alive, so that the per-tile
+ * Gemm calls issued by all threads of a parallel region do not each spawn
+ * a full set of BLAS threads. Done for OpenBLAS, whose pthreads build
+ * would otherwise oversubscribe; MKL and OpenMP builds of OpenBLAS already
+ * run sequentially when called inside a parallel region.
+ */
+class blas_single_thread_t {
+public:
+
+    blas_single_thread_t() : _threads(0) {
+#if defined(SKYLARK_HAVE_OPENMP) && defined(__GNUC__)
+        if (openblas_set_num_threads != nullptr &&
+            openblas_get_num_threads != nullptr) {
+            _threads = openblas_get_num_threads();
+            if (_threads > 1)
+                openblas_set_num_threads(1);
+        }
+#endif
+    }
+
+    ~blas_single_thread_t() {
+#if defined(SKYLARK_HAVE_OPENMP) && defined(__GNUC__)
+        if (_threads > 1)
+            openblas_set_num_threads(_threads);
+#endif
+    }
+
+private:
+    int _threads;
+
+    blas_single_thread_t(const blas_single_thread_t&);
+    void operator=(const blas_single_thread_t&);
+};
+
+/** Gram tile size (rows and columns). */
+const El::Int gram_tile_size = 128;
+
+struct inner_product_tag {};
+struct l1_distance_tag {};
+struct sqrt_sum_tag {};
+
+/**
+ * In-place exp(x[i]) written so that it vectorizes: Cody-Waite reduction
+ * to |r| <= ln(2)/2, Taylor polynomial, and scaling by 2^k through the
+ * exponent bits. Accurate to about one ulp on [-708, 708]; arguments below
+ * that range give 0, arguments above it saturate.
+ */
+inline void exp_inplace(double *x, El::Int n) {
+    const double log2e = 1.4426950408889634;
+    const double ln2_hi = 6.93147180369123816490e-01;
+    const double ln2_lo = 1.90821492927058770002e-10;
+    const double shifter = 6755399441055744.0;      // 1.5 * 2^52
+    const double lo = -708.0, hi = 708.0;
+
+#   ifdef SKYLARK_HAVE_OPENMP
+#   pragma omp simd
+#   endif
+    for(El::Int i = 0; i < n; i++) {
+        double v = x[i];
+        const bool under = v < lo;
+        v = std::min(std::max(v, lo), hi);
+
+        // t holds k = round(v / ln 2) in its low mantissa bits.
+        const double t = v * log2e + shifter;
+        const double k = t - shifter;
+        const double r = (v - k * ln2_hi) - k * ln2_lo;
+
+        double p = 1.0 / 6227020800.0;
+        p = p * r + 1.0 / 479001600.0;
+        p = p * r + 1.0 / 39916800.0;
+        p = p * r + 1.0 / 3628800.0;
+        p = p * r + 1.0 / 362880.0;
+        p = p * r + 1.0 / 40320.0;
+        p = p * r + 1.0 / 5040.0;
+        p = p * r + 1.0 / 720.0;
+        p = p * r + 1.0 / 120.0;
+        p = p * r + 1.0 / 24.0;
+        p = p * r + 1.0 / 6.0;
+        p = p * r + 0.5;
+        p = p * r + 1.0;
+        p = p * r + 1.0;
+
+        std::uint64_t bits;
+        std::memcpy(&bits, &t, sizeof(bits));
+        bits = (bits + 1023) << 52;
+        double s;
+        std::memcpy(&s, &bits, sizeof(s));
+
+        x[i] = under ? 0.0 : p * s;
+    }
+}
+
+inline void exp_inplace(float *x, El::Int n) {
+    const float log2e = 1.44269504f;
+    const float ln2_hi = 0.693359375f;
+    const float ln2_lo = -2.12194440e-4f;
+    const float shifter = 12582912.0f;               // 1.5 * 2^23
+    const float lo = -87.0f, hi = 87.0f;
+
+#   ifdef SKYLARK_HAVE_OPENMP
+#   pragma omp simd
+#   endif
+    for(El::Int i = 0; i < n; i++) {
+        float v = x[i];
+        const bool under = v < lo;
+        v = std::min(std::max(v, lo), hi);
+
+        const float t = v * log2e + shifter;
+        const float k = t - shifter;
+        const float r = (v - k * ln2_hi) - k * ln2_lo;
+
+        float p = 1.0f / 5040.0f;
+        p = p * r + 1.0f / 720.0f;
+        p = p * r + 1.0f / 120.0f;
+        p = p * r + 1.0f / 24.0f;
+        p = p * r + 1.0f / 6.0f;
+        p = p * r + 0.5f;
+        p = p * r + 1.0f;
+        p = p * r + 1.0f;
+
+        std::uint32_t bits;
+        std::memcpy(&bits, &t, sizeof(bits));
+        bits = (bits + 127) << 23;
+        float s;
+        std::memcpy(&s, &bits, sizeof(s));
+
+        x[i] = under ? 0.0f : p * s;
+    }
+}
+
+/** x[i] = x[i]^q, by repeated squaring over the whole array. */
+template<typename T>
+void ipow_inplace(T *x, El::Int n, int q, std::vector<T>& work) {
+    if (q < 0) {
+        for(El::Int i = 0; i < n; i++)
+            x[i] = std::pow(x[i], q);
+        return;
+    }
+
+    work.assign(n, T(1));
+    T *r = work.data();
+    for(unsigned e = q; e != 0; e >>= 1) {
+        if (e & 1)
+            for(El::Int i = 0; i < n; i++)
+                r[i] *= x[i];
+        if (e > 1)
+            for(El::Int i = 0; i < n; i++)
+                x[i] *= x[i];
+    }
+    std::copy(r, r + n, x);
+}
+
+/*
+ * Tile operations. Each defines the base value computed for a tile, and a
+ * finish() that maps a column of base values to kernel values. nx and ny
+ * are squared norms of the tile's points (only if needs_norms).
+ */
+
+template<typename T>
+struct gaussian_gram_op_t {
+    typedef inner_product_tag base_tag;
+    static const bool needs_norms = true;
+
+    gaussian_gram_op_t(double sigma) : _scale(-1.0 / (2 * sigma * sigma)) { }
+
+    void finish(T *c, El::Int m, const T *nx, T ny, std::vector<T>&) const {
+#       ifdef SKYLARK_HAVE_OPENMP
+#       pragma omp simd
+#       endif
+        for(El::Int i = 0; i < m; i++)
+            c[i] = _scale * std::max(nx[i] + ny - 2 * c[i], T(0));
+        exp_inplace(c, m);
+    }
+
+private:
+    const T _scale;
+};
+
+template<typename T>
+struct polynomial_gram_op_t {
+    typedef inner_product_tag base_tag;
+    static const bool needs_norms = false;
+
+    polynomial_gram_op_t(int q, double c, double gamma)
+        : _q(q), _c(c), _gamma(gamma) { }
+
+    void finish(T *c, El::Int m, const T *, T, std::vector<T>& work) const {
+        for(El::Int i = 0; i < m; i++)
+            c[i] = _gamma * c[i] + _c;
+        ipow_inplace(c, m, _q, work);
+    }
+
+private:
+    const int _q;
+    const T _c, _gamma;
+};
+
+template<typename T>
+struct laplacian_gram_op_t {
+    typedef l1_distance_tag base_tag;
+    static const bool needs_norms = false;
+
+    laplacian_gram_op_t(double sigma) : _scale(-1.0 / sigma) { }
+
+    void finish(T *c, El::Int m, const T *, T, std::vector<T>&) const {
+        for(El::Int i = 0; i < m; i++)
+            c[i] *= _scale;
+        exp_inplace(c, m);
+    }
+
+private:
+    const T _scale;
+};
+
+template<typename T>
+struct expsemigroup_gram_op_t {
+    typedef sqrt_sum_tag base_tag;
+    static const bool needs_norms = false;
+
+    expsemigroup_gram_op_t(double beta) : _scale(-beta) { }
+
+    void finish(T *c, El::Int m, const T *, T, std::vector<T>&) const {
+        for(El::Int i = 0; i < m; i++)
+            c[i] *= _scale;
+        exp_inplace(c, m);
+    }
+
+private:
+    const T _scale;
+};
+
+/**
+ * Restricts the computation to tiles that intersect one triangle of the
+ * global matrix. Local row/column i maps to global rows[i]/cols[i] (both
+ * increasing); empty maps mean the identity.
+ */
+struct gram_triangle_t {
+    bool active;
+    El::UpperOrLower uplo;
+    std::vector<El::Int> rows, cols;
+
+    gram_triangle_t() : active(false), uplo(El::LOWER) { }
+
+    gram_triangle_t(El::UpperOrLower uplo_) : active(true), uplo(uplo_) { }
+
+    bool skip(El::Int i0, El::Int i1, El::Int j0, El::Int j1) const {
+        if (!active)
+            return false;
+        El::Int rfirst = rows.empty() ? i0 : rows[i0];
+        El::Int rlast = rows.empty() ? i1 - 1 : rows[i1 - 1];
+        El::Int cfirst = cols.empty() ? j0 : cols[j0];
+        El::Int clast = cols.empty() ? j1 - 1 : cols[j1 - 1];
+        return (uplo == El::LOWER) ? rlast < cfirst : rfirst > clast;
+    }
+};
+
+template<typename T>
+struct gram_workspace_t {
+    std::vector<T> xbuf, ybuf, work;
+};
+
+template<typename T>
+void base_tile(inner_product_tag, base::direction_t dirX,
+    base::direction_t dirY, const El::Matrix<T>& X, const El::Matrix<T>& Y,
+    El::Int i0, El::Int mt, El::Int j0, El::Int nt, El::Matrix<T>& C,
+    gram_workspace_t<T>&) {
+
+    const El::Int d = dirX == base::COLUMNS ? X.Height() : X.Width();
+
+    El::Matrix<T> Xt, Yt;
+    if (dirX == base::COLUMNS)
+        El::LockedView(Xt, X, 0, i0, d, mt);
+    else
+        El::LockedView(Xt, X, i0, 0, mt, d);
+    if (dirY == base::COLUMNS)
+        El::LockedView(Yt, Y, 0, j0, d, nt);
+    else
+        El::LockedView(Yt, Y, j0, 0, nt, d);
+
+    El::Gemm(base::internal::LeftOrientation(dirX),
+        base::internal::RightOrientation(dirY), T(1.0), Xt, Yt, T(0.0), C);
+}
+
+template<typename T, typename F>
+void elementwise_tile(base::direction_t dirX, base::direction_t dirY,
+    const El::Matrix<T>& X, const El::Matrix<T>& Y,
+    El::Int i0, El::Int mt, El::Int j0, El::Int nt, El::Matrix<T>& C,
+    gram_workspace_t<T>& ws, F f) {
+
+    T *c = C.Buffer();
+    const El::Int ldc = C.LDim();
+    for(El::Int j = 0; j < nt; j++)
+        std::fill(c + j * ldc, c + j * ldc + mt, T(0));
+
+    base::internal::ElementwiseDistanceTile(dirX, dirY, X, Y,
+        i0, mt, j0, nt, c, ldc, ws.xbuf, ws.ybuf, f);
+}
+
+template<typename T>
+struct sqrt_sum_t {
+    T operator()(T a, T b) const { return std::sqrt(a + b); }
+};
+
+template<typename T>
+void base_tile(l1_distance_tag, base::direction_t dirX,
+    base::direction_t dirY, const El::Matrix<T>& X, const El::Matrix<T>& Y,
+    El::Int i0, El::Int mt, El::Int j0, El::Int nt, El::Matrix<T>& C,
+    gram_workspace_t<T>& ws) {
+
+    elementwise_tile(dirX, dirY, X, Y, i0, mt, j0, nt, C, ws,
+        base::internal::abs_diff_t<T>());
+}
+
+template<typename T>
+void base_tile(sqrt_sum_tag, base::direction_t dirX,
+    base::direction_t dirY, const El::Matrix<T>& X, const El::Matrix<T>& Y,
+    El::Int i0, El::Int mt, El::Int j0, El::Int nt, El::Matrix<T>& C,
+    gram_workspace_t<T>& ws) {
+
+    elementwise_tile(dirX, dirY, X, Y, i0, mt, j0, nt, C, ws,
+        sqrt_sum_t<T>());
+}
+
+/**
+ * K = op(X, Y) for local matrices. Tiles skipped by triangle are left
+ * untouched.
+ */
+template<typename T, typename Op>
+void FusedGram(base::direction_t dirX, base::direction_t dirY,
+    const El::Matrix<T>& X, const El::Matrix<T>& Y, El::Matrix<T>& K,
+    const Op& op, const gram_triangle_t& triangle = gram_triangle_t()) {
+
+    const El::Int m = dirX == base::COLUMNS ? X.Width() : X.Height();
+    const El::Int n = dirY == base::COLUMNS ? Y.Width() : Y.Height();
+    K.Resize(m, n);
+
+    const El::Int tb = gram_tile_size;
+    const El::Int mtiles = (m + tb - 1) / tb;
+    const El::Int ntiles = (n + tb - 1) / tb;
+
+    std::vector<T> nx, ny;
+    if (Op::needs_norms) {
+        base::internal::SquaredPointNorms(dirX, X, nx);
+        if (&X == &Y && dirX == dirY)
+            ny = nx;
+        else
+            base::internal::SquaredPointNorms(dirY, Y, ny);
+    }
+
+    blas_single_thread_t single_threaded_blas;
+
+#   ifdef SKYLARK_HAVE_OPENMP
+#   pragma omp parallel
+#   endif
+    {
+        gram_workspace_t<T> ws;
+        El::Matrix<T> C;
+
+#       ifdef SKYLARK_HAVE_OPENMP
+#       pragma omp for schedule(dynamic)
+#       endif
+        for(El::Int t = 0; t < mtiles * ntiles; t++) {
+            const El::Int i0 = (t % mtiles) * tb;
+            const El::Int j0 = (t / mtiles) * tb;
+            const El::Int mt = std::min(tb, m - i0);
+            const El::Int nt = std::min(tb, n - j0);
+
+            if (triangle.skip(i0, i0 + mt, j0, j0 + nt))
+                continue;
+
+            El::View(C, K, i0, j0, mt, nt);
+            base_tile(typename Op::base_tag(), dirX, dirY, X, Y,
+                i0, mt, j0, nt, C, ws);
+
+            T *c = C.Buffer();
+            for(El::Int j = 0; j < nt; j++)
+                op.finish(c + j * C.LDim(), mt,
+                    Op::needs_norms ? nx.data() + i0 : nullptr,
+                    Op::needs_norms ? ny[j0 + j] : T(0), ws.work);
+        }
+    }
+}
+
+/**
+ * Distributed version: K ([MC,MR] or proxied to it) is stationary, the
+ * points are replicated along grid rows/columns ([STAR,MC] and [STAR,MR]
+ * for COLUMNS, [MC,STAR] and [MR,STAR] for ROWS), and each rank runs the
+ * local fused kernel on its part of K. No communication is needed after
+ * the redistribution.
+ */
+template<typename T, typename Op>
+void FusedGram(base::direction_t dirX, base::direction_t dirY,
+    const El::ElementalMatrix<T>& XPre, const El::ElementalMatrix<T>& YPre,
+    El::ElementalMatrix<T>& KPre, const Op& op,
+    const El::UpperOrLower *uplo = nullptr) {
+
+    El::Int m = dirX == base::COLUMNS ? XPre.Width() : XPre.Height();
+    El::Int n = dirY == base::COLUMNS ? YPre.Width() : YPre.Height();
+
+    KPre.Resize(m, n);
+    El::DistMatrixWriteProxy<T, T, El::MC, El::MR> KProx(KPre);
+    auto& K = KProx.Get();
+    const El::Grid& g = K.Grid();
+
+    El::DistMatrix<T, El::STAR, El::MC> X_STAR_MC(g);
+    El::DistMatrix<T, El::MC, El::STAR> X_MC_STAR(g);
+    El::DistMatrix<T, El::STAR, El::MR> Y_STAR_MR(g);
+    El::DistMatrix<T, El::MR, El::STAR> Y_MR_STAR(g);
+
+    const El::Matrix<T> *Xl, *Yl;
+    if (dirX == base::COLUMNS) {
+        X_STAR_MC.AlignWith(K);
+        El::Copy(XPre, X_STAR_MC);
+        Xl = &X_STAR_MC.LockedMatrix();
+    } else {
+        X_MC_STAR.AlignWith(K);
+        El::Copy(XPre, X_MC_STAR);
+        Xl = &X_MC_STAR.LockedMatrix();
+    }
+
+    if (dirY == base::COLUMNS) {
+        Y_STAR_MR.AlignWith(K);
+        El::Copy(YPre, Y_STAR_MR);
+        Yl = &Y_STAR_MR.LockedMatrix();
+    } else {
+        Y_MR_STAR.AlignWith(K);
+        El::Copy(YPre, Y_MR_STAR);
+        Yl = &Y_MR_STAR.LockedMatrix();
+    }
+
+    gram_triangle_t triangle;
+    if (uplo != nullptr) {
+        triangle = gram_triangle_t(*uplo);
+        for(El::Int i = 0; i < K.LocalHeight(); i++)
+            triangle.rows.push_back(K.GlobalRow(i));
+        for(El::Int j = 0; j < K.LocalWidth(); j++)
+            triangle.cols.push_back(K.GlobalCol(j));
+    }
+
+    FusedGram(dirX, dirY, *Xl, *Yl, K.Matrix(), op, triangle);
+}
+
+/**
+ * Symmetric versions: only tiles intersecting the uplo triangle are
+ * computed (other entries of those tiles are computed as well).
+ */
+template<typename T, typename Op>
+void FusedSymmetricGram(El::UpperOrLower uplo, base::direction_t dir,
+    const El::Matrix<T>& X, El::Matrix<T>& K, const Op& op) {
+
+    FusedGram(dir, dir, X, X, K, op, gram_triangle_t(uplo));
+}
+
+template<typename T, typename Op>
+void FusedSymmetricGram(El::UpperOrLower uplo, base::direction_t dir,
+    const El::ElementalMatrix<T>& X, El::ElementalMatrix<T>& K,
+    const Op& op) {
+
+    FusedGram(dir, dir, X, X, K, op, &uplo);
+}
+
+} } } // namespace skylark::ml::detail
+
+#endif // SKYLARK_FUSED_GRAM_HPP
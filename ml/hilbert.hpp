@@ -7,11 +7,13 @@
 #include "BlockADMM.hpp"
 #include "options.hpp"
 
-template <class InputType>
-BlockADMMSolver<InputType>* GetSolver(skylark::base::context_t& context,
+template <class InputType, class ComputeType>
+BlockADMMSolver<InputType, ComputeType>* GetSolver(
+    skylark::base::context_t& context,
     const hilbert_options_t& options, int dimensions) {
 
-    typedef typename BlockADMMSolver<InputType>::value_type value_type;
+    typedef BlockADMMSolver<InputType, ComputeType> solver_type;
+    typedef typename solver_type::value_type value_type;
 
     skylark::algorithms::loss_t<value_type> *loss = NULL;
     switch(options.lossfunction) {
@@ -48,7 +50,7 @@ BlockADMMSolver<InputType>* GetSolver(skylark::base::context_t& context,
             break;
         }
 
-    BlockADMMSolver<InputType> *Solver = NULL;
+    solver_type *Solver = NULL;
     int features = 0;
     switch(options.kernel) {
     case LINEAR:
@@ -56,14 +58,14 @@ BlockADMMSolver<InputType>* GetSolver(skylark::base::context_t& context,
             (options.randomfeatures == 0 ? dimensions : options.randomfeatures);
         if (options.randomfeatures == 0)
             Solver =
-                new BlockADMMSolver<InputType>(loss,
+                new solver_type(loss,
                     regularizer,
                     options.lambda,
                     dimensions,
                     options.numfeaturepartitions);
         else
             Solver =
-                new BlockADMMSolver<InputType>(context,
+                new solver_type(context,
                     loss,
                     regularizer,
                     options.lambda,
@@ -78,7 +80,7 @@ BlockADMMSolver<InputType>* GetSolver(skylark::base::context_t& context,
         if (!options.usefast)
             if (options.seqtype == LEAPED_HALTON)
                 Solver =
-                    new BlockADMMSolver<InputType>(context,
+                    new solver_type(context,
                         loss,
                         regularizer,
                         options.lambda,
@@ -89,7 +91,7 @@ BlockADMMSolver<InputType>* GetSolver(skylark::base::context_t& context,
                         options.numfeaturepartitions);
             else
                 Solver =
-                    new BlockADMMSolver<InputType>(context,
+                    new solver_type(context,
                         loss,
                         regularizer,
                         options.lambda,
@@ -100,7 +102,7 @@ BlockADMMSolver<InputType>* GetSolver(skylark::base::context_t& context,
                         options.numfeaturepartitions);
         else
             Solver =
-                new BlockADMMSolver<InputType>(context,
+                new solver_type(context,
                     loss,
                     regularizer,
                     options.lambda,
@@ -114,7 +116,7 @@ BlockADMMSolver<InputType>* GetSolver(skylark::base::context_t& context,
     case POLYNOMIAL:
         features = options.randomfeatures;
         Solver = 
-            new BlockADMMSolver<InputType>(context,
+            new solver_type(context,
                 loss,
                 regularizer,
                 options.lambda,
@@ -129,7 +131,7 @@ BlockADMMSolver<InputType>* GetSolver(skylark::base::context_t& context,
         features = options.randomfeatures;
         if (!options.usefast)
             Solver =
-                new BlockADMMSolver<InputType>(context,
+                new solver_type(context,
                     loss,
                     regularizer,
                     options.lambda,
@@ -140,7 +142,7 @@ BlockADMMSolver<InputType>* GetSolver(skylark::base::context_t& context,
                     options.numfeaturepartitions);
         else
             Solver =
-                new BlockADMMSolver<InputType>(context,
+                new solver_type(context,
                     loss,
                     regularizer,
                     options.lambda,
@@ -154,7 +156,7 @@ BlockADMMSolver<InputType>* GetSolver(skylark::base::context_t& context,
     case LAPLACIAN:
         features = options.randomfeatures;
         if (options.seqtype == LEAPED_HALTON)
-            new BlockADMMSolver<InputType>(context,
+            new solver_type(context,
                 loss,
                 regularizer,
                 options.lambda,
@@ -165,7 +167,7 @@ BlockADMMSolver<InputType>* GetSolver(skylark::base::context_t& context,
                 options.numfeaturepartitions);
         else
             Solver =
-                new BlockADMMSolver<InputType>(context,
+                new solver_type(context,
                     loss,
                     regularizer,
                     options.lambda,
@@ -180,7 +182,7 @@ BlockADMMSolver<InputType>* GetSolver(skylark::base::context_t& context,
     case EXPSEMIGROUP:
         features = options.randomfeatures;
         if (options.seqtype == LEAPED_HALTON)
-            new BlockADMMSolver<InputType>(context,
+            new solver_type(context,
                 loss,
                 regularizer,
                 options.lambda,
@@ -191,7 +193,7 @@ BlockADMMSolver<InputType>* GetSolver(skylark::base::context_t& context,
                 options.numfeaturepartitions);
         else
             Solver =
-                new BlockADMMSolver<InputType>(context,
+                new solver_type(context,
                     loss,
                     regularizer,
                     options.lambda,
@@ -214,6 +216,9 @@ BlockADMMSolver<InputType>* GetSolver(skylark::base::context_t& context,
     Solver->set_tol(options.tolerance);
     Solver->set_nthreads(options.numthreads);
     Solver->set_cache_transform(options.cachetransforms);
+    Solver->set_pipelined(options.pipelined);
+    Solver->set_allreduce_consensus(options.allreduceconsensus);
+    Solver->set_feature_groups(options.featuregroups);
 
     return Solver;
 }
@@ -251,9 +256,6 @@ void LargeScaleKernelLearning(const boost::mpi::communicator& comm,
         shift = true;
     }
 
-    BlockADMMSolver<InputType>* Solver =
-        GetSolver<InputType>(context, options, dimensions);
-
     if(!options.valfile.empty()) {
         comm.barrier();
         if(rank == 0)
@@ -266,12 +268,28 @@ void LargeScaleKernelLearning(const boost::mpi::communicator& comm,
             ShiftForLogistic(Yv);
     }
 
-    skylark::ml::hilbert_model_t* model =
-        Solver->train(X, Y, Xv, Yv, options.regression, comm);
+    typedef typename BlockADMMSolver<InputType>::value_type value_type;
+
+    skylark::ml::hilbert_model_t* model;
+    if (options.singlefeatures) {
+        BlockADMMSolver<InputType, float>* Solver =
+            GetSolver<InputType, float>(context, options, dimensions);
+        model = Solver->train(X, Y, Xv, Yv, options.regression, comm);
+    } else {
+        BlockADMMSolver<InputType, value_type>* Solver =
+            GetSolver<InputType, value_type>(context, options, dimensions);
+        model = Solver->train(X, Y, Xv, Yv, options.regression, comm);
+    }
 
     // TODO should be done "outside"
-    if (comm.rank() == 0)
-        model->save(options.modelfile, options.print());
+    if (comm.rank() == 0) {
+        if (options.binarymodel)
+            model->save_binary(options.modelfile, options.print(),
+                static_cast<skylark::ml::coef_precision_t>(
+                    options.modelprecision));
+        else
+            model->save(options.modelfile, options.print());
+    }
 }
 
 } }
@@ -0,0 +1,193 @@
+#ifndef SKYLARK_KERNEL_OPERATOR_HPP
+#define SKYLARK_KERNEL_OPERATOR_HPP
+
+#include <algorithm>
+#include <vector>
+
+namespace skylark { namespace ml {
+
+/**
+ * The regularized kernel matrix K + lambda * I of a set of points, as a
+ * symmetric operator that is never formed as a whole.
+ *
+ * Products are computed one column panel of K at a time: the panel
+ * K(:, J) is computed from the points (through the kernel's gram) and
+ * immediately multiplied with the corresponding rows of the input. Panels
+ * are cached, in order, as long as they fit in a per-rank memory budget;
+ * the rest are recomputed in every product.
+ *
+ * The points are replicated once, at construction, along the process rows
+ * and along the process columns of the grid, so each rank computes its part
+ * of a panel locally, with no communication. The replicas are charged to the
+ * memory budget before the cache; besides them and the cache, the memory
+ * used is a single panel.
+ */
+template<typename T, typename KernelType>
+class kernel_operator_t :
+    public base::symmetric_operator_t<El::DistMatrix<T> > {
+
+public:
+
+    typedef El::DistMatrix<T> matrix_type;
+    typedef T value_type;
+    typedef El::Int index_type;
+
+    /**
+     * @param direction whether points are columns or rows of X.
+     * @param k kernel.
+     * @param X points. Replicated, not referenced.
+     * @param lambda regularization (added to the diagonal).
+     * @param panel_width number of columns of K computed at a time
+     *        (0 for the default).
+     * @param cache_mb memory budget (per rank, in MB) for the replicated
+     *        points and the cached panels.
+     */
+    kernel_operator_t(base::direction_t direction, const KernelType &k,
+        const El::DistMatrix<T> &X, T lambda, El::Int panel_width = 0,
+        double cache_mb = 0.0) :
+        _direction(direction), _k(k), _grid(X.Grid()), _lambda(lambda) {
+
+        _n = direction == base::COLUMNS ? X.Width() : X.Height();
+        El::Int d = direction == base::COLUMNS ? X.Height() : X.Width();
+        _panel_width = panel_width > 0 ? panel_width :
+            std::max(El::Blocksize(), El::Int(1024));
+        _panel_width = std::min(_panel_width, std::max(_n, El::Int(1)));
+        _num_panels = (_n + _panel_width - 1) / _panel_width;
+
+        // Points of the local rows of K (replicated on the process rows)
+        // and of the local columns of K (replicated on the process columns).
+        if (direction == base::COLUMNS) {
+            El::DistMatrix<T, El::STAR, El::MC> XR(_grid);
+            El::DistMatrix<T, El::STAR, El::MR> XC(_grid);
+            XR.AlignRows(0);
+            XC.AlignRows(0);
+            XR = X;
+            XC = X;
+            _XR = XR.LockedMatrix();
+            _XC = XC.LockedMatrix();
+        } else {
+            El::DistMatrix<T, El::MC, El::STAR> XR(_grid);
+            El::DistMatrix<T, El::MR, El::STAR> XC(_grid);
+            XR.AlignCols(0);
+            XC.AlignCols(0);
+            XR = X;
+            XC = X;
+            _XR = XR.LockedMatrix();
+            _XC = XC.LockedMatrix();
+        }
+
+        // Local memory of the replicas, and of a panel: its share of
+        // n x panel_width entries.
+        double replica_mb = double(d) * sizeof(T) *
+            double(El::MaxLength(_n, _grid.Height()) +
+                El::MaxLength(_n, _grid.Width())) / (1024.0 * 1024.0);
+        double panel_mb = double(_n) * double(_panel_width) * sizeof(T) /
+            (double(_grid.Size()) * 1024.0 * 1024.0);
+        double free_mb = std::max(cache_mb - replica_mb, 0.0);
+        _max_cached = panel_mb > 0.0 ?
+            std::min(_num_panels, El::Int(free_mb / panel_mb)) : 0;
+
+        _cache.reserve(_max_cached);
+        _computed = 0;
+    }
+
+    virtual index_type height() const { return _n; }
+    virtual index_type width() const { return _n; }
+
+    /**
+     * C = beta * C + alpha * (K + lambda * I) * B
+     */
+    virtual void apply(value_type alpha, const matrix_type &B,
+        value_type beta, matrix_type &C) const {
+
+        if (beta == T(0))
+            El::Zero(C);
+        else
+            El::Scale(beta, C);
+        El::Axpy(alpha * _lambda, B, C);
+
+        matrix_type work(_grid), Bp(_grid);
+        for(El::Int p = 0; p < _num_panels; p++) {
+            El::Int j0 = p * _panel_width;
+            El::Int nb = std::min(_panel_width, _n - j0);
+
+            const matrix_type &Kp = panel(p, work);
+            El::LockedView(Bp, B, j0, 0, nb, B.Width());
+            El::Gemm(El::NORMAL, El::NORMAL, alpha, Kp, Bp, T(1.0), C);
+        }
+    }
+
+    /** Number of panels of K that are kept in memory. */
+    El::Int num_cached_panels() const { return _max_cached; }
+
+    /** Total number of panels of K. */
+    El::Int num_panels() const { return _num_panels; }
+
+    /** Number of panel computations done so far. */
+    El::Int num_computed_panels() const { return _computed; }
+
+private:
+
+    const base::direction_t _direction;
+    const KernelType &_k;
+    const El::Grid &_grid;
+    const T _lambda;
+
+    // Local parts of X as [STAR,MC] and [STAR,MR] (points are columns),
+    // or as [MC,STAR] and [MR,STAR] (points are rows), all aligned at 0.
+    El::Matrix<T> _XR, _XC;
+
+    El::Int _n, _panel_width, _num_panels, _max_cached;
+
+    mutable std::vector<matrix_type> _cache;
+    mutable El::Int _computed;
+
+    /**
+     * Returns panel p of K, from the cache if possible. Otherwise it is
+     * computed into work, and moved to the cache if there is room.
+     *
+     * work is aligned so that its local columns are consecutive local
+     * columns (or rows) of the [STAR,MR] (or [MR,STAR]) replica.
+     */
+    const matrix_type &panel(El::Int p, matrix_type &work) const {
+
+        if (p < static_cast<El::Int>(_cache.size()))
+            return _cache[p];
+
+        El::Int j0 = p * _panel_width;
+        El::Int nb = std::min(_panel_width, _n - j0);
+
+        work.Empty();
+        work.Align(0, j0 % _grid.Width());
+        work.Resize(_n, nb);
+
+        // Replica index of the first local column of the panel.
+        El::Int c0 = (j0 + work.RowShift()) / _grid.Width();
+        El::Int nl = work.LocalWidth();
+
+        El::Matrix<T> XCp;
+        if (_direction == base::COLUMNS)
+            El::LockedView(XCp, _XC, 0, c0, _XC.Height(), nl);
+        else
+            El::LockedView(XCp, _XC, c0, 0, nl, _XC.Width());
+
+        Gram(_direction, _direction, _k, _XR, XCp, work.Matrix());
+        _computed++;
+
+        if (p == static_cast<El::Int>(_cache.size()) && p < _max_cached) {
+            _cache.push_back(matrix_type(_grid));
+            _cache.back().Align(work.ColAlign(), work.RowAlign());
+            _cache.back() = work;
+            return _cache.back();
+        }
+
+        return work;
+    }
+
+    kernel_operator_t(const kernel_operator_t&);
+    void operator=(const kernel_operator_t&);
+};
+
+} } // namespace skylark::ml
+
+#endif // SKYLARK_KERNEL_OPERATOR_HPP
@@ -3,6 +3,7 @@
 
 #include "../sketch/sketch.hpp"
 #include "feature_transform_tags.hpp"
+#include "fused_gram.hpp"
 
 namespace skylark { namespace ml {
 
@@ -309,16 +310,8 @@ struct gaussian_t : public kernel_t {
 
         typedef typename utility::typer_t<KT>::value_type value_type;
 
-        El::Int m = dirX == base::COLUMNS ? base::Width(X) : base::Height(X);
-        El::Int n = dirY == base::COLUMNS ? base::Width(Y) : base::Height(Y);
-
-        K.Resize(m, n);
-        base::EuclideanDistanceMatrix(dirX, dirY, value_type(1.0), X, Y,
-            value_type(0.0), K);
-        El::EntrywiseMap(K, std::function<value_type(value_type)> (
-            [this] (value_type x) {
-                return std::exp(-x / (2 * _sigma * _sigma));
-            }));
+        detail::FusedGram(dirX, dirY, X, Y, K,
+            detail::gaussian_gram_op_t<value_type>(_sigma));
     }
 
     template<typename XT, typename KT>
@@ -327,15 +320,8 @@ struct gaussian_t : public kernel_t {
 
         typedef typename utility::typer_t<KT>::value_type value_type;
 
-        El::Int n = dir == base::COLUMNS ? base::Width(X) : base::Height(X);
-
-        K.Resize(n, n);
-        base::SymmetricEuclideanDistanceMatrix(uplo, dir, value_type(1.0), X,
-            value_type(0.0), K);
-        base::SymmetricEntrywiseMap(uplo, K, std::function<value_type(value_type)> (
-              [this] (value_type x) {
-                  return std::exp(-x / (2 * _sigma * _sigma));
-              }));
+        detail::FusedSymmetricGram(uplo, dir, X, K,
+            detail::gaussian_gram_op_t<value_type>(_sigma));
     }
 
     /* Instantion of virtual functions in base */
@@ -468,19 +454,8 @@ struct polynomial_t : public kernel_t {
 
         typedef typename utility::typer_t<KT>::value_type value_type;
 
-        El::Int m = dirX == base::COLUMNS ? base::Width(X) : base::Height(X);
-        El::Int n = dirY == base::COLUMNS ? base::Width(Y) : base::Height(Y);
-
-        K.Resize(m, n);
-        El::Orientation xo = dirX == base::COLUMNS ? El::ADJOINT : El::NORMAL;
-        El::Orientation yo = dirY == base::COLUMNS ? El::NORMAL : El::ADJOINT;
-
-        // TODO should be base::Gemm, not El::Gemm
-        El::Gemm(xo, yo, value_type(1.0), X, Y, value_type(0.0), K);
-        El::EntrywiseMap(K, std::function<value_type(value_type)> (
-            [this] (value_type x) {
-                return std::pow(_gamma * x + _c, _q);
-            }));
+        detail::FusedGram(dirX, dirY, X, Y, K,
+            detail::polynomial_gram_op_t<value_type>(_q, _c, _gamma));
     }
 
     template<typename XT, typename KT>
@@ -489,17 +464,8 @@ struct polynomial_t : public kernel_t {
 
         typedef typename utility::typer_t<KT>::value_type value_type;
 
-        El::Int n = dir == base::COLUMNS ? base::Width(X) : base::Height(X);
-        El::Orientation o = dir == base::COLUMNS ? El::ADJOINT : El::NORMAL;
-
-        K.Resize(n, n);
-        // TODO should be base::Herk, not El::Herk
-        El::Herk(uplo, o, value_type(1.0), X, K);
-        // TODO maybe need to use Gemm version.
-        base::SymmetricEntrywiseMap(uplo, K, std::function<value_type(value_type)> (
-              [this] (value_type x) {
-                  return std::pow(_gamma * x + _c, _q);
-              }));
+        detail::FusedSymmetricGram(uplo, dir, X, K,
+            detail::polynomial_gram_op_t<value_type>(_q, _c, _gamma));
     }
 
 
@@ -643,16 +609,8 @@ struct laplacian_t : public kernel_t {
 
         typedef typename utility::typer_t<KT>::value_type value_type;
 
-        El::Int m = dirX == base::COLUMNS ? base::Width(X) : base::Height(X);
-        El::Int n = dirY == base::COLUMNS ? base::Width(Y) : base::Height(Y);
-
-        K.Resize(m, n);
-        base::L1DistanceMatrix(dirX, dirY, value_type(1.0), X, Y,
-            value_type(0.0), K);
-        El::EntrywiseMap(K, std::function<value_type(value_type)> (
-            [this] (value_type x) {
-                return std::exp(-x / _sigma);
-            }));
+        detail::FusedGram(dirX, dirY, X, Y, K,
+            detail::laplacian_gram_op_t<value_type>(_sigma));
     }
 
     template<typename XT, typename KT>
@@ -661,15 +619,8 @@ struct laplacian_t : public kernel_t {
 
         typedef typename utility::typer_t<KT>::value_type value_type;
 
-        El::Int n = dir == base::COLUMNS ? base::Width(X) : base::Height(X);
-
-        K.Resize(n, n);
-        base::SymmetricL1DistanceMatrix(uplo, dir, value_type(1.0), X,
-            value_type(0.0), K);
-        base::SymmetricEntrywiseMap(uplo, K, std::function<value_type(value_type)> (
-              [this] (value_type x) {
-                  return std::exp(-x / _sigma);
-              }));
+        detail::FusedSymmetricGram(uplo, dir, X, K,
+            detail::laplacian_gram_op_t<value_type>(_sigma));
     }
 
     /* Instantion of virtual functions in base */
@@ -789,7 +740,29 @@ struct expsemigroup_t {
             qmc_sequence_dim(_N);
     }
 
-    // TODO method for gram matrix ?
+    /**
+     * k(x, y) = exp(-beta * sum_i sqrt(x_i + y_i)), for histograms
+     * (nonnegative x and y).
+     */
+    template<typename XT, typename YT, typename KT>
+    void gram(base::direction_t dirX, base::direction_t dirY,
+        const XT &X, const YT &Y, KT &K) const {
+
+        typedef typename utility::typer_t<KT>::value_type value_type;
+
+        detail::FusedGram(dirX, dirY, X, Y, K,
+            detail::expsemigroup_gram_op_t<value_type>(_beta));
+    }
+
+    template<typename XT, typename KT>
+    void symmetric_gram(El::UpperOrLower uplo, base::direction_t dir,
+        const XT &X, KT &K) const {
+
+        typedef typename utility::typer_t<KT>::value_type value_type;
+
+        detail::FusedSymmetricGram(uplo, dir, X, K,
+            detail::expsemigroup_gram_op_t<value_type>(_beta));
+    }
 
 
 private:
@@ -21,6 +21,19 @@ struct krr_params_t : public base::params_t {
     // For memory limited methods (SketchedApproximateKRR, LargeScaleKRR)
     El::Int max_split;
 
+    // For exact methods (KRR, FasterKRR): never form the kernel matrix,
+    // compute its products panel by panel inside CG instead. Panels are
+    // cached while they fit in gram_cache_mb (per rank).
+    bool matrix_free;
+    El::Int gram_panel_width;
+    double gram_cache_mb;
+
+    // For LargeScaleKRR: memory (MB per rank) for keeping the feature
+    // blocks between iterations, and the lowest storage precision
+    // (feature_cache_precision_t) used to make them fit.
+    double z_cache_mb;
+    int z_cache_precision;
+
     krr_params_t(bool am_i_printing = 0,
         int log_level = 0,
         std::ostream &log_stream = std::cout,
@@ -39,10 +52,59 @@ struct krr_params_t : public base::params_t {
         iter_lim = 1000;
 
         max_split = 0;
+
+        matrix_free = false;
+        gram_panel_width = 0;
+        gram_cache_mb = 0.0;
+
+        z_cache_mb = 0.0;
+        z_cache_precision = FEATURE_CACHE_BFLOAT16;
   }
 
 };
 
+/**
+ * Solves (K + lambda * I) A = Y with CG, where K is applied through a
+ * kernel_operator_t and is never formed.
+ */
+template<typename T, typename KernelType>
+void MatrixFreeKernelRidge(base::direction_t direction, const KernelType &k,
+    const El::DistMatrix<T> &X, const El::DistMatrix<T> &Y, T lambda,
+    El::DistMatrix<T> &A,
+    const algorithms::outplace_precond_t<El::DistMatrix<T> > &P,
+    krr_params_t params = krr_params_t()) {
+
+    bool log_lev1 = params.am_i_printing && params.log_level >= 1;
+
+    boost::mpi::timer timer;
+
+    kernel_operator_t<T, KernelType> K(direction, k, X, lambda,
+        params.gram_panel_width, params.gram_cache_mb);
+
+    if (log_lev1) {
+        params.log_stream << params.prefix
+                          << "Solving with matrix-free kernel ("
+                          << K.num_cached_panels() << " of "
+                          << K.num_panels() << " panels cached)... "
+                          << std::endl;
+        params.log_stream.flush();
+        timer.restart();
+    }
+
+    algorithms::krylov_iter_params_t cg_params(params.tolerance,
+        params.iter_lim, params.am_i_printing, params.log_level - 1,
+        params.res_print, params.log_stream, params.prefix + "\t");
+
+    El::Zeros(A, K.height(), Y.Width());
+    algorithms::CG(El::LOWER, K, Y, A, cg_params, P);
+
+    if (log_lev1)
+        params.log_stream << params.prefix
+                          << "Took " << boost::format("%.2e") % timer.elapsed()
+                          << " sec (" << K.num_computed_panels()
+                          << " panels computed)\n";
+}
+
 template<typename T, typename KernelType>
 void KernelRidge(base::direction_t direction, const KernelType &k,
     const El::DistMatrix<T> &X, const El::DistMatrix<T> &Y, T lambda,
@@ -53,6 +115,12 @@ void KernelRidge(base::direction_t direction, const KernelType &k,
 
     boost::mpi::timer timer;
 
+    if (params.matrix_free) {
+        MatrixFreeKernelRidge(direction, k, X, Y, lambda, A,
+            algorithms::outplace_id_precond_t<El::DistMatrix<T> >(), params);
+        return;
+    }
+
     // Compute kernel matrix
     if (log_lev1) {
         params.log_stream << params.prefix
@@ -425,7 +493,7 @@ void FasterKernelRidge(base::direction_t direction, const KernelType &k,
     El::DistMatrix<T> K, D;
 
     // Hack for experiments!
-    if (params.iter_lim == -1)
+    if (params.iter_lim == -1 || params.matrix_free)
         goto skip_kernel_creation;
 
     SymmetricGram(El::LOWER, direction, k, X, K);
@@ -475,7 +543,9 @@ void FasterKernelRidge(base::direction_t direction, const KernelType &k,
 
 
     // Solve
-    if (params.iter_lim != -1) {
+    if (params.matrix_free) {
+        MatrixFreeKernelRidge(direction, k, X, Y, lambda, A, *P, params);
+    } else if (params.iter_lim != -1) {
         algorithms::krylov_iter_params_t cg_params(params.tolerance, params.iter_lim,
             params.am_i_printing, params.log_level - 1, params.res_print, 
             params.log_stream, params.prefix + "\t");
@@ -573,6 +643,22 @@ void LargeScaleKernelRidge(base::direction_t direction, const KernelType &k,
         Z.Resize(X.Height(), s0max);
     ZR.Resize(s0max, t);
 
+    // Feature blocks are kept for the next iterations if they fit.
+    feature_block_cache_t<T> zcache(params.z_cache_mb,
+        static_cast<feature_cache_precision_t>(params.z_cache_precision));
+    if (params.z_cache_mb > 0) {
+        std::vector<El::Int> local_sizes(C);
+        for(int c = 0; c < C; c++) {
+            El::Int s0 = transforms[c].get_S();
+            if (direction == base::COLUMNS)
+                Z.Resize(s0, X.Width());
+            else
+                Z.Resize(X.Height(), s0);
+            local_sizes[c] = Z.LocalHeight() * Z.LocalWidth();
+        }
+        zcache.plan(local_sizes, Z.Grid().Comm().comm);
+    }
+
     std::vector<El::DistMatrix<T> > Ls(C);
     El::DistMatrix<T> W0;
     starts = 0;
@@ -589,6 +675,7 @@ void LargeScaleKernelRidge(base::direction_t direction, const KernelType &k,
             Z.Resize(X.Height(), s0);
             transforms[c].apply(X, Z, sketch::rowwise_tag());
         }
+        zcache.store(c, Z.LockedMatrix());
 
         // Compute factor of local covariance matrix.
         El::Herk(El::LOWER, direction == base::COLUMNS ? El::NORMAL : El::ADJOINT,
@@ -633,13 +720,17 @@ void LargeScaleKernelRidge(base::direction_t direction, const KernelType &k,
             El::DistMatrix<T> &L = Ls[c];
             base::RowView(W0, W, starts, s0);
 
-            // Apply feature transform
-            if (direction == base::COLUMNS) {
+            // Apply feature transform, unless it was cached
+            if (direction == base::COLUMNS)
                 Z.Resize(s0, X.Width());
-                transforms[c].apply(X, Z, sketch::columnwise_tag());
-            } else {
+            else
                 Z.Resize(X.Height(), s0);
-                transforms[c].apply(X, Z, sketch::rowwise_tag());
+
+            if (!zcache.fetch(c, Z.Matrix())) {
+                if (direction == base::COLUMNS)
+                    transforms[c].apply(X, Z, sketch::columnwise_tag());
+                else
+                    transforms[c].apply(X, Z, sketch::rowwise_tag());
             }
 
             // Compute ZR
@@ -680,6 +771,14 @@ void LargeScaleKernelRidge(base::direction_t direction, const KernelType &k,
         params.log_stream << params.prefix
                           << "Took " << boost::format("%.2e") % timer.elapsed()
                           << " sec\n";
+
+    if (log_lev1 && params.z_cache_mb > 0)
+        params.log_stream << params.prefix
+                          << "Feature cache: " << zcache.num_cached()
+                          << " of " << C << " blocks ("
+                          << zcache.precision_name() << "), hit rate = "
+                          << boost::format("%.1f") % (100 * zcache.hit_rate())
+                          << "%\n";
 }
 
 } } // namespace skylark::ml
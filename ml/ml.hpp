@@ -4,9 +4,13 @@
 #include "coding.hpp"
 #include "graph/graph.hpp"
 #include "kernels.hpp"
+#include "kernel_operator.hpp"
+#include "feature_cache.hpp"
+#include "partial_sums.hpp"
 #include "krr.hpp"
 #include "rlsc.hpp"
 #include "model.hpp"
+#include "prediction_server.hpp"
 
 // TODO add includes to hilbert
 
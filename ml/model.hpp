@@ -10,9 +10,12 @@
 #include <fstream>
 #include <iostream>
 #include <cstdlib>
+#include <memory>
 #include <string>
 #include <vector>
 #include "kernels.hpp"
+#include "model_container.hpp"
+#include "partial_sums.hpp"
 #include "options.hpp"
 
 #ifdef SKYLARK_HAVE_OPENMP
@@ -82,7 +85,17 @@ struct hilbert_model_t {
         build_from_ptree(pt);
     }
 
+    /**
+     * Loads a model saved by save() or save_binary(); the format is detected
+     * from the file contents. Double precision binary models are used
+     * directly out of a memory mapping of the file.
+     */
     hilbert_model_t(const std::string& fname) {
+        if (IsBinaryModel(fname)) {
+            load_binary(fname);
+            return;
+        }
+
         std::ifstream is(fname);
 
         // Skip all lines begining with "#"
@@ -101,27 +114,7 @@ struct hilbert_model_t {
     }
 
     boost::property_tree::ptree to_ptree() const {
-        boost::property_tree::ptree pt;
-        pt.put("skylark_object_type", "model:linear-on-features");
-        pt.put("skylark_version", VERSION);
-
-        pt.put("num_features", _coef.Height());
-        pt.put("num_outputs", _coef.Width());
-        pt.put("input_size", _input_size);
-        pt.put("regression", _regression);
-
-        boost::property_tree::ptree ptfmap;
-        ptfmap.put("number_maps", _maps.size());
-        ptfmap.put("scale_maps", _scale_maps);
-
-
-        boost::property_tree::ptree ptmaps;
-        for(int i = 0; i < _maps.size(); i++)
-            ptmaps.push_back(std::make_pair(std::to_string(i),
-                    _maps[i]->to_ptree()));
-        ptfmap.add_child("maps", ptmaps);
-
-        pt.add_child("feature_mapping", ptfmap);
+        boost::property_tree::ptree pt = header_ptree();
 
         std::stringstream scoef;
         El::Print(_coef, "", scoef);
@@ -142,6 +135,24 @@ struct hilbert_model_t {
         of.close();
     }
 
+    /**
+     * Saves the model to a binary container named fname: the JSON description
+     * of the feature maps followed by the raw coefficient matrix. Much
+     * smaller and faster to load than save() for large models.
+     * You may want to use this method from only a single rank.
+     *
+     * @param header free text stored as the "comments" entry of the header.
+     * @param precision storage precision of the coefficients.
+     */
+    void save_binary(const std::string& fname, const std::string& header,
+        coef_precision_t precision = COEF_DOUBLE) const {
+
+        boost::property_tree::ptree pt = header_ptree();
+        pt.put("comments", header);
+        WriteModelContainer(fname, pt, _coef.LockedBuffer(),
+            _coef.Height(), _coef.Width(), _coef.LDim(), precision);
+    }
+
     template<typename InputType, typename LabelType, typename DecisionType>
     void predict(const InputType& X, LabelType& PV, DecisionType& DV,
         int num_threads = 1) const {
@@ -157,10 +168,14 @@ struct hilbert_model_t {
             base::Gemm(El::TRANSPOSE,El::NORMAL,1.0, X, _coef, 0.0, DV);
         } else {
             // Non-linear case
-            coef_type Wslice;
+            typedef typename utility::typer_t<DecisionType>::value_type
+                decision_value_type;
             int j, start, finish, sj;
 
             El::Zeros(DV, n, k);
+            detail::thread_partial_sums_t<decision_value_type> DVsum(DV,
+                num_threads);
+
 #           ifdef SKYLARK_HAVE_OPENMP
 #           pragma omp parallel for if(num_threads > 1) private(j, start, finish, sj) num_threads(num_threads)
 #           endif
@@ -176,40 +191,52 @@ struct hilbert_model_t {
                     // TODO shouldn't it be s instead of d?
                     El::Scale(sqrt(double(sj) / d), z);
 
-                DecisionType o(n, k);
-
+                coef_type Wslice;
                 El::LockedView(Wslice, _coef, start, 0, sj, k);
-                base::Gemm(El::TRANSPOSE, El::NORMAL, 1.0, z, Wslice, o);
-
-#               ifdef SKYLARK_HAVE_OPENMP
-#               pragma omp critical
-#               endif
-                base::Axpy(+1.0, o, DV);
+                base::Gemm(El::TRANSPOSE, El::NORMAL, 1.0, z, Wslice,
+                    1.0, DVsum.local());
             }
+
+            DVsum.reduce();
         }
 
-        if (!_regression) {
-            double o, o1, pred;
-            PV.Resize(n, 1);
-            for(int i=0; i < DV.Height(); i++) {
-                o = DV.Get(i,0);
-                pred = 0;
-                if (DV.Width()==1)
-                    pred = (o >= 0)? +1:-1;
-
-                for(int j=1; j < DV.Width(); j++) {
-                    o1 = DV.Get(i,j);
-                    if ( o1 > o) {
-                        o = o1;
-                        pred = j;
-                    }
+        if (!_regression)
+            decisions_to_labels(DV, PV);
+    }
+
+    /**
+     * Labels of classification decision values (one row per point): the
+     * sign for a single output, otherwise the index of the largest one.
+     */
+    template<typename DecisionType, typename LabelType>
+    static void decisions_to_labels(const DecisionType& DV, LabelType& PV) {
+        double o, o1, pred;
+        PV.Resize(DV.Height(), 1);
+        for(int i=0; i < DV.Height(); i++) {
+            o = DV.Get(i,0);
+            pred = 0;
+            if (DV.Width()==1)
+                pred = (o >= 0)? +1:-1;
+
+            for(int j=1; j < DV.Width(); j++) {
+                o1 = DV.Get(i,j);
+                if ( o1 > o) {
+                    o = o1;
+                    pred = j;
                 }
-                PV.Set(i,0, pred);
             }
+            PV.Set(i,0, pred);
         }
     }
 
     coef_type& get_coef() { return _coef; }
+    const coef_type& get_coef() const { return _coef; }
+
+    const std::vector<const feature_transform_type *>& get_maps() const {
+        return _maps;
+    }
+
+    bool get_scale_maps() const { return _scale_maps; }
 
     int get_output_size() const { return _coef.Width(); }
     int get_input_size() const { return _input_size; }
@@ -218,10 +245,84 @@ struct hilbert_model_t {
 
 protected:
 
+    /** Everything but the coefficients. */
+    boost::property_tree::ptree header_ptree() const {
+        boost::property_tree::ptree pt;
+        pt.put("skylark_object_type", "model:linear-on-features");
+        pt.put("skylark_version", VERSION);
+
+        pt.put("num_features", _coef.Height());
+        pt.put("num_outputs", _coef.Width());
+        pt.put("input_size", _input_size);
+        pt.put("regression", _regression);
+
+        boost::property_tree::ptree ptfmap;
+        ptfmap.put("number_maps", _maps.size());
+        ptfmap.put("scale_maps", _scale_maps);
+
+
+        boost::property_tree::ptree ptmaps;
+        for(int i = 0; i < _maps.size(); i++)
+            ptmaps.push_back(std::make_pair(std::to_string(i),
+                    _maps[i]->to_ptree()));
+        ptfmap.add_child("maps", ptmaps);
+
+        pt.add_child("feature_mapping", ptfmap);
+
+        return pt;
+    }
+
     void build_from_ptree(const boost::property_tree::ptree &pt) {
+        build_header_from_ptree(pt);
+
+        int num_features = _coef.Height();
+        int num_outputs = _coef.Width();
+        std::istringstream coef_str(pt.get<std::string>("coef_matrix"));
+        double *buffer = _coef.Buffer();
+        int ldim = _coef.LDim();
+        for(int i = 0; i < num_features; i++) {
+            std::string line;
+            std::getline(coef_str, line);
+            std::istringstream coefstream(line);
+            for(int j = 0; j < num_outputs; j++) {
+                std::string token;
+                coefstream >> token;
+                buffer[i + j * ldim] = atof(token.c_str());
+            }
+        }
+    }
+
+    void load_binary(const std::string& fname) {
+        model_container_t container(fname);
+        const boost::property_tree::ptree &pt = container.header;
+
+        if (pt.get<size_t>("num_features") != container.height ||
+            pt.get<size_t>("num_outputs") != container.width)
+            SKYLARK_THROW_EXCEPTION (
+                base::io_exception()
+                    << base::error_msg("Coefficient size mismatch in " +
+                        fname));
+
+        double *coefs = container.in_place_coefs();
+        if (coefs != nullptr) {
+            // The mapping is private, so writes through get_coef() are fine.
+            _file = container.file();
+            _coef.Attach(container.height, container.width, coefs,
+                container.height);
+        } else {
+            _coef.Resize(container.height, container.width);
+            container.read_coefs(_coef.Buffer(), _coef.LDim());
+        }
+
+        build_header_from_ptree(pt);
+    }
+
+    /** Everything but the coefficients; _coef is resized only if needed. */
+    void build_header_from_ptree(const boost::property_tree::ptree &pt) {
         int num_features = pt.get<int>("num_features");
         int num_outputs = pt.get<int>("num_outputs");
-        _coef.Resize(num_features, num_outputs);
+        if (_coef.Height() != num_features || _coef.Width() != num_outputs)
+            _coef.Resize(num_features, num_outputs);
 
         _input_size = pt.get<int>("input_size");
         _regression = pt.get<bool>("regression");
@@ -245,23 +346,11 @@ protected:
         }
 
         _scale_maps = pt.get<bool>("feature_mapping.scale_maps");
-
-        std::istringstream coef_str(pt.get<std::string>("coef_matrix"));
-        double *buffer = _coef.Buffer();
-        int ldim = _coef.LDim();
-        for(int i = 0; i < num_features; i++) {
-            std::string line;
-            std::getline(coef_str, line);
-            std::istringstream coefstream(line);
-            for(int j = 0; j < num_outputs; j++) {
-                std::string token;
-                coefstream >> token;
-                buffer[i + j * ldim] = atof(token.c_str());
-            }
-        }
     }
 
 private:
+    // Declared before _coef so that an attached mapping outlives it.
+    std::shared_ptr<detail::mapped_file_t> _file;
     coef_type _coef;
     El::Int _input_size;
     std::vector<const feature_transform_type *> _maps; // TODO use shared_ptr
@@ -0,0 +1,445 @@
+#ifndef SKYLARK_ML_MODEL_CONTAINER_HPP
+#define SKYLARK_ML_MODEL_CONTAINER_HPP
+
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+#include "../base/exception.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SKYLARK_MODEL_CONTAINER_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef SKYLARK_HAVE_OPENMP
+#include <omp.h>
+#endif
+
+namespace skylark { namespace ml {
+
+/**
+ * Storage precision of the coefficient blob in a binary model container.
+ * Coefficients are always computed in double; reduced precision only affects
+ * the size of the file (and the loaded coefficients).
+ */
+enum coef_precision_t {
+    COEF_DOUBLE = 0,
+    COEF_FLOAT = 1,
+    COEF_HALF = 2
+};
+
+/**
+ * Binary model container layout (all integers little-endian):
+ *
+ *   offset  0: magic "SKYMODEL"
+ *   offset  8: uint32 version
+ *   offset 12: uint32 precision (coef_precision_t)
+ *   offset 16: uint64 size of JSON header in bytes
+ *   offset 24: uint64 height of the coefficient matrix
+ *   offset 32: uint64 width of the coefficient matrix
+ *   offset 40: uint64 offset of the coefficient blob
+ *   offset 48: JSON header (same as the text model, without "coef_matrix")
+ *   padding up to a 64 byte boundary
+ *   coefficient blob, column-major, little-endian IEEE values.
+ *
+ * The blob is aligned so that a double blob can be used directly out of a
+ * memory mapping of the file.
+ */
+namespace detail {
+
+static const char model_container_magic[8] =
+{'S', 'K', 'Y', 'M', 'O', 'D', 'E', 'L'};
+static const std::uint32_t model_container_version = 1;
+static const size_t model_container_preamble_size = 48;
+static const size_t model_container_alignment = 64;
+
+inline bool host_is_little_endian() {
+    const std::uint32_t one = 1;
+    unsigned char c;
+    std::memcpy(&c, &one, 1);
+    return c == 1;
+}
+
+template<typename T>
+void put_le(char *dst, T value) {
+    for(size_t i = 0; i < sizeof(T); i++)
+        dst[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+}
+
+template<typename T>
+T get_le(const char *src) {
+    T value = 0;
+    for(size_t i = 0; i < sizeof(T); i++)
+        value |= static_cast<T>(static_cast<unsigned char>(src[i])) << (8 * i);
+    return value;
+}
+
+/** IEEE binary32 to binary16, round to nearest even. */
+inline std::uint16_t float_to_half(float f) {
+    std::uint32_t x;
+    std::memcpy(&x, &f, 4);
+
+    std::uint16_t sign = (x >> 16) & 0x8000;
+    std::uint32_t mant = x & 0x007fffff;
+    int exp = (x >> 23) & 0xff;
+
+    if (exp == 0xff)                      // Inf / NaN
+        return sign | 0x7c00 | (mant ? 0x200 : 0);
+
+    exp = exp - 127 + 15;
+    if (exp >= 0x1f)                      // Overflow
+        return sign | 0x7c00;
+
+    if (exp <= 0) {                       // Subnormal or zero
+        if (exp < -10)
+            return sign;
+        mant |= 0x00800000;
+        int shift = 14 - exp;
+        std::uint32_t half = mant >> shift;
+        std::uint32_t rem = mant & ((1u << shift) - 1);
+        std::uint32_t mid = 1u << (shift - 1);
+        if (rem > mid || (rem == mid && (half & 1)))
+            half++;
+        return sign | static_cast<std::uint16_t>(half);
+    }
+
+    std::uint32_t half = (exp << 10) | (mant >> 13);
+    std::uint32_t rem = mant & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (half & 1)))
+        half++;                           // May carry into Inf, as it should.
+    return sign | static_cast<std::uint16_t>(half);
+}
+
+/** IEEE binary16 to binary32 (exact). */
+inline float half_to_float(std::uint16_t h) {
+    std::uint32_t sign = static_cast<std::uint32_t>(h & 0x8000) << 16;
+    int exp = (h >> 10) & 0x1f;
+    std::uint32_t mant = h & 0x3ff;
+    std::uint32_t x;
+
+    if (exp == 0x1f)
+        x = sign | 0x7f800000 | (mant << 13);
+    else if (exp != 0)
+        x = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+    else if (mant == 0)
+        x = sign;
+    else {
+        exp = 127 - 15 + 1;
+        while (!(mant & 0x400)) {
+            mant <<= 1;
+            exp--;
+        }
+        x = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+    }
+
+    float f;
+    std::memcpy(&f, &x, 4);
+    return f;
+}
+
+inline size_t coef_element_size(coef_precision_t precision) {
+    switch (precision) {
+    case COEF_DOUBLE: return 8;
+    case COEF_FLOAT:  return 4;
+    case COEF_HALF:   return 2;
+    }
+    return 0;
+}
+
+/** Encodes n doubles as little-endian values of the given precision. */
+inline void encode_coefs(const double *src, size_t n,
+    coef_precision_t precision, char *dst) {
+
+    const bool le = host_is_little_endian();
+
+#   ifdef SKYLARK_HAVE_OPENMP
+#   pragma omp parallel for
+#   endif
+    for(size_t i = 0; i < n; i++) {
+        switch (precision) {
+        case COEF_DOUBLE: {
+            std::uint64_t x;
+            std::memcpy(&x, src + i, 8);
+            if (le)
+                std::memcpy(dst + 8 * i, &x, 8);
+            else
+                put_le(dst + 8 * i, x);
+            break;
+        }
+        case COEF_FLOAT: {
+            float f = static_cast<float>(src[i]);
+            std::uint32_t x;
+            std::memcpy(&x, &f, 4);
+            put_le(dst + 4 * i, x);
+            break;
+        }
+        case COEF_HALF:
+            put_le(dst + 2 * i, float_to_half(static_cast<float>(src[i])));
+            break;
+        }
+    }
+}
+
+/** Decodes n little-endian values of the given precision into doubles. */
+inline void decode_coefs(const char *src, size_t n,
+    coef_precision_t precision, double *dst) {
+
+#   ifdef SKYLARK_HAVE_OPENMP
+#   pragma omp parallel for
+#   endif
+    for(size_t i = 0; i < n; i++) {
+        switch (precision) {
+        case COEF_DOUBLE: {
+            std::uint64_t x = get_le<std::uint64_t>(src + 8 * i);
+            std::memcpy(dst + i, &x, 8);
+            break;
+        }
+        case COEF_FLOAT: {
+            std::uint32_t x = get_le<std::uint32_t>(src + 4 * i);
+            float f;
+            std::memcpy(&f, &x, 4);
+            dst[i] = f;
+            break;
+        }
+        case COEF_HALF:
+            dst[i] = half_to_float(get_le<std::uint16_t>(src + 2 * i));
+            break;
+        }
+    }
+}
+
+/**
+ * Read-only view of a whole file. Uses a private (copy-on-write) memory
+ * mapping when available, so pages are loaded on demand and writes never
+ * reach the file. Otherwise the file is read into memory.
+ */
+class mapped_file_t {
+
+public:
+
+    explicit mapped_file_t(const std::string& fname)
+        : _data(nullptr), _size(0), _mapped(false) {
+
+#       ifdef SKYLARK_MODEL_CONTAINER_MMAP
+        int fd = ::open(fname.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+                void *p = ::mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    _data = static_cast<char *>(p);
+                    _size = st.st_size;
+                    _mapped = true;
+                }
+            }
+            ::close(fd);
+        }
+        if (_mapped)
+            return;
+#       endif
+
+        std::ifstream in(fname, std::ios::binary);
+        if (!in)
+            SKYLARK_THROW_EXCEPTION (
+                base::io_exception()
+                    << base::error_msg("Failed to open model file " + fname));
+
+        in.seekg(0, std::ios::end);
+        _buffer.resize(static_cast<size_t>(in.tellg()));
+        in.seekg(0, std::ios::beg);
+        in.read(_buffer.data(), _buffer.size());
+        _data = _buffer.data();
+        _size = _buffer.size();
+    }
+
+    ~mapped_file_t() {
+#       ifdef SKYLARK_MODEL_CONTAINER_MMAP
+        if (_mapped)
+            ::munmap(_data, _size);
+#       endif
+    }
+
+    char *data() { return _data; }
+    size_t size() const { return _size; }
+    bool is_mapped() const { return _mapped; }
+
+private:
+    char *_data;
+    size_t _size;
+    bool _mapped;
+    std::vector<char> _buffer;
+
+    mapped_file_t(const mapped_file_t&);
+    void operator=(const mapped_file_t&);
+};
+
+} // namespace detail
+
+/**
+ * @return true if fname starts with the binary model container magic.
+ */
+inline bool IsBinaryModel(const std::string& fname) {
+    std::ifstream in(fname, std::ios::binary);
+    char magic[sizeof(detail::model_container_magic)];
+    if (!in.read(magic, sizeof(magic)))
+        return false;
+    return std::memcmp(magic, detail::model_container_magic,
+        sizeof(magic)) == 0;
+}
+
+/**
+ * Writes a binary model container.
+ *
+ * @param fname output file.
+ * @param pt JSON header describing the model (without the coefficients).
+ * @param coef column-major coefficients (leading dimension ldim).
+ * @param precision storage precision of the coefficients.
+ */
+inline void WriteModelContainer(const std::string& fname,
+    const boost::property_tree::ptree& pt,
+    const double *coef, size_t height, size_t width, size_t ldim,
+    coef_precision_t precision) {
+
+    if (precision < COEF_DOUBLE || precision > COEF_HALF)
+        SKYLARK_THROW_EXCEPTION (
+            base::io_exception()
+                << base::error_msg("Unknown coefficient precision"));
+
+    std::ostringstream sheader;
+    boost::property_tree::write_json(sheader, pt, false);
+    const std::string header = sheader.str();
+
+    const size_t align = detail::model_container_alignment;
+    size_t offset = detail::model_container_preamble_size + header.size();
+    offset = ((offset + align - 1) / align) * align;
+
+    std::vector<char> preamble(offset, 0);
+    std::memcpy(preamble.data(), detail::model_container_magic, 8);
+    detail::put_le<std::uint32_t>(&preamble[8],
+        detail::model_container_version);
+    detail::put_le<std::uint32_t>(&preamble[12], precision);
+    detail::put_le<std::uint64_t>(&preamble[16], header.size());
+    detail::put_le<std::uint64_t>(&preamble[24], height);
+    detail::put_le<std::uint64_t>(&preamble[32], width);
+    detail::put_le<std::uint64_t>(&preamble[40], offset);
+    std::memcpy(&preamble[detail::model_container_preamble_size],
+        header.data(), header.size());
+
+    std::ofstream of(fname, std::ios::binary);
+    if (!of)
+        SKYLARK_THROW_EXCEPTION (
+            base::io_exception()
+                << base::error_msg("Failed to open model file " + fname));
+
+    of.write(preamble.data(), preamble.size());
+
+    // One column at a time keeps the staging buffer small.
+    const size_t esize = detail::coef_element_size(precision);
+    std::vector<char> column(height * esize);
+    for(size_t j = 0; j < width; j++) {
+        detail::encode_coefs(coef + j * ldim, height, precision,
+            column.data());
+        of.write(column.data(), column.size());
+    }
+
+    if (!of)
+        SKYLARK_THROW_EXCEPTION (
+            base::io_exception()
+                << base::error_msg("Failed writing model file " + fname));
+}
+
+/**
+ * An opened binary model container. The JSON header is parsed on open;
+ * the coefficient blob is left in the (mapped) file until requested.
+ */
+struct model_container_t {
+
+    boost::property_tree::ptree header;
+    coef_precision_t precision;
+    size_t height, width;
+
+    explicit model_container_t(const std::string& fname)
+        : _file(new detail::mapped_file_t(fname)) {
+
+        const char *data = _file->data();
+        const size_t size = _file->size();
+
+        if (size < detail::model_container_preamble_size ||
+            std::memcmp(data, detail::model_container_magic, 8) != 0)
+            _invalid(fname, "bad magic");
+
+        if (detail::get_le<std::uint32_t>(data + 8) >
+            detail::model_container_version)
+            _invalid(fname, "unsupported version");
+
+        std::uint32_t p = detail::get_le<std::uint32_t>(data + 12);
+        if (p > COEF_HALF)
+            _invalid(fname, "unknown coefficient precision");
+        precision = static_cast<coef_precision_t>(p);
+
+        size_t header_size = detail::get_le<std::uint64_t>(data + 16);
+        height = detail::get_le<std::uint64_t>(data + 24);
+        width = detail::get_le<std::uint64_t>(data + 32);
+        _offset = detail::get_le<std::uint64_t>(data + 40);
+
+        if (detail::model_container_preamble_size + header_size > _offset ||
+            _offset + height * width * detail::coef_element_size(precision)
+            > size)
+            _invalid(fname, "truncated file");
+
+        std::istringstream sheader(std::string(
+                data + detail::model_container_preamble_size, header_size));
+        boost::property_tree::read_json(sheader, header);
+    }
+
+    /**
+     * @return pointer to the coefficients stored as native doubles if they
+     *         can be used in place (double precision, little-endian host),
+     *         nullptr otherwise. Valid while the container (or a copy of
+     *         file()) is alive.
+     */
+    double *in_place_coefs() {
+        if (precision != COEF_DOUBLE || !detail::host_is_little_endian())
+            return nullptr;
+        return reinterpret_cast<double *>(_file->data() + _offset);
+    }
+
+    /**
+     * Decodes the coefficients into a column-major buffer.
+     */
+    void read_coefs(double *dst, size_t ldim) const {
+        const size_t esize = detail::coef_element_size(precision);
+        for(size_t j = 0; j < width; j++)
+            detail::decode_coefs(_file->data() + _offset + j * height * esize,
+                height, precision, dst + j * ldim);
+    }
+
+    std::shared_ptr<detail::mapped_file_t> file() const { return _file; }
+
+private:
+    std::shared_ptr<detail::mapped_file_t> _file;
+    size_t _offset;
+
+    static void _invalid(const std::string& fname, const std::string& what) {
+        SKYLARK_THROW_EXCEPTION (
+            base::io_exception()
+                << base::error_msg("Invalid binary model file " + fname +
+                    ": " + what));
+    }
+};
+
+} } // namespace skylark::ml
+
+#endif // SKYLARK_ML_MODEL_CONTAINER_HPP
@@ -81,11 +81,15 @@ struct hilbert_options_t {
     bool usefast;
     SequenceType seqtype;
     bool cachetransforms;
+    bool singlefeatures;
 
     /* parallelization options */
     int numfeaturepartitions;
     int numthreads;
+    int featuregroups;
     int nummpiprocesses;
+    bool pipelined;
+    bool allreduceconsensus;
 
     int fileformat;
 
@@ -97,6 +101,10 @@ struct hilbert_options_t {
     std::string outputfile;
     std::string str = "";
 
+    /** Save the model as a binary container, and coefficient precision */
+    bool binarymodel;
+    int modelprecision;
+
     /** A parameter indicating if we need to continue or not */
     bool exit_on_return;
 
@@ -156,6 +164,10 @@ struct hilbert_options_t {
             ("numthreads,t",
                 po::value<int>(&numthreads)->default_value(DEFAULT_THREADS),
                 "Number of Threads (default: 1)")
+            ("featuregroups",
+                po::value<int>(&featuregroups)->default_value(1),
+                "Split the feature partitions among groups of this many "
+                "ranks, which share their examples (default: 1)")
             ("regression", "Build a regression model"
                 "(default is classification).")
             ("usefast", "Use 'fast' feature mapping, if available. "
@@ -167,6 +179,18 @@ struct hilbert_options_t {
             ("cachetransforms",
                 "Cache feature expanded data "
                 "(faster, but more memory demanding).")
+            ("singlefeatures",
+                "Keep (and cache) the random features in single precision, "
+                "and compute the products with them in single precision. "
+                "The feature maps are still applied in double precision: "
+                "this saves memory (with --cachetransforms) and product "
+                "time, not transform time.")
+            ("pipelined",
+                "Overlap the ADMM collectives with local work "
+                "(non-blocking MPI-3 collectives).")
+            ("allreduceconsensus",
+                "Form the ADMM consensus with an allreduce on every rank, "
+                "instead of a reduce to and broadcast from rank 0.")
             ("decisionvals",
                 "In predict mode, for classification, output the "
                 "decision values instead of class.")
@@ -191,6 +215,13 @@ struct hilbert_options_t {
             ("outputfile",
                 po::value<std::string>(&outputfile)->default_value(""),
                 "Base name for output file (will attach .txt suffix)")
+            ("binarymodel",
+                "Save the model as a binary container instead of JSON "
+                "(much faster to save and load for large models).")
+            ("modelprecision",
+                po::value<int>(&modelprecision)->default_value(0),
+                "Coefficient precision of binary model "
+                "(0:double, 1:float, 2:half)")
             ; /* end options */
 
         po::positional_options_description positionalOptions;
@@ -216,7 +247,11 @@ struct hilbert_options_t {
             regression = vm.count("regression");
             usefast = vm.count("usefast");
             cachetransforms = vm.count("cachetransforms");
+            singlefeatures = vm.count("singlefeatures");
+            pipelined = vm.count("pipelined");
+            allreduceconsensus = vm.count("allreduceconsensus");
             decisionvals = vm.count("decisionvals");
+            binarymodel = vm.count("binarymodel");
         }
         catch(po::error& e) {
             std::cerr << e.what() << std::endl;
@@ -243,12 +278,18 @@ struct hilbert_options_t {
         randomfeatures = 0;
         numfeaturepartitions = DEFAULT_FEATURE_PARTITIONS;
         numthreads = DEFAULT_THREADS;
+        featuregroups = 1;
+        singlefeatures = false;
+        pipelined = false;
+        allreduceconsensus = false;
         usefast = false;
         seqtype = MONTECARLO;
         fileformat = DEFAULT_FILEFORMAT;
         MAXITER = DEFAULT_MAXITER;
         valfile = "";
         testfile = "";
+        binarymodel = false;
+        modelprecision = 0;
 
         for (int i = 1; i < argc; i += 2) {
             std::string flag = argv[i];
@@ -283,6 +324,8 @@ struct hilbert_options_t {
                 numfeaturepartitions = boost::lexical_cast<int>(value);
             if (flag == "--numthreads" || flag == "-t")
                 numthreads = boost::lexical_cast<int>(value);
+            if (flag == "--featuregroups")
+                featuregroups = boost::lexical_cast<int>(value);
             if (flag == "--regression") {
                 regression = true;
                 i--;
@@ -295,10 +338,28 @@ struct hilbert_options_t {
                 cachetransforms = true;
                 i--;
             }
+            if (flag == "--singlefeatures") {
+                singlefeatures = true;
+                i--;
+            }
+            if (flag == "--pipelined") {
+                pipelined = true;
+                i--;
+            }
+            if (flag == "--allreduceconsensus") {
+                allreduceconsensus = true;
+                i--;
+            }
             if (flag == "--decisionvals") {
                 decisionvals = true;
                 i--;
             }
+            if (flag == "--binarymodel") {
+                binarymodel = true;
+                i--;
+            }
+            if (flag == "--modelprecision")
+                modelprecision = boost::lexical_cast<int>(value);
             if (flag == "--useqausi" || flag == "-q")
                 seqtype =
                     static_cast<SequenceType>(boost::lexical_cast<int>(value));
@@ -340,6 +401,11 @@ struct hilbert_options_t {
                      << (regression ? "True" : "False")  << std::endl;
         optionstring << "# Training File = " << trainfile << std::endl;
         optionstring << "# Model File = " << modelfile << std::endl;
+        optionstring << "# Binary Model? = "
+                     << (binarymodel ? "True" : "False") << std::endl;
+        if (binarymodel)
+            optionstring << "# Model Precision = " << modelprecision
+                         << std::endl;
         optionstring << "# Validation File = " << valfile << std::endl;
         optionstring << "# Test File = " << testfile << std::endl;
         optionstring << "# File Format = " << fileformat << std::endl;
@@ -364,6 +430,8 @@ struct hilbert_options_t {
         optionstring << "# Random Features = " << randomfeatures << std::endl;
         optionstring << "# Cache transforms? = "
                      << (cachetransforms ? "True" : "False") << std::endl;
+        optionstring << "# Single precision features? = "
+                     << (singlefeatures ? "True" : "False") << std::endl;
         optionstring << "# Use fast, if availble? = "
                      << (usefast ? "True" : "False")  << std::endl;
         optionstring << "# Sequence = " << seqtype
@@ -371,6 +439,11 @@ struct hilbert_options_t {
         optionstring << "# Number of feature partitions = "
                      << numfeaturepartitions << std::endl;
         optionstring << "# Threads = " << numthreads << std::endl;
+        optionstring << "# Feature groups = " << featuregroups << std::endl;
+        optionstring << "# Pipelined collectives? = "
+                     << (pipelined ? "True" : "False") << std::endl;
+        optionstring << "# Allreduce consensus? = "
+                     << (allreduceconsensus ? "True" : "False") << std::endl;
         optionstring <<"# Number of MPI Processes = "
                      << nummpiprocesses << std::endl;
 
@@ -0,0 +1,91 @@
+#ifndef SKYLARK_PARTIAL_SUMS_HPP
+#define SKYLARK_PARTIAL_SUMS_HPP
+
+#include <vector>
+
+#include <El.hpp>
+
+#ifdef SKYLARK_HAVE_OPENMP
+#include <omp.h>
+#endif
+
+namespace skylark { namespace ml { namespace detail {
+
+/**
+ * Accumulates contributions of the threads of a parallel loop into a local
+ * matrix S without a critical section: every thread adds into a private
+ * buffer (zeroed by the thread itself on first use), and reduce() then adds
+ * the buffers into S in parallel, each thread owning a range of columns.
+ *
+ * With a single thread, local() is S itself and reduce() does nothing.
+ */
+template<typename T>
+class thread_partial_sums_t {
+
+public:
+
+    thread_partial_sums_t(El::Matrix<T> &S, int num_threads) :
+        _S(S), _partials(num_threads > 1 ? num_threads : 0),
+        _used(_partials.size(), 0) {
+
+    }
+
+    /** Buffer of the calling thread. */
+    El::Matrix<T> &local() {
+        if (_partials.empty())
+            return _S;
+
+        int t = 0;
+#       ifdef SKYLARK_HAVE_OPENMP
+        t = omp_get_thread_num();
+#       endif
+
+        if (!_used[t]) {
+            El::Zeros(_partials[t], _S.Height(), _S.Width());
+            _used[t] = 1;
+        }
+        return _partials[t];
+    }
+
+    /** S += sum of the thread buffers. Call outside the parallel loop. */
+    void reduce() {
+        std::vector<const El::Matrix<T> *> used;
+        for(size_t t = 0; t < _partials.size(); t++)
+            if (_used[t])
+                used.push_back(&_partials[t]);
+        if (used.empty())
+            return;
+
+        const El::Int m = _S.Height(), n = _S.Width(), ld = _S.LDim();
+        const int np = used.size();
+        T *s = _S.Buffer();
+
+#       ifdef SKYLARK_HAVE_OPENMP
+#       pragma omp parallel for num_threads(_partials.size())
+#       endif
+        for(El::Int j = 0; j < n; j++) {
+            T *sj = s + j * ld;
+            for(int p = 0; p < np; p++) {
+                const T *pj = used[p]->LockedBuffer() + j * used[p]->LDim();
+                for(El::Int i = 0; i < m; i++)
+                    sj[i] += pj[i];
+            }
+        }
+
+        for(size_t t = 0; t < _partials.size(); t++)
+            _used[t] = 0;
+    }
+
+private:
+
+    El::Matrix<T> &_S;
+    std::vector<El::Matrix<T> > _partials;
+    std::vector<char> _used;
+
+    thread_partial_sums_t(const thread_partial_sums_t&);
+    void operator=(const thread_partial_sums_t&);
+};
+
+} } } // namespace skylark::ml::detail
+
+#endif // SKYLARK_PARTIAL_SUMS_HPP
@@ -0,0 +1,312 @@
+#ifndef SKYLARK_PREDICTION_SERVER_HPP
+#define SKYLARK_PREDICTION_SERVER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <El.hpp>
+
+#ifdef SKYLARK_HAVE_OPENMP
+#include <omp.h>
+#endif
+
+namespace skylark { namespace ml {
+
+/**
+ * Scores batches of points (columns of a local matrix) with a
+ * hilbert_model_t, keeping ready between calls everything that does not
+ * depend on the points: the feature maps keep their realized matrices (see
+ * sketch_transform_data_t::keep_realized) as long as they fit in a memory
+ * budget, and all buffers are allocated once, for the largest batch. Not
+ * thread safe; the model is referenced.
+ */
+struct hilbert_scorer_t {
+
+    typedef El::Matrix<double> matrix_type;
+
+    /**
+     * @param model model to score with.
+     * @param max_batch largest number of points scored in a call.
+     * @param num_threads threads used to apply the feature maps.
+     * @param realize_mb memory budget, in MB, for realized matrices of the
+     *        feature maps (S x N doubles each). The leading maps that fit
+     *        are kept realized, the others are realized on every call. The
+     *        realized matrices belong to the maps of the model, and outlive
+     *        the scorer.
+     */
+    hilbert_scorer_t(const hilbert_model_t &model, El::Int max_batch,
+        int num_threads = 1, double realize_mb = 256) :
+        _model(model), _maps(model.get_maps()),
+        _max_batch(std::max(max_batch, El::Int(1))),
+        _num_threads(num_threads), _num_realized(0), _Z(_maps.size()) {
+
+        const double budget = realize_mb * 1024.0 * 1024.0;
+        double used = 0;
+        for(size_t j = 0; j < _maps.size(); j++) {
+            double bytes = double(_maps[j]->get_S()) * _maps[j]->get_N() *
+                sizeof(double);
+            if (_num_realized == int(j) && used + bytes <= budget) {
+                _maps[j]->get_data()->keep_realized();
+                used += bytes;
+                _num_realized++;
+            }
+            _Z[j].Resize(_maps[j]->get_S(), _max_batch);
+        }
+        _DV.Resize(_max_batch, model.get_output_size());
+
+        // First application, so that the first request is not slower.
+        matrix_type X;
+        El::Zeros(X, input_size(), 1);
+        score(X);
+    }
+
+    El::Int max_batch() const { return _max_batch; }
+    int num_realized() const { return _num_realized; }
+    int input_size() const { return _model.get_input_size(); }
+    int output_size() const { return _model.get_output_size(); }
+
+    /**
+     * Decision values of the points in the columns of X (at most max_batch
+     * of them), one row per point. The result is a view of an internal
+     * buffer, and is valid until the next call.
+     */
+    const matrix_type &score(const matrix_type &X) {
+        const matrix_type &coef = _model.get_coef();
+        El::Int n = X.Width();
+        int d = X.Height();
+        int k = coef.Width();
+
+        El::View(_DVn, _DV, 0, 0, n, k);
+
+        if (_maps.empty()) {
+            El::Gemm(El::TRANSPOSE, El::NORMAL, 1.0, X, coef, 0.0, _DVn);
+            return _DVn;
+        }
+
+        const bool scale_maps = _model.get_scale_maps();
+        const int num_maps = _maps.size();
+
+#       ifdef SKYLARK_HAVE_OPENMP
+#       pragma omp parallel for if(_num_threads > 1) num_threads(_num_threads)
+#       endif
+        for(int j = 0; j < num_maps; j++) {
+            int sj = _maps[j]->get_S();
+            matrix_type Zj;
+            El::View(Zj, _Z[j], 0, 0, sj, n);
+            _maps[j]->apply(&X, &Zj, sketch::columnwise_tag());
+
+            if (scale_maps)
+                El::Scale(std::sqrt(double(sj) / d), Zj);
+        }
+
+        El::Int start = 0;
+        for(int j = 0; j < num_maps; j++) {
+            int sj = _maps[j]->get_S();
+            matrix_type Zj, Wj;
+            El::LockedView(Zj, _Z[j], 0, 0, sj, n);
+            El::LockedView(Wj, coef, start, 0, sj, k);
+            El::Gemm(El::TRANSPOSE, El::NORMAL, 1.0, Zj, Wj,
+                j == 0 ? 0.0 : 1.0, _DVn);
+            start += sj;
+        }
+
+        return _DVn;
+    }
+
+private:
+    const hilbert_model_t &_model;
+    const std::vector<const hilbert_model_t::feature_transform_type *>
+        &_maps;
+    const El::Int _max_batch;
+    const int _num_threads;
+    int _num_realized;
+
+    std::vector<matrix_type> _Z;
+    matrix_type _DV, _DVn;
+
+    hilbert_scorer_t(const hilbert_scorer_t&);
+    void operator=(const hilbert_scorer_t&);
+};
+
+/**
+ * Online prediction with a hilbert_model_t. Requests (single points) can
+ * be submitted concurrently from any number of threads; a worker thread
+ * gathers them into micro batches and scores each batch at once with a
+ * hilbert_scorer_t. A batch is scored as soon as it is full, or when its
+ * oldest request has waited max_delay_us microseconds.
+ */
+class prediction_server_t {
+
+public:
+
+    /** A point, as (zero based index, value) pairs. */
+    typedef std::vector<std::pair<El::Int, double> > point_type;
+
+    struct prediction_t {
+        double label;   /**< Label, or decision value for regression */
+        std::vector<double> decision_values;
+    };
+
+    /**
+     * @param model model to predict with. Referenced, not copied.
+     * @param max_batch maximum number of requests scored together.
+     * @param max_delay_us maximum wait for a batch to fill, in microseconds.
+     * @param num_threads threads used by the scorer.
+     * @param realize_mb memory budget of the scorer for realized feature
+     *        maps, in MB.
+     */
+    prediction_server_t(const hilbert_model_t &model, El::Int max_batch = 64,
+        int max_delay_us = 200, int num_threads = 1, double realize_mb = 256) :
+        _model(model), _scorer(model, max_batch, num_threads, realize_mb),
+        _max_delay(max_delay_us), _stop(false),
+        _num_batches(0), _num_requests(0) {
+
+        _worker = std::thread(&prediction_server_t::run, this);
+    }
+
+    /** Scores whatever is still queued, then stops the worker. */
+    ~prediction_server_t() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cv.notify_all();
+        _worker.join();
+    }
+
+    /**
+     * Queues a point for prediction. Entries with an index beyond the
+     * input size of the model are ignored.
+     */
+    std::future<prediction_t> submit(point_type point) {
+        request_t request;
+        request.point = std::move(point);
+        request.arrival = clock_type::now();
+        std::future<prediction_t> result = request.result.get_future();
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _queue.push_back(std::move(request));
+        }
+        _cv.notify_one();
+        return result;
+    }
+
+    /** Blocking prediction of a single point. */
+    prediction_t predict(point_type point) {
+        return submit(std::move(point)).get();
+    }
+
+    El::Int num_batches() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _num_batches;
+    }
+
+    El::Int num_requests() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _num_requests;
+    }
+
+private:
+
+    typedef std::chrono::steady_clock clock_type;
+
+    struct request_t {
+        point_type point;
+        std::promise<prediction_t> result;
+        clock_type::time_point arrival;
+    };
+
+    const hilbert_model_t &_model;
+    hilbert_scorer_t _scorer;
+    const std::chrono::microseconds _max_delay;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<request_t> _queue;
+    bool _stop;
+    El::Int _num_batches, _num_requests;
+    std::thread _worker;
+
+    void run() {
+        const El::Int max_batch = _scorer.max_batch();
+        const El::Int d = _scorer.input_size();
+        const int k = _scorer.output_size();
+
+        El::Matrix<double> X, Xb, labels;
+        El::Zeros(X, d, max_batch);
+        std::vector<request_t> batch;
+        batch.reserve(max_batch);
+
+        while(true) {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cv.wait(lock, [this] { return _stop || !_queue.empty(); });
+                if (_queue.empty())
+                    return;
+
+                clock_type::time_point deadline =
+                    _queue.front().arrival + _max_delay;
+                while (!_stop && (El::Int)_queue.size() < max_batch)
+                    if (_cv.wait_until(lock, deadline) ==
+                        std::cv_status::timeout)
+                        break;
+
+                while (!_queue.empty() && (El::Int)batch.size() < max_batch) {
+                    batch.push_back(std::move(_queue.front()));
+                    _queue.pop_front();
+                }
+                _num_batches++;
+                _num_requests += batch.size();
+            }
+
+            El::Int n = batch.size(), done = 0;
+            try {
+                El::View(Xb, X, 0, 0, d, n);
+                El::Zero(Xb);
+                for(El::Int i = 0; i < n; i++)
+                    for(size_t e = 0; e < batch[i].point.size(); e++) {
+                        El::Int idx = batch[i].point[e].first;
+                        if (idx >= 0 && idx < d)
+                            Xb.Set(idx, i, batch[i].point[e].second);
+                    }
+
+                const El::Matrix<double> &DV = _scorer.score(Xb);
+                if (!_model.is_regression())
+                    hilbert_model_t::decisions_to_labels(DV, labels);
+
+                for(El::Int i = 0; i < n; i++) {
+                    prediction_t p;
+                    p.label = _model.is_regression() ?
+                        DV.Get(i, 0) : labels.Get(i, 0);
+                    p.decision_values.resize(k);
+                    for(int j = 0; j < k; j++)
+                        p.decision_values[j] = DV.Get(i, j);
+                    batch[i].result.set_value(std::move(p));
+                    done++;
+                }
+            } catch(...) {
+                for(El::Int i = done; i < n; i++)
+                    batch[i].result.set_exception(std::current_exception());
+            }
+
+            batch.clear();
+        }
+    }
+
+    prediction_server_t(const prediction_server_t&);
+    void operator=(const prediction_server_t&);
+};
+
+} } // namespace skylark::ml
+
+#endif // SKYLARK_PREDICTION_SERVER_HPP
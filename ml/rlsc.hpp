@@ -21,6 +21,15 @@ struct rlsc_params_t : public base::params_t {
     // For memory limited methods (SketchedApproximateRLSC, LargeScaleRLSC)
     El::Int max_split;
 
+    // For exact methods (KernelRLSC, FasterKernelRLSC): see krr_params_t.
+    bool matrix_free;
+    El::Int gram_panel_width;
+    double gram_cache_mb;
+
+    // For LargeScaleRLSC: see krr_params_t.
+    double z_cache_mb;
+    int z_cache_precision;
+
     rlsc_params_t(bool am_i_printing = 0,
         int log_level = 0,
         std::ostream &log_stream = std::cout,
@@ -37,6 +46,13 @@ struct rlsc_params_t : public base::params_t {
         tolerance = 1e-3;
         res_print = 10;
         iter_lim = 1000;
+
+        matrix_free = false;
+        gram_panel_width = 0;
+        gram_cache_mb = 0.0;
+
+        z_cache_mb = 0.0;
+        z_cache_precision = FEATURE_CACHE_BFLOAT16;
   }
 
 };
@@ -81,6 +97,9 @@ void KernelRLSC(base::direction_t direction, const KernelType &k,
     krr_params.iter_lim = params.iter_lim;
     krr_params.res_print = params.res_print;
     krr_params.tolerance = params.tolerance;
+    krr_params.matrix_free = params.matrix_free;
+    krr_params.gram_panel_width = params.gram_panel_width;
+    krr_params.gram_cache_mb = params.gram_cache_mb;
 
     KernelRidge(base::COLUMNS, k, X, Y, T(lambda), A, krr_params);
 
@@ -240,6 +259,9 @@ void FasterKernelRLSC(base::direction_t direction, const KernelType &k,
     krr_params.iter_lim = params.iter_lim;
     krr_params.res_print = params.res_print;
     krr_params.tolerance = params.tolerance;
+    krr_params.matrix_free = params.matrix_free;
+    krr_params.gram_panel_width = params.gram_panel_width;
+    krr_params.gram_cache_mb = params.gram_cache_mb;
 
     FasterKernelRidge(direction, k, X, Y,
         T(lambda), A, s, context, krr_params);
@@ -296,6 +318,8 @@ void LargeScaleKernelRLSC(base::direction_t direction, const KernelType &k,
     krr_params.res_print = params.res_print;
     krr_params.tolerance = params.tolerance;
     krr_params.max_split = params.max_split;
+    krr_params.z_cache_mb = params.z_cache_mb;
+    krr_params.z_cache_precision = params.z_cache_precision;
 
     LargeScaleKernelRidge(direction, k, X, Y,
         T(lambda), scale_maps, transforms, W, s, context, krr_params);
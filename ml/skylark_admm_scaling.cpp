@@ -0,0 +1,165 @@
+#include <El.hpp>
+#include <skylark.hpp>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/program_options.hpp>
+#include <boost/format.hpp>
+#include "hilbert.hpp"
+
+/**
+ * Scaling benchmark of BlockADMM on random data (Gaussian random features,
+ * squared loss, L2 regularization), for several numbers of feature groups
+ * (see BlockADMMSolver::set_feature_groups).
+ *
+ * For strong scaling, run with increasing numbers of ranks and a fixed
+ * --examples (the total); for weak scaling add --weak, which makes
+ * --examples the number of examples per rank. Each line reports the time
+ * per iteration and the largest per-rank size of the factorization cache
+ * (and of the transform cache, with --cachetransforms).
+ */
+
+namespace bpo = boost::program_options;
+
+int main(int argc, char* argv[]) {
+
+    El::Initialize(argc, argv);
+
+    boost::mpi::communicator comm;
+    int rank = comm.rank();
+    int size = comm.size();
+
+    int examples, dimensions, features, partitions, iterations, threads, seed;
+    std::string groupslist;
+    bool weak, cachetransforms;
+
+    bpo::options_description desc("Options");
+    desc.add_options()
+        ("help,h", "produce a help message")
+        ("examples,n", bpo::value<int>(&examples)->default_value(20000),
+            "Number of examples (per rank with --weak).")
+        ("dimensions,d", bpo::value<int>(&dimensions)->default_value(100),
+            "Number of input dimensions.")
+        ("features,f", bpo::value<int>(&features)->default_value(16384),
+            "Number of random features.")
+        ("partitions,p", bpo::value<int>(&partitions)->default_value(16),
+            "Number of feature partitions.")
+        ("iterations,i", bpo::value<int>(&iterations)->default_value(5),
+            "ADMM iterations.")
+        ("numthreads,t", bpo::value<int>(&threads)->default_value(1),
+            "Threads per rank.")
+        ("groups,g", bpo::value<std::string>(&groupslist)->default_value("1"),
+            "Comma separated numbers of feature groups to run.")
+        ("weak", "Weak scaling: --examples is per rank.")
+        ("cachetransforms", "Cache the feature expanded data.")
+        ("seed,s", bpo::value<int>(&seed)->default_value(38734),
+            "Seed.");
+
+    bpo::variables_map vm;
+    try {
+        bpo::store(bpo::parse_command_line(argc, argv, desc), vm);
+
+        if (vm.count("help")) {
+            if (rank == 0)
+                std::cout << desc;
+            El::Finalize();
+            return 0;
+        }
+
+        bpo::notify(vm);
+        weak = vm.count("weak");
+        cachetransforms = vm.count("cachetransforms");
+    } catch(bpo::error& e) {
+        if (rank == 0)
+            std::cerr << e.what() << std::endl << desc << std::endl;
+        El::Finalize();
+        return -1;
+    }
+
+    std::vector<int> groups;
+    std::istringstream groupstream(groupslist);
+    std::string token;
+    while (std::getline(groupstream, token, ','))
+        groups.push_back(std::atoi(token.c_str()));
+
+    SKYLARK_BEGIN_TRY()
+
+        // Examples of this rank.
+        int ni = weak ? examples :
+            examples / size + (rank < examples % size ? 1 : 0);
+
+        skylark::base::context_t datacontext(seed + rank);
+        El::Matrix<double> X, Y, Xv, Yv;
+        skylark::base::GaussianMatrix(X, dimensions, ni, datacontext);
+        El::Zeros(Y, ni, 1);
+        for(int i = 0; i < ni; i++)
+            Y.Set(i, 0, X.Get(0, i) * X.Get(1, i) > 0 ? 1.0 : 0.0);
+
+        skylark::algorithms::squared_loss_t<double> loss;
+        skylark::algorithms::l2_regularizer_t<double> regularizer;
+
+        if (rank == 0)
+            std::cout << "# ranks = " << size
+                      << (weak ? ", examples per rank = " : ", examples = ")
+                      << examples << ", features = " << features
+                      << ", partitions = " << partitions << std::endl;
+
+        for(size_t g = 0; g < groups.size(); g++) {
+            if (groups[g] < 1 || size % groups[g] != 0) {
+                if (rank == 0)
+                    std::cout << "Skipping " << groups[g]
+                              << " feature groups (does not divide "
+                              << size << " ranks)" << std::endl;
+                continue;
+            }
+
+            skylark::base::context_t context(seed);
+            BlockADMMSolver<El::Matrix<double> > Solver(context, &loss,
+                &regularizer, 1.0, features,
+                skylark::ml::gaussian_t(dimensions, 10.0),
+                skylark::ml::regular_feature_transform_tag(), partitions);
+            Solver.set_maxiter(iterations);
+            Solver.set_nthreads(threads);
+            Solver.set_cache_transform(cachetransforms);
+            Solver.set_feature_groups(groups[g]);
+
+            // Cache of this rank: the partitions it takes in its group.
+            int groupsize = weak ? ni * groups[g] : 0;
+            if (!weak)
+                for(int r = rank - rank % groups[g];
+                    r < rank - rank % groups[g] + groups[g]; r++)
+                    groupsize += examples / size +
+                        (r < examples % size ? 1 : 0);
+            double cachemb = 0.0;
+            for(int j = rank % groups[g]; j < partitions; j += groups[g]) {
+                double sj = double(features / partitions +
+                    (j >= partitions - features % partitions ? 1 : 0));
+                cachemb += sj * sj + (cachetransforms ? sj * groupsize : 0);
+            }
+            cachemb *= sizeof(double) / (1024.0 * 1024.0);
+            double maxcachemb;
+            boost::mpi::reduce(comm, cachemb, maxcachemb,
+                boost::mpi::maximum<double>(), 0);
+
+            comm.barrier();
+            boost::mpi::timer timer;
+            skylark::ml::hilbert_model_t *model =
+                Solver.train(X, Y, Xv, Yv, true, comm);
+            comm.barrier();
+            double elapsed = timer.elapsed();
+            delete model;
+
+            if (rank == 0)
+                std::cout << boost::format("groups %3d  time/iteration "
+                    "%9.4f s  cache per rank %10.1f MB")
+                    % groups[g] % (elapsed / iterations) % maxcachemb
+                          << std::endl;
+        }
+
+    SKYLARK_END_TRY() SKYLARK_CATCH_AND_PRINT((rank == 0))
+
+    El::Finalize();
+    return 0;
+}
@@ -102,7 +102,8 @@ int main(int argc, char* argv[]) {
                     accuracy = std::sqrt(err / nrm);
 
             if (!options.outputfile.empty())
-                El::Write(DecisionValues, options.outputfile, El::ASCII);
+                skylark::utility::io::WriteText(options.outputfile + ".txt",
+                    DecisionValues);
 
         } else {
             El::Int correct = skylark::ml::classification_accuracy(Y,
@@ -116,9 +117,11 @@ int main(int argc, char* argv[]) {
 
             if (!options.outputfile.empty()) {
                 if (options.decisionvals)
-                    El::Write(DecisionValues, options.outputfile, El::ASCII);
+                    skylark::utility::io::WriteText(
+                        options.outputfile + ".txt", DecisionValues);
                 else
-                    El::Write(PredictedLabels, options.outputfile, El::ASCII);
+                    skylark::utility::io::WriteText(
+                        options.outputfile + ".txt", PredictedLabels);
             }
         }
 
@@ -0,0 +1,375 @@
+#include <El.hpp>
+#include <skylark.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <boost/program_options.hpp>
+#include <boost/format.hpp>
+#include <boost/random.hpp>
+
+/**
+ * Online prediction with a model trained by skylark_ml.
+ *
+ * Requests are points in LIBSVM format (index:value pairs; a leading label
+ * is ignored), one per line. Each gets a line back with the label (or the
+ * value, for regression), or all decision values with --decisionvals.
+ * Requests are read from stdin (until an empty line) or, with --socket,
+ * from any number of connections to a Unix socket. Concurrent requests are
+ * scored together, in micro batches.
+ *
+ * With --benchmark, the server is instead fed random points by --clients
+ * threads, and the latency distribution is reported.
+ */
+
+namespace bpo = boost::program_options;
+namespace skyml = skylark::ml;
+
+typedef skyml::prediction_server_t server_t;
+
+server_t::point_type parse_point(const std::string &line) {
+    server_t::point_type point;
+    std::istringstream tokenstream(line);
+    std::string token;
+    while (tokenstream >> token) {
+        size_t delim = token.find(':');
+        if (delim == std::string::npos)
+            continue;
+        point.push_back(std::make_pair(
+                El::Int(atol(token.substr(0, delim).c_str()) - 1),
+                atof(token.substr(delim + 1).c_str())));
+    }
+    return point;
+}
+
+std::string format_prediction(const server_t::prediction_t &p,
+    bool decisionvals) {
+    std::ostringstream os;
+    if (decisionvals)
+        for(size_t j = 0; j < p.decision_values.size(); j++)
+            os << (j > 0 ? " " : "") << p.decision_values[j];
+    else
+        os << p.label;
+    os << "\n";
+    return os.str();
+}
+
+/**
+ * Serves the requests of a stream. Requests are submitted as soon as they
+ * are read, so that a client can pipeline them; the answers are written,
+ * in order, by a second thread.
+ */
+template<typename WriteFunction>
+void serve_stream(server_t &server, FILE *in, bool decisionvals,
+    WriteFunction write) {
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::future<server_t::prediction_t> > pending;
+    bool done = false;
+
+    std::thread writer([&] {
+        while(true) {
+            std::future<server_t::prediction_t> result;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] { return done || !pending.empty(); });
+                if (pending.empty())
+                    return;
+                result = std::move(pending.front());
+                pending.pop_front();
+            }
+
+            std::string answer;
+            try {
+                answer = format_prediction(result.get(), decisionvals);
+            } catch(const std::exception &e) {
+                answer = std::string("error ") + e.what() + "\n";
+            }
+            if (!write(answer))
+                return;
+        }
+    });
+
+    char *buffer = nullptr;
+    size_t size = 0;
+    ssize_t len;
+    while ((len = getline(&buffer, &size, in)) > 0) {
+        std::string line(buffer, len);
+        if (line.find_first_not_of(" \t\r\n") == std::string::npos)
+            break;
+
+        std::future<server_t::prediction_t> result =
+            server.submit(parse_point(line));
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.push_back(std::move(result));
+        }
+        cv.notify_one();
+    }
+    free(buffer);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    cv.notify_one();
+    writer.join();
+}
+
+int serve_socket(server_t &server, const std::string &path,
+    bool decisionvals) {
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        std::perror("socket");
+        return -1;
+    }
+
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path too long: " << path << std::endl;
+        return -1;
+    }
+    std::strcpy(address.sun_path, path.c_str());
+    unlink(path.c_str());
+
+    if (bind(listener, (sockaddr *) &address, sizeof(address)) < 0 ||
+        listen(listener, 128) < 0) {
+        std::perror(path.c_str());
+        return -1;
+    }
+
+    std::cout << "Listening on " << path << std::endl;
+
+    while (true) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0)
+            continue;
+
+        std::thread([&server, fd, decisionvals] {
+            FILE *in = fdopen(fd, "r");
+            serve_stream(server, in, decisionvals,
+                [fd](const std::string &answer) {
+                    const char *data = answer.data();
+                    size_t left = answer.size();
+                    while (left > 0) {
+                        ssize_t written = write(fd, data, left);
+                        if (written <= 0)
+                            return false;
+                        data += written;
+                        left -= written;
+                    }
+                    return true;
+                });
+            fclose(in);
+        }).detach();
+    }
+
+    return 0;
+}
+
+double percentile(const std::vector<double> &sorted, double q) {
+    if (sorted.empty())
+        return 0.0;
+    size_t i = std::min(sorted.size() - 1, size_t(q * sorted.size()));
+    return sorted[i];
+}
+
+void print_latencies(const std::string &title, std::vector<double> &latencies,
+    double elapsed) {
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << title << ": " << latencies.size() << " requests, "
+              << boost::format("%.1f") % (latencies.size() / elapsed)
+              << " req/s, latency (us) p50 "
+              << boost::format("%.1f") % percentile(latencies, 0.50)
+              << " p90 " << boost::format("%.1f") % percentile(latencies, 0.90)
+              << " p99 " << boost::format("%.1f") % percentile(latencies, 0.99)
+              << " max " << boost::format("%.1f") % latencies.back()
+              << std::endl;
+}
+
+void benchmark(const skyml::hilbert_model_t &model, server_t &server,
+    int num_requests, int num_clients, int seed) {
+
+    typedef std::chrono::steady_clock clock_type;
+
+    int d = model.get_input_size();
+    std::vector<server_t::point_type> points(std::min(num_requests, 1024));
+    boost::random::mt19937 gen(seed);
+    boost::random::uniform_real_distribution<double> dist(0.0, 1.0);
+    for(size_t i = 0; i < points.size(); i++)
+        for(int j = 0; j < d; j++)
+            points[i].push_back(std::make_pair(El::Int(j), dist(gen)));
+
+    // Reference: one call of hilbert_model_t::predict per request.
+    {
+        int n = std::min(num_requests, 200);
+        std::vector<double> latencies(n);
+        El::Matrix<double> X, DV;
+        El::Matrix<El::Int> PV;
+        clock_type::time_point start = clock_type::now();
+        for(int i = 0; i < n; i++) {
+            clock_type::time_point t0 = clock_type::now();
+            El::Zeros(X, d, 1);
+            const server_t::point_type &point = points[i % points.size()];
+            for(size_t e = 0; e < point.size(); e++)
+                X.Set(point[e].first, 0, point[e].second);
+            model.predict(X, PV, DV);
+            latencies[i] = std::chrono::duration<double, std::micro>(
+                clock_type::now() - t0).count();
+        }
+        double elapsed = std::chrono::duration<double>(
+            clock_type::now() - start).count();
+        print_latencies("predict, one point per call", latencies, elapsed);
+    }
+
+    // Server, with closed loop clients.
+    std::vector<std::vector<double> > latencies(num_clients);
+    std::vector<std::thread> clients;
+    El::Int batches = server.num_batches(), requests = server.num_requests();
+    clock_type::time_point start = clock_type::now();
+    for(int c = 0; c < num_clients; c++)
+        clients.push_back(std::thread([&, c] {
+            for(int i = c; i < num_requests; i += num_clients) {
+                clock_type::time_point t0 = clock_type::now();
+                server.predict(points[i % points.size()]);
+                latencies[c].push_back(std::chrono::duration<double,
+                    std::micro>(clock_type::now() - t0).count());
+            }
+        }));
+    for(int c = 0; c < num_clients; c++)
+        clients[c].join();
+    double elapsed = std::chrono::duration<double>(
+        clock_type::now() - start).count();
+
+    std::vector<double> all;
+    for(int c = 0; c < num_clients; c++)
+        all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+    std::ostringstream title;
+    title << "server, " << num_clients << " clients";
+    print_latencies(title.str(), all, elapsed);
+
+    batches = server.num_batches() - batches;
+    requests = server.num_requests() - requests;
+    std::cout << "Average batch size "
+              << boost::format("%.2f") % (double(requests) / batches)
+              << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+
+    El::Initialize(argc, argv);
+
+    std::string modelfile, socketpath;
+    int maxbatch, maxdelay, numthreads, numrequests, numclients, seed;
+    double realizemb;
+    bool decisionvals;
+
+    bpo::options_description desc("Options");
+    desc.add_options()
+        ("help,h", "produce a help message")
+        ("modelfile,m",
+            bpo::value<std::string>(&modelfile),
+            "Model file (saved by skylark_ml).")
+        ("socket",
+            bpo::value<std::string>(&socketpath)->default_value(""),
+            "Serve on this Unix socket, instead of stdin. OPTIONAL.")
+        ("maxbatch",
+            bpo::value<int>(&maxbatch)->default_value(64),
+            "Maximum number of requests scored together. OPTIONAL.")
+        ("maxdelay",
+            bpo::value<int>(&maxdelay)->default_value(200),
+            "Maximum wait for a batch to fill, in microseconds. OPTIONAL.")
+        ("numthreads,t",
+            bpo::value<int>(&numthreads)->default_value(1),
+            "Threads used to score a batch. OPTIONAL.")
+        ("realizemb",
+            bpo::value<double>(&realizemb)->default_value(256),
+            "Memory (MB) for keeping the feature maps realized. OPTIONAL.")
+        ("decisionvals", "Answer with the decision values.")
+        ("benchmark",
+            bpo::value<int>(&numrequests)->default_value(0),
+            "Time this many random requests instead of serving. OPTIONAL.")
+        ("clients",
+            bpo::value<int>(&numclients)->default_value(8),
+            "Number of concurrent clients in the benchmark. OPTIONAL.")
+        ("seed,s",
+            bpo::value<int>(&seed)->default_value(38734),
+            "Seed for the benchmark's random points. OPTIONAL.");
+
+    bpo::positional_options_description positional;
+    positional.add("modelfile", 1);
+
+    bpo::variables_map vm;
+    try {
+        bpo::store(bpo::command_line_parser(argc, argv)
+            .options(desc).positional(positional).run(), vm);
+
+        if (vm.count("help")) {
+            std::cout << "Usage: " << argv[0]
+                      << " [options] model-file-name" << std::endl;
+            std::cout << desc;
+            El::Finalize();
+            return 0;
+        }
+
+        if (!vm.count("modelfile")) {
+            std::cout << "Model file is required." << std::endl;
+            El::Finalize();
+            return -1;
+        }
+
+        bpo::notify(vm);
+
+        decisionvals = vm.count("decisionvals");
+
+    } catch(bpo::error& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << desc << std::endl;
+        El::Finalize();
+        return -1;
+    }
+
+    int ret = 0;
+
+    SKYLARK_BEGIN_TRY()
+
+        skyml::hilbert_model_t model(modelfile);
+        server_t server(model, maxbatch, maxdelay, numthreads, realizemb);
+
+        if (numrequests > 0)
+            benchmark(model, server, numrequests, std::max(numclients, 1),
+                seed);
+        else if (!socketpath.empty())
+            ret = serve_socket(server, socketpath, decisionvals);
+        else
+            serve_stream(server, stdin, decisionvals,
+                [](const std::string &answer) {
+                    std::cout << answer << std::flush;
+                    return bool(std::cout);
+                });
+
+    SKYLARK_END_TRY() SKYLARK_CATCH_AND_PRINT(true)
+
+    El::Finalize();
+    return ret;
+}
@@ -201,7 +201,9 @@ void ApproximateLeastSquares(El::Orientation orientation,
  * SIAM Journal on Scientific Computing 32(3), 1217-1236, 2010
  *
  * Note: it is assume that a 4*Width(A)^2 matrix can fit in memory
- * of a single node.
+ * of a single node. For wider [VC/VR,STAR] matrices use the solver directly
+ * with blendenpik_tag<dist_qr_precond_tag> (or lsrn_tag<dist_svd_precond_tag>),
+ * which keeps the sketch and the preconditioner distributed.
  *
  * \param orientation If El::NORMAL will approximate
  *                    argmin_X ||A * X - B||_F
@@ -236,6 +238,47 @@ void FastLeastSquares(El::Orientation orientation, const AT& A, const BT& B,
 }
 
 
+/**
+ * Same as above, but with a preconditioner that outlives the call: if it is
+ * not ready it is built from A (and kept in precond), otherwise it is used
+ * as is, so solving for many right-hand sides, one block at a time, pays for
+ * the sketch and the QR only once. B may have several columns; LSQR handles
+ * them together. Call precond.refresh(A) when A changes. A ready
+ * preconditioner must have been built for a matrix of A's size.
+ *
+ * \param orientation only El::NORMAL is supported.
+ * \param A input matrix
+ * \param B right-hand side
+ * \param X solution matrix
+ * \param precond preconditioner of A (built here if not ready).
+ * \param context Skylark context
+ * \param params parameters for LSQR.
+ */
+template<typename AT, typename BT, typename XT, typename PT,
+         template <typename, typename> class TT>
+void FastLeastSquares(El::Orientation orientation, const AT& A, const BT& B,
+    XT& X, algorithms::sketch_precond_t<XT, PT, TT>& precond,
+    base::context_t& context,
+    algorithms::krylov_iter_params_t params =
+    algorithms::krylov_iter_params_t()) {
+
+    if (orientation != El::NORMAL)
+        SKYLARK_THROW_EXCEPTION (
+          base::sketch_exception()
+              << base::error_msg(
+                 "Only NORMAL orientation is supported for FastLeastSquares"));
+
+    if (!precond.ready())
+        precond.build(A, context);
+    else if (!precond.fits(A))
+        SKYLARK_THROW_EXCEPTION (
+          base::invalid_parameters()
+              << base::error_msg(
+                 "The preconditioner was built for a matrix of another size"));
+
+    algorithms::LSQR(A, B, X, params, precond);
+}
+
 } }
 
 #endif
@@ -5,5 +5,6 @@
 #include "svd.hpp"
 #include "least_squares.hpp"
 #include "CondEst.hpp"
+#include "streaming.hpp"
 
 #endif /* SKYLARK_NLA_HPP */
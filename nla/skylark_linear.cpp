@@ -1,4 +1,5 @@
 #include <iostream>
+#include <fstream>
 #include <boost/program_options.hpp>
 
 #include <El.hpp>
@@ -9,7 +10,7 @@
 #include <skylark.hpp>
 
 int seed, port;
-std::string fname, outfile, hdfs;
+std::string fname, outfile, hdfs, precondfile;
 bool as_sparse, high, use_single, directory;
 
 namespace bpo = boost::program_options;
@@ -71,7 +72,21 @@ void execute(skylark::base::context_t &context) {
     El::Int k = skylark::base::Width(b);
 
     SolType x(n, k);
-    if (high)
+    if (!precondfile.empty()) {
+        typedef skylark::algorithms::sketch_precond_t<SolType, SolType>
+            precond_type;
+
+        std::ifstream exists(precondfile);
+        bool load = exists.good();
+        exists.close();
+
+        precond_type precond;
+        if (load)
+            precond = precond_type(precondfile);
+        skylark::nla::FastLeastSquares(El::NORMAL, A, b, x, precond, context);
+        if (!load)
+            precond.save(precondfile, rank == 0);
+    } else if (high)
         skylark::nla::FastLeastSquares(El::NORMAL, A, b, x, context);
     else
         skylark::nla::ApproximateLeastSquares(El::NORMAL, A, b, x, context);
@@ -122,6 +137,11 @@ int main(int argc, char* argv[]) {
             "For HDFS: port to use.")
         //("sparse", "Whether to load the matrix as a sparse one.")
         ("highprecision,p", "Solve to high precision.")
+        ("precond",
+            bpo::value<std::string>(&precondfile)->default_value(""),
+            "Solve to high precision with the preconditioner in this file, "
+            "or build it and save it there if the file does not exist. "
+            "OPTIONAL.")
         ("single,f", "Whether to use single precision instead of double.")
         ("outputfile",
             bpo::value<std::string>(&outfile)->default_value("out"),
@@ -7,6 +7,8 @@
 #define SKYLARK_NO_ANY
 #include <skylark.hpp>
 
+#include <fstream>
+#include <functional>
 #include <iostream>
 
 namespace bpo = boost::program_options;
@@ -21,7 +23,7 @@ template<typename InputType, typename FactorType, typename UType = FactorType,
 void execute(bool directory, const std::string &fname,
     const std::string &hdfs, int port, const std::vector<int> &profile, int k,
     const skylark::nla::approximate_svd_params_t &params,
-    const std::string &prefix,
+    const std::string &prefix, const std::string &update, bool columns,
     skylark::base::context_t &context) {
 
     boost::mpi::communicator world;
@@ -34,6 +36,30 @@ void execute(bool directory, const std::string &fname,
 
     boost::mpi::timer timer;
 
+    // For an update, A holds only the new rows (or columns).
+    skylark::base::direction_t direction = skylark::base::ROWS;
+    int min_d = 0;
+    if (!update.empty()) {
+        if (rank == 0) {
+            std::cout << "Reading the factorization... ";
+            std::cout.flush();
+            timer.restart();
+        }
+
+        El::Read(U, update + ".U.txt", El::ASCII);
+        El::Read(S, update + ".S.txt", El::ASCII);
+        El::Read(V, update + ".V.txt", El::ASCII);
+        if (columns) {
+            direction = skylark::base::COLUMNS;
+            min_d = U.Height();
+        } else
+            min_d = V.Height();
+
+        if (rank == 0)
+            std::cout <<"took " << boost::format("%.2e") % timer.elapsed()
+                      << " sec\n";
+    }
+
     if (profile.empty()) {
         // Load A and Y (Y is thrown away)
         if (rank == 0) {
@@ -55,7 +81,7 @@ void execute(bool directory, const std::string &fname,
                                              "HDFS directory reading not yet supported."))
                 else
                     skylark::utility::io::ReadLIBSVM(
-                                                     fs, fname, A, Y, skylark::base::ROWS);
+                                                     fs, fname, A, Y, direction);
 
 #       else
 
@@ -66,9 +92,9 @@ void execute(bool directory, const std::string &fname,
         } else {
             if (directory)
                 skylark::utility::io::ReadDirLIBSVM(
-                                                    fname, A, Y, skylark::base::ROWS);
+                                                    fname, A, Y, direction, min_d);
             else
-                skylark::utility::io::ReadLIBSVM(fname, A, Y, skylark::base::ROWS);
+                skylark::utility::io::ReadLIBSVM(fname, A, Y, direction, min_d);
         }
 
         Y.Empty();
@@ -89,12 +115,18 @@ void execute(bool directory, const std::string &fname,
 
     /* Compute approximate SVD */
     if (rank == 0) {
-        std::cout << "Computing approximate SVD...";
+        std::cout << (update.empty() ? "Computing approximate SVD..." :
+            "Updating approximate SVD...");
         std::cout.flush();
         timer.restart();
     }
 
-    skylark::nla::ApproximateSVD(A, U, S, V, k, context, params);
+    if (update.empty())
+        skylark::nla::ApproximateSVD(A, U, S, V, k, context, params);
+    else if (columns)
+        skylark::nla::UpdateSVDColumns(A, U, S, V, context, params);
+    else
+        skylark::nla::UpdateSVDRows(A, U, S, V, context, params);
 
     if (rank == 0)
         std::cout <<"Took " << boost::format("%.2e") % timer.elapsed()
@@ -116,6 +148,45 @@ void execute(bool directory, const std::string &fname,
                   << " sec\n";
 }
 
+/**
+ * Out-of-core approximate SVD (see nla::StreamingSVD): the file is read
+ * blocksize rows at a time, in 2 * (powerits + 1) + 1 passes, and U is
+ * written block by block.
+ */
+template<typename T>
+void execute_streaming(const std::string &fname, int blocksize, int k,
+    const skylark::nla::approximate_svd_params_t &params,
+    const std::string &prefix,
+    skylark::base::context_t &context) {
+
+    El::Matrix<T> S, V;
+    boost::mpi::timer timer;
+
+    std::cout << "Computing approximate SVD (streaming)...";
+    std::cout.flush();
+    timer.restart();
+
+    skylark::utility::io::libsvm_row_block_reader_t<T> reader(fname,
+        blocksize);
+    std::ofstream uout(prefix + ".U.txt");
+    skylark::nla::StreamingSVD(reader, S, V, k, context, params,
+        std::function<void (const El::Matrix<T>&, El::Int)>(
+            [&uout](const El::Matrix<T>& U, El::Int) {
+                for(El::Int i = 0; i < U.Height(); i++) {
+                    for(El::Int j = 0; j < U.Width(); j++)
+                        uout << (j > 0 ? " " : "") << U.Get(i, j);
+                    uout << "\n";
+                }
+            }));
+    uout.close();
+
+    std::cout <<"Took " << boost::format("%.2e") % timer.elapsed()
+              << " sec\n";
+
+    El::Write(S, prefix + ".S", El::ASCII);
+    El::Write(V, prefix + ".V", El::ASCII);
+}
+
 template<typename InputType, typename FactorType, typename UType = FactorType,
          typename YType = FactorType>
 void execute_sym(bool directory, const std::string &fname,
@@ -231,8 +302,10 @@ int main(int argc, char* argv[]) {
     int size = world.size();
 
     int seed, k, powerits, port;
-    std::string fname, ftype, prefix, hdfs;
+    std::string fname, ftype, prefix, hdfs, orthogonalization, update;
     bool as_symmetric, as_sparse, skipqr, use_single, lower, directory;
+    bool timings, columns;
+    int streaming;
     int oversampling_ratio, oversampling_additive;
     std::vector<int> profile;
     
@@ -266,6 +339,13 @@ int main(int argc, char* argv[]) {
             "Number of power iterations. OPTIONAL.")
         ("skipqr", "Whether to skip QR in each iteration. Higher than one power"
             " iterations is not recommended in this mode.")
+        ("orthogonalization",
+            bpo::value<std::string>(&orthogonalization)
+            ->default_value("householder"),
+            "How to orthonormalize in the power iteration: householder, tsqr,"
+            " cholqr2 or lu. OPTIONAL.")
+        ("timings", "Print the time of every power iteration, in the products"
+            " and in the orthogonalization.")
         ("ratio,r",
             bpo::value<int>(&oversampling_ratio)->default_value(2),
             "Ratio of oversampling of rank. OPTIONAL.")
@@ -281,6 +361,18 @@ int main(int argc, char* argv[]) {
             bpo::value<std::vector<int> >()->multitoken(),
             "Generate random matrix and run on it (for profiling)."
             "Requires specification of height and width. OPTIONAL.")
+        ("update",
+            bpo::value<std::string>(&update)->default_value(""),
+            "Prefix of an existing factorization (prefix.U.txt, prefix.S.txt"
+            " and prefix.V.txt) to update with the rows of the input file,"
+            " instead of factorizing it. OPTIONAL.")
+        ("columns", "With --update, the input file holds new columns"
+            " (one per line) instead of new rows.")
+        ("streaming",
+            bpo::value<int>(&streaming)->default_value(0),
+            "If positive, do not load the matrix: stream it from the file in"
+            " blocks of this many rows (single process, non-symmetric"
+            " only). OPTIONAL.")
         ("prefix",
             bpo::value<std::string>(&prefix)->default_value("out"),
             "Prefix for output files (prefix.U.txt, prefix.S.txt"
@@ -330,6 +422,16 @@ int main(int argc, char* argv[]) {
         use_single = vm.count("single");
         directory = vm.count("directory");
         lower = vm.count("lower");
+        timings = vm.count("timings");
+        columns = vm.count("columns");
+
+        if (!update.empty() && as_symmetric) {
+            if (rank == 0)
+                std::cout << "--update is not supported with --symmetric."
+                          << std::endl;
+            world.barrier();
+            return -1;
+        }
 
     } catch(bpo::error& e) {
         if (rank == 0) {
@@ -347,10 +449,28 @@ int main(int argc, char* argv[]) {
     params.num_iterations = powerits;
     params.oversampling_ratio = oversampling_ratio;
     params.oversampling_additive = oversampling_additive;
+    params.am_i_printing = timings && rank == 0;
+    params.log_level = timings ? 2 : 0;
 
     SKYLARK_BEGIN_TRY()
 
-        if (size == 1) {
+        params.orthogonalization =
+            skylark::nla::ParseOrthogonalization(orthogonalization);
+
+        if (streaming > 0) {
+            if (size > 1 || as_symmetric || !update.empty() ||
+                !profile.empty() || directory || !hdfs.empty())
+                SKYLARK_THROW_EXCEPTION(skylark::base::invalid_parameters() <<
+                    skylark::base::error_msg("--streaming needs a single"
+                        " process and a plain libsvm file."));
+
+            if (use_single)
+                execute_streaming<float>(fname, streaming, k, params, prefix,
+                    context);
+            else
+                execute_streaming<double>(fname, streaming, k, params,
+                    prefix, context);
+        } else if (size == 1) {
             if (!as_symmetric) {
 
                 if (use_single) {
@@ -358,22 +478,26 @@ int main(int argc, char* argv[]) {
                         execute<skylark::base::sparse_matrix_t<float>,
                                 El::Matrix<float> >(
                                     directory, fname, hdfs,
-                                    port, profile, k, params, prefix, context);
+                                    port, profile, k, params, prefix,
+                                    update, columns, context);
                     else
                         execute<El::Matrix<float>,
                                 El::Matrix<float> >(directory, fname, hdfs,
-                                    port, profile, k, params, prefix, context);
+                                    port, profile, k, params, prefix,
+                                    update, columns, context);
 
                 } else {
                     if (as_sparse)
                         execute<skylark::base::sparse_matrix_t<double>,
                                 El::Matrix<double> >(
                                      directory, fname, hdfs,
-                                     port, profile, k, params, prefix, context);
+                                     port, profile, k, params, prefix,
+                                     update, columns, context);
                     else
                         execute<El::Matrix<double>,
                                 El::Matrix<double> >(directory, fname, hdfs,
-                                    port, profile, k, params, prefix, context);
+                                    port, profile, k, params, prefix,
+                                    update, columns, context);
                 }
 
             } else {
@@ -416,11 +540,13 @@ int main(int argc, char* argv[]) {
                                 El::DistMatrix<float, El::VC, El::STAR>,
                                 El::DistMatrix<float, El::VC, El::STAR> >(
                                     directory, fname, hdfs,
-                                    port, profile, k, params, prefix, context);
+                                    port, profile, k, params, prefix,
+                                    update, columns, context);
                     else
                         execute<El::DistMatrix<float>,
                                 El::DistMatrix<float> >(directory, fname, hdfs,
-                                    port, profile, k, params, prefix, context);
+                                    port, profile, k, params, prefix,
+                                    update, columns, context);
 
                 } else {
                     if (as_sparse)
@@ -429,11 +555,13 @@ int main(int argc, char* argv[]) {
                                 El::DistMatrix<double, El::VC, El::STAR>,
                                 El::DistMatrix<double, El::VC, El::STAR> >(
                                     directory, fname, hdfs,
-                                    port, profile, k, params, prefix, context);
+                                    port, profile, k, params, prefix,
+                                    update, columns, context);
                     else
                         execute<El::DistMatrix<double>,
                                 El::DistMatrix<double> >(directory, fname, hdfs,
-                                    port, profile, k, params, prefix, context);
+                                    port, profile, k, params, prefix,
+                                    update, columns, context);
                 }
 
             } else {
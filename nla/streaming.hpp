@@ -0,0 +1,328 @@
+#ifndef SKYLARK_STREAMING_HPP
+#define SKYLARK_STREAMING_HPP
+
+#include <El.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <sstream>
+
+#include "../base/exception.hpp"
+#include "../sketch/sketch.hpp"
+#include "svd.hpp"
+
+namespace skylark { namespace nla {
+
+/**
+ * Out-of-core algorithms for tall matrices, that see A only through a row
+ * block reader, one block at a time. A row block reader has:
+ *
+ *   El::Int height() const;   number of rows of A,
+ *   El::Int width() const;    number of columns of A,
+ *   El::Int targets() const;  number of columns of the right-hand side B,
+ *   void rewind();            starts a new pass,
+ *   bool next(El::Matrix<T>& X, El::Matrix<T>& Y);
+ *                             reads the next rows of A into X and of B
+ *                             into Y; false once the pass is over.
+ *
+ * utility::io::libsvm_row_block_reader_t reads a libsvm file this way
+ * (B being the labels); matrix_row_block_reader_t reads a matrix in memory.
+ */
+
+/**
+ * Row block reader over matrices in memory (A and, optionally, B).
+ */
+template<typename T>
+class matrix_row_block_reader_t {
+
+public:
+
+    matrix_row_block_reader_t(const El::Matrix<T>& A, int blocksize,
+        const El::Matrix<T> *B = nullptr)
+        : _A(A), _B(B), _blocksize(blocksize), _next(0) {
+
+    }
+
+    El::Int height() const { return _A.Height(); }
+    El::Int width() const { return _A.Width(); }
+    El::Int targets() const { return _B == nullptr ? 0 : _B->Width(); }
+
+    void rewind() { _next = 0; }
+
+    bool next(El::Matrix<T>& X, El::Matrix<T>& Y) {
+        if (_next >= _A.Height())
+            return false;
+
+        El::Int rows = std::min<El::Int>(_blocksize, _A.Height() - _next);
+        El::Matrix<T> view;
+        El::LockedView(view, _A, _next, 0, rows, _A.Width());
+        El::Copy(view, X);
+        if (_B != nullptr) {
+            El::LockedView(view, *_B, _next, 0, rows, _B->Width());
+            El::Copy(view, Y);
+        } else
+            Y.Resize(rows, 0);
+
+        _next += rows;
+        return true;
+    }
+
+private:
+    const El::Matrix<T>& _A;
+    const El::Matrix<T> *_B;
+    const int _blocksize;
+    El::Int _next;
+};
+
+namespace internal {
+
+/**
+ * One step of a streaming TSQR: R <- the R factor of [R; Y]. R is empty
+ * before the first block, and has min(rows seen, Width(Y)) rows.
+ */
+template<typename T>
+void TSQRUpdate(El::Matrix<T>& R, const El::Matrix<T>& Y) {
+    El::Int k = Y.Width();
+    El::Int r = R.Height();
+
+    El::Matrix<T> Z(r + Y.Height(), k), Zv;
+    if (r > 0) {
+        El::View(Zv, Z, 0, 0, r, k);
+        El::Copy(R, Zv);
+    }
+    El::View(Zv, Z, r, 0, Y.Height(), k);
+    El::Copy(Y, Zv);
+
+    El::qr::ExplicitTriang(Z);
+    El::Copy(Z, R);
+}
+
+/**
+ * Given the R factor of Y, returns M such that Y M is an orthonormal basis
+ * of the numerical range of Y: M = W Sigma^{-1} from the SVD of R, without
+ * the directions whose singular value is negligible.
+ */
+template<typename T>
+void RangeBasisFromR(const El::Matrix<T>& R, El::Matrix<T>& M) {
+    typedef El::Base<T> real_t;
+
+    El::Matrix<T> RR(R), W;
+    El::Matrix<real_t> s;
+    El::SVD(RR, s, W);
+
+    El::Int kk = 0;
+    real_t tol = std::max(R.Height(), R.Width()) *
+        std::numeric_limits<real_t>::epsilon() *
+        (s.Height() > 0 ? s.Get(0, 0) : real_t(0));
+    while (kk < s.Height() && s.Get(kk, 0) > tol)
+        kk++;
+
+    El::Matrix<T> Wv;
+    El::View(Wv, W, 0, 0, W.Height(), kk);
+    El::Copy(Wv, M);
+    for(El::Int j = 0; j < kk; j++) {
+        El::Matrix<T> Mj;
+        El::View(Mj, M, 0, j, M.Height(), 1);
+        El::Scale(T(1.0) / s.Get(j, 0), Mj);
+    }
+}
+
+} // namespace internal
+
+/**
+ * Streaming TSQR: the R factor (n x n) of the m x n matrix read by reader,
+ * in one pass. Holds one block and R.
+ */
+template<typename T, typename ReaderType>
+void StreamingTSQR(ReaderType &reader, El::Matrix<T>& R) {
+    El::Matrix<T> X, Y;
+
+    R.Resize(0, reader.width());
+    reader.rewind();
+    while (reader.next(X, Y))
+        internal::TSQRUpdate(R, X);
+}
+
+/**
+ * Solves argmin_X ||A X - B||_F in one pass over the blocks of A and B,
+ * from the streaming TSQR of [A B]:
+ *
+ *    [A B] = Q [R11 R12; 0 R22]  =>  X = R11^{-1} R12,
+ *
+ * and ||A X - B||_F = ||R22||_F. Unlike ApproximateLeastSquares, A is never
+ * resident, and the solution is exact. Holds one block and an
+ * (n + t) x (n + t) triangle, t being the number of right-hand sides.
+ *
+ * \param reader row block reader of A and B.
+ * \param X solution (n x t).
+ * \param residual if not null, gets ||A X - B||_F.
+ */
+template<typename T, typename ReaderType>
+void StreamingLeastSquares(ReaderType &reader, El::Matrix<T>& X,
+    El::Base<T> *residual = nullptr) {
+
+    El::Int n = reader.width();
+    El::Int t = reader.targets();
+
+    if (reader.height() < n)
+        SKYLARK_THROW_EXCEPTION (
+          base::nla_exception()
+              << base::error_msg(
+                 "StreamingLeastSquares needs at least as many rows as columns"));
+
+    El::Matrix<T> R, Z, Zv, A, B;
+    R.Resize(0, n + t);
+    reader.rewind();
+    while (reader.next(A, B)) {
+        El::Zeros(Z, A.Height(), n + t);
+        El::View(Zv, Z, 0, 0, A.Height(), n);
+        El::Copy(A, Zv);
+        El::View(Zv, Z, 0, n, A.Height(), t);
+        El::Copy(B, Zv);
+        internal::TSQRUpdate(R, Z);
+    }
+
+    El::Matrix<T> R11, R12;
+    El::LockedView(R11, R, 0, 0, n, n);
+    El::LockedView(R12, R, 0, n, n, t);
+    El::Copy(R12, X);
+    El::Trsm(El::LEFT, El::UPPER, El::NORMAL, El::NON_UNIT,
+        T(1.0), R11, X);
+
+    if (residual != nullptr) {
+        *residual = 0;
+        if (R.Height() > n) {
+            El::Matrix<T> R22;
+            El::LockedView(R22, R, n, n, R.Height() - n, t);
+            *residual = El::FrobeniusNorm(R22);
+        }
+    }
+}
+
+/**
+ * Approximate SVD of a tall matrix that does not fit in memory (see
+ * ApproximateSVD), from a row block reader.
+ *
+ * Every block of A is sketched rowwise with RangeSketch (n -> k columns,
+ * e.g. JLT or CWT) and folded into a streaming TSQR of the sketch, so the
+ * basis Q of the range is never formed; a second pass accumulates
+ * B = A^T Q one block at a time, recomputing the block of Q from the block
+ * of A. Every power iteration (params.num_iterations) takes two more
+ * passes; params.skip_qr and params.orthogonalization are ignored.
+ *
+ * Peak memory is a block of A, a block of the sketch and O(k n), whatever
+ * the number of rows. The left singular vectors are m x rank, so they are
+ * not kept: if on_u_block is set, a last pass hands it every block of U
+ * with the index of its first row.
+ *
+ * \param reader row block reader of A (m x n).
+ * \param S singular values (rank x 1).
+ * \param V right singular vectors (n x rank).
+ * \param rank target rank.
+ * \param on_u_block if set, called with the blocks of U (a third pass).
+ */
+template <template <typename, typename> class RangeSketch = sketch::JLT_t,
+          typename T, typename ReaderType>
+void StreamingSVD(ReaderType &reader, El::Matrix<El::Base<T> >& S,
+    El::Matrix<T>& V, int rank, base::context_t& context,
+    approximate_svd_params_t params = approximate_svd_params_t(),
+    const std::function<void (const El::Matrix<T>&, El::Int)>& on_u_block =
+    std::function<void (const El::Matrix<T>&, El::Int)>()) {
+
+    bool log_lev1 = params.am_i_printing && params.log_level >= 1;
+
+    El::Int m = reader.height();
+    El::Int n = reader.width();
+
+    if (rank > std::min(m, n)) {
+        std::stringstream err;
+        err << "Incompatible matrix dimensions (" << std::min(m, n)
+            << ") and target rank (" << rank << ")";
+        if (log_lev1)
+            params.log_stream << err.str() << std::endl;
+        SKYLARK_THROW_EXCEPTION(base::skylark_exception()
+            << base::error_msg(err.str()));
+    }
+
+    int k = std::max<El::Int>(rank, std::min(std::min(m, n),
+            El::Int(params.oversampling_ratio * rank +
+                params.oversampling_additive)));
+
+    typedef El::Matrix<T> matrix_type;
+    RangeSketch<matrix_type, matrix_type> Omega(n, k, context);
+    Omega.keep_realized();
+
+    // Starting block of the current round: Omega, then the (orthonormalized)
+    // result of the previous round.
+    matrix_type G, Bt, R, M, X, Y, AG, Q;
+    int round = 0;
+    auto range = [&](const matrix_type& Xb, matrix_type& AGb) {
+        if (round == 0) {
+            AGb.Resize(Xb.Height(), k);
+            Omega.apply(Xb, AGb, sketch::rowwise_tag());
+        } else
+            El::Gemm(El::NORMAL, El::NORMAL, T(1.0), Xb, G, AGb);
+    };
+
+    for(round = 0; round <= params.num_iterations; round++) {
+
+        /** Pass 1: R factor of A G */
+        R.Resize(0, k);
+        reader.rewind();
+        while (reader.next(X, Y)) {
+            range(X, AG);
+            internal::TSQRUpdate(R, AG);
+        }
+        internal::RangeBasisFromR(R, M);
+
+        /** Pass 2: B^T = A^T Q, with Q = A G M */
+        El::Zeros(Bt, n, M.Width());
+        reader.rewind();
+        while (reader.next(X, Y)) {
+            range(X, AG);
+            El::Gemm(El::NORMAL, El::NORMAL, T(1.0), AG, M, Q);
+            El::Gemm(El::ADJOINT, El::NORMAL, T(1.0), X, Q, T(1.0), Bt);
+        }
+
+        if (log_lev1)
+            params.log_stream << params.prefix
+                              << "StreamingSVD: round " << round
+                              << ", basis of " << M.Width() << " columns"
+                              << std::endl;
+
+        if (round < params.num_iterations) {
+            El::Copy(Bt, G);
+            El::qr::ExplicitUnitary(G);
+        }
+    }
+    round = params.num_iterations;
+
+    /** Compute factorization & truncate to rank */
+    matrix_type W;
+    El::SVD(Bt, S, W);
+    El::Int r = std::min<El::Int>(rank, S.Height());
+    S.Resize(r, 1);
+    El::Copy(Bt, V);
+    V.Resize(n, r);
+
+    if (!on_u_block)
+        return;
+
+    /** Pass 3: U = A G M W */
+    matrix_type MW, Wv, U;
+    El::LockedView(Wv, W, 0, 0, W.Height(), r);
+    El::Gemm(El::NORMAL, El::NORMAL, T(1.0), M, Wv, MW);
+    El::Int first = 0;
+    reader.rewind();
+    while (reader.next(X, Y)) {
+        range(X, AG);
+        El::Gemm(El::NORMAL, El::NORMAL, T(1.0), AG, MW, U);
+        on_u_block(U, first);
+        first += X.Height();
+    }
+}
+
+} } // namespace skylark::nla
+
+#endif // SKYLARK_STREAMING_HPP
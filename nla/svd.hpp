@@ -5,13 +5,49 @@
 
 #include <algorithm>
 #include <string>
+#include <vector>
 
 #include "boost/property_tree/ptree.hpp"
+#include "boost/mpi/timer.hpp"
 
 #include "../sketch/sketch.hpp"
 
 namespace skylark { namespace nla {
 
+/**
+ * How the iterates of the power iteration are orthonormalized.
+ *
+ * HOUSEHOLDER: Householder QR (El::qr::ExplicitUnitary).
+ * TSQR: tall-skinny QR (see base::qr::ExplicitTS).
+ * CHOLESKY_QR2: CholeskyQR2, two k x k reductions (see base::qr::CholeskyQR2).
+ * LU: only make the iterates well conditioned with an LU factorization, as
+ *     fbpca does; the last orthonormalization is Householder.
+ */
+enum orthogonalization_t {
+    HOUSEHOLDER,
+    TSQR,
+    CHOLESKY_QR2,
+    LU
+};
+
+/**
+ * Parses "householder", "tsqr", "cholqr2" or "lu".
+ */
+inline orthogonalization_t ParseOrthogonalization(const std::string &name) {
+    if (name == "householder")
+        return HOUSEHOLDER;
+    if (name == "tsqr")
+        return TSQR;
+    if (name == "cholqr2")
+        return CHOLESKY_QR2;
+    if (name == "lu")
+        return LU;
+
+    SKYLARK_THROW_EXCEPTION(base::invalid_parameters()
+        << base::error_msg("Unknown orthogonalization: " + name));
+    return HOUSEHOLDER;
+}
+
 /**
  * Parameter structure for approximate SVD
  *
@@ -20,11 +56,13 @@ namespace skylark { namespace nla {
  *   k = oversampling_ratio * r + oversampling_additive
  * num_iterations: number of power iteration to do
  * skip_qr: skip doing QR in every iteration (less accurate).
+ * orthogonalization: how to orthonormalize the iterates (if not skip_qr).
  */
 struct approximate_svd_params_t : public base::params_t {
     int oversampling_ratio, oversampling_additive;
     int num_iterations;
     bool skip_qr;
+    orthogonalization_t orthogonalization;
 
     approximate_svd_params_t(int oversampling_ratio = 2,
         int oversampling_additive = 0,
@@ -34,17 +72,21 @@ struct approximate_svd_params_t : public base::params_t {
         int log_level = 0,
         std::ostream &log_stream = std::cout,
         std::string prefix = "",
-        int debug_level = 0) :
+        int debug_level = 0,
+        orthogonalization_t orthogonalization = HOUSEHOLDER) :
         base::params_t(am_i_printing, log_level, log_stream, prefix, debug_level),
         oversampling_ratio(oversampling_ratio),
         oversampling_additive(oversampling_additive),
-        num_iterations(num_iterations), skip_qr(skip_qr) {}
+        num_iterations(num_iterations), skip_qr(skip_qr),
+        orthogonalization(orthogonalization) {}
 
     approximate_svd_params_t(const boost::property_tree::ptree& json) {
         oversampling_ratio = json.get<int>("oversampling_ratio");
         oversampling_additive = json.get<int>("oversampling_additive");
         num_iterations = json.get<int>("num_iterations");
         skip_qr = json.get<bool>("skip_qr");
+        orthogonalization = ParseOrthogonalization(
+            json.get<std::string>("orthogonalization", "householder"));
         am_i_printing = json.get<bool>("am_i_printing");
         log_level = json.get<int>("log_level");
         prefix = json.get<std::string>("prefix");
@@ -52,6 +94,70 @@ struct approximate_svd_params_t : public base::params_t {
     }
 };
 
+/**
+ * Time spent in each pass of PowerIteration: in the products with A and
+ * A^T, and in orthonormalizing the iterates.
+ */
+struct power_iteration_profile_t {
+    std::vector<double> products, orthogonalization;
+};
+
+namespace internal {
+
+/**
+ * Orthonormalizes the columns, or the rows, of the iterates of the power
+ * iteration, and keeps the time it took.
+ */
+struct orthonormalizer_t {
+    orthogonalization_t method;
+    double time;
+
+    orthonormalizer_t(orthogonalization_t method) :
+        method(method), time(0.0) { }
+
+    /** last: the result is the final basis, so it has to be orthonormal. */
+    template<typename MatrixType>
+    void columns(MatrixType &A, bool last) {
+        boost::mpi::timer timer;
+        switch (last && method == LU ? HOUSEHOLDER : method) {
+        case HOUSEHOLDER:
+            El::qr::ExplicitUnitary(A);
+            break;
+        case TSQR:
+            base::qr::ExplicitTS(A);
+            break;
+        case CHOLESKY_QR2:
+            base::qr::CholeskyQR2(A);
+            break;
+        case LU:
+            base::qr::ExplicitLU(A);
+            break;
+        }
+        time += timer.elapsed();
+    }
+
+    template<typename MatrixType>
+    void rows(MatrixType &A, bool last) {
+        if (method == HOUSEHOLDER || (last && method == LU)) {
+            boost::mpi::timer timer;
+            El::lq::ExplicitUnitary(A);
+            time += timer.elapsed();
+            return;
+        }
+
+        boost::mpi::timer timer;
+        MatrixType At;
+        El::Adjoint(A, At);
+        double adjoint = timer.elapsed();
+        columns(At, last);
+        timer.restart();
+        El::Adjoint(At, A);
+        time += adjoint + timer.elapsed();
+    }
+};
+
+} // namespace internal
+
 /**
  * Power iteration from a specific starting vectors (the V input).
  *
@@ -71,12 +177,22 @@ struct approximate_svd_params_t : public base::params_t {
  * \param U on output: U = A*V or A^T*V.
  * \param iternum how many iterations to do
  * \param ortho whether to orthonormalize after every multipication.
+ * \param method how to orthonormalize. With LU, V is still orthonormal
+ *               on output.
+ * \param profile if not null, gets the time of every iteration.
+ *
+ * The products with A and A^T are always two separate base::Gemm calls,
+ * also for sparse A: there is no fused A^T A (or A A^T) pass. With ortho
+ * the iterate is orthonormalized between the two products, so they could
+ * not be fused anyway.
  */
 template<typename MatrixType, typename LeftType, typename RightType>
 void PowerIteration(El::Orientation orientation, El::Orientation vorientation,
     El::Orientation uorientation, const MatrixType &A,
     RightType &V, LeftType &U,
-    int iternum, bool ortho = false) {
+    int iternum, bool ortho = false,
+    orthogonalization_t method = HOUSEHOLDER,
+    power_iteration_profile_t *profile = nullptr) {
 
     typedef typename skylark::utility::typer_t<MatrixType>::value_type
         value_type;
@@ -107,47 +223,69 @@ void PowerIteration(El::Orientation orientation, El::Orientation vorientation,
         adjorientation = El::ADJOINT;
     }
 
+    internal::orthonormalizer_t orth(method);
+    boost::mpi::timer timer;
+    double ortho_time = 0.0;
+
+    // Closes the timing of one pass of the loop.
+    auto lap = [&]() {
+        if (profile != nullptr) {
+            double elapsed = timer.elapsed();
+            profile->orthogonalization.push_back(orth.time - ortho_time);
+            profile->products.push_back(elapsed - (orth.time - ortho_time));
+        }
+        ortho_time = orth.time;
+        timer.restart();
+    };
+
     if (vorientation == El::NORMAL && uorientation == El::NORMAL) {
-        if (ortho) El::qr::ExplicitUnitary(V);
-        base::Gemm(orientation, El::NORMAL, static_cast<value_type>(1.0), A, V, U);
+        if (ortho) orth.columns(V, iternum == 0);
+        timer.restart(); ortho_time = orth.time;
         for(int i = 0; i < iternum; i++) {
             base::Gemm(orientation, El::NORMAL, static_cast<value_type>(1.0), A, V, U);
-            if (ortho) El::qr::ExplicitUnitary(U);
+            if (ortho) orth.columns(U, false);
             base::Gemm(adjorientation, El::NORMAL, static_cast<value_type>(1.0), A, U, V);
-            if (ortho) El::qr::ExplicitUnitary(V);
+            if (ortho) orth.columns(V, i == iternum - 1);
+            lap();
         }
         base::Gemm(orientation, El::NORMAL, static_cast<value_type>(1.0), A, V, U);
     }
 
     if (vorientation != El::NORMAL && uorientation == El::NORMAL) {
-        if (ortho) El::lq::ExplicitUnitary(V);
+        if (ortho) orth.rows(V, iternum == 0);
+        timer.restart(); ortho_time = orth.time;
         for(int i = 0; i < iternum; i++) {
             base::Gemm(orientation, El::ADJOINT, static_cast<value_type>(1.0), A, V, U);
-            if (ortho) El::qr::ExplicitUnitary(U);
+            if (ortho) orth.columns(U, false);
             base::Gemm(El::ADJOINT, orientation, static_cast<value_type>(1.0), U, A, V);
-            if (ortho) El::lq::ExplicitUnitary(V);
+            if (ortho) orth.rows(V, i == iternum - 1);
+            lap();
         }
         base::Gemm(orientation, El::ADJOINT, static_cast<value_type>(1.0), A, V, U);
     }
 
     if (vorientation == El::NORMAL && uorientation != El::NORMAL) {
-        if (ortho) El::qr::ExplicitUnitary(V);
+        if (ortho) orth.columns(V, iternum == 0);
+        timer.restart(); ortho_time = orth.time;
         for(int i = 0; i < iternum; i++) {
             base::Gemm(El::ADJOINT, adjorientation, static_cast<value_type>(1.0), V, A, U);
-            if (ortho) El::lq::ExplicitUnitary(U);
+            if (ortho) orth.rows(U, false);
             base::Gemm(adjorientation, El::ADJOINT, static_cast<value_type>(1.0), A, U, V);
-            if (ortho) El::qr::ExplicitUnitary(V);
+            if (ortho) orth.columns(V, i == iternum - 1);
+            lap();
         }
         base::Gemm(El::ADJOINT, adjorientation, static_cast<value_type>(1.0), V, A, U);
     }
 
     if (vorientation != El::NORMAL && uorientation != El::NORMAL) {
-        if (ortho) El::lq::ExplicitUnitary(V);
+        if (ortho) orth.rows(V, iternum == 0);
+        timer.restart(); ortho_time = orth.time;
         for(int i = 0; i < iternum; i++) {
             base::Gemm(El::NORMAL, adjorientation, static_cast<value_type>(1.0), V, A, U);
-            if (ortho) El::lq::ExplicitUnitary(U);
+            if (ortho) orth.rows(U, false);
             base::Gemm(El::NORMAL, orientation, static_cast<value_type>(1.0), U, A, V);
-            if (ortho) El::lq::ExplicitUnitary(V);
+            if (ortho) orth.rows(V, i == iternum - 1);
+            lap();
         }
         base::Gemm(orientation, El::ADJOINT, static_cast<value_type>(1.0), A, V, U);
     }
@@ -223,6 +361,21 @@ void SymmetricPowerIteration(El::UpperOrLower uplo, El::Orientation vorientation
     }
 }
 
+namespace internal {
+
+inline void LogPowerIterationProfile(const power_iteration_profile_t &profile,
+    const base::params_t &params) {
+    for(size_t i = 0; i < profile.products.size(); i++)
+        params.log_stream << params.prefix
+                          << "ApproximateSVD: Iteration " << i + 1
+                          << ", products " << profile.products[i]
+                          << " sec, orthogonalization "
+                          << profile.orthogonalization[i] << " sec"
+                          << std::endl;
+}
+
+} // namespace internal
+
 template <typename InputType, typename UType, typename SType, typename VType>
 void ApproximateSVD(const InputType &A, UType &U, SType &S, VType &V,
     int rank, base::context_t& context,
@@ -262,8 +415,12 @@ void ApproximateSVD(const InputType &A, UType &U, SType &S, VType &V,
         Omega.apply(A, Q, sketch::rowwise_tag());
 
         /** Power iteration */
+        power_iteration_profile_t profile;
         PowerIteration(El::ADJOINT, El::NORMAL, El::NORMAL, A, Q, V,
-            params.num_iterations, !params.skip_qr);
+            params.num_iterations, !params.skip_qr, params.orthogonalization,
+            log_lev2 ? &profile : nullptr);
+        if (log_lev2)
+            internal::LogPowerIterationProfile(profile, params);
 
         if (params.skip_qr) {
             if (params.num_iterations == 0) {
@@ -302,8 +459,12 @@ void ApproximateSVD(const InputType &A, UType &U, SType &S, VType &V,
         Omega.apply(A, Q, sketch::columnwise_tag());
 
         /** Power iteration */
+        power_iteration_profile_t profile;
         PowerIteration(El::NORMAL, El::ADJOINT, El::NORMAL, A, Q, U,
-            params.num_iterations, !params.skip_qr);
+            params.num_iterations, !params.skip_qr, params.orthogonalization,
+            log_lev2 ? &profile : nullptr);
+        if (log_lev2)
+            internal::LogPowerIterationProfile(profile, params);
 
         if (params.skip_qr) {
             // We should be able to do the same trick as for m>=n if
@@ -322,6 +483,448 @@ void ApproximateSVD(const InputType &A, UType &U, SType &S, VType &V,
     }
 }
 
+namespace internal {
+
+/**
+ * SVD of the (r + p) x (r + l) core of an SVD update,
+ *     [ diag(S)  0 ]
+ *     [    C     E ],
+ * truncated to rank. On output S holds the singular values and L and B the
+ * left and right singular vectors.
+ */
+template<typename SType, typename XType>
+void UpdateCoreSVD(SType &S, const XType &C, const XType &E,
+    XType &L, XType &B, int rank) {
+
+    typedef typename utility::typer_t<XType>::value_type value_type;
+
+    int r = base::Height(S);
+    int p = base::Height(C);
+    int l = base::Width(E);
+
+    XType D, Lv;
+    El::Identity(D, r, r);
+    El::DiagonalScale(El::LEFT, El::NORMAL, S, D);
+
+    El::Zeros(L, r + p, r + l);
+    El::View(Lv, L, 0, 0, r, r);
+    El::Copy(D, Lv);
+    El::View(Lv, L, r, 0, p, r);
+    El::Copy(C, Lv);
+    if (l > 0) {
+        El::View(Lv, L, r, r, p, l);
+        El::Copy(E, Lv);
+    }
+
+    El::SVD(L, S, B);
+    S.Resize(rank, 1);
+    L.Resize(r + p, rank);
+    B.Resize(r + l, rank);
+}
+
+} // namespace internal
+
+/**
+ * Updates a rank r approximate SVD, A ~= U diag(S) V^T, after the rows R
+ * (p x n) are appended to A (Brand's update). The part of R outside the
+ * span of V is captured by a sketch of R, re-orthogonalized twice against
+ * V, with min(p, k) columns where k = oversampling_ratio * r +
+ * oversampling_additive. The new rows are read twice and A is not needed,
+ * so the cost is O(nnz(R) (r + k) + n r k + (m + p) r^2): proportional
+ * to the delta, except for rotating U.
+ *
+ * On output U is (m + p) x r, and the rank is unchanged.
+ */
+template <typename InputType, typename UType, typename SType, typename VType>
+void UpdateSVDRows(const InputType &R, UType &U, SType &S, VType &V,
+    base::context_t& context,
+    approximate_svd_params_t params = approximate_svd_params_t()) {
+
+    typedef typename skylark::utility::typer_t<InputType>::value_type
+        value_type;
+
+    bool log_lev1 = params.am_i_printing && params.log_level >= 1;
+
+    int m = base::Height(U);
+    int n = base::Height(V);
+    int rank = base::Width(U);
+    int p = base::Height(R);
+
+    if (base::Width(R) != n) {
+        std::stringstream err;
+        err << "Width of new rows (" << base::Width(R)
+            << ") does not match the factorization (" << n << ")";
+        if (log_lev1)
+            params.log_stream << err.str() << std::endl;
+        SKYLARK_THROW_EXCEPTION(base::invalid_parameters()
+            << base::error_msg(err.str()));
+    }
+
+    int l = std::min(std::min(p, n - rank),
+        params.oversampling_ratio * rank + params.oversampling_additive);
+
+    /** Projection of the new rows on V */
+    UType C;
+    base::Gemm(El::NORMAL, El::NORMAL, static_cast<value_type>(1.0), R, V, C);
+
+    /** Orthonormal basis (rows of P) for the rest of the new rows */
+    VType P, W;
+    UType E;
+    if (l > 0) {
+        P.Resize(l, n);
+        sketch::JLT_t<InputType, VType> Omega(p, l, context);
+        Omega.apply(R, P, sketch::columnwise_tag());
+        for(int pass = 0; pass < 2; pass++) {
+            El::Gemm(El::NORMAL, El::NORMAL,
+                static_cast<value_type>(1.0), P, V, W);
+            El::Gemm(El::NORMAL, El::ADJOINT,
+                static_cast<value_type>(-1.0), W, V,
+                static_cast<value_type>(1.0), P);
+            El::lq::ExplicitUnitary(P);
+        }
+        base::Gemm(El::NORMAL, El::ADJOINT,
+            static_cast<value_type>(1.0), R, P, E);
+    } else
+        El::Zeros(E, p, 0);
+
+    UType L, B, Lv, Uv;
+    internal::UpdateCoreSVD(S, C, E, L, B, rank);
+
+    /** U <- [U 0; 0 I] L */
+    UType Un;
+    El::Zeros(Un, m + p, rank);
+    El::View(Uv, Un, 0, 0, m, rank);
+    El::LockedView(Lv, L, 0, 0, rank, rank);
+    El::Gemm(El::NORMAL, El::NORMAL, static_cast<value_type>(1.0), U, Lv,
+        static_cast<value_type>(0.0), Uv);
+    El::View(Uv, Un, m, 0, p, rank);
+    El::LockedView(Lv, L, rank, 0, p, rank);
+    El::Copy(Lv, Uv);
+    El::Copy(Un, U);
+
+    /** V <- [V P^T] B */
+    VType Vn;
+    UType Bv;
+    El::LockedView(Bv, B, 0, 0, rank, rank);
+    El::Gemm(El::NORMAL, El::NORMAL, static_cast<value_type>(1.0), V, Bv, Vn);
+    if (l > 0) {
+        El::LockedView(Bv, B, rank, 0, l, rank);
+        El::Gemm(El::ADJOINT, El::NORMAL, static_cast<value_type>(1.0), P, Bv,
+            static_cast<value_type>(1.0), Vn);
+    }
+    El::Copy(Vn, V);
+}
+
+/**
+ * Updates a rank r approximate SVD, A ~= U diag(S) V^T, after the columns C
+ * (m x q) are appended to A. Same as UpdateSVDRows on A^T.
+ *
+ * On output V is (n + q) x r, and the rank is unchanged.
+ */
+template <typename InputType, typename UType, typename SType, typename VType>
+void UpdateSVDColumns(const InputType &C, UType &U, SType &S, VType &V,
+    base::context_t& context,
+    approximate_svd_params_t params = approximate_svd_params_t()) {
+
+    typedef typename skylark::utility::typer_t<InputType>::value_type
+        value_type;
+
+    bool log_lev1 = params.am_i_printing && params.log_level >= 1;
+
+    int m = base::Height(U);
+    int n = base::Height(V);
+    int rank = base::Width(U);
+    int q = base::Width(C);
+
+    if (base::Height(C) != m) {
+        std::stringstream err;
+        err << "Height of new columns (" << base::Height(C)
+            << ") does not match the factorization (" << m << ")";
+        if (log_lev1)
+            params.log_stream << err.str() << std::endl;
+        SKYLARK_THROW_EXCEPTION(base::invalid_parameters()
+            << base::error_msg(err.str()));
+    }
+
+    int l = std::min(std::min(q, m - rank),
+        params.oversampling_ratio * rank + params.oversampling_additive);
+
+    /** Projection of the new columns on U */
+    VType D;
+    base::Gemm(El::ADJOINT, El::NORMAL, static_cast<value_type>(1.0), C, U, D);
+
+    /** Orthonormal basis (columns of P) for the rest of the new columns */
+    UType P, W;
+    VType E;
+    if (l > 0) {
+        P.Resize(m, l);
+        sketch::JLT_t<InputType, UType> Omega(q, l, context);
+        Omega.apply(C, P, sketch::rowwise_tag());
+        for(int pass = 0; pass < 2; pass++) {
+            El::Gemm(El::ADJOINT, El::NORMAL,
+                static_cast<value_type>(1.0), U, P, W);
+            El::Gemm(El::NORMAL, El::NORMAL,
+                static_cast<value_type>(-1.0), U, W,
+                static_cast<value_type>(1.0), P);
+            El::qr::ExplicitUnitary(P);
+        }
+        base::Gemm(El::ADJOINT, El::NORMAL,
+            static_cast<value_type>(1.0), C, P, E);
+    } else
+        El::Zeros(E, q, 0);
+
+    VType L, B, Lv, Vv;
+    internal::UpdateCoreSVD(S, D, E, L, B, rank);
+
+    /** V <- [V 0; 0 I] L */
+    VType Vn;
+    El::Zeros(Vn, n + q, rank);
+    El::View(Vv, Vn, 0, 0, n, rank);
+    El::LockedView(Lv, L, 0, 0, rank, rank);
+    El::Gemm(El::NORMAL, El::NORMAL, static_cast<value_type>(1.0), V, Lv,
+        static_cast<value_type>(0.0), Vv);
+    El::View(Vv, Vn, n, 0, q, rank);
+    El::LockedView(Lv, L, rank, 0, q, rank);
+    El::Copy(Lv, Vv);
+    El::Copy(Vn, V);
+
+    /** U <- [U P] B */
+    UType Un;
+    VType Bv;
+    El::LockedView(Bv, B, 0, 0, rank, rank);
+    El::Gemm(El::NORMAL, El::NORMAL, static_cast<value_type>(1.0), U, Bv, Un);
+    if (l > 0) {
+        El::LockedView(Bv, B, rank, 0, l, rank);
+        El::Gemm(El::NORMAL, El::NORMAL, static_cast<value_type>(1.0), P, Bv,
+            static_cast<value_type>(1.0), Un);
+    }
+    El::Copy(Un, U);
+}
+
+/**
+ * Randomized block Krylov SVD (Musco and Musco).
+ *
+ * Like ApproximateSVD, but instead of keeping only the last power iterate
+ * it projects on the span of all of them: [A Omega, (A A^T) A Omega, ...,
+ * (A A^T)^q A Omega], with q = params.num_iterations. For the same number
+ * of passes over A (2q + 2) the result is usually considerably more
+ * accurate, at the price of a basis q + 1 times wider (capped to the
+ * size of A). Every block is orthonormalized (params.skip_qr is ignored).
+ */
+template <typename InputType, typename UType, typename SType, typename VType>
+void BlockKrylovSVD(const InputType &A, UType &U, SType &S, VType &V,
+    int rank, base::context_t& context,
+    approximate_svd_params_t params = approximate_svd_params_t()) {
+
+    typedef typename skylark::utility::typer_t<InputType>::value_type
+        value_type;
+
+    bool log_lev1 = params.am_i_printing && params.log_level >= 1;
+
+    int m = base::Height(A);
+    int n = base::Width(A);
+
+    /**
+     * Check if sizes match.
+     */
+    if (rank > std::min(m, n)) {
+        std::stringstream err;
+        err << "Incompatible matrix dimensions (" << std::min(m, n)
+            << ") and target rank (" << rank << ")";
+        if (log_lev1)
+            params.log_stream << err.str() << std::endl;
+        SKYLARK_THROW_EXCEPTION(base::skylark_exception()
+            << base::error_msg(err.str()));
+    }
+
+    int k = std::max(rank, std::min(std::min(m, n),
+            params.oversampling_ratio * rank +
+            params.oversampling_additive));
+    int q = std::min(params.num_iterations, std::min(m, n) / k - 1);
+
+    /** Code for m >= n */
+    if (m >= n) {
+
+        /** Krylov blocks, each orthonormalized, as the columns of K */
+        UType Q(m, k), K(m, k * (q + 1)), Ki;
+        VType W;
+        sketch::JLT_t<InputType, UType> Omega(n, k, context);
+        Omega.apply(A, Q, sketch::rowwise_tag());
+        for(int i = 0; i <= q; i++) {
+            if (i > 0) {
+                base::Gemm(El::ADJOINT, El::NORMAL,
+                    static_cast<value_type>(1.0), A, Q, W);
+                base::Gemm(El::NORMAL, El::NORMAL,
+                    static_cast<value_type>(1.0), A, W, Q);
+            }
+            El::qr::ExplicitUnitary(Q);
+            base::ColumnView(Ki, K, i * k, k);
+            El::Copy(Q, Ki);
+        }
+        El::qr::ExplicitUnitary(K);
+
+        /** Compute factorization & truncate to rank */
+        base::Gemm(El::ADJOINT, El::NORMAL,
+            static_cast<value_type>(1.0), A, K, V);
+        VType B;
+        El::SVD(V, S, B);
+        S.Resize(rank, 1); V.Resize(n, rank);
+        VType B1 = base::ColumnView(B, 0, rank);
+        base::Gemm(El::NORMAL, El::NORMAL,
+            static_cast<value_type>(1.0), K, B1, U);
+    }
+
+    /** Code for m < n */
+    if (m < n) {
+
+        /** Krylov blocks, each orthonormalized, as the rows of K */
+        VType Q(k, n), K(k * (q + 1), n), Ki;
+        UType W;
+        sketch::JLT_t<InputType, VType> Omega(m, k, context);
+        Omega.apply(A, Q, sketch::columnwise_tag());
+        for(int i = 0; i <= q; i++) {
+            if (i > 0) {
+                base::Gemm(El::NORMAL, El::ADJOINT,
+                    static_cast<value_type>(1.0), A, Q, W);
+                base::Gemm(El::ADJOINT, El::NORMAL,
+                    static_cast<value_type>(1.0), W, A, Q);
+            }
+            El::lq::ExplicitUnitary(Q);
+            base::RowView(Ki, K, i * k, k);
+            El::Copy(Q, Ki);
+        }
+        El::lq::ExplicitUnitary(K);
+
+        /** Compute factorization & truncate to rank */
+        base::Gemm(El::NORMAL, El::ADJOINT,
+            static_cast<value_type>(1.0), A, K, U);
+        UType B;
+        El::SVD(U, S, B);
+        S.Resize(rank, 1); U.Resize(m, rank);
+        VType B1 = base::ColumnView(B, 0, rank);
+        base::Gemm(El::ADJOINT, El::NORMAL,
+            static_cast<value_type>(1.0), K, B1, V);
+    }
+}
+
+/**
+ * Single pass SVD (the "sketchy" SVD of Tropp, Yurtsever, Udell and
+ * Cevher).
+ *
+ * A is only read by two sketches that do not depend on each other, a range
+ * sketch Y = A * Omega (k columns) and a co-range sketch W = Psi * A
+ * (l = 2k + 1 rows), so a streaming caller can form both in a single pass.
+ * With Q an orthonormal basis of Y, A ~= Q X where X solves the small least
+ * squares problem (Psi Q) X = W; the SVD of A is recovered from that of X.
+ * For m < n the roles of rows and columns are swapped.
+ *
+ * Less accurate than ApproximateSVD with power iterations, but a single
+ * pass. The sketches are JLT by default; any sketch transform with the
+ * same template signature can be used, e.g. CWT for sparse inputs:
+ * SinglePassSVD<sketch::CWT_t, sketch::CWT_t>(A, U, S, V, ...).
+ * params.num_iterations and params.skip_qr are ignored.
+ */
+template <template <typename, typename> class RangeSketch = sketch::JLT_t,
+          template <typename, typename> class CoRangeSketch = sketch::JLT_t,
+          typename InputType, typename UType, typename SType, typename VType>
+void SinglePassSVD(const InputType &A, UType &U, SType &S, VType &V,
+    int rank, base::context_t& context,
+    approximate_svd_params_t params = approximate_svd_params_t()) {
+
+    typedef typename skylark::utility::typer_t<InputType>::value_type
+        value_type;
+
+    bool log_lev1 = params.am_i_printing && params.log_level >= 1;
+
+    int m = base::Height(A);
+    int n = base::Width(A);
+
+    /**
+     * Check if sizes match.
+     */
+    if (rank > std::min(m, n)) {
+        std::stringstream err;
+        err << "Incompatible matrix dimensions (" << std::min(m, n)
+            << ") and target rank (" << rank << ")";
+        if (log_lev1)
+            params.log_stream << err.str() << std::endl;
+        SKYLARK_THROW_EXCEPTION(base::skylark_exception()
+            << base::error_msg(err.str()));
+    }
+
+    /** Code for m >= n */
+    if (m >= n) {
+        int k = std::max(rank, std::min(n,
+                params.oversampling_ratio * rank +
+                params.oversampling_additive));
+        int l = std::min(m, 2 * k + 1);
+
+        /** The two sketches of A (a single pass) */
+        UType Y(m, k);
+        VType W(l, n);
+        RangeSketch<InputType, UType> Omega(n, k, context);
+        CoRangeSketch<InputType, VType> Psi(m, l, context);
+        Omega.apply(A, Y, sketch::rowwise_tag());
+        Psi.apply(A, W, sketch::columnwise_tag());
+
+        /** X = (Psi Q)^+ W, with Q = orth(Y) */
+        El::qr::ExplicitUnitary(Y);
+        VType PsiQ(l, k), R, X;
+        CoRangeSketch<UType, VType>(Psi).apply(Y, PsiQ,
+            sketch::columnwise_tag());
+        El::qr::Explicit(PsiQ, R);
+        base::Gemm(El::ADJOINT, El::NORMAL,
+            static_cast<value_type>(1.0), PsiQ, W, X);
+        El::Trsm(El::LEFT, El::UPPER, El::NORMAL, El::NON_UNIT,
+            static_cast<value_type>(1.0), R, X);
+
+        /** Compute factorization of X^T & truncate to rank */
+        VType B;
+        El::Adjoint(X, V);
+        El::SVD(V, S, B);
+        S.Resize(rank, 1); V.Resize(n, rank);
+        VType B1 = base::ColumnView(B, 0, rank);
+        base::Gemm(El::NORMAL, El::NORMAL,
+            static_cast<value_type>(1.0), Y, B1, U);
+    }
+
+    /** Code for m < n */
+    if (m < n) {
+        int k = std::max(rank, std::min(m,
+                params.oversampling_ratio * rank +
+                params.oversampling_additive));
+        int l = std::min(n, 2 * k + 1);
+
+        /** The two sketches of A (a single pass) */
+        VType Y(k, n);
+        UType W(m, l);
+        RangeSketch<InputType, VType> Omega(m, k, context);
+        CoRangeSketch<InputType, UType> Psi(n, l, context);
+        Omega.apply(A, Y, sketch::columnwise_tag());
+        Psi.apply(A, W, sketch::rowwise_tag());
+
+        /** X = W (Q Psi^T)^+, with Q = orth(Y) (by rows) */
+        El::lq::ExplicitUnitary(Y);
+        VType QPsi(k, l), PsiQ, R;
+        CoRangeSketch<VType, VType>(Psi).apply(Y, QPsi,
+            sketch::rowwise_tag());
+        El::Adjoint(QPsi, PsiQ);
+        El::qr::Explicit(PsiQ, R);
+        El::Trsm(El::RIGHT, El::UPPER, El::ADJOINT, El::NON_UNIT,
+            static_cast<value_type>(1.0), R, PsiQ);
+        base::Gemm(El::NORMAL, El::NORMAL,
+            static_cast<value_type>(1.0), W, PsiQ, U);
+
+        /** Compute factorization of X & truncate to rank */
+        UType B;
+        El::SVD(U, S, B);
+        S.Resize(rank, 1); U.Resize(m, rank);
+        VType B1 = base::ColumnView(B, 0, rank);
+        base::Gemm(El::ADJOINT, El::NORMAL,
+            static_cast<value_type>(1.0), Y, B1, V);
+    }
+}
+
 template <typename InputType, typename SType, typename VType>
 void ApproximateSymmetricSVD(El::UpperOrLower uplo,
         InputType &A, VType &V, SType &S, int rank,
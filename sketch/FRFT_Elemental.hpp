@@ -165,8 +165,29 @@ private:
         output_matrix_type& sketch_of_A,
         skylark::sketch::rowwise_tag tag) const {
 
-        // TODO this version is really bad: it completely densifies the matrix
-        //      on the begining.
+        apply_impl_rowwise(A, sketch_of_A, tag);
+    }
+
+    /**
+      * Rowwise for sparse input: transpose (still sparse) and use the
+      * columnwise implementation, which densifies one column at a time
+      * (per thread) instead of the whole matrix.
+      */
+    void apply_impl_rowwise(const base::sparse_matrix_t<value_type>& A,
+        output_matrix_type& sketch_of_A,
+        skylark::sketch::rowwise_tag tag) const {
+
+        base::sparse_matrix_t<value_type> At;
+        base::Transpose(A, At);
+        output_matrix_type sketch_of_At(data_type::_S, base::Height(A));
+        apply_impl(At, sketch_of_At, skylark::sketch::columnwise_tag());
+        El::Transpose(sketch_of_At, sketch_of_A);
+    }
+
+    void apply_impl_rowwise(const El::Matrix<value_type>& A,
+        output_matrix_type& sketch_of_A,
+        skylark::sketch::rowwise_tag tag) const {
+
         // TODO this version does not work with _NB and N
         // TODO this version is not as optimized as the columnwise version.
 
@@ -63,6 +63,10 @@ struct RLT_data_t : public sketch_transform_data_t {
         return nullptr;
     }
 
+    virtual void keep_realized() const {
+        _underlying_data->keep_realized();
+    }
+
 protected:
 
     typedef typename underlying_data_type::accessor_type accessor_type;
@@ -114,30 +114,50 @@ private:
 
         const El::Grid& grid = A.Grid();
 
-        El::DistMatrix<value_type, El::STAR, ColDist> R(grid);
+        El::DistMatrix<value_type, El::STAR, ColDist> R1(grid);
         El::DistMatrix<value_type, El::STAR, El::STAR>
             sketch_of_A_STAR_STAR(grid);
+        El::DistMatrix<value_type> sketch_of_A11(grid);
+        El::Matrix<value_type> A1;
 
-        data_type::realize_matrix_view(R);
-
-        // TODO: is alignment necessary?
-
-        // Global size of the result of the Local Gemm that follows
-        sketch_of_A_STAR_STAR.Resize(R.Height(),
-                                     A.Width());
-
-        // Local Gemm
-        base::Gemm(El::NORMAL,
-                   El::NORMAL,
-                   value_type(1),
-                   R.LockedMatrix(),
-                   A.LockedMatrix(),
-                   sketch_of_A_STAR_STAR.Matrix());
-
-        // Reduce-scatter within process grid
-        El::Zero(sketch_of_A);
-        El::AxpyContract(value_type(1), sketch_of_A_STAR_STAR, sketch_of_A);
-
+        // Blocked over the rows of the sketch and the columns of A, so that
+        // neither the sketching matrix nor the (replicated) partial sketch
+        // are ever held whole: with no blocking the partial sketch alone is
+        // S x Width(A) on every rank.
+        int blocksize = get_blocksize();
+        if (blocksize == 0)
+            blocksize = std::max(sketch_of_A.Height(), A.Width());
+
+        for(int i = 0; i < sketch_of_A.Height(); i += blocksize) {
+            int bi = std::min(static_cast<int>(sketch_of_A.Height()) - i,
+                blocksize);
+
+            // TODO: is alignment necessary?
+            data_type::realize_matrix_view(R1, i, 0, bi, A.Height());
+
+            for(int j = 0; j < A.Width(); j += blocksize) {
+                int bj = std::min(static_cast<int>(A.Width()) - j,
+                    blocksize);
+
+                El::LockedView(A1, A.LockedMatrix(), 0, j,
+                    A.LocalHeight(), bj);
+                sketch_of_A_STAR_STAR.Resize(bi, bj);
+
+                // Local Gemm
+                base::Gemm(El::NORMAL,
+                           El::NORMAL,
+                           value_type(1),
+                           R1.LockedMatrix(),
+                           A1,
+                           sketch_of_A_STAR_STAR.Matrix());
+
+                // Reduce-scatter within process grid
+                El::View(sketch_of_A11, sketch_of_A, i, j, bi, bj);
+                El::Zero(sketch_of_A11);
+                El::AxpyContract(value_type(1), sketch_of_A_STAR_STAR,
+                    sketch_of_A11);
+            }
+        }
     }
 
 
@@ -1,6 +1,9 @@
 #ifndef SKYLARK_DENSE_TRANSFORM_ELEMENTAL_LOCAL_HPP
 #define SKYLARK_DENSE_TRANSFORM_ELEMENTAL_LOCAL_HPP
 
+#include <algorithm>
+#include <vector>
+
 #include "../base/base.hpp"
 
 #include "transforms.hpp"
@@ -76,7 +79,7 @@ struct dense_transform_t <
 private:
 
     // TODO: Block-by-block mode
-    void apply_impl_local (const matrix_type& A,
+    void apply_impl_local (const El::Matrix<value_type>& A,
                           output_matrix_type& sketch_of_A,
                           skylark::sketch::rowwise_tag tag) const {
 
@@ -94,7 +97,7 @@ private:
 
 
     // TODO: Block-by-block mode
-    void apply_impl_local (const matrix_type& A,
+    void apply_impl_local (const El::Matrix<value_type>& A,
                           output_matrix_type& sketch_of_A,
                           skylark::sketch::columnwise_tag tag) const {
 
@@ -109,6 +112,91 @@ private:
                     value_type(0),
                     sketch_of_A);
     }
+
+    /**
+     * Sparse input, rowwise: only the columns of the matrix at the nonempty
+     * columns of A are realized (S x k, not S x N), and A is never densified.
+     */
+    void apply_impl_local (const base::sparse_matrix_t<value_type>& A,
+                          output_matrix_type& sketch_of_A,
+                          skylark::sketch::rowwise_tag tag) const {
+
+        const int *indptr = A.indptr();
+        const int *indices = A.indices();
+        const value_type *values = A.locked_values();
+
+        std::vector<int> cols;
+        for(int col = 0; col < A.width(); col++)
+            if (indptr[col + 1] > indptr[col])
+                cols.push_back(col);
+
+        output_matrix_type R;
+        data_type::realize_matrix_columns(R, cols);
+        const value_type *r = R.LockedBuffer();
+        const int ldr = R.LDim();
+
+        El::Zero(sketch_of_A);
+        value_type *sa = sketch_of_A.Buffer();
+        const int ldsa = sketch_of_A.LDim();
+        const int S = data_type::_S;
+        const int k = cols.size();
+
+        // Columns of the output are independent.
+#       ifdef SKYLARK_HAVE_OPENMP
+#       pragma omp parallel for
+#       endif
+        for(int l = 0; l < S; l++) {
+            value_type *sal = sa + l * ldsa;
+            for(int c = 0; c < k; c++) {
+                value_type rv = r[c * ldr + l];
+                for(int idx = indptr[cols[c]]; idx < indptr[cols[c] + 1]; idx++)
+                    sal[indices[idx]] += values[idx] * rv;
+            }
+        }
+    }
+
+    /**
+     * Sparse input, columnwise: only the columns of the matrix at the
+     * nonzero rows of A are realized, and A is never densified.
+     */
+    void apply_impl_local (const base::sparse_matrix_t<value_type>& A,
+                          output_matrix_type& sketch_of_A,
+                          skylark::sketch::columnwise_tag tag) const {
+
+        const int *indptr = A.indptr();
+        const int *indices = A.indices();
+        const value_type *values = A.locked_values();
+        const int nnz = indptr[A.width()];
+
+        std::vector<int> rows(indices, indices + nnz);
+        std::sort(rows.begin(), rows.end());
+        rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+        output_matrix_type R;
+        data_type::realize_matrix_columns(R, rows);
+        const value_type *r = R.LockedBuffer();
+        const int ldr = R.LDim();
+
+        El::Zero(sketch_of_A);
+        value_type *sa = sketch_of_A.Buffer();
+        const int ldsa = sketch_of_A.LDim();
+        const int S = data_type::_S;
+
+#       ifdef SKYLARK_HAVE_OPENMP
+#       pragma omp parallel for
+#       endif
+        for(int col = 0; col < A.width(); col++) {
+            value_type *sac = sa + col * ldsa;
+            for(int idx = indptr[col]; idx < indptr[col + 1]; idx++) {
+                int c = std::lower_bound(rows.begin(), rows.end(),
+                    indices[idx]) - rows.begin();
+                const value_type *rc = r + c * ldr;
+                value_type v = values[idx];
+                for(int l = 0; l < S; l++)
+                    sac[l] += v * rc[l];
+            }
+        }
+    }
 };
 
 template <typename ValueType,
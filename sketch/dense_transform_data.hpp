@@ -34,7 +34,7 @@ struct dense_transform_data_t : public sketch_transform_data_t {
     dense_transform_data_t (int N, int S, double scale,
         base::context_t& context)
         : base_t(N, S, context, "DenseTransform"),
-          scale(scale) {
+          scale(scale), _realized(new realized_t()) {
 
         // No scaling in "raw" form
         context = build();
@@ -60,10 +60,24 @@ struct dense_transform_data_t : public sketch_transform_data_t {
 
     dense_transform_data_t(const dense_transform_data_t& other)
         : base_t(other), scale(other.scale),
-          entries(other.entries)  {
+          entries(other.entries), _realized(other._realized)  {
 
     }
 
+    /**
+     * Computes the scaled samples once (S x N doubles) and keeps them. Later
+     * realizations, by this object or any of its copies (including copies
+     * made before, such as the transform a sketch applies), copy them
+     * instead of computing every sample again.
+     */
+    virtual void keep_realized() const {
+        if (_realized->kept)
+            return;
+
+        realize_matrix_view(_realized->samples);
+        _realized->kept = true;
+    }
+
     template<typename T>
     void realize_matrix_view(El::Matrix<T>& A) const {
         realize_matrix_view(A, 0, 0, _S, _N);
@@ -84,6 +98,23 @@ struct dense_transform_data_t : public sketch_transform_data_t {
         A.Resize(height, width);
         T *data = A.Buffer();
 
+        if (_realized->kept) {
+            const value_type *realized = _realized->samples.LockedBuffer();
+
+#           ifdef SKYLARK_HAVE_OPENMP
+#           pragma omp parallel for
+#           endif
+            for(size_t j_loc = 0; j_loc < width; j_loc++) {
+                size_t j_glob = j + j_loc * row_stride;
+                for (size_t i_loc = 0; i_loc < height; i_loc++) {
+                    size_t i_glob = i + i_loc * col_stride;
+                    data[j_loc * height + i_loc] =
+                        realized[j_glob * _S + i_glob];
+                }
+            }
+            return;
+        }
+
 #       ifdef SKYLARK_HAVE_OPENMP
 #       pragma omp parallel for
 #       endif
@@ -101,6 +132,37 @@ struct dense_transform_data_t : public sketch_transform_data_t {
     }
 
 
+    /**
+     * Realizes only the columns cols[0], cols[1], ... of the matrix, as the
+     * columns of A (S x cols.size()). A sparse input only meets the columns
+     * at the indices of its nonzero rows, which can be a small fraction of N.
+     */
+    template<typename T>
+    void realize_matrix_columns(El::Matrix<T>& A,
+        const std::vector<int>& cols) const {
+
+        const int width = cols.size();
+        A.Resize(_S, width);
+        T *data = A.Buffer();
+        const size_t ld = A.LDim();
+
+#       ifdef SKYLARK_HAVE_OPENMP
+#       pragma omp parallel for
+#       endif
+        for(int j_loc = 0; j_loc < width; j_loc++) {
+            size_t j_glob = cols[j_loc];
+            T *col = data + j_loc * ld;
+            if (_realized->kept) {
+                const value_type *realized =
+                    _realized->samples.LockedBuffer() + j_glob * _S;
+                for (int i = 0; i < _S; i++)
+                    col[i] = realized[i];
+            } else
+                for (int i = 0; i < _S; i++)
+                    col[i] = scale * entries[j_glob * _S + i];
+        }
+    }
+
     template<typename T, El::Distribution ColDist,
              El::Distribution RowDist>
     void realize_matrix_view(El::DistMatrix<T,
@@ -157,7 +219,7 @@ protected:
     dense_transform_data_t (int N, int S, double scale,
         const base::context_t& context, std::string type)
         : base_t(N, S, context, type),
-          scale(scale) {
+          scale(scale), _realized(new realized_t()) {
 
     }
 
@@ -171,6 +233,17 @@ protected:
 
     double scale; /**< Scaling factor for the samples */
     value_accesor_type entries; /**< Samples (lazily computed) */
+
+    /** Scaled samples, if kept (see keep_realized) */
+    struct realized_t {
+        bool kept;
+        El::Matrix<value_type> samples;
+
+        realized_t() : kept(false) {}
+    };
+
+    /** Shared by all copies */
+    boost::shared_ptr<realized_t> _realized;
 };
 
 } } /** namespace skylark::sketch */
@@ -39,6 +39,15 @@ struct sketch_transform_data_t {
     virtual
     boost::property_tree::ptree to_ptree() const = 0;
 
+    /**
+     * Hint that the transform is about to be applied many times (e.g. when
+     * serving predictions). Transforms that compute a matrix of samples on
+     * every application keep it in memory from now on. Default: nothing.
+     */
+    virtual void keep_realized() const {
+
+    }
+
     virtual ~sketch_transform_data_t() {
 
     }
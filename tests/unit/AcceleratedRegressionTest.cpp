@@ -0,0 +1,158 @@
+/**
+ *  This test checks the preconditioners of the sketched least squares
+ *  solver (simplified Blendenpik) on a [VC,STAR] ill conditioned problem:
+ *
+ *    - dist_qr_precond_tag and dist_svd_precond_tag, which keep the sketch
+ *      and the factor in [MC,MR], give the same solutions as the replicated
+ *      qr_precond_tag and svd_precond_tag, and the least squares solution,
+ *      computed from a known factorization of A.
+ *    - On a rank deficient A (a zero column) the SVD preconditioners drop
+ *      the zero singular value: the solutions are finite, and the minimum
+ *      norm solution.
+ *
+ *      - Elemental Gemm, QR and SVD are implemented correctly.
+ *      - LSQR is implemented correctly.
+ */
+
+#include <cmath>
+
+#include <boost/mpi.hpp>
+#include <boost/test/minimal.hpp>
+
+#define SKYLARK_NO_ANY
+
+#include "../../skylark.hpp"
+
+#include "test_utils.hpp"
+
+namespace skyb = skylark::base;
+namespace skys = skylark::sketch;
+namespace skyalg = skylark::algorithms;
+
+typedef El::DistMatrix<double, El::VC, El::STAR> vc_star_matrix_t;
+typedef El::DistMatrix<double, El::STAR, El::STAR> star_star_matrix_t;
+
+typedef skyalg::regression_problem_t<vc_star_matrix_t, skyalg::linear_tag,
+                                     skyalg::l2_tag, skyalg::no_reg_tag>
+    problem_t;
+
+/** Largest relative difference between columns of X and Y. */
+double colreldiff(const star_star_matrix_t& X, const star_star_matrix_t& Y) {
+    double worst = 0.0;
+    for(El::Int j = 0; j < Y.Width(); j++) {
+        double diff = 0.0, nrm = 0.0;
+        for(El::Int i = 0; i < Y.Height(); i++) {
+            double d = X.GetLocal(i, j) - Y.GetLocal(i, j);
+            diff += d * d;
+            nrm += Y.GetLocal(i, j) * Y.GetLocal(i, j);
+        }
+        worst = std::max(worst, std::sqrt(diff / nrm));
+    }
+    return worst;
+}
+
+/**
+ * Solves min ||A X - B|| with the PrecondTag preconditioner, built from the
+ * same sketch (same seed) for every tag.
+ */
+template<typename PrecondTag>
+void solve(const vc_star_matrix_t& A, const vc_star_matrix_t& B,
+    star_star_matrix_t& X) {
+
+    skyb::context_t context(619);
+    problem_t problem(A.Height(), A.Width(), A);
+    skyalg::accelerated_regression_solver_t<problem_t, vc_star_matrix_t,
+        star_star_matrix_t,
+        skyalg::simplified_blendenpik_tag<skys::JLT_t, PrecondTag> >
+        solver(problem, context);
+
+    El::Zeros(X, A.Width(), B.Width());
+    solver.solve(B, X);
+}
+
+/**
+ * A = Q diag(s) with orthonormal Q, and the minimum norm least squares
+ * solution diag(s)^+ Q' B.
+ */
+void make_problem(const vc_star_matrix_t& Q, const star_star_matrix_t& s,
+    const vc_star_matrix_t& B, vc_star_matrix_t& A, star_star_matrix_t& Xls) {
+
+    star_star_matrix_t sinv(s);
+    for(El::Int j = 0; j < s.Height(); j++)
+        sinv.SetLocal(j, 0,
+            s.GetLocal(j, 0) == 0.0 ? 0.0 : 1.0 / s.GetLocal(j, 0));
+
+    A = Q;
+    El::DiagonalScale(El::RIGHT, El::NORMAL, s, A);
+
+    skyb::Gemm(El::ADJOINT, El::NORMAL, 1.0, Q, B, Xls);
+    El::DiagonalScale(El::LEFT, El::NORMAL, sinv, Xls);
+}
+
+int test_main(int argc, char *argv[]) {
+
+    El::Initialize(argc, argv);
+
+    boost::mpi::communicator world;
+    El::Grid grid(world);
+    skyb::context_t context(23);
+
+    const El::Int m = 500, n = 20, k = 3;
+
+    vc_star_matrix_t Q(grid), B(grid);
+    skyb::GaussianMatrix(Q, m, n, context);
+    El::qr::ExplicitUnitary(Q);
+    skyb::GaussianMatrix(B, m, k, context);
+
+    // s = diag(1 .. 1e-3).
+    star_star_matrix_t s(n, 1, grid);
+    for(El::Int j = 0; j < n; j++)
+        s.SetLocal(j, 0, std::pow(10.0, -3.0 * j / (n - 1)));
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Distributed against replicated preconditioners <]
+
+    {
+        vc_star_matrix_t A(grid);
+        star_star_matrix_t Xls(grid);
+        make_problem(Q, s, B, A, Xls);
+
+        star_star_matrix_t Xqr(grid), Xdqr(grid), Xsvd(grid), Xdsvd(grid);
+        solve<skyalg::qr_precond_tag>(A, B, Xqr);
+        solve<skyalg::dist_qr_precond_tag>(A, B, Xdqr);
+        solve<skyalg::svd_precond_tag>(A, B, Xsvd);
+        solve<skyalg::dist_svd_precond_tag>(A, B, Xdsvd);
+
+        BOOST_REQUIRE(colreldiff(Xqr, Xls) < 1e-8);
+        BOOST_REQUIRE(colreldiff(Xsvd, Xls) < 1e-8);
+        BOOST_REQUIRE(colreldiff(Xdqr, Xqr) < 1e-10);
+        BOOST_REQUIRE(colreldiff(Xdsvd, Xsvd) < 1e-10);
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Rank deficient <]
+
+    {
+        star_star_matrix_t sd(s);
+        sd.SetLocal(n - 1, 0, 0.0);
+
+        vc_star_matrix_t A(grid);
+        star_star_matrix_t Xls(grid);
+        make_problem(Q, sd, B, A, Xls);
+
+        star_star_matrix_t Xsvd(grid), Xdsvd(grid);
+        solve<skyalg::svd_precond_tag>(A, B, Xsvd);
+        solve<skyalg::dist_svd_precond_tag>(A, B, Xdsvd);
+
+        for(El::Int j = 0; j < k; j++)
+            for(El::Int i = 0; i < n; i++)
+                BOOST_REQUIRE(std::isfinite(Xsvd.GetLocal(i, j)) &&
+                    std::isfinite(Xdsvd.GetLocal(i, j)));
+
+        BOOST_REQUIRE(colreldiff(Xsvd, Xls) < 1e-8);
+        BOOST_REQUIRE(colreldiff(Xdsvd, Xls) < 1e-8);
+    }
+
+    El::Finalize();
+    return 0;
+}
@@ -0,0 +1,148 @@
+/**
+ *  This test checks the variants of BlockADMMSolver::train against the
+ *  default (blocking, reduce and broadcast, one example block per rank)
+ *  path, on a small kernel regression problem split over two ranks:
+ *
+ *    - set_pipelined, set_allreduce_consensus, and both: the same Wbar, bit
+ *      by bit (with the allreduce consensus, on every rank).
+ *    - set_feature_groups(2), with as many feature partitions: the same Wbar,
+ *      bit by bit, as the default path with all the examples on one rank.
+ *    - float ComputeType: the same Wbar, up to float rounding.
+ *
+ *  Only two ranks (or partitions) add up each sum, so the order in which
+ *  they are added does not change it.
+ *
+ *      - Elemental Gemm and Inverse are implemented correctly.
+ */
+
+#include <cmath>
+
+#include <boost/mpi.hpp>
+#include <boost/test/minimal.hpp>
+
+#define SKYLARK_NO_ANY
+
+#include "../../skylark.hpp"
+#include "../../ml/utils.hpp"
+#include "../../ml/BlockADMM.hpp"
+
+#include "test_utils.hpp"
+
+namespace skyb = skylark::base;
+namespace skyml = skylark::ml;
+namespace skyalg = skylark::algorithms;
+
+typedef El::Matrix<double> matrix_t;
+
+/** Examples (columns of X, rows of Y) of block part out of parts. */
+void examples(const matrix_t& X, const matrix_t& Y, int part, int parts,
+    matrix_t& Xp, matrix_t& Yp) {
+
+    El::Int n = X.Width() / parts, j0 = part * n;
+    Xp.Resize(X.Height(), n);
+    Yp.Resize(n, 1);
+    for(El::Int j = 0; j < n; j++) {
+        for(El::Int i = 0; i < X.Height(); i++)
+            Xp.Set(i, j, X.Get(i, j0 + j));
+        Yp.Set(j, 0, Y.Get(j0 + j, 0));
+    }
+}
+
+/**
+ * Wbar of train on comm, with the same feature maps (same seed) for every
+ * variant.
+ */
+template<typename ComputeType>
+matrix_t train(matrix_t& X, matrix_t& Y, int partitions, bool pipelined,
+    bool allreduce, int groups, const boost::mpi::communicator& comm) {
+
+    const int features = 48;
+
+    skyalg::squared_loss_t<double> loss;
+    skyalg::l2_regularizer_t<double> regularizer;
+    skyb::context_t context(71);
+
+    BlockADMMSolver<matrix_t, ComputeType> Solver(context, &loss,
+        &regularizer, 0.1, features, skyml::gaussian_t(X.Height(), 2.0),
+        skyml::regular_feature_transform_tag(), partitions);
+    Solver.set_maxiter(8);
+    Solver.set_pipelined(pipelined);
+    Solver.set_allreduce_consensus(allreduce);
+    Solver.set_feature_groups(groups);
+
+    matrix_t Xv, Yv;
+    skyml::hilbert_model_t *model =
+        Solver.train(X, Y, Xv, Yv, true, comm);
+    matrix_t Wbar(model->get_coef());
+    delete model;
+    return Wbar;
+}
+
+double maxdiff(const matrix_t& A, const matrix_t& B) {
+    matrix_t D(A);
+    El::Axpy(-1.0, B, D);
+    return El::MaxNorm(D);
+}
+
+int test_main(int argc, char *argv[]) {
+
+    El::Initialize(argc, argv);
+
+    boost::mpi::communicator world;
+    const int rank = world.rank(), size = world.size();
+
+    // The same examples on all ranks; each trains on its block.
+    const El::Int d = 5, n = 40 * size;
+    skyb::context_t context(17);
+    matrix_t X, Y;
+    skyb::GaussianMatrix(X, d, n, context);
+    El::Zeros(Y, n, 1);
+    for(El::Int j = 0; j < n; j++)
+        Y.Set(j, 0, X.Get(0, j) * X.Get(1, j));
+
+    matrix_t Xr, Yr;
+    examples(X, Y, rank, size, Xr, Yr);
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Pipelined and allreduce consensus <]
+
+    {
+        matrix_t W0 = train<double>(Xr, Yr, 3, false, false, 1, world);
+        boost::mpi::broadcast(world, W0.Buffer(), W0.Height() * W0.Width(),
+            0);
+
+        matrix_t Wp = train<double>(Xr, Yr, 3, true, false, 1, world);
+        if (rank == 0)
+            BOOST_REQUIRE(maxdiff(Wp, W0) == 0.0);
+
+        matrix_t Wa = train<double>(Xr, Yr, 3, false, true, 1, world);
+        BOOST_REQUIRE(maxdiff(Wa, W0) == 0.0);
+
+        matrix_t Wpa = train<double>(Xr, Yr, 3, true, true, 1, world);
+        BOOST_REQUIRE(maxdiff(Wpa, W0) == 0.0);
+
+        //////////////////////////////////////////////////////////////////////
+        //[> Float ComputeType <]
+
+        matrix_t Wf = train<float>(Xr, Yr, 3, false, false, 1, world);
+        if (rank == 0)
+            BOOST_REQUIRE(maxdiff(Wf, W0) <= 1e-4 * El::MaxNorm(W0));
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Feature groups <]
+
+    {
+        // All the ranks form one example block, against all the examples
+        // on one rank.
+        boost::mpi::communicator self = world.split(rank);
+        matrix_t W1 = train<double>(X, Y, size, false, false, 1, self);
+
+        matrix_t Wg = train<double>(Xr, Yr, size, false, false, size, world);
+        if (rank == 0)
+            BOOST_REQUIRE(maxdiff(Wg, W1) == 0.0);
+    }
+
+    El::Finalize();
+    return 0;
+}
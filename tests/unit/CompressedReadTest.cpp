@@ -0,0 +1,279 @@
+/**
+ *  This test checks the compressed readers: multi-member gzip and
+ *  multi-frame zstd files (with and without content sizes and checksums,
+ *  with a skippable frame) are indexed frame by frame, decompressed whole,
+ *  split among ranks with full lines only, read by the LIBSVM reader as
+ *  the uncompressed file is, and the scanned index is saved and reused,
+ *  but not once the compressed file is replaced.
+ *  Truncated input and missing files raise errors.
+ *
+ *      - zlib and zstd are implemented correctly.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/mpi.hpp>
+#include <boost/test/minimal.hpp>
+
+#define SKYLARK_NO_ANY
+
+#include "../../skylark.hpp"
+
+#include "test_utils.hpp"
+
+namespace skyio = skylark::utility::io;
+
+/** A small LIBSVM file, as text. */
+std::string libsvm_text(int n) {
+    std::ostringstream out;
+    for(int i = 0; i < n; i++)
+        out << (i % 3) - 1 << " " << (i % 5) + 1 << ":" << 0.5 * i
+            << " 7:" << i % 11 << "\n";
+    return out.str();
+}
+
+std::string read_all(const std::string& fname) {
+    std::ifstream in(fname, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in),
+        std::istreambuf_iterator<char>());
+}
+
+#ifdef SKYLARK_HAVE_ZLIB
+
+/** gzip file with one member per part (as pigz --independent writes). */
+void write_gzip(const std::string& fname, const std::string& text,
+    int parts) {
+
+    std::remove(fname.c_str());
+    size_t part = text.size() / parts;
+    for(int m = 0; m < parts; m++) {
+        size_t b = m * part, e = (m == parts - 1) ? text.size() : b + part;
+        gzFile g = gzopen(fname.c_str(), "ab");
+        gzwrite(g, text.data() + b, e - b);
+        gzclose(g);
+    }
+}
+
+#endif
+
+#ifdef SKYLARK_HAVE_ZSTD
+
+/**
+ * zstd file with one frame per part. Odd frames are streamed (no content
+ * size, with a checksum), and a skippable frame follows the second one.
+ */
+void write_zstd(const std::string& fname, const std::string& text,
+    int parts) {
+
+    std::ofstream out(fname, std::ios::binary);
+    size_t part = text.size() / parts;
+    for(int m = 0; m < parts; m++) {
+        size_t b = m * part, e = (m == parts - 1) ? text.size() : b + part;
+        std::vector<char> buff(ZSTD_compressBound(e - b));
+        size_t size;
+        if (m % 2 == 0)
+            size = ZSTD_compress(&buff[0], buff.size(), text.data() + b,
+                e - b, 3);
+        else {
+            ZSTD_CCtx *cctx = ZSTD_createCCtx();
+            ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+            ZSTD_inBuffer input = {text.data() + b, e - b, 0};
+            ZSTD_outBuffer output = {&buff[0], buff.size(), 0};
+            ZSTD_compressStream2(cctx, &output, &input, ZSTD_e_end);
+            size = output.pos;
+            ZSTD_freeCCtx(cctx);
+        }
+        out.write(&buff[0], size);
+
+        if (m == 1) {
+            const unsigned char skippable[] =
+                {0x50, 0x2A, 0x4D, 0x18, 4, 0, 0, 0, 1, 2, 3, 4};
+            out.write(reinterpret_cast<const char *>(skippable), 12);
+        }
+    }
+}
+
+#endif
+
+void check_file(const std::string& fname, const std::string& plain,
+    const std::string& text, skyio::compression_t compression,
+    size_t num_frames, boost::mpi::communicator& world) {
+
+    BOOST_REQUIRE(skyio::DetectCompression(fname) == compression);
+
+    if (world.rank() == 0) {
+        std::remove((fname + ".fidx").c_str());
+        skyio::frame_index_t index = skyio::FrameIndex(fname, compression);
+        BOOST_REQUIRE(index.size() == num_frames);
+
+        std::vector<char> data;
+        skyio::ReadCompressedFile(fname, compression, data);
+        BOOST_REQUIRE(std::string(data.begin(), data.end()) == text);
+
+        std::unique_ptr<std::istream> in = skyio::OpenInput(fname);
+        std::ostringstream out;
+        out << in->rdbuf();
+        BOOST_REQUIRE(out.str() == text);
+    }
+    world.barrier();
+
+    // Split among ranks: full lines only, nothing lost or repeated.
+    std::vector<char> data;
+    size_t data_start;
+    skyio::ParallelCompressedRead(fname, world, compression, data,
+        data_start);
+    std::string mine(data.begin() + data_start, data.end());
+    BOOST_REQUIRE(mine.empty() || mine[mine.size() - 1] == '\n');
+
+    std::vector<std::string> all;
+    boost::mpi::gather(world, mine, all, 0);
+    if (world.rank() == 0) {
+        std::string whole;
+        for(size_t r = 0; r < all.size(); r++)
+            whole += all[r];
+        BOOST_REQUIRE(whole == text);
+
+        // The scanned index was saved, and is used from now on.
+        skyio::frame_index_t saved;
+        BOOST_REQUIRE(skyio::ReadFrameIndex(fname + ".fidx",
+                skyio::FileStamp(fname), saved));
+        BOOST_REQUIRE(saved.size() == num_frames);
+    }
+    world.barrier();
+
+    // The LIBSVM reader sees the same matrix as for the plain file.
+    El::Matrix<double> X, Y, Xc, Yc;
+    skyio::ReadLIBSVM(plain, X, Y, skylark::base::ROWS);
+    skyio::ReadLIBSVM(fname, Xc, Yc, skylark::base::ROWS);
+    BOOST_REQUIRE(X.Height() == Xc.Height() && X.Width() == Xc.Width());
+    El::Axpy(-1.0, X, Xc);
+    El::Axpy(-1.0, Y, Yc);
+    BOOST_REQUIRE(El::FrobeniusNorm(Xc) == 0.0);
+    BOOST_REQUIRE(El::FrobeniusNorm(Yc) == 0.0);
+
+    // Truncated input is an error.
+    if (world.rank() == 0) {
+        std::string compressed = read_all(fname);
+        std::string tname = "compressed_read_test.truncated";
+        std::remove((tname + ".fidx").c_str());
+        std::ofstream(tname, std::ios::binary)
+            << compressed.substr(0, compressed.size() - 50);
+
+        bool caught = false;
+        try {
+            std::vector<char> data;
+            skyio::ReadCompressedFile(tname, compression, data);
+        } catch (skylark::base::io_exception& ex) {
+            caught = true;
+        }
+        BOOST_REQUIRE(caught);
+        std::remove(tname.c_str());
+    }
+    world.barrier();
+}
+
+int test_main(int argc, char *argv[]) {
+
+    El::Initialize(argc, argv);
+
+    boost::mpi::communicator world;
+
+    const std::string text = libsvm_text(5000);
+    const std::string plain = "compressed_read_test.libsvm";
+    if (world.rank() == 0)
+        std::ofstream(plain, std::ios::binary) << text;
+    world.barrier();
+
+#ifdef SKYLARK_HAVE_ZLIB
+    {
+        const std::string fname = "compressed_read_test.libsvm.gz";
+        if (world.rank() == 0)
+            write_gzip(fname, text, 5);
+        world.barrier();
+        check_file(fname, plain, text, skyio::GZIP_COMPRESSION, 5, world);
+
+        // Members are inflated in chunks when they do not fit a uInt.
+        if (world.rank() == 0) {
+            skyio::frame_index_t index =
+                skyio::FrameIndex(fname, skyio::GZIP_COMPRESSION);
+            std::string compressed = read_all(fname);
+            std::vector<char> whole, chunked;
+            skyio::detail::gunzip_frame(compressed.data(), index[0].size,
+                whole, 0);
+            skyio::detail::gunzip_frame(compressed.data(), index[0].size,
+                chunked, 0, 7);
+            BOOST_REQUIRE(whole == chunked);
+            BOOST_REQUIRE(whole.size() == index[0].uncompressed_size);
+        }
+
+        // A replaced file is indexed again, not read with the stale index.
+        if (world.rank() == 0) {
+            const std::string other = libsvm_text(3000);
+            write_gzip(fname, other, 3);
+            skyio::frame_index_t stale;
+            BOOST_REQUIRE(!skyio::ReadFrameIndex(fname + ".fidx",
+                    skyio::FileStamp(fname), stale));
+
+            skyio::frame_index_t index =
+                skyio::FrameIndex(fname, skyio::GZIP_COMPRESSION, true);
+            BOOST_REQUIRE(index.size() == 3);
+            std::vector<char> data;
+            skyio::ReadCompressedFile(fname, skyio::GZIP_COMPRESSION, data);
+            BOOST_REQUIRE(std::string(data.begin(), data.end()) == other);
+
+            skyio::frame_index_t saved;
+            BOOST_REQUIRE(skyio::ReadFrameIndex(fname + ".fidx",
+                    skyio::FileStamp(fname), saved));
+            BOOST_REQUIRE(saved.size() == 3);
+        }
+
+        world.barrier();
+        if (world.rank() == 0) {
+            std::remove(fname.c_str());
+            std::remove((fname + ".fidx").c_str());
+        }
+    }
+#endif
+
+#ifdef SKYLARK_HAVE_ZSTD
+    {
+        const std::string fname = "compressed_read_test.libsvm.zst";
+        if (world.rank() == 0)
+            write_zstd(fname, text, 4);
+        world.barrier();
+        check_file(fname, plain, text, skyio::ZSTD_COMPRESSION, 4, world);
+
+        world.barrier();
+        if (world.rank() == 0) {
+            std::remove(fname.c_str());
+            std::remove((fname + ".fidx").c_str());
+        }
+    }
+#endif
+
+    // A missing file raises on every rank, not only on the reading one.
+    {
+        bool caught = false;
+        try {
+            std::vector<char> data;
+            size_t data_start;
+            skyio::ParallelCompressedRead("compressed_read_test.missing",
+                world, skyio::GZIP_COMPRESSION, data, data_start);
+        } catch (skylark::base::skylark_exception& ex) {
+            caught = true;
+        }
+        BOOST_REQUIRE(caught);
+    }
+
+    world.barrier();
+    if (world.rank() == 0)
+        std::remove(plain.c_str());
+
+    El::Finalize();
+    return 0;
+}
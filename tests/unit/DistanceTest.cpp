@@ -0,0 +1,175 @@
+/**
+ *  This test checks the distance matrices against distances computed entry
+ *  by entry from the points:
+ *
+ *    - EuclideanDistanceMatrix and L1DistanceMatrix for points in the
+ *      columns or rows of A and of B (all four combinations), with alpha
+ *      and beta, on local and [MC,MR] matrices.
+ *    - SymmetricEuclideanDistanceMatrix and SymmetricL1DistanceMatrix in
+ *      the lower and upper triangles: the other triangle is not changed.
+ *
+ *  Sizes span several tiles and feature blocks (and Elemental blocks), and
+ *  the [MC,MR] matrices are split over both grid dimensions on 4 ranks.
+ *
+ *      - Elemental Gemm and Herk are implemented correctly.
+ */
+
+#include <cmath>
+
+#include <boost/mpi.hpp>
+#include <boost/test/minimal.hpp>
+
+#define SKYLARK_NO_ANY
+
+#include "../../skylark.hpp"
+
+#include "test_utils.hpp"
+
+namespace skyb = skylark::base;
+
+typedef El::Matrix<double> matrix_t;
+typedef El::DistMatrix<double> dist_matrix_t;
+
+void local_copy(const matrix_t& A, matrix_t& B) {
+    B = A;
+}
+
+void local_copy(const dist_matrix_t& A, matrix_t& B) {
+    El::DistMatrix<double, El::STAR, El::STAR> A_STAR_STAR(A);
+    B = A_STAR_STAR.Matrix();
+}
+
+/** Feature k of point i of A. */
+double feature(skyb::direction_t dir, const matrix_t& A, El::Int k,
+    El::Int i) {
+    return dir == skyb::COLUMNS ? A.Get(k, i) : A.Get(i, k);
+}
+
+/** Squared euclidean (l1 if l1 is true) distance of point i and point j. */
+double distance(skyb::direction_t dirA, skyb::direction_t dirB,
+    const matrix_t& A, const matrix_t& B, El::Int i, El::Int j, bool l1) {
+
+    const El::Int d = dirA == skyb::COLUMNS ? A.Height() : A.Width();
+    double s = 0;
+    for(El::Int k = 0; k < d; k++) {
+        double diff = feature(dirA, A, k, i) - feature(dirB, B, k, j);
+        s += l1 ? std::abs(diff) : diff * diff;
+    }
+    return s;
+}
+
+/**
+ * Requires C = beta * C0 + alpha * D(A, B) in the uplo triangle (everywhere
+ * if null), and C = C0 outside of it, entry by entry.
+ */
+template<typename MatrixType>
+void check_distances(skyb::direction_t dirA, skyb::direction_t dirB,
+    double alpha, const MatrixType& AD, const MatrixType& BD, double beta,
+    const MatrixType& C0D, const MatrixType& CD, bool l1,
+    const El::UpperOrLower *uplo = nullptr) {
+
+    matrix_t A, B, C0, C;
+    local_copy(AD, A);
+    local_copy(BD, B);
+    local_copy(C0D, C0);
+    local_copy(CD, C);
+
+    for(El::Int j = 0; j < C.Width(); j++)
+        for(El::Int i = 0; i < C.Height(); i++) {
+            if (uplo != nullptr && (*uplo == El::LOWER ? i < j : i > j)) {
+                BOOST_REQUIRE(C.Get(i, j) == C0.Get(i, j));
+                continue;
+            }
+            double D = distance(dirA, dirB, A, B, i, j, l1);
+            double expected = beta * C0.Get(i, j) + alpha * D;
+            BOOST_REQUIRE(std::abs(C.Get(i, j) - expected) <=
+                1e-12 * (std::abs(beta * C0.Get(i, j)) + alpha * D + 1.0));
+        }
+}
+
+template<typename MatrixType>
+void orient(skyb::direction_t dir, const MatrixType& P, MatrixType& X) {
+    if (dir == skyb::COLUMNS)
+        X = P;
+    else
+        El::Transpose(P, X);
+}
+
+template<typename MatrixType>
+void check_all(const MatrixType& PA, const MatrixType& PB,
+    const MatrixType& C0, const MatrixType& S0) {
+
+    const double alpha = 0.5, beta = 2.0;
+    skyb::direction_t dirs[] = {skyb::COLUMNS, skyb::ROWS};
+
+    for(int a = 0; a < 2; a++)
+        for(int b = 0; b < 2; b++) {
+            MatrixType A, B, C;
+            orient(dirs[a], PA, A);
+            orient(dirs[b], PB, B);
+
+            C = C0;
+            skyb::EuclideanDistanceMatrix(dirs[a], dirs[b], alpha, A, B,
+                beta, C);
+            check_distances(dirs[a], dirs[b], alpha, A, B, beta, C0, C,
+                false);
+
+            C = C0;
+            skyb::L1DistanceMatrix(dirs[a], dirs[b], alpha, A, B, beta, C);
+            check_distances(dirs[a], dirs[b], alpha, A, B, beta, C0, C, true);
+        }
+
+    El::UpperOrLower uplos[] = {El::LOWER, El::UPPER};
+    for(int a = 0; a < 2; a++)
+        for(int u = 0; u < 2; u++) {
+            MatrixType A, S;
+            orient(dirs[a], PA, A);
+
+            S = S0;
+            skyb::SymmetricEuclideanDistanceMatrix(uplos[u], dirs[a], alpha,
+                A, beta, S);
+            check_distances(dirs[a], dirs[a], alpha, A, A, beta, S0, S,
+                false, &uplos[u]);
+
+            S = S0;
+            skyb::SymmetricL1DistanceMatrix(uplos[u], dirs[a], alpha, A,
+                beta, S);
+            check_distances(dirs[a], dirs[a], alpha, A, A, beta, S0, S,
+                true, &uplos[u]);
+        }
+}
+
+int test_main(int argc, char *argv[]) {
+
+    El::Initialize(argc, argv);
+
+    // Points as columns: more than one feature block and tile.
+    const El::Int d = 300, m = 150, n = 133;
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Local matrices <]
+
+    {
+        matrix_t PA, PB, C0, S0;
+        El::Uniform(PA, d, m);
+        El::Uniform(PB, d, n);
+        El::Uniform(C0, m, n);
+        El::Uniform(S0, m, m);
+        check_all(PA, PB, C0, S0);
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> [MC,MR] matrices <]
+
+    {
+        dist_matrix_t PA, PB, C0, S0;      // on the default grid
+        El::Uniform(PA, d, m);
+        El::Uniform(PB, d, n);
+        El::Uniform(C0, m, n);
+        El::Uniform(S0, m, m);
+        check_all(PA, PB, C0, S0);
+    }
+
+    El::Finalize();
+    return 0;
+}
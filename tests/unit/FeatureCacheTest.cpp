@@ -0,0 +1,177 @@
+/**
+ *  This test checks the feature block cache: bfloat16 conversion (exact for
+ *  bfloat16 values, ties to even), and that plan() picks, identically on
+ *  every rank even when local sizes differ, the highest precision at which
+ *  all blocks fit the budget, or the leading blocks that fit at the lowest
+ *  allowed precision. Fetched blocks equal the stored ones up to the storage
+ *  precision, including blocks stored from views, and blocks not kept miss.
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <boost/mpi.hpp>
+#include <boost/test/minimal.hpp>
+
+#define SKYLARK_NO_ANY
+
+#include "../../skylark.hpp"
+
+#include "test_utils.hpp"
+
+namespace skyml = skylark::ml;
+
+typedef El::Matrix<double> matrix_t;
+
+const double MB = 1024.0 * 1024.0;
+
+void check_bfloat16() {
+    using skyml::detail::float_to_bfloat16;
+    using skyml::detail::bfloat16_to_float;
+
+    for(std::uint32_t h = 0; h < 0x10000; h++) {
+        float f = bfloat16_to_float(h);
+        if (!std::isnan(f))
+            BOOST_REQUIRE(float_to_bfloat16(f) == h);
+    }
+
+    // bfloat16 has 8 significant bits.
+    BOOST_REQUIRE(bfloat16_to_float(float_to_bfloat16(1.0f +
+                std::ldexp(1.0f, -8))) == 1.0f);
+    BOOST_REQUIRE(bfloat16_to_float(float_to_bfloat16(1.0f +
+                3 * std::ldexp(1.0f, -8))) == 1.0f + std::ldexp(1.0f, -6));
+    BOOST_REQUIRE(bfloat16_to_float(float_to_bfloat16(1.0f +
+                std::ldexp(1.0f, -8) + std::ldexp(1.0f, -12))) ==
+        1.0f + std::ldexp(1.0f, -7));
+}
+
+/**
+ * Plans for blocks with the given local sizes, stores them all, fetches them
+ * all, and checks the plan is the same on all ranks and the fetched blocks
+ * are within tol (relative) of the stored ones.
+ */
+void check_cache(skyml::feature_block_cache_t<double>& cache,
+    const std::vector<matrix_t>& blocks, int precision, int cached,
+    double tol, boost::mpi::communicator& world) {
+
+    std::vector<El::Int> sizes;
+    for(size_t c = 0; c < blocks.size(); c++)
+        sizes.push_back(blocks[c].Height() * blocks[c].Width());
+    cache.plan(sizes, world);
+
+    BOOST_REQUIRE(cache.num_blocks() == int(blocks.size()));
+    BOOST_REQUIRE(cache.precision() == precision);
+    BOOST_REQUIRE(cache.num_cached() == cached);
+
+    for(size_t c = 0; c < blocks.size(); c++)
+        cache.store(c, blocks[c]);
+
+    // Twice: fetches do not consume the blocks.
+    for(int rep = 0; rep < 2; rep++)
+        for(size_t c = 0; c < blocks.size(); c++) {
+            matrix_t Z(blocks[c].Height(), blocks[c].Width());
+            bool hit = cache.fetch(c, Z);
+            BOOST_REQUIRE(hit == (int(c) < cached));
+            if (hit) {
+                El::Axpy(-1.0, blocks[c], Z);
+                BOOST_REQUIRE(El::MaxNorm(Z) <=
+                    tol * El::MaxNorm(blocks[c]));
+            }
+        }
+
+    double rate = double(cached) / blocks.size();
+    BOOST_REQUIRE(std::abs(cache.hit_rate() - rate) < 1e-12);
+}
+
+int test_main(int argc, char *argv[]) {
+
+    El::Initialize(argc, argv);
+
+    boost::mpi::communicator world;
+
+    check_bfloat16();
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Plans and storage, with rank dependent local sizes <]
+
+    const int heights[] = {20, 30, 40};
+    const El::Int n = 100 + 10 * world.rank();
+    const El::Int nmax = 100 + 10 * (world.size() - 1);
+
+    std::vector<matrix_t> blocks(3);
+    double total = 0.0, first_two = 0.0;
+    for(int c = 0; c < 3; c++) {
+        El::Gaussian(blocks[c], heights[c], n);
+        total += heights[c] * nmax;
+        if (c < 2)
+            first_two += heights[c] * nmax;
+    }
+
+    const double feps = std::numeric_limits<float>::epsilon();
+    const double beps = std::ldexp(1.0, -8);
+
+    // Everything fits in full precision.
+    {
+        skyml::feature_block_cache_t<double> cache(total * 8 / MB);
+        check_cache(cache, blocks, skyml::FEATURE_CACHE_FULL, 3, 0.0, world);
+    }
+
+    // Fits in float, not in double. The largest local size decides, so
+    // the smaller ranks do not keep more than the others.
+    {
+        skyml::feature_block_cache_t<double> cache(total * 6 / MB);
+        check_cache(cache, blocks, skyml::FEATURE_CACHE_FLOAT, 3, feps,
+            world);
+    }
+
+    // Fits only in bfloat16.
+    {
+        skyml::feature_block_cache_t<double> cache(total * 3 / MB);
+        check_cache(cache, blocks, skyml::FEATURE_CACHE_BFLOAT16, 3, beps,
+            world);
+    }
+
+    // Not even in bfloat16: leading blocks only.
+    {
+        skyml::feature_block_cache_t<double> cache(first_two * 2 / MB);
+        check_cache(cache, blocks, skyml::FEATURE_CACHE_BFLOAT16, 2, beps,
+            world);
+    }
+
+    // Full precision only: leading blocks that fit.
+    {
+        skyml::feature_block_cache_t<double> cache(first_two * 8 / MB,
+            skyml::FEATURE_CACHE_FULL);
+        check_cache(cache, blocks, skyml::FEATURE_CACHE_FULL, 2, 0.0, world);
+    }
+
+    // No budget, no caching.
+    {
+        skyml::feature_block_cache_t<double> cache(0.0);
+        check_cache(cache, blocks, skyml::FEATURE_CACHE_BFLOAT16, 0, 0.0,
+            world);
+    }
+
+    // Blocks stored from, and fetched into, views with a leading dimension.
+    {
+        matrix_t big, bigout;
+        El::Gaussian(big, 50, n);
+        El::Zeros(bigout, 50, n);
+        matrix_t Zv, Zout;
+        El::View(Zv, big, 5, 0, 20, n);
+        El::View(Zout, bigout, 5, 0, 20, n);
+
+        skyml::feature_block_cache_t<double> cache(1.0);
+        cache.plan(std::vector<El::Int>(1, 20 * n), world);
+        cache.store(0, Zv);
+        BOOST_REQUIRE(cache.fetch(0, Zout));
+        El::Axpy(-1.0, Zv, Zout);
+        BOOST_REQUIRE(El::MaxNorm(Zout) == 0.0);
+        BOOST_REQUIRE(El::MaxNorm(bigout) == 0.0);
+    }
+
+    El::Finalize();
+    return 0;
+}
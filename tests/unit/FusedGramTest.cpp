@@ -0,0 +1,242 @@
+/**
+ *  This test checks the fused, tiled Gram kernels: the vectorized exp
+ *  against std::exp over the whole input range (including underflow and
+ *  saturation), and the Gram matrices of the gaussian, laplacian,
+ *  polynomial and expsemigroup kernels for local and distributed matrices,
+ *  all direction combinations and symmetric Grams. The distance kernels are
+ *  checked entry by entry against the kernel evaluated on each pair of
+ *  points, and the polynomial kernel against Gemm followed by an entrywise
+ *  map.
+ *
+ *      - Elemental Gemm is implemented correctly.
+ */
+
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include <boost/mpi.hpp>
+#include <boost/test/minimal.hpp>
+
+#define SKYLARK_NO_ANY
+
+#include "../../skylark.hpp"
+
+#include "test_utils.hpp"
+
+namespace skyb = skylark::base;
+namespace skyml = skylark::ml;
+
+/**
+ * exp_inplace on n points evenly spread on [lo, hi]: within ulps ulps of
+ * std::exp on [valid_lo, valid_hi], 0 below it, and saturated above it.
+ */
+template<typename T>
+void check_exp(T lo, T hi, T valid_lo, T valid_hi, double ulps) {
+
+    const El::Int n = 2000001;
+    std::vector<T> x(n), v(n);
+    for(El::Int i = 0; i < n; i++)
+        x[i] = v[i] = lo + (hi - lo) * (T(i) / T(n - 1));
+    skyml::detail::exp_inplace(x.data(), n);
+
+    T top = valid_hi;
+    skyml::detail::exp_inplace(&top, 1);
+    BOOST_REQUIRE(std::isfinite(top));
+
+    const double eps = std::numeric_limits<T>::epsilon();
+    for(El::Int i = 0; i < n; i++) {
+        if (v[i] < valid_lo) {
+            BOOST_REQUIRE(x[i] == T(0));
+            BOOST_REQUIRE(std::exp(v[i]) <= std::exp(valid_lo));
+        } else if (v[i] > valid_hi)
+            BOOST_REQUIRE(x[i] == top);
+        else {
+            double e = std::exp(double(v[i]));
+            BOOST_REQUIRE(std::abs(x[i] - e) <= ulps * eps * e);
+        }
+    }
+}
+
+/** Maximum absolute difference. */
+template<typename MatrixType>
+double maxdiff(const MatrixType& A, const MatrixType& B) {
+    MatrixType D(A);
+    El::Axpy(-1.0, B, D);
+    return El::MaxNorm(D);
+}
+
+void local_copy(const El::Matrix<double>& A, El::Matrix<double>& B) {
+    B = A;
+}
+
+void local_copy(const El::DistMatrix<double>& A, El::Matrix<double>& B) {
+    El::DistMatrix<double, El::STAR, El::STAR> A_STAR_STAR(A);
+    B = A_STAR_STAR.Matrix();
+}
+
+/**
+ * Requires |K(i, j) - f(px, i, py, j)| < tol for all pairs of points
+ * (columns) i of PX and j of PY, in the uplo triangle only if given.
+ */
+template<typename MatrixType, typename F>
+void check_entries(const MatrixType& PX, const MatrixType& PY,
+    const MatrixType& K, F f, double tol,
+    const El::UpperOrLower *uplo = nullptr) {
+
+    El::Matrix<double> px, py, Kl;
+    local_copy(PX, px);
+    local_copy(PY, py);
+    local_copy(K, Kl);
+    BOOST_REQUIRE(Kl.Height() == px.Width() && Kl.Width() == py.Width());
+    for(El::Int j = 0; j < py.Width(); j++)
+        for(El::Int i = 0; i < px.Width(); i++) {
+            if (uplo != nullptr && (*uplo == El::LOWER ? i < j : i > j))
+                continue;
+            BOOST_REQUIRE(std::abs(Kl.Get(i, j) - f(px, i, py, j)) < tol);
+        }
+}
+
+/** exp(-||x_i - y_j||^2 / (2 sigma^2)) */
+std::function<double(const El::Matrix<double>&, El::Int,
+    const El::Matrix<double>&, El::Int)> gaussian_entry(double sigma) {
+    return [sigma] (const El::Matrix<double>& px, El::Int i,
+        const El::Matrix<double>& py, El::Int j) {
+        double s = 0;
+        for(El::Int k = 0; k < px.Height(); k++)
+            s += (px.Get(k, i) - py.Get(k, j)) * (px.Get(k, i) - py.Get(k, j));
+        return std::exp(-s / (2 * sigma * sigma));
+    };
+}
+
+template<typename MatrixType>
+void orient(skyb::direction_t dir, const MatrixType& P, MatrixType& X) {
+    if (dir == skyb::COLUMNS)
+        X = P;
+    else
+        El::Transpose(P, X);
+}
+
+template<typename MatrixType>
+void check_kernels(skyb::direction_t dirX, skyb::direction_t dirY,
+    const MatrixType& PX, const MatrixType& PY) {
+
+    typedef double T;
+    const El::Int d = PX.Height();
+    const double sigma = 1.5, beta = 0.7;
+
+    MatrixType X, Y, K, R;
+    orient(dirX, PX, X);
+    orient(dirY, PY, Y);
+
+    // gaussian
+    skyml::gaussian_t gaussian(d, sigma);
+    skyml::Gram(dirX, dirY, gaussian, X, Y, K);
+    check_entries(PX, PY, K, gaussian_entry(sigma), 1e-12);
+
+    // laplacian: exp(-||x_i - y_j||_1 / sigma)
+    skyml::laplacian_t laplacian(d, sigma);
+    skyml::Gram(dirX, dirY, laplacian, X, Y, K);
+    check_entries(PX, PY, K, [sigma] (const El::Matrix<T>& px, El::Int i,
+            const El::Matrix<T>& py, El::Int j) {
+            T s = 0;
+            for(El::Int k = 0; k < px.Height(); k++)
+                s += std::abs(px.Get(k, i) - py.Get(k, j));
+            return std::exp(-s / sigma);
+        }, 1e-12);
+
+    // polynomial
+    skyml::polynomial_t polynomial(d, 3, 0.5, 0.25);
+    skyml::Gram(dirX, dirY, polynomial, X, Y, K);
+    El::Gemm(dirX == skyb::COLUMNS ? El::ADJOINT : El::NORMAL,
+        dirY == skyb::COLUMNS ? El::NORMAL : El::ADJOINT,
+        T(1.0), X, Y, T(0.0), R);
+    El::EntrywiseMap(R, std::function<T(T)>([] (T x) {
+                return std::pow(0.25 * x + 0.5, 3); }));
+    BOOST_REQUIRE(maxdiff(K, R) < 1e-12 * El::MaxNorm(R));
+
+    // expsemigroup: exp(-beta sum_k sqrt(x_k + y_k))
+    skyml::expsemigroup_t expsemigroup(d, beta);
+    skyml::Gram(dirX, dirY, expsemigroup, X, Y, K);
+    check_entries(PX, PY, K, [beta] (const El::Matrix<T>& px, El::Int i,
+            const El::Matrix<T>& py, El::Int j) {
+            T s = 0;
+            for(El::Int k = 0; k < px.Height(); k++)
+                s += std::sqrt(px.Get(k, i) + py.Get(k, j));
+            return std::exp(-beta * s);
+        }, 1e-12);
+}
+
+template<typename MatrixType>
+void check_symmetric(skyb::direction_t dir, const MatrixType& P) {
+
+    const double sigma = 0.8;
+
+    MatrixType X, K;
+    orient(dir, P, X);
+
+    El::UpperOrLower uplos[] = {El::LOWER, El::UPPER};
+    for(int u = 0; u < 2; u++) {
+        skyml::gaussian_t gaussian(P.Height(), sigma);
+        skyml::SymmetricGram(uplos[u], dir, gaussian, X, K);
+        check_entries(P, P, K, gaussian_entry(sigma), 1e-12, &uplos[u]);
+    }
+}
+
+int test_main(int argc, char *argv[]) {
+
+    El::Initialize(argc, argv);
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Vectorized exp <]
+
+    check_exp<double>(-800.0, 800.0, -708.0, 708.0, 2.0);
+    check_exp<float>(-100.0f, 100.0f, -87.0f, 87.0f, 2.0);
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Fused against unfused Gram (several tiles in each dimension) <]
+
+    const El::Int d = 10, m = 300, n = 170;
+    skyb::direction_t dirs[] = {skyb::COLUMNS, skyb::ROWS};
+
+    // Points (as columns) in [0, 1], so that sqrt(x + y) is defined.
+    El::Matrix<double> PX, PY;
+    El::Uniform(PX, d, m, 0.5, 0.5);
+    El::Uniform(PY, d, n, 0.5, 0.5);
+    El::DistMatrix<double> DX, DY;     // on the default grid
+    El::Uniform(DX, d, m, 0.5, 0.5);
+    El::Uniform(DY, d, n, 0.5, 0.5);
+
+    for(int i = 0; i < 2; i++)
+        for(int j = 0; j < 2; j++) {
+            check_kernels(dirs[i], dirs[j], PX, PY);
+            check_kernels(dirs[i], dirs[j], DX, DY);
+        }
+
+    for(int i = 0; i < 2; i++) {
+        check_symmetric(dirs[i], PX);
+        check_symmetric(dirs[i], DX);
+    }
+
+    // Single precision, within float accuracy.
+    {
+        El::Matrix<float> X, Y, K;
+        El::Uniform(X, d, m, 0.5f, 0.5f);
+        El::Uniform(Y, d, n, 0.5f, 0.5f);
+        skyml::gaussian_t gaussian(d, 1.5);
+        skyml::Gram(skyb::COLUMNS, skyb::COLUMNS, gaussian, X, Y, K);
+        for(El::Int j = 0; j < n; j++)
+            for(El::Int i = 0; i < m; i++) {
+                double s = 0;
+                for(El::Int k = 0; k < d; k++)
+                    s += (double(X.Get(k, i)) - Y.Get(k, j)) *
+                        (double(X.Get(k, i)) - Y.Get(k, j));
+                BOOST_REQUIRE(std::abs(K.Get(i, j) - std::exp(-s / 4.5)) <
+                    1e-5);
+            }
+    }
+
+    El::Finalize();
+    return 0;
+}
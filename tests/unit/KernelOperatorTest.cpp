@@ -0,0 +1,102 @@
+/**
+ *  This test checks that the matrix-free kernel operator applies K + lambda I
+ *  as the explicit Gram matrix followed by Gemm does, for both directions,
+ *  several panel widths, with and without a panel cache, and that beta = 0
+ *  overwrites the output instead of scaling it.
+ *
+ *      - The distributed Gram and Elemental Gemm are implemented correctly.
+ */
+
+#include <limits>
+
+#include <boost/mpi.hpp>
+#include <boost/test/minimal.hpp>
+
+#define SKYLARK_NO_ANY
+
+#include "../../skylark.hpp"
+
+#include "test_utils.hpp"
+
+namespace skyb = skylark::base;
+namespace skyml = skylark::ml;
+
+typedef El::DistMatrix<double> dense_matrix_t;
+
+double reldiff(const dense_matrix_t& X, const dense_matrix_t& Y) {
+    dense_matrix_t D(X);
+    El::Axpy(-1.0, Y, D);
+    return El::FrobeniusNorm(D) / El::FrobeniusNorm(Y);
+}
+
+int test_main(int argc, char *argv[]) {
+
+    El::Initialize(argc, argv);
+
+    boost::mpi::communicator world;
+    El::Grid grid(world);
+    skyb::context_t context(1234);
+
+    const El::Int d = 5, n = 37, k = 3;
+    const double lambda = 0.25, alpha = 1.5, beta = -0.5;
+
+    skyml::gaussian_t kernel(d, 1.5);
+
+    skyb::direction_t directions[] = {skyb::COLUMNS, skyb::ROWS};
+    El::Int panel_widths[] = {0, 1, 5, n};
+    double cache_mbs[] = {0.0, 100.0};
+
+    for(int di = 0; di < 2; di++) {
+        skyb::direction_t direction = directions[di];
+
+        dense_matrix_t X(grid), B(grid), C0(grid);
+        if (direction == skyb::COLUMNS)
+            skyb::GaussianMatrix(X, d, n, context);
+        else
+            skyb::GaussianMatrix(X, n, d, context);
+        skyb::GaussianMatrix(B, n, k, context);
+        skyb::GaussianMatrix(C0, n, k, context);
+
+        // Explicit path: C = beta C0 + alpha (K + lambda I) B
+        dense_matrix_t K(grid);
+        skyml::Gram(direction, direction, kernel, X, X, K);
+
+        dense_matrix_t Ce(C0), Ce0(grid);
+        El::Scale(beta, Ce);
+        El::Axpy(alpha * lambda, B, Ce);
+        El::Gemm(El::NORMAL, El::NORMAL, alpha, K, B, 1.0, Ce);
+
+        El::Zeros(Ce0, n, k);
+        El::Axpy(alpha * lambda, B, Ce0);
+        El::Gemm(El::NORMAL, El::NORMAL, alpha, K, B, 1.0, Ce0);
+
+        for(int pi = 0; pi < 4; pi++)
+            for(int ci = 0; ci < 2; ci++) {
+                skyml::kernel_operator_t<double, skyml::gaussian_t>
+                    op(direction, kernel, X, lambda, panel_widths[pi],
+                        cache_mbs[ci]);
+                BOOST_REQUIRE(op.height() == n && op.width() == n);
+
+                // Twice, so the second product can come from the cache.
+                for(int rep = 0; rep < 2; rep++) {
+                    dense_matrix_t C(C0);
+                    op.apply(alpha, B, beta, C);
+                    BOOST_REQUIRE(reldiff(C, Ce) < 1e-12);
+                }
+
+                El::Int computed = cache_mbs[ci] > 0.0 ?
+                    op.num_panels() : 2 * op.num_panels();
+                BOOST_REQUIRE(op.num_computed_panels() == computed);
+
+                // beta = 0 must not propagate NaNs from C.
+                dense_matrix_t C(grid);
+                El::Ones(C, n, k);
+                El::Scale(std::numeric_limits<double>::quiet_NaN(), C);
+                op.apply(alpha, B, 0.0, C);
+                BOOST_REQUIRE(reldiff(C, Ce0) < 1e-12);
+            }
+    }
+
+    El::Finalize();
+    return 0;
+}
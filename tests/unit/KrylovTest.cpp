@@ -0,0 +1,252 @@
+/**
+ *  This test checks the pipelined and deflating Krylov solvers against the
+ *  baseline ones and against direct solutions:
+ *
+ *    - CG, standard with and without deflation and pipelined, with and
+ *      without a preconditioner, on an SPD system: small true residuals and
+ *      the same solution.
+ *    - LSQR, standard with and without deflation and pipelined, on
+ *      consistent and inconsistent right-hand sides: the least squares
+ *      solution computed from a known factorization of A.
+ *    - Deflation in CG, FlexibleCG and LSQR on right-hand sides that
+ *      converge after one or two iterations: per-column iteration counts,
+ *      and exact solutions for the deflated and the remaining columns.
+ *
+ *      - Elemental Gemm, Symm and QR are implemented correctly.
+ */
+
+#include <cmath>
+#include <vector>
+
+#include <boost/mpi.hpp>
+#include <boost/test/minimal.hpp>
+
+#define SKYLARK_NO_ANY
+
+#include "../../skylark.hpp"
+
+#include "test_utils.hpp"
+
+namespace skyb = skylark::base;
+namespace skyalg = skylark::algorithms;
+
+typedef El::DistMatrix<double> dense_matrix_t;
+typedef El::DistMatrix<double, El::VC, El::STAR> dense_vc_star_matrix_t;
+typedef El::DistMatrix<double, El::STAR, El::STAR> dense_star_star_matrix_t;
+
+/** Largest relative difference between columns of X and Y. */
+template<typename MatrixType>
+double colreldiff(const MatrixType& X, const MatrixType& Y) {
+    dense_star_star_matrix_t Xs(X), Ys(Y);
+    double worst = 0.0;
+    for(El::Int j = 0; j < Ys.Width(); j++) {
+        double diff = 0.0, nrm = 0.0;
+        for(El::Int i = 0; i < Ys.Height(); i++) {
+            double d = Xs.GetLocal(i, j) - Ys.GetLocal(i, j);
+            diff += d * d;
+            nrm += Ys.GetLocal(i, j) * Ys.GetLocal(i, j);
+        }
+        worst = std::max(worst, std::sqrt(diff / nrm));
+    }
+    return worst;
+}
+
+/** Jacobi-like preconditioner: X = D^{-1} B. */
+struct diagonal_precond_t :
+    public skyalg::outplace_precond_t<dense_matrix_t, dense_matrix_t> {
+
+    diagonal_precond_t(const dense_star_star_matrix_t& d) : _dinv(d) {
+        for(El::Int i = 0; i < _dinv.Height(); i++)
+            _dinv.SetLocal(i, 0, 1.0 / _dinv.GetLocal(i, 0));
+    }
+
+    bool is_id() const { return false; }
+
+    void apply(const dense_matrix_t& B, dense_matrix_t& X) const {
+        X = B;
+        El::DiagonalScale(El::LEFT, El::NORMAL, _dinv, X);
+    }
+
+    void apply_adjoint(const dense_matrix_t& B, dense_matrix_t& X) const {
+        apply(B, X);
+    }
+
+private:
+    dense_star_star_matrix_t _dinv;
+};
+
+int test_main(int argc, char *argv[]) {
+
+    El::Initialize(argc, argv);
+
+    boost::mpi::communicator world;
+    El::Grid grid(world);
+    skyb::context_t context(4711);
+
+    const El::Int k = 4;
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> CG: standard, deflated, pipelined, with and without preconditioner <]
+
+    {
+        const El::Int n = 150;
+
+        // A = D + G G' / n, with D = diag(1..10): well conditioned SPD.
+        dense_star_star_matrix_t d(n, 1, grid);
+        for(El::Int i = 0; i < n; i++)
+            d.SetLocal(i, 0, 1.0 + 9.0 * i / (n - 1));
+        dense_matrix_t G(grid), A(grid), B(grid);
+        skyb::GaussianMatrix(G, n, n, context);
+        El::Zeros(A, n, n);
+        El::Gemm(El::NORMAL, El::ADJOINT, 1.0 / n, G, G, 0.0, A);
+        for(El::Int i = 0; i < n; i++)
+            A.Update(i, i, d.GetLocal(i, 0));
+        skyb::GaussianMatrix(B, n, k, context);
+
+        diagonal_precond_t M(d);
+
+        dense_matrix_t Xref(grid);
+        for(int precond = 0; precond < 2; precond++)
+            for(int variant = 0; variant < 3; variant++) {
+                skyalg::krylov_iter_params_t params(1e-10, 500);
+                params.deflate = variant == 1;
+                params.pipelined = variant == 2;
+
+                dense_matrix_t X(grid);
+                El::Zeros(X, n, k);
+                int ret = precond ?
+                    skyalg::CG(El::LOWER, A, B, X, params, M) :
+                    skyalg::CG(El::LOWER, A, B, X, params);
+                BOOST_REQUIRE(ret == -1);
+
+                dense_matrix_t AX(grid);
+                El::Zeros(AX, n, k);
+                El::Gemm(El::NORMAL, El::NORMAL, 1.0, A, X, 0.0, AX);
+                BOOST_REQUIRE(colreldiff(AX, B) < 1e-8);
+
+                if (precond == 0 && variant == 0)
+                    Xref = X;
+                else
+                    BOOST_REQUIRE(colreldiff(X, Xref) < 1e-7);
+            }
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Deflation in CG and FlexibleCG <]
+
+    {
+        const El::Int n = 200;
+
+        // A = diag(1..100); the first right-hand side is an eigenvector
+        // (one iteration), the second a sum of two (two iterations).
+        dense_matrix_t A(grid), B(grid), Xe(grid);
+        El::Zeros(A, n, n);
+        for(El::Int i = 0; i < n; i++)
+            A.Set(i, i, 1.0 + 99.0 * i / (n - 1));
+        skyb::GaussianMatrix(B, n, k, context);
+        for(El::Int i = 0; i < n; i++) {
+            B.Set(i, 0, i == 0 ? 3.0 : 0.0);
+            B.Set(i, 1, (i == 0 || i == 5) ? 1.0 : 0.0);
+        }
+        El::Zeros(Xe, n, k);
+        for(El::Int i = 0; i < n; i++)
+            for(El::Int j = 0; j < k; j++)
+                Xe.Set(i, j, B.Get(i, j) / (1.0 + 99.0 * i / (n - 1)));
+
+        for(int flexible = 0; flexible < 2; flexible++) {
+            std::vector<int> iterations;
+            skyalg::krylov_iter_params_t params(1e-12, 1000);
+            params.column_iterations = &iterations;
+
+            dense_matrix_t X(grid);
+            El::Zeros(X, n, k);
+            int ret = flexible ?
+                skyalg::FlexibleCG(A, B, X, params) :
+                skyalg::CG(El::LOWER, A, B, X, params);
+            BOOST_REQUIRE(ret == -1);
+
+            BOOST_REQUIRE(iterations.size() == size_t(k));
+            BOOST_REQUIRE(iterations[0] == 1);
+            BOOST_REQUIRE(iterations[1] <= 3);
+            BOOST_REQUIRE(iterations[2] > 5 && iterations[3] > 5);
+            BOOST_REQUIRE(colreldiff(X, Xe) < 1e-9);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> LSQR <]
+
+    {
+        const El::Int m = 300, d = 20;
+
+        // A = Q S with orthonormal Q and S = diag(1 .. 0.1), so that the
+        // least squares solution is S^{-1} Q' B.
+        dense_matrix_t Q(grid);
+        skyb::GaussianMatrix(Q, m, d, context);
+        El::qr::ExplicitUnitary(Q);
+        dense_star_star_matrix_t s(d, 1, grid), sinv(d, 1, grid);
+        for(El::Int j = 0; j < d; j++) {
+            s.SetLocal(j, 0, std::pow(10.0, -1.0 * j / (d - 1)));
+            sinv.SetLocal(j, 0, 1.0 / s.GetLocal(j, 0));
+        }
+        dense_matrix_t A(Q);
+        El::DiagonalScale(El::RIGHT, El::NORMAL, s, A);
+        dense_vc_star_matrix_t A_VC_STAR(A);
+
+        // Consistent (first two) and inconsistent (last two) columns.
+        dense_matrix_t Xt(grid), N(grid), B(grid);
+        skyb::GaussianMatrix(Xt, d, k, context);
+        skyb::GaussianMatrix(N, m, k, context);
+        El::Zeros(B, m, k);
+        El::Gemm(El::NORMAL, El::NORMAL, 1.0, A, Xt, 0.0, B);
+        for(El::Int j = 2; j < k; j++)
+            for(El::Int i = 0; i < m; i++)
+                B.Update(i, j, 0.1 * N.Get(i, j));
+        dense_vc_star_matrix_t B_VC_STAR(B);
+
+        dense_matrix_t Xls(grid);
+        El::Zeros(Xls, d, k);
+        El::Gemm(El::ADJOINT, El::NORMAL, 1.0, Q, B, 0.0, Xls);
+        El::DiagonalScale(El::LEFT, El::NORMAL, sinv, Xls);
+        dense_star_star_matrix_t Xls_STAR_STAR(Xls);
+
+        for(int variant = 0; variant < 3; variant++) {
+            skyalg::krylov_iter_params_t params(1e-12, 500);
+            params.deflate = variant == 1;
+            params.pipelined = variant == 2;
+
+            dense_star_star_matrix_t X(grid);
+            El::Zeros(X, d, k);
+            skyalg::LSQR(A_VC_STAR, B_VC_STAR, X, params);
+            BOOST_REQUIRE(colreldiff(X, Xls_STAR_STAR) < 1e-9);
+        }
+
+        // Deflation: A e_0 takes one iteration (A' A is diagonal), and
+        // A (e_0 + e_3) two.
+        for(El::Int i = 0; i < m; i++) {
+            B.Set(i, 0, A.Get(i, 0));
+            B.Set(i, 1, A.Get(i, 0) + A.Get(i, 3));
+        }
+        B_VC_STAR = B;
+        El::Gemm(El::ADJOINT, El::NORMAL, 1.0, Q, B, 0.0, Xls);
+        El::DiagonalScale(El::LEFT, El::NORMAL, sinv, Xls);
+        Xls_STAR_STAR = Xls;
+
+        std::vector<int> iterations;
+        skyalg::krylov_iter_params_t params(1e-12, 500);
+        params.column_iterations = &iterations;
+        dense_star_star_matrix_t X(grid);
+        El::Zeros(X, d, k);
+        int ret = skyalg::LSQR(A_VC_STAR, B_VC_STAR, X, params);
+        BOOST_REQUIRE(ret == -2 || ret == -3);
+
+        BOOST_REQUIRE(iterations.size() == size_t(k));
+        BOOST_REQUIRE(iterations[0] <= 2);
+        BOOST_REQUIRE(iterations[1] <= 3);
+        BOOST_REQUIRE(iterations[2] > iterations[1]);
+        BOOST_REQUIRE(colreldiff(X, Xls_STAR_STAR) < 1e-9);
+    }
+
+    El::Finalize();
+    return 0;
+}
@@ -0,0 +1,178 @@
+/**
+ *  This test checks the binary model container: half precision conversion
+ *  (every half value round trips, ties round to even, overflow saturates to
+ *  infinity), and that a hilbert_model_t with random feature maps saved with
+ *  save_binary() loads back with the same maps and the same coefficients
+ *  (exactly in double, to storage precision in float and half), predicts as
+ *  the original model, is not modified on disk through get_coef() of a
+ *  mapped model, and that truncated files are rejected.
+ *
+ *      - The JSON (save()/to_ptree()) model path is implemented correctly.
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <boost/mpi.hpp>
+#include <boost/test/minimal.hpp>
+
+#define SKYLARK_NO_ANY
+#define SKYLARK_WITH_GAUSSIAN_RFT_ANY
+
+#include "../../skylark.hpp"
+
+#include "test_utils.hpp"
+
+namespace skyb = skylark::base;
+namespace skyml = skylark::ml;
+namespace skys = skylark::sketch;
+
+typedef El::Matrix<double> matrix_t;
+
+double maxdiff(const matrix_t& A, const matrix_t& B) {
+    BOOST_REQUIRE(A.Height() == B.Height() && A.Width() == B.Width());
+    matrix_t D(A);
+    El::Axpy(-1.0, B, D);
+    return El::MaxNorm(D);
+}
+
+void check_half() {
+    using skyml::detail::float_to_half;
+    using skyml::detail::half_to_float;
+
+    for(std::uint32_t h = 0; h < 0x10000; h++) {
+        float f = half_to_float(h);
+        if (std::isnan(f))
+            BOOST_REQUIRE(std::isnan(half_to_float(float_to_half(f))));
+        else
+            BOOST_REQUIRE(float_to_half(f) == h);
+    }
+
+    // Ties to even, in the normal and the subnormal range.
+    BOOST_REQUIRE(half_to_float(float_to_half(1.0f + std::ldexp(1.0f, -11)))
+        == 1.0f);
+    BOOST_REQUIRE(half_to_float(float_to_half(1.0f +
+                3 * std::ldexp(1.0f, -11))) == 1.0f + std::ldexp(1.0f, -9));
+    BOOST_REQUIRE(half_to_float(float_to_half(std::ldexp(1.0f, -25))) == 0.0f);
+    BOOST_REQUIRE(half_to_float(float_to_half(3 * std::ldexp(1.0f, -25)))
+        == std::ldexp(1.0f, -23));
+
+    BOOST_REQUIRE(half_to_float(float_to_half(65504.0f)) == 65504.0f);
+    BOOST_REQUIRE(std::isinf(half_to_float(float_to_half(65520.0f))));
+}
+
+int test_main(int argc, char *argv[]) {
+
+    El::Initialize(argc, argv);
+
+    boost::mpi::communicator world;
+    skyb::context_t context(31);
+
+    check_half();
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Model round trip <]
+
+    const int d = 6, s = 8, k = 3, n = 25;
+
+    typedef skys::GaussianRFT_t<matrix_t, matrix_t> map_t;
+    map_t map0(d, s, 1.5, context), map1(d, s, 0.5, context);
+    std::vector<const map_t *> maps = {&map0, &map1};
+
+    skyml::hilbert_model_t model(maps, true, 2 * s, k, false);
+    El::Gaussian(model.get_coef(), 2 * s, k);
+
+    matrix_t X;
+    El::Gaussian(X, d, n);
+    matrix_t PV, DV;
+    model.predict(X, PV, DV);
+
+    const std::string fname = "model_container_test.model";
+    skyml::coef_precision_t precisions[] =
+        {skyml::COEF_DOUBLE, skyml::COEF_FLOAT, skyml::COEF_HALF};
+    double tolerances[] = {0.0, 1e-6, 1e-3};
+
+    for(int p = 0; p < 3; p++) {
+        if (world.rank() == 0)
+            model.save_binary(fname, "# test", precisions[p]);
+        world.barrier();
+
+        BOOST_REQUIRE(skyml::IsBinaryModel(fname));
+        skyml::hilbert_model_t loaded(fname);
+        BOOST_REQUIRE(loaded.get_input_size() == d);
+        BOOST_REQUIRE(loaded.get_output_size() == k);
+        BOOST_REQUIRE(loaded.get_scale_maps());
+        BOOST_REQUIRE(!loaded.is_regression());
+        BOOST_REQUIRE(loaded.get_maps().size() == 2);
+        for(int i = 0; i < 2; i++)
+            BOOST_REQUIRE(loaded.get_maps()[i]->to_ptree() ==
+                maps[i]->to_ptree());
+
+        double scale = El::MaxNorm(model.get_coef());
+        BOOST_REQUIRE(maxdiff(loaded.get_coef(), model.get_coef()) <=
+            tolerances[p] * scale);
+
+        matrix_t PVl, DVl;
+        loaded.predict(X, PVl, DVl);
+        if (precisions[p] == skyml::COEF_DOUBLE) {
+            BOOST_REQUIRE(maxdiff(DVl, DV) == 0.0);
+            BOOST_REQUIRE(maxdiff(PVl, PV) == 0.0);
+        } else
+            BOOST_REQUIRE(maxdiff(DVl, DV) <= 2 * s * tolerances[p] * scale);
+
+        // Writes through a (mapped) model never reach the file.
+        if (precisions[p] == skyml::COEF_DOUBLE) {
+            El::Zero(loaded.get_coef());
+            skyml::hilbert_model_t again(fname);
+            BOOST_REQUIRE(maxdiff(again.get_coef(), model.get_coef()) == 0.0);
+        }
+        world.barrier();
+    }
+
+    // The text format is not taken as a container, and still loads.
+    if (world.rank() == 0)
+        model.save(fname, "# test\n");
+    world.barrier();
+    BOOST_REQUIRE(!skyml::IsBinaryModel(fname));
+    {
+        skyml::hilbert_model_t loaded(fname);
+        BOOST_REQUIRE(loaded.get_maps().size() == 2);
+        BOOST_REQUIRE(loaded.get_coef().Height() == 2 * s);
+    }
+    world.barrier();
+
+    // Truncated containers are rejected.
+    if (world.rank() == 0) {
+        model.save_binary(fname, "", skyml::COEF_DOUBLE);
+        std::string bytes;
+        {
+            std::ifstream in(fname, std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(in),
+                std::istreambuf_iterator<char>());
+        }
+        std::ofstream(fname, std::ios::binary)
+            << bytes.substr(0, bytes.size() - 8);
+    }
+    world.barrier();
+    {
+        bool caught = false;
+        try {
+            skyml::hilbert_model_t loaded(fname);
+        } catch (skyb::io_exception& ex) {
+            caught = true;
+        }
+        BOOST_REQUIRE(caught);
+    }
+
+    world.barrier();
+    if (world.rank() == 0)
+        std::remove(fname.c_str());
+
+    El::Finalize();
+    return 0;
+}
@@ -0,0 +1,189 @@
+/**
+ *  This test checks that the number formatter writes values that read back
+ *  exactly (random bit patterns, subnormals, extremes, signed zeros and
+ *  integer limits), and that the parallel text writers (WriteText and the
+ *  distributed WriteLIBSVM) write every row exactly once, in order, for
+ *  block sizes that do not divide the number of rows.
+ *
+ *      - strtod/strtof and the local ReadLIBSVM are implemented correctly.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+
+#include <boost/mpi.hpp>
+#include <boost/test/minimal.hpp>
+#include <boost/random/mersenne_twister.hpp>
+
+#define SKYLARK_NO_ANY
+
+#include "../../skylark.hpp"
+
+#include "test_utils.hpp"
+
+namespace skyio = skylark::utility::io;
+
+template<typename T>
+T parse(const std::string& s);
+
+template<>
+double parse<double>(const std::string& s) {
+    return std::strtod(s.c_str(), nullptr);
+}
+
+template<>
+float parse<float>(const std::string& s) {
+    return std::strtof(s.c_str(), nullptr);
+}
+
+/** Formats value, and checks it reads back bit for bit. */
+template<typename T>
+void check_round_trip(T value) {
+    std::string s;
+    skyio::AppendNumber(s, value);
+    BOOST_REQUIRE(s.size() <= size_t(skyio::MAX_NUMBER_CHARS));
+    T back = parse<T>(s);
+    BOOST_REQUIRE(std::memcmp(&back, &value, sizeof(T)) == 0);
+}
+
+template<typename T, typename Bits>
+void check_random_bits(int n) {
+    boost::random::mt19937 gen(19);
+    for(int i = 0; i < n; i++) {
+        Bits bits = 0;
+        for(size_t b = 0; b < sizeof(Bits); b += 4)
+            bits = (bits << 16 << 16) | Bits(gen());
+        T value;
+        std::memcpy(&value, &bits, sizeof(T));
+        if (std::isfinite(value))
+            check_round_trip(value);
+    }
+}
+
+template<typename T>
+void check_special() {
+    typedef std::numeric_limits<T> limits;
+    T values[] = {T(0), -T(0), T(1), T(-1), T(0.1), T(1) / T(3),
+                  limits::min(), limits::max(), -limits::max(),
+                  limits::denorm_min(), -limits::denorm_min(),
+                  limits::epsilon(), T(1e7), T(1e-7), T(123456789)};
+    for(size_t i = 0; i < sizeof(values) / sizeof(T); i++)
+        check_round_trip(values[i]);
+
+    std::string s;
+    skyio::AppendNumber(s, limits::infinity());
+    BOOST_REQUIRE(s == "inf");
+    s.clear();
+    skyio::AppendNumber(s, -limits::infinity());
+    BOOST_REQUIRE(s == "-inf");
+}
+
+template<typename T>
+void check_integer(T value) {
+    std::string s;
+    skyio::AppendNumber(s, value);
+    std::ostringstream expected;
+    expected << value;
+    BOOST_REQUIRE(s == expected.str());
+}
+
+int test_main(int argc, char *argv[]) {
+
+    El::Initialize(argc, argv);
+
+    boost::mpi::communicator world;
+    El::Grid grid(world);
+    skylark::base::context_t context(7);
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Number formatter round trip <]
+
+    check_random_bits<double, std::uint64_t>(200000);
+    check_random_bits<float, std::uint32_t>(200000);
+    check_special<double>();
+    check_special<float>();
+
+    check_integer(0);
+    check_integer(-17);
+    check_integer(std::numeric_limits<int>::min());
+    check_integer(std::numeric_limits<int>::max());
+    check_integer(std::numeric_limits<long long>::min());
+    check_integer(std::numeric_limits<unsigned long long>::max());
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Parallel writers: all rows, in order, exactly <]
+
+    const El::Int n = 53, d = 6;
+    const std::string fname = "number_format_test.txt";
+
+    El::DistMatrix<double> X(grid), Y(grid);
+    skylark::base::GaussianMatrix(X, n, d, context);
+    skylark::base::GaussianMatrix(Y, n, 1, context);
+    El::DistMatrix<double, El::STAR, El::STAR> X_STAR_STAR(X), Y_STAR_STAR(Y);
+    const El::Matrix<double>& Xl = X_STAR_STAR.LockedMatrix();
+    const El::Matrix<double>& Yl = Y_STAR_STAR.LockedMatrix();
+
+    int blocksizes[] = {1, 5, 100};
+    for(int b = 0; b < 3; b++) {
+        skyio::WriteText(fname, X, blocksizes[b]);
+        world.barrier();
+
+        std::ifstream in(fname);
+        std::string line;
+        El::Int i = 0;
+        while (std::getline(in, line)) {
+            BOOST_REQUIRE(i < n);
+            std::istringstream tokens(line);
+            std::string token;
+            for(El::Int j = 0; j < d; j++) {
+                BOOST_REQUIRE(tokens >> token);
+                BOOST_REQUIRE(parse<double>(token) == Xl.Get(i, j));
+            }
+            BOOST_REQUIRE(!(tokens >> token));
+            i++;
+        }
+        BOOST_REQUIRE(i == n);
+        in.close();
+        world.barrier();
+
+        skyio::WriteLIBSVM(fname, X, Y, skylark::base::ROWS, blocksizes[b]);
+        world.barrier();
+
+        El::Matrix<double> Xr, Yr;
+        skyio::ReadLIBSVM(fname, Xr, Yr, skylark::base::ROWS);
+        El::Axpy(-1.0, Xl, Xr);
+        El::Axpy(-1.0, Yl, Yr);
+        BOOST_REQUIRE(El::FrobeniusNorm(Xr) == 0.0);
+        BOOST_REQUIRE(El::FrobeniusNorm(Yr) == 0.0);
+        world.barrier();
+    }
+
+    // Examples as columns.
+    {
+        El::DistMatrix<double> XT(grid), YT(grid);
+        El::Transpose(X, XT);
+        El::Transpose(Y, YT);
+        skyio::WriteLIBSVM(fname, XT, YT, skylark::base::COLUMNS, 4);
+        world.barrier();
+
+        El::Matrix<double> Xr, Yr;
+        skyio::ReadLIBSVM(fname, Xr, Yr, skylark::base::ROWS);
+        El::Axpy(-1.0, Xl, Xr);
+        El::Axpy(-1.0, Yl, Yr);
+        BOOST_REQUIRE(El::FrobeniusNorm(Xr) == 0.0);
+        BOOST_REQUIRE(El::FrobeniusNorm(Yr) == 0.0);
+    }
+
+    world.barrier();
+    if (world.rank() == 0)
+        std::remove(fname.c_str());
+
+    El::Finalize();
+    return 0;
+}
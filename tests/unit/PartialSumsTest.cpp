@@ -0,0 +1,82 @@
+/**
+ *  This test checks the per-thread partial sums: contributions of a parallel
+ *  loop are added to the existing content of the output, for any number of
+ *  threads (including more threads than iterations, so that some buffers are
+ *  never used), for outputs that are views, and across repeated reductions.
+ *  Contributions are integers, so sums are exact in any order.
+ */
+
+#include <boost/mpi.hpp>
+#include <boost/test/minimal.hpp>
+
+#define SKYLARK_NO_ANY
+
+#include "../../skylark.hpp"
+
+#include "test_utils.hpp"
+
+namespace skyml = skylark::ml;
+
+typedef El::Matrix<double> matrix_t;
+
+/** Contribution of iteration it: entry (i, j) is it + i - 2 j. */
+void contribution(int it, matrix_t& S) {
+    for(El::Int j = 0; j < S.Width(); j++)
+        for(El::Int i = 0; i < S.Height(); i++)
+            S.Set(i, j, S.Get(i, j) + it + i - 2 * j);
+}
+
+/**
+ * S += contributions of iterations 0..iters-1, with num_threads threads,
+ * twice (reusing the partial sums after a reduction).
+ */
+void check_sums(matrix_t& S, int iters, int num_threads) {
+
+    matrix_t E(S);
+    for(int rep = 0; rep < 2; rep++)
+        for(int it = 0; it < iters; it++)
+            contribution(it, E);
+
+    skyml::detail::thread_partial_sums_t<double> Ssum(S, num_threads);
+    for(int rep = 0; rep < 2; rep++) {
+        int it;
+#       ifdef SKYLARK_HAVE_OPENMP
+#       pragma omp parallel for if(num_threads > 1) private(it) num_threads(num_threads)
+#       endif
+        for(it = 0; it < iters; it++)
+            contribution(it, Ssum.local());
+
+        Ssum.reduce();
+    }
+
+    El::Axpy(-1.0, E, S);
+    BOOST_REQUIRE(El::MaxNorm(S) == 0.0);
+}
+
+int test_main(int argc, char *argv[]) {
+
+    El::Initialize(argc, argv);
+
+    const El::Int m = 37, n = 5;
+    int threads[] = {1, 2, 3, 8};
+    int iters[] = {0, 2, 50};
+
+    for(int t = 0; t < 4; t++)
+        for(int i = 0; i < 3; i++) {
+            matrix_t S;
+            El::Uniform(S, m, n, 0.0, 10.0);
+            El::Round(S);
+            check_sums(S, iters[i], threads[t]);
+
+            // Output that is a view (leading dimension > height), whose
+            // surroundings must not change.
+            matrix_t big, Sv;
+            El::Zeros(big, m + 10, n);
+            El::View(Sv, big, 4, 0, m, n);
+            check_sums(Sv, iters[i], threads[t]);
+            BOOST_REQUIRE(El::MaxNorm(big) == 0.0);
+        }
+
+    El::Finalize();
+    return 0;
+}
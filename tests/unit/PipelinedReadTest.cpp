@@ -0,0 +1,168 @@
+/**
+ *  This test checks that the pipelined, blocked distributed LIBSVM readers
+ *  give the same matrices as the sequential local reader, for any block size
+ *  and prefetch depth, that on_block sees every block in order, and that a
+ *  reading error on the reading rank is raised on all ranks.
+ *
+ *      - The local (El::Matrix) ReadLIBSVM is implemented correctly.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <string>
+
+#include <boost/mpi.hpp>
+#include <boost/test/minimal.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+
+#define SKYLARK_NO_ANY
+
+#include "../../skylark.hpp"
+
+#include "test_utils.hpp"
+
+namespace skyio = skylark::utility::io;
+
+typedef El::DistMatrix<double, El::STAR, El::VR> dense_star_vr_matrix_t;
+typedef El::DistMatrix<double, El::VC, El::STAR> dense_vc_star_matrix_t;
+typedef El::DistMatrix<double> dense_matrix_t;
+
+/** Writes n random examples with d features, with or without comments. */
+void write_file(const std::string& fname, int n, int d, bool comments) {
+    boost::random::mt19937 gen(17);
+    boost::random::uniform_int_distribution<> value_dist(1, 500);
+    boost::random::uniform_int_distribution<> nnz_dist(0, 3);
+
+    std::ofstream out(fname);
+    if (comments)
+        out << "# generated by PipelinedReadTest" << std::endl;
+    for(int i = 0; i < n; i++) {
+        out << (i % 3) - 1;
+        for(int j = 0; j < d; j++)
+            if (nnz_dist(gen) == 0 || j == d - 1)
+                out << " " << j + 1 << ":" << value_dist(gen) / 100.0;
+        out << std::endl;
+        if (comments && i % 7 == 3)
+            out << std::endl << "# a comment" << std::endl;
+    }
+}
+
+template<typename DistMatrixType>
+void check_same(const DistMatrixType& A, const El::Matrix<double>& B) {
+    El::DistMatrix<double, El::STAR, El::STAR> A_STAR_STAR(A);
+    El::Matrix<double> D(A_STAR_STAR.LockedMatrix());
+    BOOST_REQUIRE(D.Height() == B.Height() && D.Width() == B.Width());
+    El::Axpy(-1.0, B, D);
+    BOOST_REQUIRE(El::FrobeniusNorm(D) == 0.0);
+}
+
+int test_main(int argc, char *argv[]) {
+
+    El::Initialize(argc, argv);
+
+    boost::mpi::communicator world;
+    El::Grid grid(world);
+
+    const int n = 103, d = 20;
+    const std::string fname = "pipelined_read_test.libsvm";
+    const std::string cname = "pipelined_read_test_comments.libsvm";
+    if (world.rank() == 0) {
+        write_file(fname, n, d, false);
+        write_file(cname, n, d, true);
+    }
+    world.barrier();
+
+    // Reference: sequential read of the whole file on every rank.
+    El::Matrix<double> Xr, Yr, XrT, YrT;
+    skyio::ReadLIBSVM(fname, Xr, Yr, skylark::base::ROWS);
+    skyio::ReadLIBSVM(fname, XrT, YrT, skylark::base::COLUMNS);
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Dense readers, for several block sizes and prefetch depths <]
+
+    int blocksizes[] = {1, 7, 50, 103, 1000};
+    for(int b = 0; b < 5; b++)
+        for(int prefetch = 1; prefetch <= 3; prefetch++) {
+            dense_matrix_t X(grid), Y(grid);
+            int next = 0;
+            std::function<void (dense_matrix_t&, dense_matrix_t&, int)>
+                on_block = [&](dense_matrix_t& Xv, dense_matrix_t& Yv,
+                    int start) {
+                BOOST_REQUIRE(start == next);
+                BOOST_REQUIRE(Xv.Height() == Yv.Height());
+                next += Xv.Height();
+            };
+
+            skyio::pipeline_stats_t stats;
+            skyio::ReadLIBSVM(fname, X, Y, skylark::base::ROWS, 0, -1,
+                blocksizes[b], on_block, prefetch, &stats);
+            BOOST_REQUIRE(next == n);
+            check_same(X, Xr);
+            check_same(Y, Yr);
+            if (world.rank() == 0)
+                BOOST_REQUIRE(stats.num_blocks ==
+                    size_t((n + blocksizes[b] - 1) / blocksizes[b]));
+
+            dense_star_vr_matrix_t XT(grid), YT(grid);
+            skyio::ReadLIBSVM(fname, XT, YT, skylark::base::COLUMNS, 0, -1,
+                blocksizes[b]);
+            check_same(XT, XrT);
+            check_same(YT, YrT);
+        }
+
+    // Empty and comment lines are skipped, not taken as the end of the data.
+    {
+        dense_vc_star_matrix_t X(grid), Y(grid);
+        skyio::ReadLIBSVM(cname, X, Y, skylark::base::ROWS, 0, -1, 10);
+        check_same(X, Xr);
+        check_same(Y, Yr);
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Sparse [VC,STAR] reader <]
+
+    {
+        skylark::base::sparse_vc_star_matrix_t<double> X(0, 0, grid);
+        dense_vc_star_matrix_t Y(grid);
+        skyio::ReadLIBSVM(cname, X, Y, skylark::base::COLUMNS, 0, 9);
+
+        dense_vc_star_matrix_t Xd(grid);
+        El::Zeros(Xd, X.height(), X.width());
+        const int* indptr = X.indptr();
+        const int* indices = X.indices();
+        const double* values = X.locked_values();
+        for(int col = 0; col < X.local_width(); col++)
+            for(int idx = indptr[col]; idx < indptr[col + 1]; idx++)
+                Xd.SetLocal(indices[idx], col, values[idx]);
+        check_same(Xd, XrT);
+        check_same(Y, YrT);
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> A reading error on rank 0 is raised on every rank <]
+
+    {
+        bool caught = false;
+        dense_matrix_t X(grid), Y(grid);
+        try {
+            skyio::ReadLIBSVM(std::string("pipelined_read_test.missing"),
+                X, Y, skylark::base::ROWS);
+        } catch (skylark::base::skylark_exception& ex) {
+            caught = true;
+        } catch (std::exception& ex) {
+            caught = true;
+        }
+        BOOST_REQUIRE(caught);
+    }
+
+    world.barrier();
+    if (world.rank() == 0) {
+        std::remove(fname.c_str());
+        std::remove(cname.c_str());
+    }
+
+    El::Finalize();
+    return 0;
+}
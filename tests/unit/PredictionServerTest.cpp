@@ -0,0 +1,185 @@
+/**
+ *  This test checks the prediction server against hilbert_model_t::predict:
+ *  the scorer for batches of any size up to the maximum, with none, some or
+ *  all of the feature maps kept realized (memory budget), and the server for
+ *  requests submitted concurrently from several threads, for classification
+ *  and regression models with feature maps, and for linear models. Indices
+ *  beyond the input size are ignored, and requests still queued when the
+ *  server is destroyed are answered.
+ *
+ *      - hilbert_model_t::predict is implemented correctly.
+ */
+
+#include <cmath>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include <boost/mpi.hpp>
+#include <boost/test/minimal.hpp>
+
+#define SKYLARK_NO_ANY
+#define SKYLARK_WITH_GAUSSIAN_RFT_ANY
+
+#include "../../skylark.hpp"
+
+#include "test_utils.hpp"
+
+namespace skyb = skylark::base;
+namespace skyml = skylark::ml;
+namespace skys = skylark::sketch;
+
+typedef El::Matrix<double> matrix_t;
+typedef skyml::prediction_server_t::point_type point_t;
+
+/** Column i of X as (index, value) pairs, zeros left out. */
+point_t point(const matrix_t& X, El::Int i) {
+    point_t p;
+    for(El::Int r = 0; r < X.Height(); r++)
+        if (X.Get(r, i) != 0.0)
+            p.push_back(std::make_pair(r, X.Get(r, i)));
+    return p;
+}
+
+void check_prediction(const skyml::prediction_server_t::prediction_t& p,
+    const skyml::hilbert_model_t& model, const matrix_t& PV,
+    const matrix_t& DV, El::Int i) {
+
+    const double tol = 1e-12;
+    BOOST_REQUIRE(p.decision_values.size() == size_t(DV.Width()));
+    for(El::Int j = 0; j < DV.Width(); j++)
+        BOOST_REQUIRE(std::abs(p.decision_values[j] - DV.Get(i, j)) <=
+            tol * (1 + std::abs(DV.Get(i, j))));
+    if (model.is_regression())
+        BOOST_REQUIRE(p.label == p.decision_values[0]);
+    else
+        BOOST_REQUIRE(p.label == PV.Get(i, 0));
+}
+
+void check_model(const skyml::hilbert_model_t& model, const matrix_t& X) {
+
+    const El::Int n = X.Width(), max_batch = 8;
+
+    matrix_t PV, DV;
+    model.predict(X, PV, DV);
+
+    // Scorer, for batch sizes 1..max_batch, one and two threads, with a
+    // budget for no realized map, for the first map only, and for all.
+    // Realized maps stay so, so the budgets grow.
+    const auto& maps = model.get_maps();
+    const double first_mb = maps.empty() ? 0.0 :
+        double(maps[0]->get_S()) * maps[0]->get_N() * sizeof(double) /
+        (1024.0 * 1024.0);
+    double budgets[] = {0.0, first_mb, 256.0};
+    int realized[] = {0, maps.empty() ? 0 : 1, int(maps.size())};
+    for(int r = 0; r < 3; r++)
+        for(int threads = 1; threads <= 2; threads++) {
+            skyml::hilbert_scorer_t scorer(model, max_batch, threads,
+                budgets[r]);
+            BOOST_REQUIRE(scorer.num_realized() == realized[r]);
+            for(El::Int b = 1; b <= max_batch; b++)
+                for(El::Int s = 0; s + b <= n; s += b) {
+                    matrix_t Xb;
+                    El::LockedView(Xb, X, 0, s, X.Height(), b);
+                    const matrix_t& DVb = scorer.score(Xb);
+                    BOOST_REQUIRE(DVb.Height() == b);
+                    for(El::Int i = 0; i < b; i++)
+                        for(El::Int j = 0; j < DV.Width(); j++)
+                            BOOST_REQUIRE(std::abs(DVb.Get(i, j) -
+                                    DV.Get(s + i, j)) <=
+                                1e-12 * (1 + std::abs(DV.Get(s + i, j))));
+                }
+        }
+
+    // Server, with requests from several threads at once.
+    {
+        skyml::prediction_server_t server(model, max_batch, 500);
+
+        const int num_clients = 4;
+        std::vector<std::future<skyml::prediction_server_t::prediction_t> >
+            results(n);
+        std::vector<std::thread> clients;
+        for(int c = 0; c < num_clients; c++)
+            clients.push_back(std::thread([&, c] {
+                        for(El::Int i = c; i < n; i += num_clients)
+                            results[i] = server.submit(point(X, i));
+                    }));
+        for(int c = 0; c < num_clients; c++)
+            clients[c].join();
+
+        for(El::Int i = 0; i < n; i++)
+            check_prediction(results[i].get(), model, PV, DV, i);
+
+        // Entries beyond the input size are ignored.
+        point_t p = point(X, 0);
+        p.push_back(std::make_pair(El::Int(X.Height() + 3), 5.0));
+        check_prediction(server.predict(p), model, PV, DV, 0);
+
+        BOOST_REQUIRE(server.num_requests() == n + 1);
+        BOOST_REQUIRE(server.num_batches() >= (n + max_batch - 1) / max_batch);
+        BOOST_REQUIRE(server.num_batches() <= n + 1);
+    }
+
+    // Requests queued at destruction are still answered.
+    {
+        std::vector<std::future<skyml::prediction_server_t::prediction_t> >
+            results(n);
+        {
+            skyml::prediction_server_t server(model, 2 * n, 10000000);
+            for(El::Int i = 0; i < n; i++)
+                results[i] = server.submit(point(X, i));
+        }
+        for(El::Int i = 0; i < n; i++)
+            check_prediction(results[i].get(), model, PV, DV, i);
+    }
+}
+
+int test_main(int argc, char *argv[]) {
+
+    El::Initialize(argc, argv);
+
+    skyb::context_t context(57);
+
+    const int d = 7, s = 12, k = 3, n = 41;
+
+    matrix_t X;
+    El::Gaussian(X, d, n);
+    for(El::Int i = 0; i < n; i++)
+        X.Set(i % d, i, 0.0);
+
+    typedef skys::GaussianRFT_t<matrix_t, matrix_t> map_t;
+    map_t map0(d, s, 1.5, context), map1(d, s, 0.7, context);
+    std::vector<const map_t *> maps = {&map0, &map1};
+
+    // Classification, several outputs.
+    {
+        skyml::hilbert_model_t model(maps, true, 2 * s, k, false);
+        El::Gaussian(model.get_coef(), 2 * s, k);
+        check_model(model, X);
+    }
+
+    // Classification, single output (labels are signs).
+    {
+        skyml::hilbert_model_t model(maps, false, 2 * s, 1, false);
+        El::Gaussian(model.get_coef(), 2 * s, 1);
+        check_model(model, X);
+    }
+
+    // Regression.
+    {
+        skyml::hilbert_model_t model(maps, true, 2 * s, 1, true);
+        El::Gaussian(model.get_coef(), 2 * s, 1);
+        check_model(model, X);
+    }
+
+    // Linear (no maps).
+    {
+        std::vector<const map_t *> nomaps;
+        skyml::hilbert_model_t model(nomaps, false, d, k, false);
+        El::Gaussian(model.get_coef(), d, k);
+        check_model(model, X);
+    }
+
+    El::Finalize();
+    return 0;
+}
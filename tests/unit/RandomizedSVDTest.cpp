@@ -0,0 +1,370 @@
+/**
+ *  This test checks the randomized SVDs against a known SVD, for tall and
+ *  wide matrices:
+ *
+ *    - BlockKrylovSVD and SinglePassSVD (JLT and CWT co-range sketch) on a
+ *      matrix of exactly the target rank: the exact factorization.
+ *    - BlockKrylovSVD (including more iterations than the size allows) and
+ *      SinglePassSVD on a matrix with decaying spectrum: the top singular
+ *      values, and a residual close to the optimal one.
+ *    - UpdateSVDRows and UpdateSVDColumns, appending in two steps rows
+ *      (columns) that add new directions while the total rank stays within
+ *      the factorization rank: the exact factorization of the grown matrix,
+ *      with the singular values of its dense SVD.
+ *    - A target rank larger than the matrix, and appended rows (columns)
+ *      of the wrong size, are rejected.
+ *    - The range finders of base/QR.hpp, on local and [VC,STAR] matrices:
+ *      CholeskyQR2 and ExplicitTS return orthonormal bases of the column
+ *      space, also of an ill-conditioned, rank deficient matrix (for which
+ *      CholeskyQR2 falls back to a tall-skinny QR), and ExplicitLU returns
+ *      a basis of the column space.
+ *
+ *      - Elemental Gemm, QR and SVD are implemented correctly.
+ */
+
+#include <cmath>
+#include <vector>
+
+#include <boost/mpi.hpp>
+#include <boost/test/minimal.hpp>
+
+#define SKYLARK_NO_ANY
+
+#include "../../skylark.hpp"
+
+#include "test_utils.hpp"
+
+namespace skyb = skylark::base;
+namespace skynla = skylark::nla;
+namespace skys = skylark::sketch;
+
+typedef El::Matrix<double> matrix_t;
+typedef El::DistMatrix<double, El::VC, El::STAR> vc_star_matrix_t;
+typedef El::DistMatrix<double, El::STAR, El::STAR> star_star_matrix_t;
+
+/** A = U0 diag(s) V0', with random orthonormal U0 (m x r), V0 (n x r). */
+void known_svd(El::Int m, El::Int n, const matrix_t& s, matrix_t& A) {
+    El::Int r = s.Height();
+    matrix_t U0, V0;
+    El::Gaussian(U0, m, r);
+    El::Gaussian(V0, n, r);
+    El::qr::ExplicitUnitary(U0);
+    El::qr::ExplicitUnitary(V0);
+    El::DiagonalScale(El::RIGHT, El::NORMAL, s, U0);
+    El::Zeros(A, m, n);
+    El::Gemm(El::NORMAL, El::ADJOINT, 1.0, U0, V0, 0.0, A);
+}
+
+/** ||X' X - I||_max */
+double orthogonality(const matrix_t& X) {
+    matrix_t G;
+    El::Identity(G, X.Width(), X.Width());
+    El::Gemm(El::ADJOINT, El::NORMAL, 1.0, X, X, -1.0, G);
+    return El::MaxNorm(G);
+}
+
+/**
+ * Checks the shapes, that U and V are orthonormal, that S is within
+ * stol * s_0 of the leading entries of s, and returns ||A - U S V'||_F.
+ */
+double check_svd(const matrix_t& A, const matrix_t& U, const matrix_t& S,
+    const matrix_t& V, const matrix_t& s, int rank, double stol) {
+
+    BOOST_REQUIRE(U.Height() == A.Height() && U.Width() == rank);
+    BOOST_REQUIRE(V.Height() == A.Width() && V.Width() == rank);
+    BOOST_REQUIRE(S.Height() == rank && S.Width() == 1);
+    BOOST_REQUIRE(orthogonality(U) < 1e-10);
+    BOOST_REQUIRE(orthogonality(V) < 1e-10);
+    for(int i = 0; i < rank; i++)
+        BOOST_REQUIRE(std::abs(S.Get(i, 0) - s.Get(i, 0)) <=
+            stol * s.Get(0, 0));
+
+    matrix_t US(U), E(A);
+    El::DiagonalScale(El::RIGHT, El::NORMAL, S, US);
+    El::Gemm(El::NORMAL, El::ADJOINT, -1.0, US, V, 1.0, E);
+    return El::FrobeniusNorm(E);
+}
+
+/** Rank r truncation of the dense SVD of A. */
+void truncated_svd(const matrix_t& A, int r, matrix_t& U, matrix_t& S,
+    matrix_t& V) {
+    U = A;
+    El::SVD(U, S, V);
+    U.Resize(A.Height(), r);
+    S.Resize(r, 1);
+    V.Resize(A.Width(), r);
+}
+
+void local_copy(const matrix_t& A, matrix_t& B) {
+    B = A;
+}
+
+void local_copy(const vc_star_matrix_t& A, matrix_t& B) {
+    star_star_matrix_t A_STAR_STAR(A);
+    B = A_STAR_STAR.Matrix();
+}
+
+/** ||A - Q Q' A||_F / ||A||_F, for Q with orthonormal columns. */
+double span_residual(const matrix_t& Q, const matrix_t& A) {
+    matrix_t QtA, E(A);
+    El::Zeros(QtA, Q.Width(), A.Width());
+    El::Gemm(El::ADJOINT, El::NORMAL, 1.0, Q, A, 0.0, QtA);
+    El::Gemm(El::NORMAL, El::NORMAL, -1.0, Q, QtA, 1.0, E);
+    return El::FrobeniusNorm(E) / El::FrobeniusNorm(A);
+}
+
+/** Orthonormal basis of the column space of A (of full column rank). */
+matrix_t orth(const matrix_t& A) {
+    matrix_t Q(A);
+    El::qr::ExplicitUnitary(Q);
+    return Q;
+}
+
+/**
+ * CholeskyQR2 and ExplicitTS of A0: orthonormal, and spanning the columns
+ * of A0; ExplicitLU (if lu is true): the same column space as A0.
+ */
+template<typename MatrixType>
+void check_range_finders(const MatrixType& A0, bool lu) {
+
+    matrix_t A;
+    local_copy(A0, A);
+
+    for(int method = 0; method < 2; method++) {
+        MatrixType Q(A0);
+        if (method == 0)
+            skyb::qr::CholeskyQR2(Q);
+        else
+            skyb::qr::ExplicitTS(Q);
+
+        matrix_t Ql;
+        local_copy(Q, Ql);
+        BOOST_REQUIRE(Ql.Height() == A.Height() && Ql.Width() == A.Width());
+        BOOST_REQUIRE(orthogonality(Ql) < 1e-12);
+        BOOST_REQUIRE(span_residual(Ql, A) < 1e-10);
+    }
+
+    if (lu) {
+        MatrixType PL(A0);
+        skyb::qr::ExplicitLU(PL);
+
+        matrix_t PLl;
+        local_copy(PL, PLl);
+        BOOST_REQUIRE(PLl.Height() == A.Height() && PLl.Width() == A.Width());
+        BOOST_REQUIRE(span_residual(orth(PLl), A) < 1e-10);
+        BOOST_REQUIRE(span_residual(orth(A), PLl) < 1e-10);
+    }
+}
+
+int test_main(int argc, char *argv[]) {
+
+    El::Initialize(argc, argv);
+
+    skyb::context_t context(1729);
+
+    const El::Int m = 200, n = 80;
+    const int rank = 5;
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Exact rank <]
+
+    {
+        matrix_t s(rank, 1);
+        for(int i = 0; i < rank; i++)
+            s.Set(i, 0, 10.0 - i);
+
+        for(int wide = 0; wide < 2; wide++) {
+            matrix_t A;
+            if (wide)
+                known_svd(n, m, s, A);
+            else
+                known_svd(m, n, s, A);
+            double nrm = El::FrobeniusNorm(A);
+
+            matrix_t U, S, V;
+            skynla::BlockKrylovSVD(A, U, S, V, rank, context);
+            BOOST_REQUIRE(check_svd(A, U, S, V, s, rank, 1e-10) < 1e-9 * nrm);
+
+            skynla::SinglePassSVD(A, U, S, V, rank, context);
+            BOOST_REQUIRE(check_svd(A, U, S, V, s, rank, 1e-10) < 1e-9 * nrm);
+
+            skynla::SinglePassSVD<skys::JLT_t, skys::CWT_t>(A, U, S, V, rank,
+                context);
+            BOOST_REQUIRE(check_svd(A, U, S, V, s, rank, 1e-10) < 1e-9 * nrm);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Decaying spectrum <]
+
+    {
+        // s_i = 2^-i, full rank.
+        matrix_t s(n, 1);
+        for(El::Int i = 0; i < n; i++)
+            s.Set(i, 0, std::pow(0.5, i));
+        double optimal = 0.0;
+        for(El::Int i = rank; i < n; i++)
+            optimal += s.Get(i, 0) * s.Get(i, 0);
+        optimal = std::sqrt(optimal);
+
+        for(int wide = 0; wide < 2; wide++) {
+            matrix_t A;
+            if (wide)
+                known_svd(n, m, s, A);
+            else
+                known_svd(m, n, s, A);
+
+            matrix_t U, S, V;
+
+            // A Krylov space of dimension 30 and (capped) 80.
+            int iterations[] = {2, 100};
+            for(int q = 0; q < 2; q++) {
+                skynla::approximate_svd_params_t params;
+                params.num_iterations = iterations[q];
+                skynla::BlockKrylovSVD(A, U, S, V, rank, context, params);
+                BOOST_REQUIRE(check_svd(A, U, S, V, s, rank, 1e-8) <=
+                    1.01 * optimal);
+            }
+
+            // Range sketch of 20 columns, co-range sketch of 41 rows.
+            skynla::approximate_svd_params_t params(2, 10);
+            skynla::SinglePassSVD(A, U, S, V, rank, context, params);
+            BOOST_REQUIRE(check_svd(A, U, S, V, s, rank, 1e-3) <=
+                1.1 * optimal);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Updates <]
+
+    {
+        // A0 (m x n) has rank 3; R (p x n) adds two new directions to the
+        // row space, so [A0; R] has rank 5 and the updated rank 5
+        // factorization is exact.
+        const El::Int p = 7, p1 = 4;
+        matrix_t s3(3, 1);
+        for(int i = 0; i < 3; i++)
+            s3.Set(i, 0, 3.0 - i);
+        matrix_t A0, G, W, R;
+        known_svd(m, n, s3, A0);
+        El::Gaussian(G, p, m);
+        El::Gaussian(W, p, 2);
+        El::Zeros(R, p, n);
+        El::Gemm(El::NORMAL, El::NORMAL, 0.1, G, A0, 0.0, R);
+        matrix_t N;
+        El::Gaussian(N, 2, n);
+        El::Gemm(El::NORMAL, El::NORMAL, 1.0, W, N, 1.0, R);
+
+        matrix_t A(m + p, n), Av;
+        El::View(Av, A, 0, 0, m, n);
+        El::Copy(A0, Av);
+        El::View(Av, A, m, 0, p, n);
+        El::Copy(R, Av);
+        double nrm = El::FrobeniusNorm(A);
+
+        matrix_t s, C(A);
+        El::SVD(C, s);
+
+        matrix_t R1, R2;
+        El::LockedView(R1, R, 0, 0, p1, n);
+        El::LockedView(R2, R, p1, 0, p - p1, n);
+
+        // Rows.
+        {
+            matrix_t U, S, V;
+            truncated_svd(A0, rank, U, S, V);
+            skynla::UpdateSVDRows(R1, U, S, V, context);
+            BOOST_REQUIRE(U.Height() == m + p1);
+            skynla::UpdateSVDRows(R2, U, S, V, context);
+            BOOST_REQUIRE(check_svd(A, U, S, V, s, rank, 1e-10) < 1e-9 * nrm);
+        }
+
+        // Columns, on the transposes.
+        {
+            matrix_t At, A0t, R1t, R2t;
+            El::Transpose(A, At);
+            El::Transpose(A0, A0t);
+            El::Transpose(R1, R1t);
+            El::Transpose(R2, R2t);
+
+            matrix_t U, S, V;
+            truncated_svd(A0t, rank, U, S, V);
+            skynla::UpdateSVDColumns(R1t, U, S, V, context);
+            BOOST_REQUIRE(V.Height() == m + p1);
+            skynla::UpdateSVDColumns(R2t, U, S, V, context);
+            BOOST_REQUIRE(check_svd(At, U, S, V, s, rank, 1e-10) <
+                1e-9 * nrm);
+        }
+
+        // Wrong sizes.
+        {
+            matrix_t U, S, V, B;
+            truncated_svd(A0, rank, U, S, V);
+            El::Gaussian(B, p, n + 1);
+            bool caught = false;
+            try {
+                skynla::UpdateSVDRows(B, U, S, V, context);
+            } catch (skyb::invalid_parameters& ex) {
+                caught = true;
+            }
+            BOOST_REQUIRE(caught);
+
+            El::Gaussian(B, m + 1, p);
+            caught = false;
+            try {
+                skynla::UpdateSVDColumns(B, U, S, V, context);
+            } catch (skyb::invalid_parameters& ex) {
+                caught = true;
+            }
+            BOOST_REQUIRE(caught);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Range finders <]
+
+    {
+        const El::Int k = 12;
+
+        // Gaussian, and with columns scaled down to 1e-9 and the last one
+        // zero: its Gram matrix is singular, so CholeskyQR2 cannot factor
+        // it and has to fall back to the tall-skinny QR.
+        star_star_matrix_t G, D(k, 1);
+        El::Gaussian(G, m, k);
+        for(El::Int j = 0; j < k; j++)
+            D.SetLocal(j, 0,
+                j < k - 1 ? std::pow(10.0, -9.0 * j / (k - 2)) : 0.0);
+        star_star_matrix_t Ill(G);
+        El::DiagonalScale(El::RIGHT, El::NORMAL, D, Ill);
+
+        check_range_finders(G.Matrix(), true);
+        check_range_finders(Ill.Matrix(), false);
+
+        vc_star_matrix_t G_VC_STAR(G), Ill_VC_STAR(Ill);
+        check_range_finders(G_VC_STAR, true);
+        check_range_finders(Ill_VC_STAR, false);
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Target rank larger than the matrix <]
+
+    {
+        matrix_t A, U, S, V;
+        El::Gaussian(A, 10, 4);
+        for(int method = 0; method < 2; method++) {
+            bool caught = false;
+            try {
+                if (method == 0)
+                    skynla::BlockKrylovSVD(A, U, S, V, 5, context);
+                else
+                    skynla::SinglePassSVD(A, U, S, V, 5, context);
+            } catch (skyb::skylark_exception& ex) {
+                caught = true;
+            }
+            BOOST_REQUIRE(caught);
+        }
+    }
+
+    El::Finalize();
+    return 0;
+}
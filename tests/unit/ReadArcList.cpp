@@ -29,11 +29,12 @@ int test_main(int argc, char *argv[]) {
     // We read the file in chunks and make sure all the data is read correctly
     // by exactly on rank.
 
-    std::stringstream data;
+    std::vector<char> data;
+    size_t data_start = 0;
 
     try {
         skylark::utility::io::detail::parallelChunkedRead(argv[1], world,
-            num_partitions, data);
+            num_partitions, data, data_start);
     } catch (skylark::base::skylark_exception ex) {
         SKYLARK_PRINT_EXCEPTION_DETAILS(ex);
         SKYLARK_PRINT_EXCEPTION_TRACE(ex);
@@ -54,7 +55,8 @@ int test_main(int argc, char *argv[]) {
     }
 
     std::vector<std::string> vec_data;
-    boost::mpi::gather(world, data.str(), vec_data, 0);
+    boost::mpi::gather(world,
+        std::string(data.begin() + data_start, data.end()), vec_data, 0);
 
     if (world.rank() == 0) {
         // compare line by line for nicer error reporting
@@ -65,13 +67,8 @@ int test_main(int argc, char *argv[]) {
             std::stringstream res_data;
             res_data << vec_data[i];
 
+            // each rank only owns full lines
             std::string line;
-            // XXX: we need to strip the first partial line for all ranks after
-            //      0. Note that this is not necessarely true since a rank can
-            //      get the start of a line.
-            if (i > 0)
-                std::getline(res_data, line);
-
             while (std::getline(res_data, line)) {
                 std::string ref_line;
                 std::getline(ref_data, ref_line);
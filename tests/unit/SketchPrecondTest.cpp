@@ -0,0 +1,220 @@
+/**
+ *  This test checks the reusable sketch-and-precondition preconditioner on
+ *  an ill conditioned least squares problem:
+ *
+ *    - Built by FastLeastSquares on first use and reused for later
+ *      right-hand sides: the least squares solution, computed from a known
+ *      factorization of A, in a few LSQR iterations.
+ *    - save() and load: the same size, condition estimate and R, and the
+ *      same solutions.
+ *    - refresh() on A D (D diagonal) reuses the sketch, also when loaded:
+ *      the new R is R D.
+ *    - Matrices of another size are rejected by refresh() and
+ *      FastLeastSquares, and refresh() needs a built preconditioner.
+ *
+ *      - Elemental Gemm and QR are implemented correctly.
+ *      - LSQR is implemented correctly.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <boost/mpi.hpp>
+#include <boost/test/minimal.hpp>
+
+#define SKYLARK_NO_ANY
+
+#include "../../skylark.hpp"
+
+#include "test_utils.hpp"
+
+namespace skyb = skylark::base;
+namespace skyalg = skylark::algorithms;
+namespace skynla = skylark::nla;
+
+typedef El::DistMatrix<double> dense_matrix_t;
+typedef El::DistMatrix<double, El::STAR, El::STAR> dense_star_star_matrix_t;
+typedef skyalg::sketch_precond_t<dense_matrix_t, dense_matrix_t>
+    precond_t;
+
+/** Largest relative difference between columns of X and Y. */
+template<typename MatrixType>
+double colreldiff(const MatrixType& X, const MatrixType& Y) {
+    dense_star_star_matrix_t Xs(X), Ys(Y);
+    double worst = 0.0;
+    for(El::Int j = 0; j < Ys.Width(); j++) {
+        double diff = 0.0, nrm = 0.0;
+        for(El::Int i = 0; i < Ys.Height(); i++) {
+            double d = Xs.GetLocal(i, j) - Ys.GetLocal(i, j);
+            diff += d * d;
+            nrm += Ys.GetLocal(i, j) * Ys.GetLocal(i, j);
+        }
+        worst = std::max(worst, std::sqrt(diff / nrm));
+    }
+    return worst;
+}
+
+/** Solves with precond, and checks against Xls and the iteration counts. */
+void check_solve(const dense_matrix_t& A, const dense_matrix_t& B,
+    const dense_matrix_t& Xls, precond_t& precond, skyb::context_t& context,
+    dense_matrix_t& X) {
+
+    std::vector<int> iterations;
+    skyalg::krylov_iter_params_t params(1e-12, 200);
+    params.column_iterations = &iterations;
+
+    El::Zeros(X, A.Width(), B.Width());
+    skynla::FastLeastSquares(El::NORMAL, A, B, X, precond, context, params);
+    BOOST_REQUIRE(colreldiff(X, Xls) < 1e-8);
+    for(size_t j = 0; j < iterations.size(); j++)
+        BOOST_REQUIRE(iterations[j] < 100);
+}
+
+int test_main(int argc, char *argv[]) {
+
+    El::Initialize(argc, argv);
+
+    boost::mpi::communicator world;
+    El::Grid grid(world);
+    skyb::context_t context(619);
+
+    const El::Int m = 500, n = 20, k = 3;
+
+    // A = Q S with orthonormal Q and S = diag(1 .. 1e-3), so that the least
+    // squares solution is S^{-1} Q' B.
+    dense_matrix_t Q(grid);
+    skyb::GaussianMatrix(Q, m, n, context);
+    El::qr::ExplicitUnitary(Q);
+    dense_star_star_matrix_t s(n, 1, grid), sinv(n, 1, grid);
+    for(El::Int j = 0; j < n; j++) {
+        s.SetLocal(j, 0, std::pow(10.0, -3.0 * j / (n - 1)));
+        sinv.SetLocal(j, 0, 1.0 / s.GetLocal(j, 0));
+    }
+    dense_matrix_t A(Q);
+    El::DiagonalScale(El::RIGHT, El::NORMAL, s, A);
+
+    // Two blocks of right-hand sides, and their solutions.
+    std::vector<dense_matrix_t> B(2, dense_matrix_t(grid));
+    std::vector<dense_matrix_t> Xls(2, dense_matrix_t(grid));
+    for(int b = 0; b < 2; b++) {
+        skyb::GaussianMatrix(B[b], m, k, context);
+        El::Zeros(Xls[b], n, k);
+        El::Gemm(El::ADJOINT, El::NORMAL, 1.0, Q, B[b], 0.0, Xls[b]);
+        El::DiagonalScale(El::LEFT, El::NORMAL, sinv, Xls[b]);
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Build on first use, reuse <]
+
+    precond_t precond;
+    BOOST_REQUIRE(!precond.ready());
+
+    std::vector<dense_matrix_t> X(2, dense_matrix_t(grid));
+    for(int b = 0; b < 2; b++)
+        check_solve(A, B[b], Xls[b], precond, context, X[b]);
+
+    BOOST_REQUIRE(precond.ready());
+    BOOST_REQUIRE(precond.height() == m && precond.width() == n);
+    BOOST_REQUIRE(precond.fits(A));
+    BOOST_REQUIRE(precond.condest() > 1e2 && precond.condest() < 1e14);
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Save and load <]
+
+    const std::string fname = "sketch_precond_test.json";
+    precond.save(fname, world.rank() == 0);
+    world.barrier();
+
+    precond_t loaded(fname);
+    BOOST_REQUIRE(loaded.ready());
+    BOOST_REQUIRE(loaded.height() == m && loaded.width() == n);
+    BOOST_REQUIRE(std::abs(loaded.condest() - precond.condest()) <=
+        1e-12 * precond.condest());
+
+    dense_star_star_matrix_t R(precond.R()), Rl(loaded.R());
+    El::Axpy(-1.0, R, Rl);
+    BOOST_REQUIRE(El::MaxNorm(Rl) == 0.0);
+
+    for(int b = 0; b < 2; b++) {
+        dense_matrix_t Xl(grid);
+        check_solve(A, B[b], Xls[b], loaded, context, Xl);
+        BOOST_REQUIRE(colreldiff(Xl, X[b]) < 1e-14);
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Refresh <]
+
+    {
+        // A D, with D = diag(1 .. 2): S A D = (S A) D, so R becomes R D.
+        dense_star_star_matrix_t d(n, 1, grid);
+        for(El::Int j = 0; j < n; j++)
+            d.SetLocal(j, 0, 1.0 + double(j) / (n - 1));
+        dense_matrix_t AD(A);
+        El::DiagonalScale(El::RIGHT, El::NORMAL, d, AD);
+
+        dense_star_star_matrix_t RD(R);
+        El::DiagonalScale(El::RIGHT, El::NORMAL, d, RD);
+
+        precond_t *preconds[] = {&precond, &loaded};
+        for(int p = 0; p < 2; p++) {
+            preconds[p]->refresh(AD);
+            dense_star_star_matrix_t Rr(preconds[p]->R());
+            El::Axpy(-1.0, RD, Rr);
+            BOOST_REQUIRE(El::MaxNorm(Rr) <= 1e-12 * El::MaxNorm(RD));
+        }
+
+        // Solutions of the refreshed problem: D^{-1} Xls.
+        dense_star_star_matrix_t dinv(d);
+        for(El::Int j = 0; j < n; j++)
+            dinv.SetLocal(j, 0, 1.0 / d.GetLocal(j, 0));
+        dense_matrix_t XD(Xls[0]), Xr(grid);
+        El::DiagonalScale(El::LEFT, El::NORMAL, dinv, XD);
+        check_solve(AD, B[0], XD, loaded, context, Xr);
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Matrices of another size <]
+
+    {
+        dense_matrix_t Aw(grid), Bw(grid), Xw(grid);
+        skyb::GaussianMatrix(Aw, m, n + 1, context);
+        skyb::GaussianMatrix(Bw, m, 1, context);
+        El::Zeros(Xw, n + 1, 1);
+        BOOST_REQUIRE(!precond.fits(Aw));
+
+        bool caught = false;
+        try {
+            precond.refresh(Aw);
+        } catch (skyb::invalid_parameters& ex) {
+            caught = true;
+        }
+        BOOST_REQUIRE(caught);
+
+        caught = false;
+        try {
+            skynla::FastLeastSquares(El::NORMAL, Aw, Bw, Xw, precond,
+                context);
+        } catch (skyb::invalid_parameters& ex) {
+            caught = true;
+        }
+        BOOST_REQUIRE(caught);
+
+        precond_t empty;
+        caught = false;
+        try {
+            empty.refresh(A);
+        } catch (skyb::invalid_parameters& ex) {
+            caught = true;
+        }
+        BOOST_REQUIRE(caught);
+    }
+
+    world.barrier();
+    if (world.rank() == 0)
+        std::remove(fname.c_str());
+
+    El::Finalize();
+    return 0;
+}
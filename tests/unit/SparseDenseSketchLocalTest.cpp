@@ -0,0 +1,142 @@
+/**
+ *  This test checks the sparse input path of the local dense sketches (JLT)
+ *  and random feature maps (GaussianRFT): applied to a sparse matrix with
+ *  empty rows and columns, columnwise and rowwise, they give the same sketch
+ *  as applied to its dense copy. Also after the samples are kept realized
+ *  (keep_realized), which must not change the sketches.
+ *
+ *      - Elemental Gemm is implemented correctly.
+ *      - base::DenseCopy is implemented correctly.
+ */
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <boost/mpi.hpp>
+#include <boost/test/minimal.hpp>
+
+#define SKYLARK_NO_ANY
+
+#include "../../skylark.hpp"
+
+#include "test_utils.hpp"
+
+namespace skyb = skylark::base;
+namespace skys = skylark::sketch;
+
+typedef El::Matrix<double> matrix_t;
+typedef skyb::sparse_matrix_t<double> sparse_matrix_t;
+
+/**
+ * Random m x n sparse matrix A, and its dense copy AD. Rows 0, m - 1 and
+ * the multiples of 5, and columns 0, n - 1 and the multiples of 7 are
+ * empty.
+ */
+void random_sparse(El::Int m, El::Int n, std::mt19937& gen,
+    sparse_matrix_t& A, matrix_t& AD) {
+
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+    std::normal_distribution<double> value;
+
+    sparse_matrix_t::coords_t coords;
+    for(int j = 0; j < n; j++)
+        for(int i = 0; i < m; i++) {
+            if (i == 0 || i == m - 1 || i % 5 == 0 ||
+                j == 0 || j == n - 1 || j % 7 == 0)
+                continue;
+            if (coin(gen) < 0.3)
+                coords.push_back(sparse_matrix_t::coord_tuple_t(i, j,
+                        value(gen)));
+        }
+
+    A.set(coords, m, n);
+    skyb::DenseCopy(A, AD);
+}
+
+/**
+ * Sketches of A (with Ts) and of its dense copy AD (with Td) in dimension
+ * Dimension must agree; the sketch is h x w. Returns the sketch of A.
+ */
+template<typename SparseTransformType, typename DenseTransformType,
+         typename Dimension>
+matrix_t check_apply(const SparseTransformType& Ts,
+    const DenseTransformType& Td, const sparse_matrix_t& A,
+    const matrix_t& AD, El::Int h, El::Int w, Dimension dimension) {
+
+    matrix_t SA(h, w), SAD(h, w);
+    Ts.apply(A, SA, dimension);
+    Td.apply(AD, SAD, dimension);
+
+    BOOST_REQUIRE(SA.Height() == h && SA.Width() == w);
+    matrix_t D(SA);
+    El::Axpy(-1.0, SAD, D);
+    BOOST_REQUIRE(El::MaxNorm(D) <= 1e-12 * std::max(1.0, El::MaxNorm(SAD)));
+    return SA;
+}
+
+/**
+ * Sparse against dense application of Transform<sparse_matrix_t, matrix_t>
+ * (built by make) and of its Transform<matrix_t, matrix_t> copy, before and
+ * after keep_realized.
+ */
+template<template<typename, typename> class Transform, typename Make>
+void check_transform(Make make) {
+
+    typedef Transform<sparse_matrix_t, matrix_t> sparse_transform_t;
+    typedef Transform<matrix_t, matrix_t> dense_transform_t;
+
+    const El::Int N = 60, S = 20, n = 23;
+    std::mt19937 gen(3);
+
+    // Columnwise: A is N x n, and rowwise: n x N.
+    sparse_matrix_t Ac, Ar;
+    matrix_t ADc, ADr;
+    random_sparse(N, n, gen, Ac, ADc);
+    random_sparse(n, N, gen, Ar, ADr);
+
+    skyb::context_t context(29);
+    sparse_transform_t Ts = make(N, S, context);
+    dense_transform_t Td(Ts);
+
+    matrix_t SAc = check_apply(Ts, Td, Ac, ADc, S, n, skys::columnwise_tag());
+    matrix_t SAr = check_apply(Ts, Td, Ar, ADr, n, S, skys::rowwise_tag());
+
+    // Kept realized: the same sketches, for the transform and its copies.
+    Ts.get_data()->keep_realized();
+    sparse_transform_t Tsc(Ts);
+
+    matrix_t SAck = check_apply(Ts, Td, Ac, ADc, S, n,
+        skys::columnwise_tag());
+    matrix_t SArk = check_apply(Tsc, Td, Ar, ADr, n, S,
+        skys::rowwise_tag());
+    El::Axpy(-1.0, SAc, SAck);
+    El::Axpy(-1.0, SAr, SArk);
+    BOOST_REQUIRE(El::MaxNorm(SAck) == 0.0);
+    BOOST_REQUIRE(El::MaxNorm(SArk) == 0.0);
+}
+
+int test_main(int argc, char *argv[]) {
+
+    El::Initialize(argc, argv);
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> JLT <]
+
+    check_transform<skys::JLT_t>(
+        [] (int N, int S, skyb::context_t& context) {
+            return skys::JLT_t<sparse_matrix_t, matrix_t>(N, S, context);
+        });
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> GaussianRFT <]
+
+    check_transform<skys::GaussianRFT_t>(
+        [] (int N, int S, skyb::context_t& context) {
+            return skys::GaussianRFT_t<sparse_matrix_t, matrix_t>(N, S, 2.0,
+                context);
+        });
+
+    El::Finalize();
+    return 0;
+}
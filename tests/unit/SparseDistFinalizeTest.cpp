@@ -0,0 +1,162 @@
+/**
+ *  This test checks the radix sort and the coordinate list finalize of
+ *  distributed sparse matrices, for several numbers of threads:
+ *
+ *    - RadixSort is stable and sorts keys wider than 32 bits: the same
+ *      order as std::stable_sort.
+ *    - finalize(coords) builds the same local CSC structure (indptr,
+ *      indices, values, bit by bit) as queue_update followed by finalize(),
+ *      on coordinates with duplicates, empty rows and empty columns, and
+ *      also when some values were queued before.
+ *
+ *  Duplicates are summed in the order they are given on both paths, so
+ *  sums agree exactly.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <boost/mpi.hpp>
+#include <boost/test/minimal.hpp>
+
+#define SKYLARK_NO_ANY
+
+#include "../../skylark.hpp"
+
+#include "test_utils.hpp"
+
+#ifdef SKYLARK_HAVE_OPENMP
+#include <omp.h>
+#endif
+
+namespace skyb = skylark::base;
+namespace skyu = skylark::utility;
+
+typedef skyb::sparse_vc_star_matrix_t<double> matrix_t;
+typedef std::tuple<El::Int, El::Int, double> coord_t;
+
+/** Requires the same local CSC structure and global number of nonzeros. */
+void check_equal(const matrix_t& A, const matrix_t& B) {
+
+    BOOST_REQUIRE(A.local_height() == B.local_height());
+    BOOST_REQUIRE(A.local_width() == B.local_width());
+    BOOST_REQUIRE(A.local_nonzeros() == B.local_nonzeros());
+    BOOST_REQUIRE(A.nonzeros() == B.nonzeros());
+
+    for(El::Int j = 0; j <= A.local_width(); j++)
+        BOOST_REQUIRE(A.indptr()[j] == B.indptr()[j]);
+
+    for(El::Int k = 0; k < A.local_nonzeros(); k++) {
+        BOOST_REQUIRE(A.indices()[k] == B.indices()[k]);
+        BOOST_REQUIRE(A.locked_values()[k] == B.locked_values()[k]);
+    }
+}
+
+int test_main(int argc, char *argv[]) {
+
+    El::Initialize(argc, argv);
+
+    boost::mpi::communicator world;
+    El::Grid grid(world);
+
+    // Same coordinates on all ranks.
+    std::mt19937 gen(1234);
+
+    int threads[] = {1, 2, 4};
+
+    for(int t = 0; t < 3; t++) {
+#       ifdef SKYLARK_HAVE_OPENMP
+        omp_set_num_threads(threads[t]);
+#       endif
+
+        //////////////////////////////////////////////////////////////////////
+        //[> Radix sort <]
+
+        {
+            // Few distinct keys (many ties), some above 2^32.
+            std::uniform_int_distribution<int> digit(0, 63);
+            std::vector<std::pair<std::uint64_t, size_t> > data(5000);
+            for(size_t i = 0; i < data.size(); i++)
+                data[i] = std::make_pair(
+                    (std::uint64_t(digit(gen)) << 35) + digit(gen), i);
+
+            std::vector<std::pair<std::uint64_t, size_t> > ref(data);
+            std::stable_sort(ref.begin(), ref.end(),
+                [](const std::pair<std::uint64_t, size_t>& x,
+                   const std::pair<std::uint64_t, size_t>& y) {
+                    return x.first < y.first;
+                });
+
+            skyu::RadixSort(data,
+                [](const std::pair<std::uint64_t, size_t>& x) {
+                    return x.first;
+                });
+            BOOST_REQUIRE(data == ref);
+        }
+
+        //////////////////////////////////////////////////////////////////////
+        //[> Coordinate list finalize <]
+
+        {
+            // Rows that are multiples of 7 and columns 5 and 17 are empty;
+            // coordinates are drawn from a small range, and some are
+            // repeated explicitly, so there are many duplicates.
+            const El::Int m = 97, n = 40;
+            std::uniform_int_distribution<El::Int> row(0, m - 1), col(0, n - 1);
+            std::uniform_real_distribution<double> value(-1.0, 1.0);
+
+            std::vector<coord_t> coords;
+            while(coords.size() < 3000) {
+                El::Int i = row(gen), j = col(gen);
+                if (i % 7 == 0 || j == 5 || j == 17)
+                    continue;
+                coords.push_back(std::make_tuple(i, j, value(gen)));
+                if (coords.size() % 10 == 0)
+                    coords.push_back(std::make_tuple(i, j, value(gen)));
+            }
+
+            matrix_t Aq(m, n, grid), Ar(m, n, grid);
+            for(size_t k = 0; k < coords.size(); k++)
+                Aq.queue_update(std::get<0>(coords[k]),
+                    std::get<1>(coords[k]), std::get<2>(coords[k]));
+            Aq.finalize();
+            Ar.finalize(coords);
+            check_equal(Aq, Ar);
+
+            for(El::Int j = 0; j < Ar.local_width(); j++)
+                for(El::Int k = Ar.indptr()[j]; k < Ar.indptr()[j + 1]; k++)
+                    BOOST_REQUIRE(Ar.global_row(Ar.indices()[k]) % 7 != 0);
+            if (Ar.local_width() > 17)
+                BOOST_REQUIRE(Ar.indptr()[17] == Ar.indptr()[18]);
+
+            // Values queued before finalize(coords) are added to the list.
+            // Integer values, since the order of the sums differs.
+            std::vector<coord_t> rounded, first, second;
+            for(size_t k = 0; k < coords.size(); k++) {
+                coord_t c = coords[k];
+                std::get<2>(c) = std::floor(8 * std::get<2>(c));
+                rounded.push_back(c);
+                (k % 3 == 0 ? first : second).push_back(c);
+            }
+
+            matrix_t Bq(m, n, grid), Br(m, n, grid);
+            for(size_t k = 0; k < rounded.size(); k++)
+                Bq.queue_update(std::get<0>(rounded[k]),
+                    std::get<1>(rounded[k]), std::get<2>(rounded[k]));
+            Bq.finalize();
+            for(size_t k = 0; k < first.size(); k++)
+                Br.queue_update(std::get<0>(first[k]),
+                    std::get<1>(first[k]), std::get<2>(first[k]));
+            Br.finalize(second);
+            check_equal(Bq, Br);
+        }
+    }
+
+    El::Finalize();
+    return 0;
+}
@@ -0,0 +1,326 @@
+/**
+ *  This test checks the streaming (row block reader) algorithms, for block
+ *  sizes smaller than the width, that do not divide the height, and larger
+ *  than the matrix:
+ *
+ *    - StreamingTSQR: an upper triangular R with R' R = A' A.
+ *    - StreamingLeastSquares on consistent and inconsistent right-hand
+ *      sides: the least squares solution computed from a known
+ *      factorization of A, and its residual. Wide matrices are rejected.
+ *    - StreamingSVD, with and without power iterations, on a matrix of
+ *      exactly the target rank (the exact factorization, U being collected
+ *      from the blocks handed out) and on a matrix with decaying spectrum
+ *      (the top singular values, and a residual close to the optimal one).
+ *    - The LIBSVM row block reader, on a file with comment and empty lines
+ *      (including before the first example) and examples without features:
+ *      the same dimensions and blocks as the matrix written, and the same
+ *      least squares solution.
+ *
+ *      - Elemental Gemm, QR and SVD are implemented correctly.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <string>
+
+#include <boost/mpi.hpp>
+#include <boost/test/minimal.hpp>
+
+#define SKYLARK_NO_ANY
+
+#include "../../skylark.hpp"
+
+#include "test_utils.hpp"
+
+namespace skyb = skylark::base;
+namespace skynla = skylark::nla;
+namespace skyio = skylark::utility::io;
+
+typedef El::Matrix<double> matrix_t;
+typedef skynla::matrix_row_block_reader_t<double> reader_t;
+
+/** A = U0 diag(s) V0', with random orthonormal U0 (m x r), V0 (n x r). */
+void known_svd(El::Int m, El::Int n, const matrix_t& s, matrix_t& A) {
+    El::Int r = s.Height();
+    matrix_t U0, V0;
+    El::Gaussian(U0, m, r);
+    El::Gaussian(V0, n, r);
+    El::qr::ExplicitUnitary(U0);
+    El::qr::ExplicitUnitary(V0);
+    El::DiagonalScale(El::RIGHT, El::NORMAL, s, U0);
+    El::Zeros(A, m, n);
+    El::Gemm(El::NORMAL, El::ADJOINT, 1.0, U0, V0, 0.0, A);
+}
+
+/** ||X' X - I||_max */
+double orthogonality(const matrix_t& X) {
+    matrix_t G;
+    El::Identity(G, X.Width(), X.Width());
+    El::Gemm(El::ADJOINT, El::NORMAL, 1.0, X, X, -1.0, G);
+    return El::MaxNorm(G);
+}
+
+/**
+ * StreamingSVD of A, collecting U from the blocks. Checks the shapes, that
+ * U and V are orthonormal, that S is within stol * s_0 of the leading
+ * entries of s, and returns ||A - U S V'||_F.
+ */
+double check_streaming_svd(const matrix_t& A, int blocksize,
+    const matrix_t& s, int rank, double stol, skyb::context_t& context,
+    const skynla::approximate_svd_params_t& params) {
+
+    const El::Int m = A.Height(), n = A.Width();
+
+    matrix_t U, S, V;
+    El::Zeros(U, m, rank);
+    El::Int covered = 0;
+    reader_t reader(A, blocksize);
+    skynla::StreamingSVD(reader, S, V, rank, context, params,
+        std::function<void (const matrix_t&, El::Int)>(
+            [&](const matrix_t& Ub, El::Int first) {
+                BOOST_REQUIRE(first == covered);
+                BOOST_REQUIRE(Ub.Width() == rank);
+                matrix_t Uv;
+                El::View(Uv, U, first, 0, Ub.Height(), rank);
+                El::Copy(Ub, Uv);
+                covered += Ub.Height();
+            }));
+    BOOST_REQUIRE(covered == m);
+
+    BOOST_REQUIRE(V.Height() == n && V.Width() == rank);
+    BOOST_REQUIRE(S.Height() == rank && S.Width() == 1);
+    BOOST_REQUIRE(orthogonality(U) < 1e-10);
+    BOOST_REQUIRE(orthogonality(V) < 1e-10);
+    for(int i = 0; i < rank; i++)
+        BOOST_REQUIRE(std::abs(S.Get(i, 0) - s.Get(i, 0)) <=
+            stol * s.Get(0, 0));
+
+    matrix_t US(U), E(A);
+    El::DiagonalScale(El::RIGHT, El::NORMAL, S, US);
+    El::Gemm(El::NORMAL, El::ADJOINT, -1.0, US, V, 1.0, E);
+    return El::FrobeniusNorm(E);
+}
+
+int test_main(int argc, char *argv[]) {
+
+    El::Initialize(argc, argv);
+
+    skyb::context_t context(2203);
+
+    const El::Int m = 203, d = 20, k = 4;
+    const int blocksizes[] = {7, 50, 203, 500};
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> TSQR <]
+
+    {
+        matrix_t A, AtA;
+        El::Gaussian(A, m, d);
+        El::Zeros(AtA, d, d);
+        El::Gemm(El::ADJOINT, El::NORMAL, 1.0, A, A, 0.0, AtA);
+        double nrm = El::MaxNorm(AtA);
+
+        for(int b = 0; b < 4; b++) {
+            reader_t reader(A, blocksizes[b]);
+            matrix_t R;
+            skynla::StreamingTSQR(reader, R);
+            BOOST_REQUIRE(R.Height() == d && R.Width() == d);
+            for(El::Int j = 0; j < d; j++)
+                for(El::Int i = j + 1; i < d; i++)
+                    BOOST_REQUIRE(R.Get(i, j) == 0.0);
+
+            El::Gemm(El::ADJOINT, El::NORMAL, 1.0, R, R, -1.0, AtA);
+            BOOST_REQUIRE(El::MaxNorm(AtA) < 1e-12 * nrm);
+            El::Gemm(El::ADJOINT, El::NORMAL, 1.0, R, R, 0.0, AtA);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> Least squares <]
+
+    {
+        // A = Q S with orthonormal Q and S = diag(1 .. 0.1), so that the
+        // least squares solution is S^{-1} Q' B.
+        matrix_t Q, s(d, 1), sinv(d, 1);
+        El::Gaussian(Q, m, d);
+        El::qr::ExplicitUnitary(Q);
+        for(El::Int j = 0; j < d; j++) {
+            s.Set(j, 0, std::pow(10.0, -1.0 * j / (d - 1)));
+            sinv.Set(j, 0, 1.0 / s.Get(j, 0));
+        }
+        matrix_t A(Q);
+        El::DiagonalScale(El::RIGHT, El::NORMAL, s, A);
+
+        // Consistent (first two) and inconsistent (last two) columns.
+        matrix_t Xt, N, B;
+        El::Gaussian(Xt, d, k);
+        El::Gaussian(N, m, k);
+        El::Zeros(B, m, k);
+        El::Gemm(El::NORMAL, El::NORMAL, 1.0, A, Xt, 0.0, B);
+        for(El::Int j = 2; j < k; j++)
+            for(El::Int i = 0; i < m; i++)
+                B.Update(i, j, 0.1 * N.Get(i, j));
+
+        matrix_t Xls;
+        El::Zeros(Xls, d, k);
+        El::Gemm(El::ADJOINT, El::NORMAL, 1.0, Q, B, 0.0, Xls);
+        El::DiagonalScale(El::LEFT, El::NORMAL, sinv, Xls);
+
+        matrix_t E(B);
+        El::Gemm(El::NORMAL, El::NORMAL, -1.0, A, Xls, 1.0, E);
+        double optimal = El::FrobeniusNorm(E);
+
+        for(int b = 0; b < 4; b++) {
+            reader_t reader(A, blocksizes[b], &B);
+            matrix_t X;
+            double residual;
+            skynla::StreamingLeastSquares(reader, X, &residual);
+            BOOST_REQUIRE(X.Height() == d && X.Width() == k);
+            El::Axpy(-1.0, Xls, X);
+            BOOST_REQUIRE(El::MaxNorm(X) < 1e-10 * El::MaxNorm(Xls));
+            BOOST_REQUIRE(std::abs(residual - optimal) < 1e-10 * optimal);
+        }
+
+        // Fewer rows than columns.
+        matrix_t Aw, Bw;
+        El::Gaussian(Aw, 5, 8);
+        El::Gaussian(Bw, 5, 1);
+        reader_t reader(Aw, 2, &Bw);
+        matrix_t X;
+        bool caught = false;
+        try {
+            skynla::StreamingLeastSquares(reader, X);
+        } catch (skyb::nla_exception& ex) {
+            caught = true;
+        }
+        BOOST_REQUIRE(caught);
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> SVD <]
+
+    {
+        const El::Int n = 80;
+        const int rank = 5;
+
+        // Exact rank, with a sketch of exactly the target rank.
+        {
+            matrix_t s(rank, 1);
+            for(int i = 0; i < rank; i++)
+                s.Set(i, 0, 10.0 - i);
+            matrix_t A;
+            known_svd(m, n, s, A);
+            double nrm = El::FrobeniusNorm(A);
+
+            for(int q = 0; q < 2; q++)
+                for(int b = 0; b < 4; b++) {
+                    skynla::approximate_svd_params_t params(1, 0, q);
+                    BOOST_REQUIRE(check_streaming_svd(A, blocksizes[b], s,
+                            rank, 1e-10, context, params) < 1e-9 * nrm);
+                }
+        }
+
+        // s_i = 2^-i, full rank; the default sketch of twice the rank.
+        {
+            matrix_t s(n, 1);
+            for(El::Int i = 0; i < n; i++)
+                s.Set(i, 0, std::pow(0.5, i));
+            double optimal = 0.0;
+            for(El::Int i = rank; i < n; i++)
+                optimal += s.Get(i, 0) * s.Get(i, 0);
+            optimal = std::sqrt(optimal);
+            matrix_t A;
+            known_svd(m, n, s, A);
+
+            for(int b = 0; b < 4; b++) {
+                skynla::approximate_svd_params_t params(2, 0, 2);
+                BOOST_REQUIRE(check_streaming_svd(A, blocksizes[b], s, rank,
+                        1e-8, context, params) <= 1.01 * optimal);
+            }
+        }
+
+        // Target rank larger than the matrix.
+        matrix_t A, S, V;
+        El::Gaussian(A, 10, 4);
+        reader_t reader(A, 3);
+        bool caught = false;
+        try {
+            skynla::StreamingSVD(reader, S, V, 5, context);
+        } catch (skyb::skylark_exception& ex) {
+            caught = true;
+        }
+        BOOST_REQUIRE(caught);
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    //[> LIBSVM file <]
+
+    {
+        // Every third entry is zero (left out of the file), and so is the
+        // whole of row 10.
+        matrix_t A, B;
+        El::Gaussian(A, m, d);
+        El::Gaussian(B, m, 1);
+        for(El::Int j = 0; j < d; j++)
+            for(El::Int i = 0; i < m; i++)
+                if ((i + j) % 3 == 0 || i == 10)
+                    A.Set(i, j, 0.0);
+
+        const std::string fname = "streaming_test.libsvm";
+        {
+            std::ofstream out(fname);
+            out.precision(std::numeric_limits<double>::digits10 + 2);
+            out << "# header\n\n";
+            for(El::Int i = 0; i < m; i++) {
+                out << B.Get(i, 0);
+                for(El::Int j = 0; j < d; j++)
+                    if (A.Get(i, j) != 0.0)
+                        out << " " << j + 1 << ":" << A.Get(i, j);
+                out << "\n";
+                if (i % 50 == 7)
+                    out << "\n# comment\n";
+            }
+        }
+
+        for(int b = 0; b < 4; b++) {
+            skyio::libsvm_row_block_reader_t<double> reader(fname,
+                blocksizes[b]);
+            BOOST_REQUIRE(reader.height() == m);
+            BOOST_REQUIRE(reader.width() == d);
+            BOOST_REQUIRE(reader.targets() == 1);
+
+            // Twice: rewind() starts over.
+            for(int pass = 0; pass < 2; pass++) {
+                matrix_t X, Y;
+                El::Int first = 0;
+                reader.rewind();
+                while (reader.next(X, Y)) {
+                    BOOST_REQUIRE(X.Width() == d && Y.Width() == 1);
+                    for(El::Int i = 0; i < X.Height(); i++) {
+                        BOOST_REQUIRE(Y.Get(i, 0) == B.Get(first + i, 0));
+                        for(El::Int j = 0; j < d; j++)
+                            BOOST_REQUIRE(X.Get(i, j) ==
+                                A.Get(first + i, j));
+                    }
+                    first += X.Height();
+                }
+                BOOST_REQUIRE(first == m);
+            }
+
+            matrix_t X, Xm;
+            skynla::StreamingLeastSquares(reader, X);
+            reader_t mreader(A, blocksizes[b], &B);
+            skynla::StreamingLeastSquares(mreader, Xm);
+            El::Axpy(-1.0, Xm, X);
+            BOOST_REQUIRE(El::MaxNorm(X) <= 1e-14 * El::MaxNorm(Xm));
+        }
+
+        std::remove(fname.c_str());
+    }
+
+    El::Finalize();
+    return 0;
+}
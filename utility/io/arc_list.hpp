@@ -1,17 +1,21 @@
 #ifndef SKYLARK_ARC_LIST_HPP_
 #define SKYLARK_ARC_LIST_HPP_
 
-#include <boost/lexical_cast.hpp>
-#include <boost/algorithm/string.hpp>
+#include <boost/serialization/vector.hpp>
 
 #include <algorithm>
 #include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <tuple>
 #include <vector>
 
+#include "compressed_io.hpp"
+
 // XXX: add a Boost serializer for our edge tuples: (index, index, value)
 namespace boost { namespace serialization {
 
@@ -32,104 +36,134 @@ namespace skylark { namespace utility { namespace io {
 // FIXME: move to io util header
 namespace detail {
 
-template <typename value_t>
-void local_insert(
-    base::sparse_vc_star_matrix_t<value_t>& X,
-    const std::vector<std::tuple<El::Int, El::Int, value_t> >& edge_list) {
+inline bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
 
-    assert(X.is_finalized() == false);
+inline const char *skip_blanks(const char *pos, const char *end) {
+    while (pos != end && is_blank(*pos))
+        pos++;
+    return pos;
+}
+
+/**
+ * Parses a non-negative integer token starting at pos.
+ *
+ * @return position after the token, or nullptr if the token is not a valid
+ *         index.
+ */
+inline const char *parse_index(const char *pos, const char *end,
+    size_t &value) {
+
+    const char *start = pos;
+    value = 0;
+    while (pos != end && *pos >= '0' && *pos <= '9') {
+        value = 10 * value + static_cast<size_t>(*pos - '0');
+        pos++;
+    }
 
-    typedef std::tuple<El::Int, El::Int, El::Int> tuple_type;
-    std::vector<tuple_type>::const_iterator itr;
+    if (pos == start || (pos != end && !is_blank(*pos)))
+        return nullptr;
 
-    for (size_t i = 0; i < edge_list.size(); i++)
-        X.queue_update(
-            get<0>(edge_list[i]), get<1>(edge_list[i]), get<2>(edge_list[i]));
+    return pos;
+}
+
+/**
+ * Parses a floating point token starting at pos.
+ *
+ * @return position after the token, or nullptr if the token is not a valid
+ *         number.
+ */
+template <typename value_t>
+const char *parse_value(const char *pos, const char *end, value_t &value) {
+
+    // strtod needs a terminated string, tokens are short so copy them.
+    char token[64];
+    size_t len = 0;
+    while (pos != end && !is_blank(*pos)) {
+        if (len == sizeof(token) - 1)
+            return nullptr;
+        token[len++] = *pos++;
+    }
+    token[len] = '\0';
+
+    char *token_end;
+    double v = std::strtod(token, &token_end);
+    if (len == 0 || token_end != token + len)
+        return nullptr;
+
+    value = static_cast<value_t>(v);
+    return pos;
+}
 
-    X.finalize();
+inline void throw_invalid_line(const char *line, const char *eol) {
+    std::stringstream err;
+    err << "Invalid line \"" << std::string(line, eol) << "\""
+        << std::endl;
+    SKYLARK_THROW_EXCEPTION(
+        base::io_exception() << base::error_msg(err.str()));
 }
 
 /**
  * Parse local buffer and insert edges into temporary lists for target
- * processors.
+ * processors. The buffer is parsed in place, it does not have to be
+ * terminated.
  *
  * FIXME: target_rank computation only works for VC/STAR distribution (current
  * implementation). Better to use the Owner method to compute the target rank.
 */
 template <typename edge_list_t, typename value_t>
-void parse(std::stringstream& data, std::vector<edge_list_t>& proc_edge_list,
+void parse(const char *begin, const char *end,
+        std::vector<edge_list_t>& proc_edge_list,
         size_t& max_row_idx, size_t& max_col_idx,
         boost::mpi::communicator &comm, bool symmetrize) {
-    std::string line;
-    while (std::getline(data, line)) {
-        if (!data.good() && !data.eof())
-            SKYLARK_THROW_EXCEPTION(
-                base::io_exception() << base::error_msg("Stream went bad!"));
 
-        if (line[0] == '#')
-            continue;
+    const size_t num_procs = comm.size();
 
-        std::vector<std::string> values;
-        boost::split(values, line, boost::is_any_of("\t "));
+    const char *line = begin;
+    while (line < end) {
+        const char *eol = static_cast<const char *>(
+            std::memchr(line, '\n', end - line));
+        if (eol == nullptr)
+            eol = end;
 
-        size_t from = 0, to = 0;
+        const char *pos = skip_blanks(line, eol);
 
-        if (values.size() < 2) {
-            std::stringstream err;
-            err << "Invalid line \"" << line << "\""
-                << std::endl;
-            SKYLARK_THROW_EXCEPTION(
-                base::io_exception() << base::error_msg(err.str()));
-        }
+        // skip empty lines and comments
+        if (pos != eol && *pos != '#') {
+            size_t from = 0, to = 0;
 
-        try {
-            from = boost::lexical_cast<size_t>(values[0]);
-        } catch(boost::bad_lexical_cast &) {
-            std::stringstream err;
-            err << "Cannot convert: \"" << values[0]
-               << "\" of line \""
-               << line << "\"" << std::endl;
-            SKYLARK_THROW_EXCEPTION(
-                base::io_exception() << base::error_msg(err.str()));
-        }
+            pos = parse_index(pos, eol, from);
+            if (pos == nullptr)
+                throw_invalid_line(line, eol);
 
-        try {
-            to = boost::lexical_cast<size_t>(values[1]);
-        } catch(boost::bad_lexical_cast &) {
-            std::stringstream err;
-            err << "Cannot convert: \"" << values[1]
-                << "\" of line \""
-                << line << "\"" << std::endl;
-            SKYLARK_THROW_EXCEPTION(
-                base::io_exception() << base::error_msg(err.str()));
-        }
+            pos = parse_index(skip_blanks(pos, eol), eol, to);
+            if (pos == nullptr)
+                throw_invalid_line(line, eol);
 
-        value_t value = 1.0;
-        if (values.size() > 2) {
-            try {
-                value = boost::lexical_cast<value_t>(values[2]);
-            } catch(boost::bad_lexical_cast &) {
-                std::stringstream err;
-                err << "Cannot convert: \"" << values[2]
-                    << "\" of line \""
-                    << line << "\"" << std::endl;
-                SKYLARK_THROW_EXCEPTION(
-                    base::io_exception() << base::error_msg(err.str()));
-            }
-        }
+            value_t value = 1.0;
+            pos = skip_blanks(pos, eol);
+            if (pos != eol && parse_value(pos, eol, value) == nullptr)
+                throw_invalid_line(line, eol);
 
-        max_col_idx = std::max(to, max_col_idx);
-        max_row_idx = std::max(from, max_row_idx);
+            max_col_idx = std::max(to, max_col_idx);
+            max_row_idx = std::max(from, max_row_idx);
 
-        size_t target_rank = from % comm.size();
+            size_t target_rank = from % num_procs;
 
-        if (symmetrize) {
-            proc_edge_list[target_rank].push_back(std::make_tuple(from, to, value / 2));
-            target_rank = to % comm.size();
-            proc_edge_list[target_rank].push_back(std::make_tuple(to, from, value / 2));
-        } else {
-            proc_edge_list[target_rank].push_back(std::make_tuple(from, to, value));
+            if (symmetrize) {
+                proc_edge_list[target_rank].push_back(
+                    std::make_tuple(from, to, value / 2));
+                target_rank = to % num_procs;
+                proc_edge_list[target_rank].push_back(
+                    std::make_tuple(to, from, value / 2));
+            } else {
+                proc_edge_list[target_rank].push_back(
+                    std::make_tuple(from, to, value));
+            }
         }
+
+        line = eol + 1;
     }
 
     if (symmetrize) {
@@ -139,18 +173,54 @@ void parse(std::stringstream& data, std::vector<edge_list_t>& proc_edge_list,
     }
 }
 
+/**
+ * Reads count bytes at offset. MPI-IO takes an int count, so the read is
+ * split into as many calls of at most INT_MAX bytes as needed.
+ */
+inline void chunked_read_at(MPI_File file, MPI_Offset offset,
+    char *buff, size_t count) {
+
+    while (count > 0) {
+        int chunk = static_cast<int>(
+            std::min(count, static_cast<size_t>(INT_MAX)));
+
+        MPI_Status status;
+        int err = MPI_File_read_at(file, offset, buff, chunk,
+            MPI_BYTE, &status);
+        if (err != MPI_SUCCESS)
+            SKYLARK_THROW_EXCEPTION(
+                base::io_exception()
+                    << base::error_msg("Error while MPI_File_read_at!"));
+
+        int read = 0;
+        MPI_Get_count(&status, MPI_BYTE, &read);
+        if (read <= 0)
+            SKYLARK_THROW_EXCEPTION(
+                base::io_exception()
+                    << base::error_msg("Unexpected end of file!"));
+
+        offset += read;
+        buff   += read;
+        count  -= read;
+    }
+}
+
 /**
  * Reads a text file in chunks and ensures that each partition/rank gets
  * full lines.
  *
+ * There is no limit on the number of bytes a single rank can read: large
+ * chunks are read in pieces of at most INT_MAX bytes.
+ *
  * \param fname name of the file
  * \param comm (sub-)communicator to read the and distribute the file
  * \param num_partitions number of partitions to split the file
- * \param data stream of read data
+ * \param data read data, full lines owned by this rank start at data_start
+ * \param data_start offset of the first byte owned by this rank in data
 */
-void parallelChunkedRead(
+inline void parallelChunkedRead(
         const std::string& fname, boost::mpi::communicator &comm,
-        int num_partitions, std::stringstream& data) {
+        int num_partitions, std::vector<char>& data, size_t& data_start) {
 
     int rank = comm.rank();
 
@@ -166,139 +236,103 @@ void parallelChunkedRead(
     MPI_Offset size;
     MPI_File_get_size(file, &size);
 
-    size_t myStart = static_cast<size_t>(static_cast<double>(rank) *
-                     (static_cast<double>(size) / num_partitions));
-
-    size_t myEnd = static_cast<size_t>(static_cast<double>(rank + 1) *
-                   (static_cast<double>(size) / num_partitions));
-
-    if (rank == num_partitions)
-        myEnd = size;
-
-    size_t mySize  = myEnd - myStart;
-
-    // in case we rely on MPI I/O we need to make sure the max buffer size
-    // is respected
-    if (comm.size() > 1 && mySize > static_cast<size_t>(INT_MAX)) {
-        std::ostringstream os;
-        os << "ERROR: file " << fname << " cannot be opened."
-           << std::endl
-           << "Current implementation does not support one process "
-           << "to read more than " << INT_MAX << " bytes (limited "
-           << "by INT_MAX)."
-           << std::endl;
-        os << "To avoid this problem, use more processes to read the data."
-           << std::endl;
-        SKYLARK_THROW_EXCEPTION(
-            base::io_exception() << base::error_msg(os.str()));
-    }
+    size_t mySize = 0, myEnd = 0;
+    if (rank < num_partitions) {
+        size_t myStart = static_cast<size_t>(size) * rank / num_partitions;
+        myEnd = static_cast<size_t>(size) * (rank + 1) / num_partitions;
+        if (rank == num_partitions - 1)
+            myEnd = size;
+
+        mySize = myEnd - myStart;
 
-    int err = 0;
-    if (num_partitions == 1) {
-        std::ifstream infile(fname);
-        if (infile) {
-            data << infile.rdbuf();
-            infile.close();
-        }
-    } else {
         // Reading a portion of the file that is an initial guess of what
         // should belong to this process. Might not consist of entire lines,
         // balance later.
-        std::vector<char> buff(mySize);
-        MPI_Status readStatus;
-        MPI_Offset offset = myStart;
-
-        err =
-            MPI_File_read_at(file, offset, &buff[0], mySize,
-                MPI_BYTE, &readStatus);
-        if (err != MPI_SUCCESS)
+        try {
+            data.resize(mySize);
+        } catch (std::bad_alloc &e) {
             SKYLARK_THROW_EXCEPTION(
-                base::io_exception()
-                    << base::error_msg("Error while MPI_File_read_ordered!"));
+                base::allocation_exception()
+                    << base::error_msg("Out of memory."));
+        }
 
-        data << std::string(buff.begin(), buff.end());
+        chunked_read_at(file, myStart, data.data(), mySize);
+    } else {
+        data.clear();
     }
 
-    if (num_partitions > 1) {
+    data_start = 0;
+
+    if (num_partitions > 1 && rank < num_partitions) {
         // now we go about "redistributing" (reading the correct offsets)
         // corresponding to the underlaying distribution.
-        // 1) we need to figure out where our line ends and read the rest of the
-        //    line.
+        // 1) we need to figure out where our line ends and read the rest of
+        //    the line. The first (partial) line of each chunk belongs to the
+        //    preceding rank.
         // 2) we need to find out what rows/cols we own and comm (?)
         //    the appropriate values
 
         MPI_Request recReq, sendReq;
-        MPI_Status  recStatus, sendStatus;
 
-        int myNumExtraBytes   = 0;
-        int prevNumExtraBytes = 0;
+        unsigned long long myNumExtraBytes   = 0;
+        unsigned long long prevNumExtraBytes = 0;
+        bool received = (rank == num_partitions - 1);
 
         // pre-post receives
-        if (rank != num_partitions - 1) {
+        if (!received) {
             // expecting to receive the number of bytes until the first
             // endline character of the next portion
-            MPI_Irecv(&myNumExtraBytes, 1, MPI_INT, rank + 1,
+            MPI_Irecv(&myNumExtraBytes, 1, MPI_UNSIGNED_LONG_LONG, rank + 1,
                       0, comm, &recReq);
         }
 
         // make sure that we have "full" lines on each processor
-        if (rank == 0) {
-            // and not sending anything just waiting for
-            // the number of extra bytes to arrive
-            MPI_Wait(&recReq, &recStatus);
-        } else {
-            std::string firstLine;
+        if (rank != 0) {
             // find the position of the first endline
-            std::getline(data, firstLine);
-            prevNumExtraBytes = data.tellg();
-            if (data.eof() && rank != num_partitions - 1) {
+            std::vector<char>::const_iterator eol =
+                std::find(data.begin(), data.end(), '\n');
+
+            if (eol == data.end()) {
                 // this ranks data does not contain any line ending, so send
-                // all my data preceding rank
+                // all my data (and the bytes requested from the next rank)
+                // to the preceding rank
                 prevNumExtraBytes = mySize;
-
-                MPI_Wait(&recReq, &recStatus);
-                prevNumExtraBytes += myNumExtraBytes;
-
-                myNumExtraBytes = 0;
-                MPI_Isend(&prevNumExtraBytes, 1, MPI_INT, rank - 1,
-                          0, comm, &sendReq);
-            } else {
-                // did find a line ending, send the number of bytes to
-                // preceding rank
-                MPI_Isend(&prevNumExtraBytes, 1, MPI_INT, rank - 1,
-                          0, comm, &sendReq);
-                if (rank == num_partitions - 1)
+                if (!received) {
+                    MPI_Wait(&recReq, MPI_STATUS_IGNORE);
+                    received = true;
+                    prevNumExtraBytes += myNumExtraBytes;
                     myNumExtraBytes = 0;
-                else
-                    MPI_Wait(&recReq, &recStatus);
-
-                // strip the first prevNumExtraBytes from the stream
-                //data.rdbuf()->pubsetbuf(&buff[prevNumExtraBytes],
-                                        //mySize - prevNumExtraBytes);
+                }
+            } else {
+                prevNumExtraBytes = (eol - data.begin()) + 1;
             }
+
+            MPI_Isend(&prevNumExtraBytes, 1, MPI_UNSIGNED_LONG_LONG, rank - 1,
+                      0, comm, &sendReq);
+
+            data_start = std::min(static_cast<size_t>(prevNumExtraBytes),
+                mySize);
         }
 
+        if (!received)
+            MPI_Wait(&recReq, MPI_STATUS_IGNORE);
+
         // Reading the extra bytes at the end.
-        MPI_Status extraReadStatus;
         if (myNumExtraBytes > 0) {
-            std::vector<char> extbuff(myNumExtraBytes);
-            err = MPI_File_read_at(file, myEnd, &extbuff[0], myNumExtraBytes,
-                                   MPI_BYTE, &extraReadStatus);
-            if (err != MPI_SUCCESS)
+            try {
+                data.resize(mySize + myNumExtraBytes);
+            } catch (std::bad_alloc &e) {
                 SKYLARK_THROW_EXCEPTION(
-                    base::io_exception()
-                        << base::error_msg("Error while MPI_file_read_at!"));
+                    base::allocation_exception()
+                        << base::error_msg("Out of memory."));
+            }
 
-            // append the extra data
-            data.seekg(0, data.end);
-            data << std::string(extbuff.begin(), extbuff.end());
+            chunked_read_at(file, myEnd, data.data() + mySize,
+                myNumExtraBytes);
         }
 
         // waiting for the completion of all send requests
-        if (rank != 0) MPI_Wait(&sendReq, &sendStatus);
-
-        data.seekp(prevNumExtraBytes);
-        data.seekg(prevNumExtraBytes);
+        if (rank != 0) MPI_Wait(&sendReq, MPI_STATUS_IGNORE);
     }
 
     MPI_File_close(&file);
@@ -322,6 +356,9 @@ void parallelChunkedRead(
  *  Current implementation aims to divide the file into equal portions
  *  in bytes.
  *
+ *  Compressed files (gzip or zstd, see compressed_io.hpp) are detected
+ *  automatically and split among the ranks by frame instead of by bytes.
+ *
  *  @param fname input file name
  *  @param X output distributed sparse matrix
  *  @param comm MPI communicator reading and distributing the file
@@ -340,13 +377,24 @@ void ReadArcList(const std::string& fname,
     int rank = comm.rank();
     int num_partitions = comm.size();
 
-    std::stringstream data;
-    detail::parallelChunkedRead(fname, comm, num_partitions, data);
-
     std::vector<edge_list_t> proc_set(comm.size());
     size_t max_row_idx = 0, max_col_idx = 0;
-    detail::parse<edge_list_t, value_t>(data, proc_set,
-        max_row_idx, max_col_idx, comm, symmetrize);
+
+    {
+        std::vector<char> data;
+        size_t data_start = 0;
+        compression_t compression = DetectCompression(fname);
+        if (compression == NO_COMPRESSION)
+            detail::parallelChunkedRead(fname, comm, num_partitions,
+                data, data_start);
+        else
+            ParallelCompressedRead(fname, comm, compression,
+                data, data_start);
+
+        detail::parse<edge_list_t, value_t>(
+            data.data() + data_start, data.data() + data.size(), proc_set,
+            max_row_idx, max_col_idx, comm, symmetrize);
+    }
 
     boost::mpi::all_reduce(comm, boost::mpi::inplace_t<size_t>(max_row_idx),
         boost::mpi::maximum<size_t>());
@@ -356,7 +404,7 @@ void ReadArcList(const std::string& fname,
     X.resize(max_row_idx + 1, max_col_idx + 1);
 
     if (comm.size() == 1)
-        return detail::local_insert(X, proc_set[0]);
+        return X.finalize(proc_set[0]);
 
     // finally we can redistribute the data, create a plan
     std::vector<size_t> proc_count(comm.size(), 0);
@@ -421,16 +469,11 @@ void ReadArcList(const std::string& fname,
     boost::mpi::wait_all(&requests[0],
         &requests[vector_proc_counts.size() - 1]);
 
-    // insert all values the processor owns
-    typename std::vector<tuple_type>::iterator matrix_itr;
-    for (matrix_itr = matrix_data.begin(); matrix_itr != matrix_data.end();
-        matrix_itr++) {
-        // converts global to local
-        X.queue_update(
-            get<0>(*matrix_itr), get<1>(*matrix_itr), get<2>(*matrix_itr));
-    }
+    // release the send buffers before building the local matrix
+    std::vector<edge_list_t>().swap(proc_set);
 
-    X.finalize();
+    // insert all values the processor owns (converts global to local)
+    X.finalize(matrix_data);
 }
 
 
@@ -451,10 +494,17 @@ void ReadArcList(const std::string& fname,
 
     boost::mpi::communicator self(MPI_COMM_SELF, boost::mpi::comm_attach);
 
-    std::stringstream data;
-    std::ifstream file(fname);
-    if (file) {
-        data << file.rdbuf();
+    std::vector<char> data;
+    compression_t compression = DetectCompression(fname);
+    std::ifstream file(fname, std::ios::binary);
+    if (file && compression != NO_COMPRESSION) {
+        file.close();
+        ReadCompressedFile(fname, compression, data);
+    } else if (file) {
+        file.seekg(0, file.end);
+        data.resize(file.tellg());
+        file.seekg(0, file.beg);
+        file.read(data.data(), data.size());
         file.close();
     } else {
         std::stringstream err;
@@ -468,8 +518,8 @@ void ReadArcList(const std::string& fname,
     typedef std::vector<coord_tuple_t> edge_list_t;
     std::vector<edge_list_t> edge_list(1);
     size_t max_row_idx = 0, max_col_idx = 0;
-    detail::parse<edge_list_t, value_t>(data, edge_list,
-        max_row_idx, max_col_idx, self, symmetrize);
+    detail::parse<edge_list_t, value_t>(data.data(), data.data() + data.size(),
+        edge_list, max_row_idx, max_col_idx, self, symmetrize);
     X.set(edge_list[0], max_row_idx + 1, max_col_idx + 1);
 }
 
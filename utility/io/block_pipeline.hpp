@@ -0,0 +1,281 @@
+#ifndef SKYLARK_BLOCK_PIPELINE_HPP
+#define SKYLARK_BLOCK_PIPELINE_HPP
+
+#include <boost/mpi.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include "../../base/exception.hpp"
+
+namespace skylark { namespace utility { namespace io {
+
+/**
+ * Time accounting for a block pipeline.
+ *
+ * io_wait is the time the consumer spent blocked waiting for the next block
+ * (the pipeline is I/O bound), compute is the time the consumer spent between
+ * receiving a block and asking for the next one (the pipeline is compute
+ * bound). read is the time the reader thread spent producing blocks.
+ */
+struct pipeline_stats_t {
+
+    double io_wait;
+    double compute;
+    double read;
+    size_t num_blocks;
+
+    pipeline_stats_t() : io_wait(0.0), compute(0.0), read(0.0), num_blocks(0)
+    {}
+
+    /**
+     * Prints min/max/average over all ranks in comm on rank 0.
+     * Collective over comm.
+     */
+    void print(const boost::mpi::communicator& comm,
+        std::ostream& os = std::cout) const {
+
+        const char *names[] = {"I/O wait", "Compute", "Read"};
+        double times[] = {io_wait, compute, read};
+
+        for(int i = 0; i < 3; i++) {
+            double tmin, tmax, tsum;
+            boost::mpi::all_reduce(comm, times[i], tmin,
+                boost::mpi::minimum<double>());
+            boost::mpi::all_reduce(comm, times[i], tmax,
+                boost::mpi::maximum<double>());
+            boost::mpi::all_reduce(comm, times[i], tsum, std::plus<double>());
+
+            if (comm.rank() == 0)
+                os << names[i] << " time (secs) "
+                   << "Min: " << tmin << " Max: " << tmax
+                   << " Ave: " << tsum / comm.size() << std::endl;
+        }
+
+        if (comm.rank() == 0)
+            os << "Blocks: " << num_blocks << std::endl;
+    }
+};
+
+/**
+ * Runs a block producer on a dedicated reader thread and hands the produced
+ * blocks to the consumer through a bounded queue. Producing block i+1 thus
+ * overlaps whatever the consumer does with block i (e.g. redistributing it,
+ * sketching it or feeding it to a solver).
+ *
+ * The producer fills the given block and returns false once there are no
+ * more blocks. It runs on its own thread and therefore must not call MPI.
+ * Exceptions thrown by the producer are rethrown by next(); when only one
+ * rank reads, use next_block() so that every rank learns about them.
+ *
+ * @tparam BlockType type of a block, must be default constructible and
+ *                   swappable.
+ */
+template<typename BlockType>
+class block_pipeline_t {
+
+public:
+
+    typedef BlockType block_type;
+    typedef std::function<bool (block_type&)> producer_type;
+
+    /**
+     * @param producer fills one block, returns false at the end.
+     * @param depth maximum number of blocks buffered ahead of the consumer.
+     */
+    block_pipeline_t(producer_type producer, size_t depth = 2)
+        : _producer(producer), _depth(std::max(depth, size_t(1))),
+          _done(false), _closed(false), _error(nullptr),
+          _last(clock_type::now()), _first(true) {
+
+        _thread = std::thread(&block_pipeline_t::_run, this);
+    }
+
+    ~block_pipeline_t() {
+        close();
+    }
+
+    /**
+     * Pops the next block.
+     *
+     * @param block output block (swapped with the queued block).
+     * @return false if there are no more blocks.
+     */
+    bool next(block_type& block) {
+
+        clock_type::time_point start = clock_type::now();
+        if (!_first)
+            _stats.compute += _seconds(_last, start);
+        _first = false;
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _not_empty.wait(lock, [this] {
+                return !_queue.empty() || _done || _closed;
+            });
+
+        _last = clock_type::now();
+        _stats.io_wait += _seconds(start, _last);
+
+        if (_queue.empty()) {
+            if (_error != nullptr)
+                std::rethrow_exception(_error);
+            return false;
+        }
+
+        std::swap(block, _queue.front());
+        _queue.pop_front();
+        _stats.num_blocks++;
+        lock.unlock();
+        _not_full.notify_one();
+
+        return true;
+    }
+
+    /**
+     * Stops the reader thread and drops any queued blocks.
+     */
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _closed = true;
+        }
+        _not_full.notify_all();
+        _not_empty.notify_all();
+
+        if (_thread.joinable())
+            _thread.join();
+    }
+
+    /**
+     * @return timing statistics. Only meaningful once the pipeline has been
+     *         drained or closed.
+     */
+    const pipeline_stats_t& stats() const {
+        return _stats;
+    }
+
+private:
+
+    typedef std::chrono::steady_clock clock_type;
+
+    static double _seconds(clock_type::time_point from,
+        clock_type::time_point to) {
+        return std::chrono::duration<double>(to - from).count();
+    }
+
+    void _run() {
+
+        try {
+            while (true) {
+                block_type block;
+
+                clock_type::time_point start = clock_type::now();
+                bool more = _producer(block);
+                double elapsed = _seconds(start, clock_type::now());
+
+                std::unique_lock<std::mutex> lock(_mutex);
+                _stats.read += elapsed;
+                if (!more || _closed)
+                    break;
+
+                _not_full.wait(lock, [this] {
+                        return _queue.size() < _depth || _closed;
+                    });
+                if (_closed)
+                    break;
+
+                _queue.push_back(block_type());
+                std::swap(_queue.back(), block);
+                lock.unlock();
+                _not_empty.notify_one();
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _done = true;
+        }
+        _not_empty.notify_all();
+    }
+
+    producer_type _producer;
+    const size_t _depth;
+
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _not_empty;
+    std::condition_variable _not_full;
+    std::deque<block_type> _queue;
+
+    bool _done;
+    bool _closed;
+    std::exception_ptr _error;
+
+    pipeline_stats_t _stats;
+    clock_type::time_point _last;
+    bool _first;
+
+    block_pipeline_t(const block_pipeline_t&);
+    void operator=(const block_pipeline_t&);
+};
+
+/**
+ * Collective: if error is set on root (it is ignored elsewhere), rethrows it
+ * on root and raises an io_exception on the other ranks of comm, so that a
+ * failure of the only reading rank does not leave the others waiting for
+ * data that never comes.
+ */
+inline void raise_on_all(const boost::mpi::communicator& comm,
+    std::exception_ptr error, int root = 0) {
+
+    int failed = (comm.rank() == root && error != nullptr) ? 1 : 0;
+    boost::mpi::broadcast(comm, failed, root);
+    if (!failed)
+        return;
+
+    if (comm.rank() == root)
+        std::rethrow_exception(error);
+    SKYLARK_THROW_EXCEPTION (
+        base::io_exception()
+            << base::error_msg("Reading failed on the reading rank"));
+}
+
+/**
+ * Collective next() for a pipeline that exists only on the root rank of comm
+ * (pipeline is null on the other ranks). A producer exception is raised on
+ * every rank (see raise_on_all).
+ *
+ * @return on all ranks, whether root got a block.
+ */
+template<typename BlockType>
+bool next_block(block_pipeline_t<BlockType> *pipeline, BlockType& block,
+    const boost::mpi::communicator& comm, int root = 0) {
+
+    int more = 0;
+    std::exception_ptr error;
+    if (comm.rank() == root) {
+        try {
+            more = pipeline->next(block) ? 1 : 0;
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+
+    raise_on_all(comm, error, root);
+    boost::mpi::broadcast(comm, more, root);
+    return more == 1;
+}
+
+} } } // namespace skylark::utility::io
+
+#endif // SKYLARK_BLOCK_PIPELINE_HPP
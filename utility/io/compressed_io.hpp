@@ -0,0 +1,993 @@
+#ifndef SKYLARK_COMPRESSED_IO_HPP
+#define SKYLARK_COMPRESSED_IO_HPP
+
+#include <boost/mpi.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#ifdef SKYLARK_HAVE_OPENMP
+#include <omp.h>
+#endif
+
+#ifdef SKYLARK_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef SKYLARK_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "block_pipeline.hpp"
+
+namespace skylark { namespace utility { namespace io {
+
+/**
+ * Compression formats understood by the readers. Compressed files are
+ * treated as sequences of independently decompressible frames: gzip members
+ * (e.g. bgzip or pigz --independent output) and zstd frames (e.g. the zstd
+ * seekable format). The frame is the unit of parallelism; there are no
+ * checkpoints inside a frame. A file compressed as a single member/frame
+ * (plain gzip or zstd output) is read correctly, but is decompressed
+ * serially by a single thread of a single rank. Parallel reads need
+ * multi-member/multi-frame input.
+ */
+enum compression_t {
+    NO_COMPRESSION,
+    GZIP_COMPRESSION,
+    ZSTD_COMPRESSION
+};
+
+/**
+ * An independently decompressible frame of a compressed file.
+ */
+struct compressed_frame_t {
+    std::uint64_t offset;             /// offset of the frame in the file
+    std::uint64_t size;               /// compressed size
+    std::uint64_t uncompressed_size;  /// uncompressed size, 0 if unknown
+};
+
+typedef std::vector<compressed_frame_t> frame_index_t;
+
+namespace detail {
+
+inline void throw_compressed_io(const std::string& msg) {
+    SKYLARK_THROW_EXCEPTION(
+        base::io_exception() << base::error_msg(msg));
+}
+
+inline std::uint32_t read_le32(const unsigned char *p) {
+    return std::uint32_t(p[0]) | (std::uint32_t(p[1]) << 8) |
+        (std::uint32_t(p[2]) << 16) | (std::uint32_t(p[3]) << 24);
+}
+
+inline std::uint16_t read_le16(const unsigned char *p) {
+    return std::uint16_t(p[0] | (p[1] << 8));
+}
+
+inline std::uint64_t file_size(std::ifstream& in) {
+    in.clear();
+    in.seekg(0, std::ios::end);
+    return static_cast<std::uint64_t>(in.tellg());
+}
+
+inline void read_bytes(std::ifstream& in, std::uint64_t offset,
+    std::uint64_t size, char *buff) {
+
+    in.clear();
+    in.seekg(offset, std::ios::beg);
+    in.read(buff, size);
+    if (static_cast<std::uint64_t>(in.gcount()) != size)
+        throw_compressed_io("Unexpected end of compressed file.");
+}
+
+inline bool is_zstd_skippable(std::uint32_t magic) {
+    return (magic & 0xFFFFFFF0U) == 0x184D2A50U;
+}
+
+#ifdef SKYLARK_HAVE_ZLIB
+
+/**
+ * Builds the member index of a gzip file. BGZF members carry their size in
+ * the header and are indexed without decompressing anything, other members
+ * have to be inflated once to find where they end (scanned is then set).
+ */
+inline frame_index_t gzip_frame_index(const std::string& fname,
+    bool& scanned) {
+
+    std::ifstream in(fname, std::ios::binary);
+    if (!in)
+        throw_compressed_io("Cannot open file \"" + fname + "\".");
+
+    const std::uint64_t size = file_size(in);
+    const size_t chunk = 1 << 20;
+    std::vector<char> buff(chunk);
+    frame_index_t index;
+    scanned = false;
+
+    std::uint64_t offset = 0;
+    while (offset + 18 <= size) {
+        unsigned char header[18];
+        read_bytes(in, offset, 18, reinterpret_cast<char *>(header));
+        if (header[0] != 0x1f || header[1] != 0x8b || header[2] != 8)
+            break;   // trailing garbage or padding
+
+        compressed_frame_t frame;
+        frame.offset = offset;
+        frame.size = 0;
+        frame.uncompressed_size = 0;
+
+        // BGZF: FEXTRA with a single 'BC' subfield holding the block size
+        if ((header[3] & 4) && read_le16(header + 10) == 6 &&
+            header[12] == 'B' && header[13] == 'C' &&
+            read_le16(header + 14) == 2) {
+
+            frame.size = std::uint64_t(read_le16(header + 16)) + 1;
+            unsigned char isize[4];
+            read_bytes(in, offset + frame.size - 4, 4,
+                reinterpret_cast<char *>(isize));
+            frame.uncompressed_size = read_le32(isize);
+        } else {
+            scanned = true;
+            z_stream strm;
+            strm.zalloc = Z_NULL;
+            strm.zfree = Z_NULL;
+            strm.opaque = Z_NULL;
+            strm.avail_in = 0;
+            strm.next_in = Z_NULL;
+            if (inflateInit2(&strm, 15 + 16) != Z_OK)
+                throw_compressed_io("Cannot initialize zlib.");
+
+            std::vector<unsigned char> out(chunk);
+            std::uint64_t pos = offset, produced = 0;
+            int ret = Z_OK;
+            while (ret != Z_STREAM_END) {
+                if (strm.avail_in == 0) {
+                    std::uint64_t count = std::min<std::uint64_t>(chunk,
+                        size - pos);
+                    if (count == 0)
+                        break;
+                    read_bytes(in, pos, count, &buff[0]);
+                    pos += count;
+                    strm.next_in = reinterpret_cast<Bytef *>(&buff[0]);
+                    strm.avail_in = count;
+                }
+
+                strm.next_out = &out[0];
+                strm.avail_out = out.size();
+                ret = inflate(&strm, Z_NO_FLUSH);
+                if (ret != Z_OK && ret != Z_STREAM_END) {
+                    inflateEnd(&strm);
+                    throw_compressed_io("Corrupted gzip member in \"" +
+                        fname + "\".");
+                }
+                produced += out.size() - strm.avail_out;
+            }
+
+            // total_in/total_out are uLong, which may be 32 bits.
+            frame.size = pos - strm.avail_in - offset;
+            frame.uncompressed_size = produced;
+            inflateEnd(&strm);
+
+            if (ret != Z_STREAM_END)
+                throw_compressed_io("Truncated gzip member in \"" +
+                    fname + "\".");
+        }
+
+        index.push_back(frame);
+        offset += frame.size;
+    }
+
+    return index;
+}
+
+/**
+ * Inflates a gzip member. zlib counts are uInt, so both the input and the
+ * output are fed in chunks of at most max_chunk bytes (members of 4 GiB or
+ * more are fine).
+ */
+inline void gunzip_frame(const char *src, size_t size,
+    std::vector<char>& out, size_t hint,
+    size_t max_chunk = std::numeric_limits<uInt>::max()) {
+
+    z_stream strm;
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    strm.next_in = Z_NULL;
+    strm.avail_in = 0;
+    if (inflateInit2(&strm, 15 + 16) != Z_OK)
+        throw_compressed_io("Cannot initialize zlib.");
+
+    out.resize(std::max<size_t>(hint, 4 * size) + 1);
+    size_t consumed = 0, produced = 0;
+    int ret = Z_OK;
+    while (ret != Z_STREAM_END) {
+        if (strm.avail_in == 0 && consumed < size) {
+            size_t count = std::min(max_chunk, size - consumed);
+            strm.next_in =
+                reinterpret_cast<Bytef *>(const_cast<char *>(src + consumed));
+            strm.avail_in = count;
+            consumed += count;
+        }
+
+        if (produced == out.size())
+            out.resize(2 * out.size());
+
+        size_t count = std::min(max_chunk, out.size() - produced);
+        strm.next_out = reinterpret_cast<Bytef *>(&out[produced]);
+        strm.avail_out = count;
+        ret = inflate(&strm, Z_NO_FLUSH);
+        produced += count - strm.avail_out;
+        if (ret != Z_OK && ret != Z_STREAM_END) {
+            inflateEnd(&strm);
+            throw_compressed_io("Corrupted gzip member.");
+        }
+        if (ret == Z_OK && strm.avail_in == 0 && consumed == size &&
+            strm.avail_out != 0) {
+            inflateEnd(&strm);
+            throw_compressed_io("Truncated gzip member.");
+        }
+    }
+
+    out.resize(produced);
+    inflateEnd(&strm);
+}
+
+#endif // SKYLARK_HAVE_ZLIB
+
+#ifdef SKYLARK_HAVE_ZSTD
+
+/**
+ * Compressed size of the zstd frame at offset, found by walking the frame
+ * and block headers (RFC 8878) with seeks: the block contents are never
+ * read. uncompressed_size is set from the frame header (0 if absent).
+ */
+inline std::uint64_t zstd_walk_frame(std::ifstream& in, std::uint64_t offset,
+    std::uint64_t size, std::uint64_t& uncompressed_size) {
+
+    unsigned char header[14];
+    uncompressed_size = 0;
+
+    read_bytes(in, offset, 4, reinterpret_cast<char *>(header));
+    std::uint32_t magic = read_le32(header);
+    if (is_zstd_skippable(magic)) {
+        read_bytes(in, offset + 4, 4, reinterpret_cast<char *>(header));
+        return 8 + std::uint64_t(read_le32(header));
+    }
+    if (magic != 0xFD2FB528U)
+        throw_compressed_io("Corrupted zstd frame (bad magic number).");
+
+    // frame header descriptor
+    read_bytes(in, offset + 4, 1, reinterpret_cast<char *>(header));
+    const unsigned char fhd = header[0];
+    if (fhd & 0x08)
+        throw_compressed_io("Corrupted zstd frame header.");
+    const bool single_segment = (fhd >> 5) & 1;
+    const bool checksum = (fhd >> 2) & 1;
+    const int did_sizes[] = {0, 1, 2, 4};
+    const int fcs_sizes[] = {single_segment ? 1 : 0, 2, 4, 8};
+    const int did_size = did_sizes[fhd & 3];
+    const int fcs_size = fcs_sizes[fhd >> 6];
+
+    std::uint64_t pos = offset + 5 + (single_segment ? 0 : 1) + did_size;
+    if (fcs_size > 0) {
+        read_bytes(in, pos, fcs_size, reinterpret_cast<char *>(header));
+        for(int i = fcs_size - 1; i >= 0; i--)
+            uncompressed_size = (uncompressed_size << 8) | header[i];
+        if (fcs_size == 2)
+            uncompressed_size += 256;
+        pos += fcs_size;
+    }
+
+    // blocks: 3 byte header (last flag, type, size) followed by the content
+    bool last = false;
+    while (!last) {
+        read_bytes(in, pos, 3, reinterpret_cast<char *>(header));
+        std::uint32_t bh = std::uint32_t(header[0]) |
+            (std::uint32_t(header[1]) << 8) | (std::uint32_t(header[2]) << 16);
+        last = bh & 1;
+        int type = (bh >> 1) & 3;
+        if (type == 3)
+            throw_compressed_io("Corrupted zstd block header.");
+        pos += 3 + (type == 1 ? 1 : (bh >> 3));
+    }
+
+    if (checksum)
+        pos += 4;
+    if (pos > size)
+        throw_compressed_io("Truncated zstd frame.");
+
+    return pos - offset;
+}
+
+/**
+ * Builds the frame index of a zstd file. Files in the zstd seekable format
+ * carry a seek table in a trailing skippable frame, which is used directly.
+ * Other files are walked frame by frame (scanned is then set), reading only
+ * the frame and block headers.
+ */
+inline frame_index_t zstd_frame_index(const std::string& fname,
+    bool& scanned) {
+
+    std::ifstream in(fname, std::ios::binary);
+    if (!in)
+        throw_compressed_io("Cannot open file \"" + fname + "\".");
+
+    const std::uint64_t size = file_size(in);
+    frame_index_t index;
+    scanned = false;
+
+    // seekable format footer:
+    //   number of frames (4), descriptor (1), magic 0x8F92EAB1 (4)
+    if (size >= 17) {
+        unsigned char footer[9];
+        read_bytes(in, size - 9, 9, reinterpret_cast<char *>(footer));
+
+        if (read_le32(footer + 5) == 0x8F92EAB1U) {
+            std::uint32_t num_frames = read_le32(footer);
+            size_t entry_size = (footer[4] & 0x80) ? 12 : 8;
+            std::uint64_t table_size =
+                std::uint64_t(num_frames) * entry_size + 9 + 8;
+            if (table_size > size)
+                throw_compressed_io("Corrupted zstd seek table in \"" +
+                    fname + "\".");
+
+            std::vector<unsigned char> table(num_frames * entry_size);
+            if (!table.empty())
+                read_bytes(in, size - table_size + 8, table.size(),
+                    reinterpret_cast<char *>(&table[0]));
+
+            std::uint64_t offset = 0;
+            for(std::uint32_t f = 0; f < num_frames; f++) {
+                compressed_frame_t frame;
+                frame.offset = offset;
+                frame.size = read_le32(&table[f * entry_size]);
+                frame.uncompressed_size =
+                    read_le32(&table[f * entry_size + 4]);
+                index.push_back(frame);
+                offset += frame.size;
+            }
+
+            return index;
+        }
+    }
+
+    // no seek table: walk the frames
+    scanned = true;
+    std::uint64_t offset = 0;
+    while (offset + 4 <= size) {
+        unsigned char magic[4];
+        read_bytes(in, offset, 4, reinterpret_cast<char *>(magic));
+
+        compressed_frame_t frame;
+        frame.offset = offset;
+        frame.size = zstd_walk_frame(in, offset, size,
+            frame.uncompressed_size);
+        if (!is_zstd_skippable(read_le32(magic)))
+            index.push_back(frame);
+
+        offset += frame.size;
+    }
+
+    return index;
+}
+
+inline void unzstd_frame(const char *src, size_t size,
+    std::vector<char>& out, size_t hint) {
+
+    // skippable frames (e.g. the seek table) carry no data
+    if (size >= 4 && is_zstd_skippable(
+            read_le32(reinterpret_cast<const unsigned char *>(src)))) {
+        out.clear();
+        return;
+    }
+
+    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+    if (dctx == nullptr)
+        throw_compressed_io("Cannot initialize zstd.");
+
+    ZSTD_inBuffer input = {src, size, 0};
+    out.resize(std::max<size_t>(hint, 4 * size) + 1);
+    size_t produced = 0;
+    size_t ret = 1;
+    while (ret != 0) {
+        if (produced == out.size())
+            out.resize(2 * out.size());
+
+        ZSTD_outBuffer output = {&out[0], out.size(), produced};
+        ret = ZSTD_decompressStream(dctx, &output, &input);
+        produced = output.pos;
+        if (ZSTD_isError(ret)) {
+            ZSTD_freeDCtx(dctx);
+            throw_compressed_io(std::string("Corrupted zstd frame: ") +
+                ZSTD_getErrorName(ret));
+        }
+        if (ret != 0 && input.pos == input.size &&
+            output.pos < output.size) {
+            ZSTD_freeDCtx(dctx);
+            throw_compressed_io("Truncated zstd frame.");
+        }
+    }
+
+    out.resize(produced);
+    ZSTD_freeDCtx(dctx);
+}
+
+#endif // SKYLARK_HAVE_ZSTD
+
+} // namespace detail
+
+/**
+ * Detects the compression of a file from its magic number.
+ */
+inline compression_t DetectCompression(const std::string& fname) {
+
+    std::ifstream in(fname, std::ios::binary);
+    unsigned char magic[4] = {0, 0, 0, 0};
+    in.read(reinterpret_cast<char *>(magic), 4);
+
+    if (in.gcount() >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+        return GZIP_COMPRESSION;
+
+    if (in.gcount() == 4) {
+        std::uint32_t m = detail::read_le32(magic);
+        if (m == 0xFD2FB528U || detail::is_zstd_skippable(m))
+            return ZSTD_COMPRESSION;
+    }
+
+    return NO_COMPRESSION;
+}
+
+/**
+ * Size and modification time of a file, stored with its frame index so that
+ * an index left over from a replaced file is not used.
+ */
+struct file_stamp_t {
+    std::uint64_t size;
+    std::int64_t mtime;
+
+    bool operator==(const file_stamp_t& other) const {
+        return size == other.size && mtime == other.mtime;
+    }
+};
+
+/**
+ * Returns the size and modification time of a file (zeros if it cannot be
+ * accessed).
+ */
+inline file_stamp_t FileStamp(const std::string& fname) {
+    file_stamp_t stamp = {0, 0};
+    struct stat st;
+    if (stat(fname.c_str(), &st) == 0) {
+        stamp.size = st.st_size;
+        stamp.mtime = st.st_mtime;
+    }
+    return stamp;
+}
+
+/**
+ * Reads a frame index written by WriteFrameIndex.
+ *
+ * @param stamp stamp of the compressed file the index must have been
+ *              written for.
+ * @return false if there is no readable index file, or if it was written
+ *         for a file with another stamp (the file was replaced since).
+ */
+inline bool ReadFrameIndex(const std::string& index_name,
+    const file_stamp_t& stamp, frame_index_t& index) {
+
+    std::ifstream in(index_name);
+    if (!in)
+        return false;
+
+    std::string tag;
+    file_stamp_t saved;
+    if (!(in >> tag >> saved.size >> saved.mtime) || tag != "fidx" ||
+        !(saved == stamp))
+        return false;
+
+    index.clear();
+    compressed_frame_t frame;
+    while (in >> frame.offset >> frame.size >> frame.uncompressed_size)
+        index.push_back(frame);
+
+    return in.eof();
+}
+
+/**
+ * Writes a frame index so that later reads do not have to rebuild it. The
+ * readers look for it in <fname>.fidx. The index is written to a temporary
+ * file and renamed, so concurrent readers never see a partial index.
+ *
+ * @param stamp stamp of the compressed file (see FileStamp), taken before
+ *              the index was built.
+ */
+inline void WriteFrameIndex(const std::string& index_name,
+    const file_stamp_t& stamp, const frame_index_t& index) {
+
+    const std::string tmp_name = index_name + ".tmp";
+    {
+        std::ofstream out(tmp_name);
+        if (!out)
+            detail::throw_compressed_io("Cannot write frame index \"" +
+                index_name + "\".");
+
+        out << "fidx " << stamp.size << " " << stamp.mtime << "\n";
+        for(size_t f = 0; f < index.size(); f++)
+            out << index[f].offset << " " << index[f].size << " "
+                << index[f].uncompressed_size << "\n";
+
+        out.close();
+        if (!out) {
+            std::remove(tmp_name.c_str());
+            detail::throw_compressed_io("Cannot write frame index \"" +
+                index_name + "\".");
+        }
+    }
+
+    if (std::rename(tmp_name.c_str(), index_name.c_str()) != 0) {
+        std::remove(tmp_name.c_str());
+        detail::throw_compressed_io("Cannot write frame index \"" +
+            index_name + "\".");
+    }
+}
+
+/**
+ * Returns the frame index of a compressed file, loading <fname>.fidx if it
+ * exists and was written for the file as it is now (same size and
+ * modification time), and building it otherwise.
+ *
+ * @param save_index if the index had to be built by scanning the file (gzip
+ *                   members other than BGZF, zstd without a seek table),
+ *                   try to save it in <fname>.fidx for later reads. Failing
+ *                   to save it (e.g. a read-only directory) is not an error.
+ */
+inline frame_index_t FrameIndex(const std::string& fname,
+    compression_t compression, bool save_index = false) {
+
+    frame_index_t index;
+    const file_stamp_t stamp = FileStamp(fname);
+    if (ReadFrameIndex(fname + ".fidx", stamp, index))
+        return index;
+
+    bool scanned = false;
+    switch (compression) {
+    case GZIP_COMPRESSION:
+#ifdef SKYLARK_HAVE_ZLIB
+        index = detail::gzip_frame_index(fname, scanned);
+#else
+        detail::throw_compressed_io(
+            "Cannot read \"" + fname + "\": built without zlib support.");
+#endif
+        break;
+
+    case ZSTD_COMPRESSION:
+#ifdef SKYLARK_HAVE_ZSTD
+        index = detail::zstd_frame_index(fname, scanned);
+#else
+        detail::throw_compressed_io(
+            "Cannot read \"" + fname + "\": built without zstd support.");
+#endif
+        break;
+
+    default:
+        break;
+    }
+
+    if (save_index && scanned) {
+        try {
+            WriteFrameIndex(fname + ".fidx", stamp, index);
+        } catch (base::io_exception&) {
+
+        }
+    }
+
+    return index;
+}
+
+/**
+ * Decompresses a single frame.
+ *
+ * @param compression compression format.
+ * @param src compressed frame.
+ * @param size compressed size.
+ * @param out output, resized to the uncompressed size.
+ * @param hint expected uncompressed size (0 if unknown).
+ */
+inline void DecompressFrame(compression_t compression,
+    const char *src, size_t size, std::vector<char>& out, size_t hint = 0) {
+
+    switch (compression) {
+    case GZIP_COMPRESSION:
+#ifdef SKYLARK_HAVE_ZLIB
+        detail::gunzip_frame(src, size, out, hint);
+#else
+        detail::throw_compressed_io("Built without zlib support.");
+#endif
+        break;
+
+    case ZSTD_COMPRESSION:
+#ifdef SKYLARK_HAVE_ZSTD
+        detail::unzstd_frame(src, size, out, hint);
+#else
+        detail::throw_compressed_io("Built without zstd support.");
+#endif
+        break;
+
+    default:
+        out.assign(src, src + size);
+    }
+}
+
+/**
+ * Decompresses the frames [first, last) of a file into one contiguous
+ * buffer. Frames are decompressed in parallel (one frame per thread).
+ *
+ * @param in open (binary) input stream of the compressed file.
+ * @param compression compression format.
+ * @param index frame index of the file.
+ * @param first first frame to decompress.
+ * @param last one past the last frame to decompress.
+ * @param data output buffer.
+ */
+inline void DecompressFrames(std::ifstream& in, compression_t compression,
+    const frame_index_t& index, size_t first, size_t last,
+    std::vector<char>& data) {
+
+    data.clear();
+    if (first >= last)
+        return;
+
+    const std::uint64_t start = index[first].offset;
+    const std::uint64_t end = index[last - 1].offset + index[last - 1].size;
+    std::vector<char> compressed(end - start);
+    detail::read_bytes(in, start, end - start, &compressed[0]);
+
+    const int num_frames = last - first;
+    std::vector< std::vector<char> > parts(num_frames);
+    std::exception_ptr error = nullptr;
+
+#   ifdef SKYLARK_HAVE_OPENMP
+#   pragma omp parallel for schedule(dynamic)
+#   endif
+    for(int f = 0; f < num_frames; f++) {
+        const compressed_frame_t& frame = index[first + f];
+        try {
+            DecompressFrame(compression, &compressed[frame.offset - start],
+                frame.size, parts[f], frame.uncompressed_size);
+        } catch (...) {
+#           ifdef SKYLARK_HAVE_OPENMP
+#           pragma omp critical
+#           endif
+            error = std::current_exception();
+        }
+    }
+
+    if (error != nullptr)
+        std::rethrow_exception(error);
+
+    std::vector<size_t> offsets(num_frames + 1, 0);
+    for(int f = 0; f < num_frames; f++)
+        offsets[f + 1] = offsets[f] + parts[f].size();
+
+    try {
+        data.resize(offsets[num_frames]);
+    } catch (std::bad_alloc &e) {
+        SKYLARK_THROW_EXCEPTION(
+            base::allocation_exception() << base::error_msg("Out of memory."));
+    }
+
+#   ifdef SKYLARK_HAVE_OPENMP
+#   pragma omp parallel for schedule(dynamic)
+#   endif
+    for(int f = 0; f < num_frames; f++) {
+        std::copy(parts[f].begin(), parts[f].end(), data.begin() + offsets[f]);
+        std::vector<char>().swap(parts[f]);
+    }
+}
+
+/**
+ * Reads and decompresses a whole compressed file.
+ */
+inline void ReadCompressedFile(const std::string& fname,
+    compression_t compression, std::vector<char>& data) {
+
+    frame_index_t index = FrameIndex(fname, compression);
+    std::ifstream in(fname, std::ios::binary);
+    if (!in)
+        detail::throw_compressed_io("Cannot open file \"" + fname + "\".");
+
+    DecompressFrames(in, compression, index, 0, index.size(), data);
+}
+
+/**
+ * Reads a compressed text file in parallel, splitting the work by frame:
+ * every rank decompresses a contiguous range of frames of roughly equal
+ * compressed size. Lines crossing the range boundaries are completed by
+ * the preceding rank, so that each rank gets full lines only (same contract
+ * as detail::parallelChunkedRead).
+ *
+ * Only multi-member gzip and multi-frame zstd files are split (see
+ * compression_t); a single-frame file is decompressed by rank 0 alone. An
+ * index built by scanning is saved in <fname>.fidx.
+ *
+ * \param fname name of the file
+ * \param comm communicator reading the file
+ * \param compression compression format of the file
+ * \param data decompressed data, full lines owned by this rank start at
+ *             data_start
+ * \param data_start offset of the first byte owned by this rank in data
+ */
+inline void ParallelCompressedRead(const std::string& fname,
+    boost::mpi::communicator& comm, compression_t compression,
+    std::vector<char>& data, size_t& data_start) {
+
+    const int rank = comm.rank();
+    const int size = comm.size();
+
+    // the index is built once and shared
+    std::vector<std::uint64_t> flat;
+    std::exception_ptr error;
+    if (rank == 0) {
+        try {
+            frame_index_t index = FrameIndex(fname, compression, true);
+            for(size_t f = 0; f < index.size(); f++) {
+                flat.push_back(index[f].offset);
+                flat.push_back(index[f].size);
+                flat.push_back(index[f].uncompressed_size);
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+    raise_on_all(comm, error);
+    boost::mpi::broadcast(comm, flat, 0);
+
+    frame_index_t index(flat.size() / 3);
+    for(size_t f = 0; f < index.size(); f++) {
+        index[f].offset = flat[3 * f];
+        index[f].size = flat[3 * f + 1];
+        index[f].uncompressed_size = flat[3 * f + 2];
+    }
+
+    // frame f goes to the rank whose share of the compressed bytes contains
+    // the start of the frame
+    std::uint64_t total = index.empty() ? 0 :
+        index.back().offset + index.back().size;
+    size_t first = index.size(), last = index.size();
+    for(size_t f = 0; f < index.size(); f++) {
+        int owner = static_cast<int>(
+            (index[f].offset * size) / std::max<std::uint64_t>(total, 1));
+        if (owner == rank && first == index.size())
+            first = f;
+        if (owner > rank) {
+            last = f;
+            break;
+        }
+    }
+
+    std::ifstream in(fname, std::ios::binary);
+    if (!in)
+        detail::throw_compressed_io("Cannot open file \"" + fname + "\".");
+    DecompressFrames(in, compression, index, first, last, data);
+
+    data_start = 0;
+    if (size == 1)
+        return;
+
+    // Now make sure that each rank has full lines only: the first partial
+    // line is shipped to the preceding rank. A rank without any line
+    // ending first has to wait for the data of the next rank, and forwards
+    // everything.
+    std::vector<char>::const_iterator eol =
+        std::find(data.begin(), data.end(), '\n');
+    bool has_eol = (eol != data.end());
+
+    if (rank != 0 && has_eol) {
+        data_start = (eol - data.begin()) + 1;
+        comm.send(rank - 1, 0,
+            std::string(data.begin(), data.begin() + data_start));
+    }
+
+    if (rank != size - 1) {
+        std::string tail;
+        comm.recv(rank + 1, 0, tail);
+        data.insert(data.end(), tail.begin(), tail.end());
+    }
+
+    if (rank != 0 && !has_eol) {
+        data_start = data.size();
+        comm.send(rank - 1, 0, std::string(data.begin(), data.end()));
+    }
+}
+
+/**
+ * A read-only stream buffer over a compressed file. Frames are decompressed
+ * in batches, all frames of a batch in parallel, and handed to the reader in
+ * order. Only rewinding to the beginning is supported for seeking (which is
+ * what the two-pass text readers need).
+ */
+class decompressing_streambuf_t : public std::streambuf {
+
+public:
+
+    /**
+     * @param fname compressed file.
+     * @param compression compression format.
+     * @param batch number of frames decompressed at once; 0 selects twice
+     *              the number of threads.
+     */
+    decompressing_streambuf_t(const std::string& fname,
+        compression_t compression, size_t batch = 0)
+        : _fname(fname), _in(fname, std::ios::binary),
+          _compression(compression), _indexed(false), _batch(batch),
+          _next(0), _current(0) {
+
+        if (!_in)
+            detail::throw_compressed_io("Cannot open file \"" + fname +
+                "\".");
+
+        if (_batch == 0) {
+            _batch = 2;
+#           ifdef SKYLARK_HAVE_OPENMP
+            _batch = 2 * omp_get_max_threads();
+#           endif
+        }
+
+        setg(nullptr, nullptr, nullptr);
+    }
+
+protected:
+
+    int_type underflow() {
+
+        if (gptr() < egptr())
+            return traits_type::to_int_type(*gptr());
+
+        while (true) {
+            while (_current < _decoded.size()) {
+                std::vector<char>& part = _decoded[_current++];
+                if (!part.empty()) {
+                    _buffer.swap(part);
+                    setg(&_buffer[0], &_buffer[0], &_buffer[0] + _buffer.size());
+                    return traits_type::to_int_type(*gptr());
+                }
+            }
+
+            // the index is only built once data is requested, so that
+            // opening the stream on ranks that never read is cheap.
+            if (!_indexed) {
+                _index = FrameIndex(_fname, _compression, true);
+                _indexed = true;
+            }
+
+            if (_next >= _index.size())
+                return traits_type::eof();
+
+            size_t last = std::min(_next + _batch, _index.size());
+            _decoded.assign(last - _next, std::vector<char>());
+
+            const int num_frames = last - _next;
+            const std::uint64_t start = _index[_next].offset;
+            const std::uint64_t end =
+                _index[last - 1].offset + _index[last - 1].size;
+            std::vector<char> compressed(end - start);
+            detail::read_bytes(_in, start, end - start, &compressed[0]);
+
+            std::exception_ptr error = nullptr;
+
+#           ifdef SKYLARK_HAVE_OPENMP
+#           pragma omp parallel for schedule(dynamic)
+#           endif
+            for(int f = 0; f < num_frames; f++) {
+                const compressed_frame_t& frame = _index[_next + f];
+                try {
+                    DecompressFrame(_compression,
+                        &compressed[frame.offset - start], frame.size,
+                        _decoded[f], frame.uncompressed_size);
+                } catch (...) {
+#                   ifdef SKYLARK_HAVE_OPENMP
+#                   pragma omp critical
+#                   endif
+                    error = std::current_exception();
+                }
+            }
+
+            if (error != nullptr)
+                std::rethrow_exception(error);
+
+            _next = last;
+            _current = 0;
+        }
+    }
+
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+        std::ios_base::openmode which) {
+
+        if (off == 0 && dir == std::ios_base::beg)
+            return _rewind();
+
+        return pos_type(off_type(-1));
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) {
+
+        if (pos == pos_type(0))
+            return _rewind();
+
+        return pos_type(off_type(-1));
+    }
+
+private:
+
+    pos_type _rewind() {
+        _next = 0;
+        _current = 0;
+        _decoded.clear();
+        _buffer.clear();
+        setg(nullptr, nullptr, nullptr);
+        return pos_type(0);
+    }
+
+    const std::string _fname;
+    std::ifstream _in;
+    const compression_t _compression;
+    bool _indexed;
+    frame_index_t _index;
+    size_t _batch;
+
+    size_t _next;
+    size_t _current;
+    std::vector< std::vector<char> > _decoded;
+    std::vector<char> _buffer;
+};
+
+/**
+ * An input stream transparently decompressing a compressed file.
+ */
+class decompressing_istream_t : public std::istream {
+
+public:
+
+    decompressing_istream_t(const std::string& fname,
+        compression_t compression, size_t batch = 0)
+        : std::istream(nullptr), _buf(fname, compression, batch) {
+        rdbuf(&_buf);
+    }
+
+private:
+    decompressing_streambuf_t _buf;
+};
+
+/**
+ * Opens a text file for reading, transparently decompressing gzip and zstd
+ * files (detected from their magic numbers).
+ */
+inline std::unique_ptr<std::istream> OpenInput(const std::string& fname) {
+
+    compression_t compression = DetectCompression(fname);
+    if (compression == NO_COMPRESSION)
+        return std::unique_ptr<std::istream>(new std::ifstream(fname));
+
+    return std::unique_ptr<std::istream>(
+        new decompressing_istream_t(fname, compression));
+}
+
+} } } // namespace skylark::utility::io
+
+#endif // SKYLARK_COMPRESSED_IO_HPP
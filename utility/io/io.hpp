@@ -1,7 +1,11 @@
 #ifndef SKYLARK_IO_HPP
 #define SKYLARK_IO_HPP
 
+#include "block_pipeline.hpp"
+#include "number_format.hpp"
+#include "text_writer.hpp"
 #include "libsvm_io.hpp"
+#include "compressed_io.hpp"
 #include "arc_list.hpp"
 
 #ifdef SKYLARK_HAVE_HDF5
@@ -9,8 +9,15 @@
 namespace boostfs = boost::filesystem;
 #endif
 
+#include <functional>
 #include <unordered_map>
 #include <boost/serialization/list.hpp>
+#include <boost/serialization/vector.hpp>
+
+#include "block_pipeline.hpp"
+#include "compressed_io.hpp"
+#include "number_format.hpp"
+#include "text_writer.hpp"
 
 namespace skylark { namespace utility { namespace io {
 
@@ -40,7 +47,8 @@ void ReadLIBSVM(const std::string& fname,
     int i, j, last;
     char c;
 
-    std::ifstream in(fname);
+    std::unique_ptr<std::istream> input = OpenInput(fname);
+    std::istream& in = *input;
 
     // make one pass over the data to figure out dimensions -
     // will pay in terms of preallocated storage.
@@ -129,97 +137,316 @@ void ReadLIBSVM(const std::string& fname,
     }
 }
 
+namespace detail {
+
 /**
- * Reads X and Y from a file in libsvm format.
- * X and Y are Elemental distributed matrices.
- *
- * @param fname input file name.
- * @param X output X
- * @param Y output Y
- * @param direction whether the examples are to be put in rows or columns
- * @param max_n stop reading after n rows. If -1 then will read all rows.
- * @param min_d minimum number of rows in the matrix.
- * @param blocksize blocksize for blocking of read.
+ * A block of examples parsed from a libsvm file, stored densely in
+ * column-major order with the layout of the target block: d x rows (nt x rows
+ * for the targets) if examples are columns, rows x d (rows x nt) otherwise.
  */
-template<typename T, El::Distribution UX, El::Distribution VX,
-         typename R, El::Distribution UY, El::Distribution VY>
-void ReadLIBSVM(const std::string& fname,
-    El::DistMatrix<T, UX, VX>& X, El::DistMatrix<R, UY, VY>& Y,
-    base::direction_t direction, int min_d = 0, int max_n = -1,
-    int blocksize = 10000) {
+template<typename T, typename R>
+struct libsvm_dense_block_t {
+    int rows;
+    std::vector<T> X;
+    std::vector<R> Y;
 
-    std::string line;
-    std::string token, val, ind;
-    R label;
-    unsigned int start = 0;
-    size_t delim;
-    unsigned int t;
-    int n = 0, nt = 0;
-    int d = 0;
-    int i, j, last;
-    char c;
+    libsvm_dense_block_t() : rows(0) {}
+};
 
-    std::ifstream in(fname);
+/**
+ * Source of the lines of a libsvm stream for the block readers: returns
+ * false once the stream is exhausted.
+ */
+struct stream_line_source_t {
 
-    // TODO check that X and Y have the same grid.
-    boost::mpi::communicator comm = skylark::utility::get_communicator(X);
-    int rank = X.Grid().Rank();
+    stream_line_source_t(std::istream& in) : _in(in) {}
 
-    // make one pass over the data to figure out dimensions -
-    // will pay in terms of preallocated storage.
-    if (rank==0) {
-        while(!in.eof() && n != max_n) {
-            getline(in, line);
+    bool operator()(std::string& line) {
+        return static_cast<bool>(std::getline(_in, line));
+    }
 
-            // Ignore empty lines and comment lines (begin with #)
-            if(line.length() == 0 || line[0] == '#')
-                break;
+private:
+    std::istream& _in;
+};
+
+/** Opens a (possibly compressed) libsvm file, which must exist. */
+inline std::unique_ptr<std::istream> open_libsvm(const std::string& fname) {
+    std::unique_ptr<std::istream> in = OpenInput(fname);
+    if (!in->good())
+        SKYLARK_THROW_EXCEPTION (
+            base::io_exception()
+                << base::error_msg("Could not open " + fname));
+    return in;
+}
 
-            n++;
+/** Empty lines and comment lines (begin with #) hold no example. */
+inline bool libsvm_skip_line(const std::string& line) {
+    return line.length() == 0 || line[0] == '#';
+}
 
-            // Figure out number of targets (only first line)
-            if (n == 1) {
-                std::string tstr;
-                std::istringstream tokenstream (line);
+/**
+ * Scans the lines of a libsvm input for the number of examples n (at most
+ * max_n, unless it is -1), of features d and of targets nt.
+ */
+template<typename LineSource>
+void libsvm_dimensions(LineSource& lines, int max_n, int& n, int& d,
+    int& nt) {
+
+    std::string line;
+    n = 0;
+    d = 0;
+    nt = 0;
+    while (n != max_n && lines(line)) {
+        if (libsvm_skip_line(line))
+            continue;
+
+        n++;
+
+        // Figure out number of targets (only first line)
+        if (n == 1) {
+            std::string tstr;
+            std::istringstream tokenstream (line);
+            tokenstream >> tstr;
+            while (tstr.find(":") == std::string::npos) {
+                nt++;
+                if (tokenstream.eof())
+                    break;
                 tokenstream >> tstr;
-                while (tstr.find(":") == std::string::npos) {
-                    nt++;
-                    if (tokenstream.eof())
-                        break;
-                    tokenstream >> tstr;
-                }
             }
+        }
 
-            size_t delim = line.find_last_of(":");
-            if(delim == std::string::npos)
+        size_t delim = line.find_last_of(":");
+        if(delim == std::string::npos)
+            continue;
+
+        size_t t = delim;
+        while(line[t]!=' ')
+            t--;
+
+        int last = atoi(line.substr(t+1, delim - t).c_str());
+        if (last>d)
+            d = last;
+    }
+}
+
+/**
+ * Block producer for block_pipeline_t: parses consecutive blocks of at most
+ * blocksize examples (and n examples in total) from the lines of a libsvm
+ * input, skipping empty and comment lines.
+ */
+template<typename T, typename R, typename LineSource>
+struct libsvm_dense_block_reader_t {
+
+    libsvm_dense_block_reader_t(const LineSource& lines, int n, int d, int nt,
+        base::direction_t direction, int blocksize)
+        : _lines(lines), _remaining(n), _d(d), _nt(nt), _direction(direction),
+          _blocksize(blocksize)
+    {}
+
+    bool operator()(libsvm_dense_block_t<T, R>& block) {
+
+        int rows = std::min(_blocksize, _remaining);
+        if (rows <= 0)
+            return false;
+        _remaining -= rows;
+
+        block.rows = rows;
+        block.X.assign(static_cast<size_t>(rows) * _d, T(0));
+        block.Y.assign(static_cast<size_t>(rows) * _nt, R(0));
+
+        // leading dimensions of the column-major blocks
+        int ldX = (_direction == base::COLUMNS) ? _d : rows;
+        int ldY = (_direction == base::COLUMNS) ? _nt : rows;
+
+        std::string line, token;
+        R label;
+        int t = 0;
+        while (t < rows && _lines(line)) {
+            if (libsvm_skip_line(line))
                 continue;
 
-            t = delim;
-            while(line[t]!=' ')
-                t--;
+            std::istringstream tokenstream(line);
 
-            val = line.substr(t+1, delim - t);
-            last = atoi(val.c_str());
-            if (last>d)
-                d = last;
+            for(int r = 0; r < _nt; r++) {
+                tokenstream >> label;
+                if (_direction == base::COLUMNS)
+                    block.Y[t * ldY + r] = label;
+                else
+                    block.Y[r * ldY + t] = label;
+            }
+
+            while (tokenstream >> token) {
+                size_t delim  = token.find(':');
+                int j = atoi(token.substr(0, delim).c_str()) - 1;
+                T val = atof(token.substr(delim + 1).c_str());
+                if (_direction == base::COLUMNS)
+                    block.X[t * ldX + j] = val;
+                else
+                    block.X[j * ldX + t] = val;
+            }
+
+            t++;
         }
-        if (min_d > 0)
-            d = std::max(d, min_d);
 
-        // prepare for second pass
-        in.clear();
-        in.seekg(0, std::ios::beg);
+        if (t < rows)
+            SKYLARK_THROW_EXCEPTION (
+                base::io_exception()
+                    << base::error_msg(
+                        "The input has fewer examples than it had when "
+                        "it was scanned"));
+
+        return true;
     }
 
-    boost::mpi::broadcast(comm, n, 0);
-    boost::mpi::broadcast(comm, d, 0);
-    boost::mpi::broadcast(comm, nt, 0);
+private:
+    LineSource _lines;
+    int _remaining;
+    const int _d;
+    const int _nt;
+    const base::direction_t _direction;
+    const int _blocksize;
+};
 
-    int numblocks = ((int) n/ (int) blocksize); // of size blocksize
-    int leftover = n % blocksize;
-    int block = blocksize;
+/**
+ * Copies a column-major buffer into an Elemental local matrix of the same
+ * size.
+ */
+template<typename T>
+void copy_into(const std::vector<T>& src, El::Matrix<T>& dst) {
+    const int m = dst.Height();
+    const int ld = dst.LDim();
+    T *data = dst.Buffer();
+    for(int j = 0; j < dst.Width(); j++)
+        std::copy(src.begin() + static_cast<size_t>(j) * m,
+            src.begin() + static_cast<size_t>(j + 1) * m,
+            data + static_cast<size_t>(j) * ld);
+}
 
-    if (direction == base::COLUMNS) {
+/**
+ * Ships a column-major block, held by the root rank of comm (the VC
+ * communicator of a grid), to a [VC,STAR] (by rows) or [STAR,VC] (by
+ * columns) staging matrix with non-blocking point-to-point messages. post()
+ * returns at once, so root can go on parsing and the other ranks can
+ * redistribute the previous block while the transfer is in flight; wait()
+ * completes it. The buffers of a posted block are owned here, so use one
+ * object per block in flight.
+ */
+template<typename T>
+class block_scatter_t {
+
+public:
+
+    block_scatter_t(const boost::mpi::communicator& comm, int tag,
+        int root = 0)
+        : _comm(comm), _tag(tag), _root(root), _height(0), _width(0),
+          _by_columns(false)
+    {}
+
+    ~block_scatter_t() {
+        boost::mpi::wait_all(_requests.begin(), _requests.end());
+    }
+
+    /**
+     * Collective. src (height x width, column-major) is only read on root.
+     */
+    void post(const std::vector<T>& src, int height, int width,
+        bool by_columns) {
+
+        _height = height;
+        _width = width;
+        _by_columns = by_columns;
+
+        int p = _comm.size();
+        if (_comm.rank() == _root) {
+            _send.resize(p);
+            for(int r = 0; r < p; r++) {
+                std::vector<T>& buf = (r == _root) ? _local : _send[r];
+                pack(src, r, p, buf);
+                if (r != _root)
+                    _requests.push_back(_comm.isend(r, _tag,
+                            buf.data(), static_cast<int>(buf.size())));
+            }
+        } else {
+            _local.resize(local_size(_comm.rank(), p));
+            _requests.push_back(_comm.irecv(_root, _tag,
+                    _local.data(), static_cast<int>(_local.size())));
+        }
+    }
+
+    /**
+     * Completes the transfer into B, [VC,STAR] if posted by rows and
+     * [STAR,VC] if by columns, on the grid of comm.
+     */
+    template<El::Distribution U, El::Distribution V>
+    void wait(El::DistMatrix<T, U, V>& B) {
+        boost::mpi::wait_all(_requests.begin(), _requests.end());
+        _requests.clear();
+
+        B.Resize(_height, _width);
+        copy_into(_local, B.Matrix());
+    }
+
+private:
+
+    boost::mpi::communicator _comm;
+    const int _tag;
+    const int _root;
+    int _height, _width;
+    bool _by_columns;
+
+    std::vector< std::vector<T> > _send;
+    std::vector<T> _local;
+    std::vector<boost::mpi::request> _requests;
+
+    size_t local_size(int r, int p) const {
+        return _by_columns ?
+            static_cast<size_t>(_height) * El::Length(_width, r, p) :
+            static_cast<size_t>(El::Length(_height, r, p)) * _width;
+    }
+
+    /** Local part of rank r, column-major, as Elemental stores it. */
+    void pack(const std::vector<T>& src, int r, int p,
+        std::vector<T>& buf) const {
+
+        buf.clear();
+        buf.reserve(local_size(r, p));
+        if (_by_columns) {
+            for(int j = r; j < _width; j += p)
+                buf.insert(buf.end(),
+                    src.begin() + static_cast<size_t>(j) * _height,
+                    src.begin() + static_cast<size_t>(j + 1) * _height);
+        } else {
+            for(int j = 0; j < _width; j++)
+                for(int i = r; i < _height; i += p)
+                    buf.push_back(src[static_cast<size_t>(j) * _height + i]);
+        }
+    }
+};
+
+/**
+ * Distributes the n examples produced, one block at a time, by producer into
+ * X and Y. The producer runs on a reader thread of the root rank of the VC
+ * communicator (it is not called elsewhere), so parsing block i+2 overlaps
+ * the transfer of block i+1 from root (non-blocking, see block_scatter_t),
+ * which in turn overlaps the redistribution of block i from the staging
+ * [VC,STAR] / [STAR,VC] matrices to the distribution of X and Y, and on_block.
+ */
+template<typename T, El::Distribution UX, El::Distribution VX,
+         typename R, El::Distribution UY, El::Distribution VY>
+void distribute_blocks(
+    const std::function<bool (libsvm_dense_block_t<T, R>&)>& producer,
+    El::DistMatrix<T, UX, VX>& X, El::DistMatrix<R, UY, VY>& Y,
+    base::direction_t direction, int n, int d, int nt, int blocksize,
+    const std::function<void (El::DistMatrix<T, UX, VX>&,
+        El::DistMatrix<R, UY, VY>&, int)>& on_block,
+    int prefetch, pipeline_stats_t *stats) {
+
+    boost::mpi::communicator comm(X.Grid().VCComm().comm,
+        boost::mpi::comm_attach);
+    int rank = comm.rank();
+    bool by_columns = direction == base::COLUMNS;
+
+    if (by_columns) {
         X.Resize(d, n);
         Y.Resize(nt, n);
     } else {
@@ -227,78 +454,252 @@ void ReadLIBSVM(const std::string& fname,
         Y.Resize(n, nt);
     }
 
-    El::DistMatrix<T, El::CIRC, El::CIRC> XB(X.Grid());
-    El::DistMatrix<R, El::CIRC, El::CIRC> YB(Y.Grid());
+    typedef libsvm_dense_block_t<T, R> block_t;
+    std::unique_ptr< block_pipeline_t<block_t> > pipeline;
+    if (rank == 0)
+        pipeline.reset(new block_pipeline_t<block_t>(producer, prefetch));
+
+    // Two blocks in flight: one being transferred, one redistributed.
+    block_scatter_t<T> xs[2] = {
+        block_scatter_t<T>(comm, 0), block_scatter_t<T>(comm, 0) };
+    block_scatter_t<R> ys[2] = {
+        block_scatter_t<R>(comm, 1), block_scatter_t<R>(comm, 1) };
+
+    El::DistMatrix<T, El::VC, El::STAR> X_VC_STAR(X.Grid());
+    El::DistMatrix<T, El::STAR, El::VC> X_STAR_VC(X.Grid());
+    El::DistMatrix<R, El::VC, El::STAR> Y_VC_STAR(Y.Grid());
+    El::DistMatrix<R, El::STAR, El::VC> Y_STAR_VC(Y.Grid());
     El::DistMatrix<T, UX, VX> Xv(X.Grid());
     El::DistMatrix<R, UY, VY> Yv(Y.Grid());
-    for(int i=0; i<numblocks+1; i++) {
-        if (i==numblocks)
-            block = leftover;
-        if (block==0)
-            break;
-
-        if (direction == base::COLUMNS) {
-            El::Zeros(XB, d, block);
-            El::Zeros(YB, nt, block);
-        } else {
-            El::Zeros(XB, block, d);
-            El::Zeros(YB, block, nt);
-        }
-
-        if(rank==0) {
-            T *Xdata = XB.Matrix().Buffer();
-            R *Ydata = YB.Matrix().Buffer();
-            int ldX = XB.Matrix().LDim();
-            int ldY = YB.Matrix().LDim();
-
-            t = 0;
-            while(!in.eof() && t<block) {
-                getline(in, line);
 
-                // Ignore empty lines and comment lines (begin with #)
-                if(line.length() == 0 || line[0] == '#')
-                    break;
+    int numblocks = (n + blocksize - 1) / blocksize;
+    block_t parsed;
 
-                std::istringstream tokenstream(line);
+    auto post = [&](int i) {
+        if (!next_block(pipeline.get(), parsed, comm))
+            SKYLARK_THROW_EXCEPTION (
+                base::io_exception()
+                    << base::error_msg("The input ended before all blocks "
+                        "were read"));
 
-                for(int r = 0; r < nt; r++) {
-                    tokenstream >> label;
-                    if (direction == base::COLUMNS)
-                        Ydata[t * ldY + r] = label;
-                    else
-                        Ydata[r * ldY + t] = label;
-                }
+        int block = std::min(blocksize, n - i * blocksize);
+        xs[i % 2].post(parsed.X, by_columns ? d : block,
+            by_columns ? block : d, by_columns);
+        ys[i % 2].post(parsed.Y, by_columns ? nt : block,
+            by_columns ? block : nt, by_columns);
+    };
 
-                while (tokenstream >> token) {
-                    size_t delim  = token.find(':');
-                    ind = token.substr(0, delim);
-                    val = token.substr(delim+1); //.substr(delim+1);
-                    j = atoi(ind.c_str()) - 1;
-                    if (direction == base::COLUMNS)
-                        Xdata[t * ldX + j] = atof(val.c_str());
-                    else
-                        Xdata[j * ldX + t] = atof(val.c_str());
-                }
+    if (numblocks > 0)
+        post(0);
 
-                t++;
-            }
-        }
+    for(int i = 0; i < numblocks; i++) {
+        if (i + 1 < numblocks)
+            post(i + 1);
 
-        // The calls below should distribute the data to all the nodes.
-        if (direction == base::COLUMNS) {
-            int ldX = XB.Matrix().LDim();
+        int block = std::min(blocksize, n - i * blocksize);
+        if (by_columns) {
             El::View(Xv, X, 0, i*blocksize, d, block);
             El::View(Yv, Y, 0, i*blocksize, nt, block);
+            xs[i % 2].wait(X_STAR_VC);
+            ys[i % 2].wait(Y_STAR_VC);
+            Xv = X_STAR_VC;
+            Yv = Y_STAR_VC;
         } else {
             El::View(Xv, X, i*blocksize, 0, block, d);
             El::View(Yv, Y, i*blocksize, 0, block, nt);
+            xs[i % 2].wait(X_VC_STAR);
+            ys[i % 2].wait(Y_VC_STAR);
+            Xv = X_VC_STAR;
+            Yv = Y_VC_STAR;
         }
 
-        Xv = XB;
-        Yv = YB;
+        if (on_block)
+            on_block(Xv, Yv, i*blocksize);
     }
+
+    if (rank == 0) {
+        pipeline->close();
+        if (stats != nullptr)
+            *stats = pipeline->stats();
+    }
+}
+
+} // namespace detail
+
+/**
+ * Reads X and Y from a file in libsvm format.
+ * X and Y are Elemental distributed matrices.
+ *
+ * The file is read by rank 0 in blocks of examples. Parsing runs on a
+ * separate reader thread (see block_pipeline_t), and every parsed block is
+ * sent to the other ranks with non-blocking messages, so that parsing and
+ * sending the next blocks overlap the redistribution of the current one.
+ * Every block is handed to on_block as soon as it is distributed, which
+ * lets sketching or training start consuming the data while the rest of
+ * the file is read. Empty and comment lines are skipped.
+ *
+ * @param fname input file name.
+ * @param X output X
+ * @param Y output Y
+ * @param direction whether the examples are to be put in rows or columns
+ * @param min_d minimum number of rows in the matrix.
+ * @param max_n stop reading after n rows. If -1 then will read all rows.
+ * @param blocksize blocksize for blocking of read.
+ * @param on_block called (collectively) with views of every block of X and Y
+ *                 and the index of its first example. Can be empty.
+ * @param prefetch number of parsed blocks buffered ahead of redistribution.
+ * @param stats if not null, receives the I/O wait/compute time accounting
+ *              of the reading rank (zeros on the other ranks).
+ */
+template<typename T, El::Distribution UX, El::Distribution VX,
+         typename R, El::Distribution UY, El::Distribution VY>
+void ReadLIBSVM(const std::string& fname,
+    El::DistMatrix<T, UX, VX>& X, El::DistMatrix<R, UY, VY>& Y,
+    base::direction_t direction, int min_d, int max_n, int blocksize,
+    const std::function<void (El::DistMatrix<T, UX, VX>&,
+        El::DistMatrix<R, UY, VY>&, int)>& on_block,
+    int prefetch = 2, pipeline_stats_t *stats = nullptr) {
+
+    // TODO check that X and Y have the same grid.
+    boost::mpi::communicator comm(X.Grid().VCComm().comm,
+        boost::mpi::comm_attach);
+    int rank = comm.rank();
+
+    // make one pass over the data to figure out dimensions -
+    // will pay in terms of preallocated storage.
+    int n = 0, d = 0, nt = 0;
+    std::unique_ptr<std::istream> input;
+    std::exception_ptr error;
+    if (rank==0) {
+        try {
+            input = detail::open_libsvm(fname);
+            detail::stream_line_source_t lines(*input);
+            detail::libsvm_dimensions(lines, max_n, n, d, nt);
+            if (min_d > 0)
+                d = std::max(d, min_d);
+
+            // prepare for second pass
+            input->clear();
+            input->seekg(0, std::ios::beg);
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+
+    raise_on_all(comm, error);
+    boost::mpi::broadcast(comm, n, 0);
+    boost::mpi::broadcast(comm, d, 0);
+    boost::mpi::broadcast(comm, nt, 0);
+
+    std::function<bool (detail::libsvm_dense_block_t<T, R>&)> producer;
+    if (rank == 0)
+        producer = detail::libsvm_dense_block_reader_t<T, R,
+            detail::stream_line_source_t>(
+                detail::stream_line_source_t(*input), n, d, nt, direction,
+                blocksize);
+
+    detail::distribute_blocks(producer, X, Y, direction, n, d, nt, blocksize,
+        on_block, prefetch, stats);
 }
 
+/**
+ * Reads X and Y from a file in libsvm format.
+ * X and Y are Elemental distributed matrices.
+ *
+ * @param fname input file name.
+ * @param X output X
+ * @param Y output Y
+ * @param direction whether the examples are to be put in rows or columns
+ * @param min_d minimum number of rows in the matrix.
+ * @param max_n stop reading after n rows. If -1 then will read all rows.
+ * @param blocksize blocksize for blocking of read.
+ */
+template<typename T, El::Distribution UX, El::Distribution VX,
+         typename R, El::Distribution UY, El::Distribution VY>
+void ReadLIBSVM(const std::string& fname,
+    El::DistMatrix<T, UX, VX>& X, El::DistMatrix<R, UY, VY>& Y,
+    base::direction_t direction, int min_d = 0, int max_n = -1,
+    int blocksize = 10000) {
+
+    ReadLIBSVM(fname, X, Y, direction, min_d, max_n, blocksize,
+        std::function<void (El::DistMatrix<T, UX, VX>&,
+            El::DistMatrix<R, UY, VY>&, int)>());
+}
+
+/**
+ * Reads a libsvm file one block of examples at a time, as dense local row
+ * blocks (examples are rows), for out-of-core algorithms (see
+ * nla/streaming.hpp). Only the current block is held in memory; the
+ * dimensions are found by a first scan of the file, and rewind() reopens
+ * it for another pass.
+ */
+template<typename T>
+class libsvm_row_block_reader_t {
+
+public:
+
+    /**
+     * @param fname input file name.
+     * @param blocksize number of examples in a block.
+     * @param min_d minimum number of columns.
+     */
+    libsvm_row_block_reader_t(const std::string& fname,
+        int blocksize = 10000, int min_d = 0)
+        : _fname(fname), _blocksize(blocksize), _n(0), _d(0), _nt(0) {
+
+        std::unique_ptr<std::istream> input = detail::open_libsvm(fname);
+        detail::stream_line_source_t lines(*input);
+        detail::libsvm_dimensions(lines, -1, _n, _d, _nt);
+        _d = std::max(_d, min_d);
+
+        rewind();
+    }
+
+    /** Number of examples (rows) in the file */
+    El::Int height() const { return _n; }
+
+    /** Number of features (columns) */
+    El::Int width() const { return _d; }
+
+    /** Number of targets */
+    El::Int targets() const { return _nt; }
+
+    /** Starts a new pass over the file. */
+    void rewind() {
+        _reader.reset();
+        _input = OpenInput(_fname);
+        _reader.reset(new detail::libsvm_dense_block_reader_t<T, T,
+            detail::stream_line_source_t>(
+                detail::stream_line_source_t(*_input),
+                _n, _d, _nt, base::ROWS, _blocksize));
+    }
+
+    /**
+     * Reads the next block: X gets the examples (rows x width()) and Y
+     * the targets (rows x targets()). Returns false at the end of the file.
+     */
+    bool next(El::Matrix<T>& X, El::Matrix<T>& Y) {
+        if (!(*_reader)(_block))
+            return false;
+
+        X.Resize(_block.rows, _d);
+        Y.Resize(_block.rows, _nt);
+        detail::copy_into(_block.X, X);
+        detail::copy_into(_block.Y, Y);
+        return true;
+    }
+
+private:
+    const std::string _fname;
+    const int _blocksize;
+    int _n, _d, _nt;
+
+    std::unique_ptr<std::istream> _input;
+    std::unique_ptr<detail::libsvm_dense_block_reader_t<T, T,
+                        detail::stream_line_source_t> > _reader;
+    detail::libsvm_dense_block_t<T, T> _block;
+};
+
 /**
  * Reads X and Y from a file in libsvm format.
  * X is a Skylark local sparse matrix, and Y is Elemental dense matrices.
@@ -327,7 +728,8 @@ void ReadLIBSVM(const std::string& fname,
     int nnz=0;
     int nz;
 
-    std::ifstream in(fname);
+    std::unique_ptr<std::istream> input = OpenInput(fname);
+    std::istream& in = *input;
 
     // make one pass over the data to figure out dimensions and nnz
     // will pay in terms of preallocated storage.
@@ -464,6 +866,102 @@ void ReadLIBSVM(const std::string& fname,
         X.attach(col_ptr, rowind, values, nnz, n, d, true);
 }
 
+namespace detail {
+
+/**
+ * A block of examples parsed from a libsvm file for a sparse distributed
+ * matrix. Non-zeros are already bucketed by owning rank; the targets are
+ * stored densely in the layout of the target block.
+ */
+template<typename T>
+struct libsvm_sparse_block_t {
+    std::vector<T> Y;
+    std::vector< std::vector<int> > j;
+    std::vector< std::vector<int> > row;
+    std::vector< std::vector<T> > v;
+};
+
+/**
+ * Block producer for block_pipeline_t: parses consecutive blocks of at most
+ * blocksize examples from a libsvm stream and buckets the non-zeros by the
+ * rank owning them in X.
+ */
+template<typename T>
+struct libsvm_sparse_block_reader_t {
+
+    libsvm_sparse_block_reader_t(std::istream& in,
+        const base::sparse_vc_star_matrix_t<T>& X, int n, int nt, int nprocs,
+        base::direction_t direction, int blocksize)
+        : _in(in), _X(X), _row(0), _n(n), _nt(nt), _nprocs(nprocs),
+          _direction(direction), _blocksize(blocksize)
+    {}
+
+    bool operator()(libsvm_sparse_block_t<T>& block) {
+
+        int rows = std::min(_blocksize, _n - _row);
+        if (rows <= 0)
+            return false;
+
+        block.Y.assign(static_cast<size_t>(rows) * _nt, T(0));
+        block.j.assign(_nprocs, std::vector<int>());
+        block.row.assign(_nprocs, std::vector<int>());
+        block.v.assign(_nprocs, std::vector<T>());
+
+        int ldY = (_direction == base::COLUMNS) ? _nt : rows;
+
+        std::string line, token;
+        T label;
+        int t = 0;
+        while(t < rows && std::getline(_in, line)) {
+            if (libsvm_skip_line(line))
+                continue;
+
+            std::istringstream tokenstream(line);
+            for(int r = 0; r < _nt; r++) {
+                tokenstream >> label;
+                if (_direction == base::COLUMNS)
+                    block.Y[t * ldY + r] = label;
+                else
+                    block.Y[r * ldY + t] = label;
+            }
+
+            while (tokenstream >> token) {
+                size_t delim  = token.find(':');
+                int j = atoi(token.substr(0, delim).c_str()) - 1;
+                int owner = (_direction == base::COLUMNS) ?
+                    _X.owner(j, _row + t) : _X.owner(_row + t, j);
+                block.j[owner].push_back(j);
+                block.row[owner].push_back(_row + t);
+                block.v[owner].push_back(atof(token.substr(delim+1).c_str()));
+            }
+
+            t++;
+        }
+
+        if (t < rows)
+            SKYLARK_THROW_EXCEPTION (
+                base::io_exception()
+                    << base::error_msg(
+                        "The input has fewer examples than it had when "
+                        "it was scanned"));
+
+        _row += rows;
+        return true;
+    }
+
+private:
+    std::istream& _in;
+    const base::sparse_vc_star_matrix_t<T>& _X;
+    int _row;
+    const int _n;
+    const int _nt;
+    const int _nprocs;
+    const base::direction_t _direction;
+    const int _blocksize;
+};
+
+} // namespace detail
+
 /**
  * Reads X and Y from a file in libsvm format.
  * X is a sparse distributed VC/STAR matrix and Y is a dense distributed
@@ -484,67 +982,34 @@ void ReadLIBSVM(const std::string& fname,
     base::sparse_vc_star_matrix_t<T>& X, El::DistMatrix<R, UY, VY>& Y,
     base::direction_t direction, int min_d = 0, int blocksize = 10000) {
 
-
-    std::string line;
-    std::string token, val, ind;
-    T label;
-    unsigned int start = 0;
-    unsigned int delim, t;
     int n = 0, nt = 0;
     int d = 0;
-    int i, j, last;
-    char c;
-
-    std::ifstream in(fname);
 
     boost::mpi::communicator comm = skylark::utility::get_communicator(Y);
     int rank = comm.rank();
     int size = comm.size();
 
-    std::vector< std::list<int> > non_local_updates_j(size);
-    std::vector< std::list<int> > non_local_updates_row(size);
-    std::vector< std::list<T> > non_local_updates_v(size);
-
     // make one pass over the data to figure out dimensions -
     // will pay in terms of preallocated storage.
+    std::unique_ptr<std::istream> input;
+    std::exception_ptr error;
     if (rank==0) {
-        while(!in.eof()) {
-            getline(in, line);
-            if(line.length()==0)
-                break;
-            delim = line.find_last_of(":");
-            if(delim > line.length())
-                continue;
-            n++;
-
-            // Figure out number of targets
-            if (n == 1) {
-                std::string tstr;
-                std::istringstream tokenstream (line);
-                tokenstream >> tstr;
-                while (tstr.find(":") == std::string::npos) {
-                    nt++;
-                    tokenstream >> tstr;
-                }
-            }
-
-            t = delim;
-            while(line[t]!=' ') {
-                t--;
-            }
-            val = line.substr(t+1, delim - t);
-            last = atoi(val.c_str());
-            if (last>d)
-                d = last;
+        try {
+            input = detail::open_libsvm(fname);
+            detail::stream_line_source_t lines(*input);
+            detail::libsvm_dimensions(lines, -1, n, d, nt);
+            if (min_d > 0)
+                d = std::max(d, min_d);
+
+            // prepare for second pass
+            input->clear();
+            input->seekg(0, std::ios::beg);
+        } catch (...) {
+            error = std::current_exception();
         }
-        if (min_d > 0)
-            d = std::max(d, min_d);
-
-        // prepare for second pass
-        in.clear();
-        in.seekg(0, std::ios::beg);
     }
 
+    raise_on_all(comm, error);
     boost::mpi::broadcast(comm, n, 0);
     boost::mpi::broadcast(comm, d, 0);
     boost::mpi::broadcast(comm, nt, 0);
@@ -561,10 +1026,24 @@ void ReadLIBSVM(const std::string& fname,
         Y.Resize(n, nt);
     }
 
+    // rank 0 parses on a reader thread while the main thread ships the
+    // previous block; sends of block i are only completed once block i+1
+    // has been parsed.
+    typedef detail::libsvm_sparse_block_t<T> block_t;
+    std::unique_ptr< block_pipeline_t<block_t> > pipeline;
+    if (rank == 0)
+        pipeline.reset(new block_pipeline_t<block_t>(
+                detail::libsvm_sparse_block_reader_t<T>(*input, X, n, nt,
+                    size, direction, blocksize)));
+
     El::DistMatrix<T, El::CIRC, El::CIRC> YB(Y.Grid());
     El::DistMatrix<T, El::VC, El::STAR> Yv(Y.Grid());
 
-    int row = 0;
+    block_t parsed, in_flight;
+    std::vector<boost::mpi::request> requests;
+    std::vector<int> recv_j, recv_row;
+    std::vector<T> recv_v;
+
     for(int i=0; i<numblocks+1; i++) {
         if (i==numblocks)
             block = leftover;
@@ -577,82 +1056,52 @@ void ReadLIBSVM(const std::string& fname,
             El::Zeros(YB, block, nt);
         }
 
+        if (!next_block(pipeline.get(), parsed, comm))
+            SKYLARK_THROW_EXCEPTION (
+                base::io_exception()
+                    << base::error_msg("The input ended before all blocks "
+                        "were read"));
+
         if(rank==0) {
-            T *Ydata = YB.Matrix().Buffer();
-            int ldY = YB.Matrix().LDim();
 
-            t = 0;
-            while(!in.eof() && t<block) {
-                getline(in, line);
-                if( line.length()==0)
-                    break;
+            // the previous block has to be delivered before its buffers are
+            // released.
+            boost::mpi::wait_all(requests.begin(), requests.end());
+            requests.clear();
+            std::swap(in_flight, parsed);
 
-                std::istringstream tokenstream (line);
-                for(int r = 0; r < nt; r++) {
-                    tokenstream >> label;
-                    if (direction == base::COLUMNS)
-                        Ydata[t * ldY + r] = label;
-                    else
-                        Ydata[r * ldY + t] = label;
-                }
+            if (in_flight.Y.size() == static_cast<size_t>(block) * nt)
+                detail::copy_into(in_flight.Y, YB.Matrix());
 
-                while (tokenstream >> token) {
-                    delim  = token.find(':');
-                    ind = token.substr(0, delim);
-                    val = token.substr(delim+1); //.substr(delim+1);
-                    j = atoi(ind.c_str()) - 1;
-                    int owner = (direction == base::COLUMNS) ?
-                        X.owner(j, row) : X.owner(row, j);
-                    if (owner == 0) {
-                        if (direction == base::COLUMNS)
-                            X.queue_update(j, row, atof(val.c_str()));
-                        else
-                            X.queue_update(row, j, atof(val.c_str()));
-                    } else {
-                        non_local_updates_j[owner].push_back(j);
-                        non_local_updates_row[owner].push_back(row);
-                        non_local_updates_v[owner].push_back(atof(val.c_str()));
-                    }
-                }
-
-                row++;
-                t++;
-            }
+            in_flight.j.resize(size);
+            in_flight.row.resize(size);
+            in_flight.v.resize(size);
 
             for (int rk = 1; rk < size; rk++) {
-                comm.send(rk, 0, non_local_updates_j[rk]);
-                comm.send(rk, 0, non_local_updates_row[rk]);
-                comm.send(rk, 0, non_local_updates_v[rk]);
+                requests.push_back(comm.isend(rk, 0, in_flight.j[rk]));
+                requests.push_back(comm.isend(rk, 0, in_flight.row[rk]));
+                requests.push_back(comm.isend(rk, 0, in_flight.v[rk]));
+            }
 
-                non_local_updates_j[rk].clear();
-                non_local_updates_row[rk].clear();
-                non_local_updates_v[rk].clear();
+            for(size_t k = 0; k < in_flight.j[0].size(); k++) {
+                if (direction == base::COLUMNS)
+                    X.queue_update(in_flight.j[0][k], in_flight.row[0][k],
+                        in_flight.v[0][k]);
+                else
+                    X.queue_update(in_flight.row[0][k], in_flight.j[0][k],
+                        in_flight.v[0][k]);
             }
         } else {
-                comm.recv(0, 0, non_local_updates_j[rank]);
-                comm.recv(0, 0, non_local_updates_row[rank]);
-                comm.recv(0, 0, non_local_updates_v[rank]);
-
-                auto it_j = non_local_updates_j[rank].begin();
-                auto it_row = non_local_updates_row[rank].begin();
-                auto it_v = non_local_updates_v[rank].begin();
-
-                for(; it_j != non_local_updates_j[rank].end();) {
-
-                    int j = *it_j, row = *it_row;
-                    T val = *it_v;
-
-                    if (direction == base::COLUMNS)
-                        X.queue_update(j, row, val);
-                    else
-                        X.queue_update(row, j, val);
-
-                    it_j++; it_row++; it_v++;
-                }
+            comm.recv(0, 0, recv_j);
+            comm.recv(0, 0, recv_row);
+            comm.recv(0, 0, recv_v);
 
-                non_local_updates_j[rank].clear();
-                non_local_updates_row[rank].clear();
-                non_local_updates_v[rank].clear();
+            for(size_t k = 0; k < recv_j.size(); k++) {
+                if (direction == base::COLUMNS)
+                    X.queue_update(recv_j[k], recv_row[k], recv_v[k]);
+                else
+                    X.queue_update(recv_row[k], recv_j[k], recv_v[k]);
+            }
         }
 
         // The calls below should distribute the data to all the nodes.
@@ -665,53 +1114,81 @@ void ReadLIBSVM(const std::string& fname,
         Yv = YB;
     }
 
-    X.finalize();
+    boost::mpi::wait_all(requests.begin(), requests.end());
+
+    X.finalize();
+}
+
+
+namespace detail {
+
+/**
+ * Appends examples [start, start + count) of X and Y as libsvm lines.
+ */
+template<typename T, typename R>
+void format_libsvm_lines(const El::Matrix<T>& X, const El::Matrix<R>& Y,
+    base::direction_t direction, El::Int start, El::Int count,
+    std::string& out) {
+
+    const T *x = X.LockedBuffer();
+    const R *y = Y.LockedBuffer();
+    const El::Int ldx = X.LDim();
+    const El::Int ldy = Y.LDim();
+    const El::Int d = (direction == base::COLUMNS) ? X.Height() : X.Width();
+
+    // Stride between consecutive features, and between examples.
+    const El::Int fstride = (direction == base::COLUMNS) ? 1 : ldx;
+    const El::Int xstride = (direction == base::COLUMNS) ? ldx : 1;
+    const El::Int ystride = (direction == base::COLUMNS) ? ldy : 1;
+
+    format_lines(count,
+        [=] (El::Int i, std::string& line) {
+            const El::Int j = start + i;
+            AppendNumber(line, y[j * ystride]);
+            const T *xj = x + j * xstride;
+            for(El::Int r = 0; r < d; r++) {
+                T val = xj[r * fstride];
+                if (val != 0.0) {
+                    line.push_back(' ');
+                    AppendNumber(line, r + 1);
+                    line.push_back(':');
+                    AppendNumber(line, val);
+                }
+            }
+            line.push_back('\n');
+        }, out);
 }
 
+} // namespace detail
 
 /**
  * Write X and Y from a file in libsvm format.
  * X and Y are Elemental dense matrices.
  *
+ * Values are written with the shortest representation that reads back
+ * exactly, and blocks of examples are formatted by all threads.
+ *
  * @param fname output file name.
  * @param X input X
  * @param Y output Y
  * @param direction whether the examples are in the rows or columns of X and Y
+ * @param blocksize number of examples formatted at a time.
  */
 template<typename T, typename R>
 void WriteLIBSVM(const std::string& fname,
     El::Matrix<T>& X, El::Matrix<R>& Y,
-    base::direction_t direction) {
+    base::direction_t direction, int blocksize = 10000) {
 
-    std::ofstream out(fname);
-    El::Int n, d;
+    std::ofstream out(fname, std::ios::binary);
+    El::Int n = (direction == base::COLUMNS) ? X.Width() : X.Height();
 
-    if (direction == base::COLUMNS) {
-        n = X.Width();
-        d = X.Height();
-    } else {
-        n = X.Height();
-        d = X.Width();
-    }
+    std::string text;
+    for(El::Int start = 0; start < n; start += blocksize) {
+        El::Int count = std::min<El::Int>(blocksize, n - start);
 
-    for(El::Int j = 0; j < n; j++) {
-        if (direction == base::COLUMNS) {
-            out << Y.Get(0, j) << " ";
-            for(El::Int r = 0; r < d; r++) {
-                T val = X.Get(r, j);
-                if (val != 0.0)
-                    out << (r+1) << ":" << val << " ";
-            }
-            out << std::endl;
-        } else {
-            out << Y.Get(j, 0) << " ";
-            for(El::Int r = 0; r < d; r++) {
-                T val = X.Get(j, r);
-                if (val != 0.0)
-                    out << (r+1) << ":" << val << " ";
-            }
-            out << std::endl;
-        }
+        text.clear();
+        detail::format_libsvm_lines(X, Y, direction, start, count, text);
+        out.write(text.data(), text.size());
     }
 
     out.close();
@@ -721,11 +1198,15 @@ void WriteLIBSVM(const std::string& fname,
  * Write X and Y from a file in libsvm format.
  * X and Y are Elemental distributed matrices.
  *
+ * Each block of examples is split in contiguous slices, one per rank; every
+ * rank formats its slice with all its threads and the slices are written
+ * collectively with MPI-IO at offsets given by a prefix sum of their sizes.
+ *
  * @param fname output file name.
  * @param X input X
  * @param Y output Y
  * @param direction whether the examples are in the rows or columns of X and Y
- * @param blocksize blocksize for blocking of read.
+ * @param blocksize number of examples per rank in each block.
  */
 template<typename T, El::Distribution UX, El::Distribution VX,
          typename R, El::Distribution UY, El::Distribution VY>
@@ -733,67 +1214,29 @@ void WriteLIBSVM(const std::string& fname,
     El::DistMatrix<T, UX, VX>& X, El::DistMatrix<R, UY, VY>& Y,
     base::direction_t direction, int blocksize = 10000) {
 
-    int rank = X.Grid().Rank();
-
-    std::ofstream out(fname);
-    El::Int n, d;
-
-    if (direction == base::COLUMNS) {
-        n = X.Width();
-        d = X.Height();
-    } else {
-        n = X.Height();
-        d = X.Width();
-    }
+    parallel_text_writer_t writer(fname, X.Grid().VCComm().comm);
 
-    El::Int numblocks = ((int) n/ (int) blocksize);
-    El::Int leftover = n % blocksize;
-    El::Int block = blocksize;
+    El::Int n = (direction == base::COLUMNS) ? X.Width() : X.Height();
+    El::Int block = static_cast<El::Int>(blocksize) * X.Grid().Size();
 
-    El::DistMatrix<T, El::CIRC, El::CIRC> XB(X.Grid());
-    El::DistMatrix<R, El::CIRC, El::CIRC> YB(Y.Grid());
-    El::DistMatrix<T, UX, VX> Xv(X.Grid());
-    El::DistMatrix<R, UY, VY> Yv(Y.Grid());
-    for(El::Int i = 0; i < numblocks + 1; i++) {
-        if (i == numblocks)
-            block = leftover;
-        if (block == 0)
-            break;
+    El::Matrix<T> XB;
+    El::Matrix<R> YB;
+    std::string text;
+    for(El::Int start = 0; start < n; start += block) {
+        El::Int count = std::min(block, n - start);
 
-        // The calls below should distribute the data to all the nodes.
-        if (direction == base::COLUMNS) {
-            El::View(Xv, X, 0, i*blocksize, d, block);
-            El::View(Yv, Y, 0, i*blocksize, 1, block);
-        } else {
-            El::View(Xv, X, i*blocksize, 0, block, d);
-            El::View(Yv, Y, i*blocksize, 0, block, 1);
-        }
+        detail::gather_contiguous_slice(X, direction, start, count, XB);
+        detail::gather_contiguous_slice(Y, direction, start, count, YB);
 
-        XB = Xv;
-        YB = Yv;
+        El::Int local = (direction == base::COLUMNS) ?
+            XB.Width() : XB.Height();
 
-        if(rank==0)
-            for(El::Int j = 0; j < block; j++) {
-                if (direction == base::COLUMNS) {
-                    out << YB.Get(0, j) << " ";
-                    for(El::Int r = 0; r < d; r++) {
-                        T val = XB.Get(r, j);
-                        if (val != 0.0)
-                            out << (r+1) << ":" << val << " ";
-                    }
-                    out << std::endl;
-                } else {
-                        out << YB.Get(j, 0) << " ";
-                        for(El::Int r = 0; r < d; r++) {
-                            T val = XB.Get(j, r);
-                            if (val != 0.0)
-                                out << (r+1) << ":" << val << " ";
-                        }
-                        out << std::endl;
-                }
-            }
+        text.clear();
+        detail::format_libsvm_lines(XB, YB, direction, 0, local, text);
+        writer.write_ordered(text);
     }
-    out.close();
+
+    writer.close();
 }
 
 #if SKYLARK_HAVE_BOOST_FILESYSTEM
@@ -1136,10 +1579,55 @@ void ReadDirLIBSVM(const std::string& dname,
         X.attach(col_ptr, rowind, values, nnz, n, d, true);
 }
 
+namespace detail {
+
+/**
+ * Source of the lines of all the (non-hidden) files of a directory, one file
+ * after the other, for the block readers.
+ */
+struct dir_line_source_t {
+
+    dir_line_source_t(const boostfs::path& dname)
+        : _it(new boostfs::directory_iterator(dname)),
+          _in(new std::ifstream())
+    {}
+
+    bool operator()(std::string& line) {
+        boostfs::directory_iterator end_iter;
+        while (true) {
+            if (_in->is_open()) {
+                if (std::getline(*_in, line))
+                    return true;
+                _in->close();
+            }
+
+            while (*_it != end_iter &&
+                (*_it)->path().filename().string()[0] == '.')
+                ++(*_it);
+            if (*_it == end_iter)
+                return false;
+
+            _in->clear();
+            _in->open((*_it)->path().string());
+            ++(*_it);
+        }
+    }
+
+private:
+    // Shared, so that the source can be copied into a block producer.
+    std::shared_ptr<boostfs::directory_iterator> _it;
+    std::shared_ptr<std::ifstream> _in;
+};
+
+} // namespace detail
+
 /**
  * reads x and y from a directory of files in libsvm format.
  * x and y are elemental distributed matrices.
  *
+ * Read in blocks by rank 0 and distributed as in ReadLIBSVM, with parsing,
+ * sending and redistribution of consecutive blocks overlapped.
+ *
  * @param fname input file name.
  * @param x output x
  * @param y output y
@@ -1153,205 +1641,43 @@ void ReadDirLIBSVM(const std::string& dname,
     El::DistMatrix<T, UX, VX>& X, El::DistMatrix<R, UY, VY>& Y,
     base::direction_t direction, int min_d = 0, int blocksize = 10000) {
 
-
-    std::string line;
-    std::string token, val, ind;
-    R label;
-    unsigned int start = 0;
-    unsigned int t;
-    int n = 0, nt = 0;
-    int d = 0;
-    int i, j, last;
-    char c;
-
     // TODO check that X and Y have the same grid.
-    boost::mpi::communicator comm = skylark::utility::get_communicator(X);
-    int rank = X.Grid().Rank();
+    boost::mpi::communicator comm(X.Grid().VCComm().comm,
+        boost::mpi::comm_attach);
+    int rank = comm.rank();
 
     boostfs::path full_path(boostfs::system_complete(boostfs::path(dname)));
-    boostfs::directory_iterator end_iter;
 
     // make one pass over the data to figure out dimensions -
     // will pay in terms of preallocated storage.
+    int n = 0, d = 0, nt = 0;
+    std::exception_ptr error;
     if (rank==0) {
-        for(boostfs::directory_iterator dirit(full_path); dirit != end_iter;
-            dirit++) {
-
-            std::string fname = dirit->path().filename().string();
-            if (fname == "." || fname == ".." || fname[0] == '.')
-                continue;
-
-            std::ifstream in(dirit->path().string());
-
-            while(!in.eof()) {
-                getline(in, line);
-
-                // Ignore empty lines and comment lines (begin with #)
-                if(line.length() == 0 || line[0] == '#')
-                    break;
-
-                n++;
-
-                // Figure out number of targets (only first line)
-                if (n == 1) {
-                    std::string tstr;
-                    std::istringstream tokenstream (line);
-                    tokenstream >> tstr;
-                    while (tstr.find(":") == std::string::npos) {
-                        nt++;
-                        if (tokenstream.eof())
-                            break;
-                        tokenstream >> tstr;
-                    }
-                }
-
-                size_t delim = line.find_last_of(":");
-                if(delim == std::string::npos)
-                    continue;
-
-                t = delim;
-                while(line[t]!=' ') {
-                    t--;
-                }
-                val = line.substr(t+1, delim - t);
-                last = atoi(val.c_str());
-                if (last>d)
-                    d = last;
-            }
-
-            in.close();
+        try {
+            detail::dir_line_source_t lines(full_path);
+            detail::libsvm_dimensions(lines, -1, n, d, nt);
+            if (min_d > 0)
+                d = std::max(d, min_d);
+        } catch (...) {
+            error = std::current_exception();
         }
-
-        if (min_d > 0)
-            d = std::max(d, min_d);
     }
 
+    raise_on_all(comm, error);
     boost::mpi::broadcast(comm, n, 0);
     boost::mpi::broadcast(comm, d, 0);
     boost::mpi::broadcast(comm, nt, 0);
 
-    int numblocks = ((int) n/ (int) blocksize); // of size blocksize
-    int leftover = n % blocksize;
-    int block = blocksize;
-
-    if (direction == base::COLUMNS) {
-        X.Resize(d, n);
-        Y.Resize(nt, n);
-    } else {
-        X.Resize(n, d);
-        Y.Resize(n, nt);
-    }
-
-    El::DistMatrix<T, El::CIRC, El::CIRC> XB(X.Grid()), YB(Y.Grid());
-    El::DistMatrix<T, UX, VX> Xv(X.Grid());
-    El::DistMatrix<R, UY, VY> Yv(Y.Grid());
-    boostfs::directory_iterator dirit(full_path);
-
-    std::ifstream in;
-    if (rank == 0) {
-        std::string fname = dirit->path().filename().string();
-        while (fname == "." || fname == ".." || fname[0] == '.') {
-            dirit++;
-            if (dirit == end_iter)
-                break;
-            fname = dirit->path().filename().string();
-        }
-
-        in.open(dirit->path().string());
-
-        dirit++;
-    }
-
-    for(int i=0; i<numblocks+1; i++) {
-        if (i==numblocks)
-            block = leftover;
-        if (block==0)
-            break;
-
-        if (direction == base::COLUMNS) {
-            El::Zeros(XB, d, block);
-            El::Zeros(YB, nt, block);
-        } else {
-            El::Zeros(XB, block, d);
-            El::Zeros(YB, block, nt);
-        }
-
-        if(rank==0) {
-            T *Xdata = XB.Matrix().Buffer();
-            R *Ydata = YB.Matrix().Buffer();
-            int ldX = XB.Matrix().LDim();
-            int ldY = YB.Matrix().LDim();
-
-            t = 0;
-            while(t<block) {
-                if (in.eof()) {
-                    if (dirit == end_iter)
-                        break;
-
-                    in.close();
-
-                    std::string fname = dirit->path().filename().string();
-                    while (fname == "." || fname == ".." || fname[0] == '.') {
-                        dirit++;
-                        if (dirit == end_iter)
-                            break;
-
-                        fname = dirit->path().filename().string();
-                    }
-
-                    if (dirit == end_iter)
-                        break;
-
-                    in.open(dirit->path().string());
-                    dirit++;
-                }
-
-                getline(in, line);
-
-                // Ignore empty lines and comment lines (begin with #)
-                if(line.length() == 0 || line[0] == '#')
-                    break;
-
-                std::istringstream tokenstream (line);
-                for(int r = 0; r < nt; r++) {
-                    tokenstream >> label;
-                    if (direction == base::COLUMNS)
-                        Ydata[t * ldY + r] = label;
-                    else
-                        Ydata[r * ldY + t] = label;
-                }
-
-                while (tokenstream >> token) {
-                    size_t delim  = token.find(':');
-                    ind = token.substr(0, delim);
-                    val = token.substr(delim+1); //.substr(delim+1);
-                    j = atoi(ind.c_str()) - 1;
-                    if (direction == base::COLUMNS)
-                        Xdata[t * ldX + j] = atof(val.c_str());
-                    else
-                        Xdata[j * ldX + t] = atof(val.c_str());
-                }
-
-                t++;
-            }
-        }
-
-        // The calls below should distribute the data to all the nodes.
-        if (direction == base::COLUMNS) {
-            int ldX = XB.Matrix().LDim();
-            El::View(Xv, X, 0, i*blocksize, d, block);
-            El::View(Yv, Y, 0, i*blocksize, nt, block);
-        } else {
-            El::View(Xv, X, i*blocksize, 0, block, d);
-            El::View(Yv, Y, i*blocksize, 0, block, nt);
-        }
-
-        Xv = XB;
-        Yv = YB;
-    }
-
+    std::function<bool (detail::libsvm_dense_block_t<T, R>&)> producer;
     if (rank == 0)
-        in.close();
+        producer = detail::libsvm_dense_block_reader_t<T, R,
+            detail::dir_line_source_t>(
+                detail::dir_line_source_t(full_path), n, d, nt, direction,
+                blocksize);
+
+    detail::distribute_blocks(producer, X, Y, direction, n, d, nt, blocksize,
+        std::function<void (El::DistMatrix<T, UX, VX>&,
+            El::DistMatrix<R, UY, VY>&, int)>(), 2, nullptr);
 }
 
 template<typename T,
@@ -1689,11 +2015,44 @@ void ReadLIBSVM(hdfsFS &fs, const std::string& fname,
         X.attach(col_ptr, rowind, values, nnz, n, d, true);
 }
 
+namespace detail {
+
+/**
+ * Source of the lines of an HDFS file, or of all the files of an HDFS
+ * directory, for the block readers.
+ */
+struct hdfs_line_source_t {
+
+    hdfs_line_source_t(const hdfsFS& fs, const std::string& fname)
+        : _itr(new hdfs_line_streamer_iterator_t(fs, fname, 1000)) {
+        _in = _itr->next();
+    }
+
+    bool operator()(std::string& line) {
+        while (_in != nullptr) {
+            _in->getline(line);
+            if (!_in->eof() || line.length() > 0)
+                return true;
+            _in = _itr->next();
+        }
+        return false;
+    }
+
+private:
+    // Shared, so that the source can be copied into a block producer.
+    std::shared_ptr<hdfs_line_streamer_iterator_t> _itr;
+    std::shared_ptr<hdfs_line_streamer_t> _in;
+};
+
+} // namespace detail
+
 /**
  * Reads X and Y from a file in libsvm format (from HDFS filesystem).
  * X and Y are Elemental distributed matrices.
- * Note that all the data is read on rank 0 (WHY??).
  *
+ * Read in blocks by rank 0 and distributed as in ReadLIBSVM, with parsing
+ * (on a reader thread, which libhdfs attaches to the JVM), sending and
+ * redistribution of consecutive blocks overlapped.
  *
  * @param fname input file name.
  * @param X output X
@@ -1708,167 +2067,41 @@ void ReadLIBSVM(hdfsFS &fs, const std::string& fname,
     El::DistMatrix<T, UX, VX>& X, El::DistMatrix<R, UY, VY>& Y,
     base::direction_t direction, int min_d = 0, int blocksize = 10000) {
 
-    std::string line;
-    std::string token, val, ind;
-    R label;
-    unsigned int start = 0;
-    unsigned int t;
-    int n = 0, nt = 0;
-    int d = 0;
-    int i, j, last;
-    char c;
-
     // TODO check that X and Y have the same grid.
-    boost::mpi::communicator comm = skylark::utility::get_communicator(X);
-    int rank = X.Grid().Rank();
-
-    //FIXME: only required on rank 0
-    //detail::hdfs_line_streamer_iterator_t itr(fs, fname, 1000);
-    std::unique_ptr<hdfs_line_streamer_iterator_t> itr(nullptr);
+    boost::mpi::communicator comm(X.Grid().VCComm().comm,
+        boost::mpi::comm_attach);
+    int rank = comm.rank();
 
     // make one pass over the data to figure out dimensions -
     // will pay in terms of preallocated storage.
+    int n = 0, d = 0, nt = 0;
+    std::exception_ptr error;
     if (rank==0) {
-
-        itr.reset(new hdfs_line_streamer_iterator_t (fs, fname, 1000));
-        auto in = itr->next();
-
-        while(in != nullptr) {
-            while(!in->eof()) {
-                in->getline(line);
-
-                // Ignore empty lines and comment lines (begin with #)
-                if(line.length() == 0 || line[0] == '#')
-                    break;
-
-                n++;
-
-                // Figure out number of targets
-                if (n == 1) {
-                    std::string tstr;
-                    std::istringstream tokenstream (line);
-                    tokenstream >> tstr;
-                    while (tstr.find(":") == std::string::npos) {
-                        nt++;
-                        if (tokenstream.eof())
-                            break;
-                        tokenstream >> tstr;
-                    }
-                }
-
-                size_t delim = line.find_last_of(":");
-                if(delim == std::string::npos)
-                    continue;
-
-                t = delim;
-                while(line[t]!=' ') {
-                    t--;
-                }
-                val = line.substr(t+1, delim - t);
-                last = atoi(val.c_str());
-                if (last>d)
-                    d = last;
-            }
-
-            in = itr->next();
+        try {
+            detail::hdfs_line_source_t lines(fs, fname);
+            detail::libsvm_dimensions(lines, -1, n, d, nt);
+            if (min_d > 0)
+                d = std::max(d, min_d);
+        } catch (...) {
+            error = std::current_exception();
         }
-
-        if (min_d > 0)
-            d = std::max(d, min_d);
     }
 
+    raise_on_all(comm, error);
     boost::mpi::broadcast(comm, n, 0);
     boost::mpi::broadcast(comm, d, 0);
     boost::mpi::broadcast(comm, nt, 0);
 
-    int numblocks = ((int) n/ (int) blocksize); // of size blocksize
-    int leftover = n % blocksize;
-    int block = blocksize;
-
-    if (direction == base::COLUMNS) {
-        X.Resize(d, n);
-        Y.Resize(nt, n);
-    } else {
-        X.Resize(n, d);
-        Y.Resize(n, nt);
-    }
-
-    El::DistMatrix<T, El::CIRC, El::CIRC> XB(X.Grid()), YB(Y.Grid());
-    El::DistMatrix<T, UX, VX> Xv(X.Grid());
-    El::DistMatrix<R, UY, VY> Yv(Y.Grid());
-    for(int i=0; i<numblocks+1; i++) {
-        if (i==numblocks)
-            block = leftover;
-        if (block==0)
-            break;
-
-        if (direction == base::COLUMNS) {
-            El::Zeros(XB, d, block);
-            El::Zeros(YB, nt, block);
-        } else {
-            El::Zeros(XB, block, d);
-            El::Zeros(YB, block, nt);
-        }
-
-        if(rank==0) {
-            T *Xdata = XB.Matrix().Buffer();
-            R *Ydata = YB.Matrix().Buffer();
-            int ldX = XB.Matrix().LDim();
-            int ldY = YB.Matrix().LDim();
-
-            itr->reset();
-            auto in = itr->next();
-
-            t = 0;
-            while(in != nullptr) {
-
-                in->rewind();
-                while(!in->eof() && t<block) {
-                    in->getline(line);
-
-                    // Ignore empty lines and comment lines (begin with #)
-                    if(line.length() == 0 || line[0] == '#')
-                        break;
-                    std::istringstream tokenstream (line);
-                    for(int r = 0; r < nt; r++) {
-                        tokenstream >> label;
-                        if (direction == base::COLUMNS)
-                            Ydata[t * ldY + r] = label;
-                        else
-                            Ydata[r * ldY + t] = label;
-                    }
-
-                    while (tokenstream >> token) {
-                        size_t delim  = token.find(':');
-                        ind = token.substr(0, delim);
-                        val = token.substr(delim+1); //.substr(delim+1);
-                        j = atoi(ind.c_str()) - 1;
-                        if (direction == base::COLUMNS)
-                            Xdata[t * ldX + j] = atof(val.c_str());
-                        else
-                            Xdata[j * ldX + t] = atof(val.c_str());
-                    }
-
-                    t++;
-                }
-
-                in = itr->next();
-            }
-        }
-
-        // The calls below should distribute the data to all the nodes.
-        if (direction == base::COLUMNS) {
-            int ldX = XB.Matrix().LDim();
-            El::View(Xv, X, 0, i*blocksize, d, block);
-            El::View(Yv, Y, 0, i*blocksize, nt, block);
-        } else {
-            El::View(Xv, X, i*blocksize, 0, block, d);
-            El::View(Yv, Y, i*blocksize, 0, block, nt);
-        }
-
-        Xv = XB;
-        Yv = YB;
-    }
+    std::function<bool (detail::libsvm_dense_block_t<T, R>&)> producer;
+    if (rank == 0)
+        producer = detail::libsvm_dense_block_reader_t<T, R,
+            detail::hdfs_line_source_t>(
+                detail::hdfs_line_source_t(fs, fname), n, d, nt, direction,
+                blocksize);
+
+    detail::distribute_blocks(producer, X, Y, direction, n, d, nt, blocksize,
+        std::function<void (El::DistMatrix<T, UX, VX>&,
+            El::DistMatrix<R, UY, VY>&, int)>(), 2, nullptr);
 }
 
 template<typename T,
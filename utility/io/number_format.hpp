@@ -0,0 +1,503 @@
+#ifndef SKYLARK_NUMBER_FORMAT_HPP
+#define SKYLARK_NUMBER_FORMAT_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace skylark { namespace utility { namespace io {
+
+/**
+ * Upper bound on the number of characters written by FormatNumber.
+ */
+const int MAX_NUMBER_CHARS = 32;
+
+namespace detail {
+
+/**
+ * Grisu2 shortest round-trip floating point formatting (F. Loitsch,
+ * "Printing Floating-Point Numbers Quickly and Accurately with Integers",
+ * PLDI 2010). The produced digits always read back to the same value, and
+ * are the shortest such digits in all but a tiny fraction of cases.
+ */
+namespace grisu {
+
+struct diyfp_t {
+    std::uint64_t f;
+    int e;
+
+    diyfp_t(std::uint64_t f_, int e_) : f(f_), e(e_) { }
+
+    static diyfp_t sub(const diyfp_t& x, const diyfp_t& y) {
+        return diyfp_t(x.f - y.f, x.e);
+    }
+
+    /** Product rounded to 64 bits (ties up). */
+    static diyfp_t mul(const diyfp_t& x, const diyfp_t& y) {
+        const std::uint64_t u_lo = x.f & 0xFFFFFFFFu;
+        const std::uint64_t u_hi = x.f >> 32;
+        const std::uint64_t v_lo = y.f & 0xFFFFFFFFu;
+        const std::uint64_t v_hi = y.f >> 32;
+
+        const std::uint64_t p0 = u_lo * v_lo;
+        const std::uint64_t p1 = u_lo * v_hi;
+        const std::uint64_t p2 = u_hi * v_lo;
+        const std::uint64_t p3 = u_hi * v_hi;
+
+        std::uint64_t q = (p0 >> 32) + (p1 & 0xFFFFFFFFu) + (p2 & 0xFFFFFFFFu);
+        q += std::uint64_t(1) << 31;
+
+        return diyfp_t(p3 + (p2 >> 32) + (p1 >> 32) + (q >> 32),
+            x.e + y.e + 64);
+    }
+
+    static diyfp_t normalize(diyfp_t x) {
+        while ((x.f >> 63) == 0) {
+            x.f <<= 1;
+            x.e--;
+        }
+        return x;
+    }
+
+    static diyfp_t normalize_to(const diyfp_t& x, int e) {
+        return diyfp_t(x.f << (x.e - e), e);
+    }
+};
+
+/**
+ * v and its normalized rounding boundaries m- and m+ (with equal exponent).
+ * value must be finite and positive.
+ */
+template<typename FloatType>
+void compute_boundaries(FloatType value,
+    diyfp_t& w, diyfp_t& w_minus, diyfp_t& w_plus) {
+
+    typedef typename std::conditional<sizeof(FloatType) == 4,
+        std::uint32_t, std::uint64_t>::type bits_type;
+
+    const int precision = std::numeric_limits<FloatType>::digits;
+    const int bias =
+        std::numeric_limits<FloatType>::max_exponent - 1 + (precision - 1);
+    const int min_exp = 1 - bias;
+    const std::uint64_t hidden_bit = std::uint64_t(1) << (precision - 1);
+
+    bits_type raw;
+    std::memcpy(&raw, &value, sizeof(raw));
+    const std::uint64_t bits = raw;
+    const std::uint64_t E = bits >> (precision - 1);
+    const std::uint64_t F = bits & (hidden_bit - 1);
+
+    const diyfp_t v = (E == 0) ?
+        diyfp_t(F, min_exp) :
+        diyfp_t(F + hidden_bit, static_cast<int>(E) - bias);
+
+    const bool lower_closer = F == 0 && E > 1;
+    const diyfp_t m_plus(2 * v.f + 1, v.e - 1);
+    const diyfp_t m_minus = lower_closer ?
+        diyfp_t(4 * v.f - 1, v.e - 2) : diyfp_t(2 * v.f - 1, v.e - 1);
+
+    w_plus = diyfp_t::normalize(m_plus);
+    w_minus = diyfp_t::normalize_to(m_minus, w_plus.e);
+    w = diyfp_t::normalize(v);
+}
+
+/** c = f * 2^e ~= 10^k */
+struct cached_power_t {
+    std::uint64_t f;
+    int e;
+    int k;
+};
+
+const int alpha_exp = -60;
+const int gamma_exp = -32;
+const int cached_powers_min_k = -300;
+const int cached_powers_max_k = 324;
+const int cached_powers_step = 8;
+
+/** Just enough of an unsigned big integer to build the cached powers. */
+class bignum_t {
+
+public:
+
+    explicit bignum_t(std::uint32_t v) : _limbs(1, v) { }
+
+    static bignum_t pow2(int e) {
+        bignum_t b(0);
+        b._limbs.assign(e / 32 + 1, 0);
+        b._limbs.back() = std::uint32_t(1) << (e % 32);
+        return b;
+    }
+
+    void mul_small(std::uint32_t m) {
+        std::uint64_t carry = 0;
+        for(size_t i = 0; i < _limbs.size(); i++) {
+            std::uint64_t t = std::uint64_t(_limbs[i]) * m + carry;
+            _limbs[i] = static_cast<std::uint32_t>(t);
+            carry = t >> 32;
+        }
+        if (carry)
+            _limbs.push_back(static_cast<std::uint32_t>(carry));
+    }
+
+    void shl1() {
+        std::uint32_t carry = 0;
+        for(size_t i = 0; i < _limbs.size(); i++) {
+            std::uint32_t next = _limbs[i] >> 31;
+            _limbs[i] = (_limbs[i] << 1) | carry;
+            carry = next;
+        }
+        if (carry)
+            _limbs.push_back(carry);
+    }
+
+    /** Requires *this >= o. */
+    void sub(const bignum_t& o) {
+        std::int64_t borrow = 0;
+        for(size_t i = 0; i < _limbs.size(); i++) {
+            std::int64_t t = std::int64_t(_limbs[i]) - borrow -
+                (i < o._limbs.size() ? std::int64_t(o._limbs[i]) : 0);
+            borrow = t < 0;
+            _limbs[i] = static_cast<std::uint32_t>(t + (borrow << 32));
+        }
+        _trim();
+    }
+
+    bool geq(const bignum_t& o) const {
+        if (_limbs.size() != o._limbs.size())
+            return _limbs.size() > o._limbs.size();
+        for(size_t i = _limbs.size(); i-- > 0; )
+            if (_limbs[i] != o._limbs[i])
+                return _limbs[i] > o._limbs[i];
+        return true;
+    }
+
+    int bit_length() const {
+        int n = 32 * (static_cast<int>(_limbs.size()) - 1);
+        for(std::uint32_t top = _limbs.back(); top != 0; top >>= 1)
+            n++;
+        return n;
+    }
+
+    bool bit(int i) const {
+        if (i < 0 || size_t(i / 32) >= _limbs.size())
+            return false;
+        return (_limbs[i / 32] >> (i % 32)) & 1;
+    }
+
+private:
+    std::vector<std::uint32_t> _limbs;
+
+    void _trim() {
+        while (_limbs.size() > 1 && _limbs.back() == 0)
+            _limbs.pop_back();
+    }
+};
+
+/** Correctly rounded normalized 64-bit significand of 10^k. */
+inline cached_power_t make_cached_power(int k) {
+    bignum_t b(1);
+    for(int i = 0; i < std::abs(k); i++)
+        b.mul_small(10);
+
+    const int L = b.bit_length();
+    cached_power_t c;
+    c.k = k;
+    c.f = 0;
+
+    bool round_up;
+    if (k >= 0) {
+        c.e = L - 64;
+        for(int i = 0; i < 64; i++)
+            if (b.bit(c.e + i))
+                c.f |= std::uint64_t(1) << i;
+        round_up = b.bit(c.e - 1);
+    } else {
+        // floor(2^(L+63) / 10^-k) by long division; it has exactly 64 bits.
+        c.e = -(L + 63);
+        bignum_t r = bignum_t::pow2(L);
+        for(int i = 0; i < 64; i++) {
+            if (i > 0)
+                r.shl1();
+            c.f <<= 1;
+            if (r.geq(b)) {
+                r.sub(b);
+                c.f |= 1;
+            }
+        }
+        r.shl1();
+        round_up = r.geq(b);
+    }
+
+    if (round_up && ++c.f == 0) {
+        c.f = std::uint64_t(1) << 63;
+        c.e++;
+    }
+
+    return c;
+}
+
+inline const std::vector<cached_power_t>& cached_powers() {
+    static const std::vector<cached_power_t> powers = [] {
+        std::vector<cached_power_t> p;
+        for(int k = cached_powers_min_k; k <= cached_powers_max_k;
+            k += cached_powers_step)
+            p.push_back(make_cached_power(k));
+        return p;
+    }();
+    return powers;
+}
+
+/**
+ * Cached power c such that alpha_exp <= c.e + e + 64 <= gamma_exp.
+ */
+inline const cached_power_t& cached_power_for_binary_exponent(int e) {
+    const int f = alpha_exp - e - 1;
+    const int k = (f * 78913) / (1 << 18) + static_cast<int>(f > 0);
+    const int index = (-cached_powers_min_k + k + (cached_powers_step - 1)) /
+        cached_powers_step;
+    return cached_powers()[index];
+}
+
+inline int find_largest_pow10(std::uint32_t n, std::uint32_t& pow10) {
+    int digits = 1;
+    pow10 = 1;
+    while (digits < 10 && n / pow10 >= 10) {
+        pow10 *= 10;
+        digits++;
+    }
+    return digits;
+}
+
+inline void round_weed(char *buf, int len, std::uint64_t dist,
+    std::uint64_t delta, std::uint64_t rest, std::uint64_t ten_k) {
+
+    while (rest < dist && delta - rest >= ten_k &&
+        (rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+        buf[len - 1]--;
+        rest += ten_k;
+    }
+}
+
+inline void digit_gen(char *buf, int& len, int& decimal_exponent,
+    diyfp_t M_minus, diyfp_t w, diyfp_t M_plus) {
+
+    std::uint64_t delta = diyfp_t::sub(M_plus, M_minus).f;
+    std::uint64_t dist = diyfp_t::sub(M_plus, w).f;
+
+    const diyfp_t one(std::uint64_t(1) << -M_plus.e, M_plus.e);
+
+    std::uint32_t p1 = static_cast<std::uint32_t>(M_plus.f >> -one.e);
+    std::uint64_t p2 = M_plus.f & (one.f - 1);
+
+    std::uint32_t pow10;
+    int n = find_largest_pow10(p1, pow10);
+
+    while (n > 0) {
+        const std::uint32_t d = p1 / pow10;
+        p1 %= pow10;
+        buf[len++] = static_cast<char>('0' + d);
+        n--;
+
+        const std::uint64_t rest = (std::uint64_t(p1) << -one.e) + p2;
+        if (rest <= delta) {
+            decimal_exponent += n;
+            round_weed(buf, len, dist, delta, rest,
+                std::uint64_t(pow10) << -one.e);
+            return;
+        }
+        pow10 /= 10;
+    }
+
+    int m = 0;
+    while (true) {
+        p2 *= 10;
+        const std::uint64_t d = p2 >> -one.e;
+        p2 &= one.f - 1;
+        buf[len++] = static_cast<char>('0' + d);
+        m++;
+
+        delta *= 10;
+        dist *= 10;
+        if (p2 <= delta)
+            break;
+    }
+
+    decimal_exponent -= m;
+    round_weed(buf, len, dist, delta, p2, one.f);
+}
+
+/**
+ * Digits of value (finite, positive): value ~= buf[0..len) * 10^exponent.
+ */
+template<typename FloatType>
+void grisu2(char *buf, int& len, int& exponent, FloatType value) {
+    diyfp_t w(0, 0), m_minus(0, 0), m_plus(0, 0);
+    compute_boundaries(value, w, m_minus, m_plus);
+
+    const cached_power_t& cached = cached_power_for_binary_exponent(m_plus.e);
+    const diyfp_t c(cached.f, cached.e);
+
+    const diyfp_t cw = diyfp_t::mul(w, c);
+    const diyfp_t cw_minus = diyfp_t::mul(m_minus, c);
+    const diyfp_t cw_plus = diyfp_t::mul(m_plus, c);
+
+    // Shrink the interval by one ulp on each side to account for the
+    // rounding in mul.
+    const diyfp_t M_minus(cw_minus.f + 1, cw_minus.e);
+    const diyfp_t M_plus(cw_plus.f - 1, cw_plus.e);
+
+    len = 0;
+    exponent = -cached.k;
+    digit_gen(buf, len, exponent, M_minus, cw, M_plus);
+}
+
+} // namespace grisu
+
+inline char *format_exponent(char *out, int e) {
+    *out++ = 'e';
+    if (e < 0) {
+        *out++ = '-';
+        e = -e;
+    } else
+        *out++ = '+';
+
+    if (e >= 100) {
+        *out++ = static_cast<char>('0' + e / 100);
+        e %= 100;
+        *out++ = static_cast<char>('0' + e / 10);
+    } else
+        *out++ = static_cast<char>('0' + e / 10);
+    *out++ = static_cast<char>('0' + e % 10);
+    return out;
+}
+
+/**
+ * Lays out digits * 10^k the way %g does: fixed notation when the decimal
+ * exponent is in [-5, 17), otherwise scientific.
+ */
+inline char *format_digits(char *out, const char *digits, int n, int k) {
+    const int p = n + k;
+
+    if (k >= 0 && p <= 17) {
+        std::memcpy(out, digits, n);
+        out += n;
+        for(int i = 0; i < k; i++)
+            *out++ = '0';
+    } else if (0 < p && p <= 17) {
+        std::memcpy(out, digits, p);
+        out += p;
+        *out++ = '.';
+        std::memcpy(out, digits + p, n - p);
+        out += n - p;
+    } else if (-4 < p && p <= 0) {
+        *out++ = '0';
+        *out++ = '.';
+        for(int i = 0; i < -p; i++)
+            *out++ = '0';
+        std::memcpy(out, digits, n);
+        out += n;
+    } else {
+        *out++ = digits[0];
+        if (n > 1) {
+            *out++ = '.';
+            std::memcpy(out, digits + 1, n - 1);
+            out += n - 1;
+        }
+        out = format_exponent(out, p - 1);
+    }
+
+    return out;
+}
+
+template<typename FloatType>
+char *format_float(char *out, FloatType value) {
+    if (std::isnan(value)) {
+        std::memcpy(out, "nan", 3);
+        return out + 3;
+    }
+
+    if (std::signbit(value)) {
+        *out++ = '-';
+        value = -value;
+    }
+
+    if (std::isinf(value)) {
+        std::memcpy(out, "inf", 3);
+        return out + 3;
+    }
+
+    if (value == 0) {
+        *out++ = '0';
+        return out;
+    }
+
+    char digits[20];
+    int len, exponent;
+    grisu::grisu2(digits, len, exponent, value);
+    return format_digits(out, digits, len, exponent);
+}
+
+template<typename IntType>
+char *format_integer(char *out, IntType value) {
+    typedef typename std::make_unsigned<IntType>::type unsigned_type;
+
+    unsigned_type u = static_cast<unsigned_type>(value);
+    if (value < 0) {
+        *out++ = '-';
+        u = unsigned_type(0) - u;
+    }
+
+    char tmp[24];
+    int n = 0;
+    do {
+        tmp[n++] = static_cast<char>('0' + u % 10);
+        u /= 10;
+    } while (u != 0);
+
+    while (n > 0)
+        *out++ = tmp[--n];
+    return out;
+}
+
+} // namespace detail
+
+/**
+ * Writes the shortest decimal representation of value that reads back
+ * (with strtod/strtof) to exactly value. Integral types are written as is.
+ * At most MAX_NUMBER_CHARS characters are written; no terminating zero.
+ *
+ * @param out output buffer.
+ * @param value value to format.
+ * @return one past the last character written.
+ */
+template<typename T>
+typename std::enable_if<std::is_floating_point<T>::value, char *>::type
+FormatNumber(char *out, T value) {
+    // long double is not supported by the digit generation.
+    typedef typename std::conditional<std::is_same<T, float>::value,
+        float, double>::type format_type;
+    return detail::format_float(out, static_cast<format_type>(value));
+}
+
+template<typename T>
+typename std::enable_if<std::is_integral<T>::value, char *>::type
+FormatNumber(char *out, T value) {
+    return detail::format_integer(out, value);
+}
+
+/**
+ * Appends the formatted value to a string.
+ */
+template<typename T>
+void AppendNumber(std::string& s, T value) {
+    char buf[MAX_NUMBER_CHARS];
+    s.append(buf, FormatNumber(buf, value) - buf);
+}
+
+} } } // namespace skylark::utility::io
+
+#endif // SKYLARK_NUMBER_FORMAT_HPP
@@ -0,0 +1,252 @@
+#ifndef SKYLARK_TEXT_WRITER_HPP
+#define SKYLARK_TEXT_WRITER_HPP
+
+#include <boost/mpi.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef SKYLARK_HAVE_OPENMP
+#include <omp.h>
+#endif
+
+#include "number_format.hpp"
+
+namespace skylark { namespace utility { namespace io {
+
+/**
+ * Collective text output through MPI-IO. Every call to write_ordered
+ * appends one piece of text per rank, in rank order, each rank writing its
+ * own piece at an offset computed with a prefix sum over the piece sizes.
+ *
+ * Slices from detail::gather_contiguous_slice are numbered by VC rank, so
+ * writers of such slices are created on the VC communicator of the grid.
+ *
+ * Closing the file is collective, so it is never done by the destructor:
+ * close() must be called by all ranks.
+ */
+class parallel_text_writer_t {
+
+public:
+
+    /**
+     * Creates (or truncates) fname. Collective over comm.
+     */
+    parallel_text_writer_t(const std::string& fname, MPI_Comm comm)
+        : _comm(comm), _offset(0), _open(false) {
+
+        int rc = MPI_File_open(_comm, const_cast<char *>(fname.c_str()),
+            MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &_file);
+        if (rc != MPI_SUCCESS)
+            SKYLARK_THROW_EXCEPTION (
+                base::io_exception()
+                    << base::error_msg("Failed to open " + fname +
+                        " for writing"));
+        _open = true;
+
+        MPI_File_set_size(_file, 0);
+    }
+
+    /**
+     * Does not close the file. A writer destroyed while an exception
+     * propagates only releases its local state; destroying an open writer
+     * otherwise is a missing close(), and aborts.
+     */
+    ~parallel_text_writer_t() {
+        if (_open && !std::uncaught_exception()) {
+            std::cerr << "parallel_text_writer_t destroyed without close()"
+                      << std::endl;
+            MPI_Abort(_comm, 1);
+        }
+    }
+
+    /**
+     * Appends text after the text of all lower ranks. Collective.
+     */
+    void write_ordered(const std::string& text) {
+
+        unsigned long long size = text.size(), before = 0, total = 0;
+        MPI_Exscan(&size, &before, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, _comm);
+        MPI_Allreduce(&size, &total, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM,
+            _comm);
+
+        int rank;
+        MPI_Comm_rank(_comm, &rank);
+        if (rank == 0)
+            before = 0;
+
+        // The collective write takes an int count, so large pieces are
+        // written in rounds; all ranks must take part in every round.
+        const unsigned long long max_chunk = INT_MAX;
+        unsigned long long rounds = (size + max_chunk - 1) / max_chunk;
+        unsigned long long max_rounds;
+        MPI_Allreduce(&rounds, &max_rounds, 1, MPI_UNSIGNED_LONG_LONG,
+            MPI_MAX, _comm);
+
+        for(unsigned long long i = 0; i < max_rounds; i++) {
+            unsigned long long start = std::min(i * max_chunk, size);
+            int count = static_cast<int>(std::min(max_chunk, size - start));
+
+            MPI_Status status;
+            int rc = MPI_File_write_at_all(_file, _offset + before + start,
+                const_cast<char *>(text.data() + start), count, MPI_CHAR,
+                &status);
+            if (rc != MPI_SUCCESS)
+                SKYLARK_THROW_EXCEPTION (
+                    base::io_exception()
+                        << base::error_msg(
+                            "Error while MPI_File_write_at_all!"));
+        }
+
+        _offset += total;
+    }
+
+    /**
+     * Closes the file. Collective, and must be called before the writer is
+     * destroyed.
+     */
+    void close() {
+        if (_open)
+            MPI_File_close(&_file);
+        _open = false;
+    }
+
+private:
+    MPI_Comm _comm;
+    MPI_File _file;
+    MPI_Offset _offset;
+    bool _open;
+
+    parallel_text_writer_t(const parallel_text_writer_t&);
+    void operator=(const parallel_text_writer_t&);
+};
+
+namespace detail {
+
+/**
+ * Formats lines [0, n) into out, in order. Ranges of lines are formatted
+ * into per-thread buffers which are then concatenated.
+ *
+ * @param format functor appending line i to a std::string.
+ */
+template<typename LineFormatter>
+void format_lines(El::Int n, LineFormatter format, std::string& out) {
+
+    int nthreads = 1;
+#   ifdef SKYLARK_HAVE_OPENMP
+    nthreads = std::max(1, std::min<int>(omp_get_max_threads(), n));
+#   endif
+
+    std::vector<std::string> buffers(nthreads);
+
+#   ifdef SKYLARK_HAVE_OPENMP
+#   pragma omp parallel num_threads(nthreads)
+#   endif
+    {
+        int tid = 0;
+#       ifdef SKYLARK_HAVE_OPENMP
+        tid = omp_get_thread_num();
+#       endif
+
+        std::string& buffer = buffers[tid];
+        for(El::Int i = (n * tid) / nthreads;
+            i < (n * (tid + 1)) / nthreads; i++)
+            format(i, buffer);
+    }
+
+    size_t size = out.size();
+    for(int t = 0; t < nthreads; t++)
+        size += buffers[t].size();
+    out.reserve(size);
+    for(int t = 0; t < nthreads; t++)
+        out.append(buffers[t]);
+}
+
+/**
+ * Gathers rows (or columns, if direction is COLUMNS) [start, start + count)
+ * of A so that the rank with VC rank r ends up with the r-th contiguous slice
+ * in local (slices of ceil(count / p) rows, the last ones possibly shorter
+ * or empty). This is a single redistribution of the block to a block-wise
+ * [VC,STAR] (or [STAR,VC]) distribution. Collective over the grid.
+ */
+template<typename T, El::Distribution U, El::Distribution V>
+void gather_contiguous_slice(const El::DistMatrix<T, U, V>& A,
+    base::direction_t direction, El::Int start, El::Int count,
+    El::Matrix<T>& local) {
+
+    const El::Grid& grid = A.Grid();
+    const El::Int slice = std::max<El::Int>(1,
+        (count + grid.Size() - 1) / grid.Size());
+
+    El::DistMatrix<T, U, V> Av(grid);
+    if (direction == base::COLUMNS) {
+        El::LockedView(Av, A, 0, start, A.Height(), count);
+        El::DistMatrix<T, El::STAR, El::VC, El::BLOCK> B(grid, 1, slice);
+        B = Av;
+        local = B.LockedMatrix();
+    } else {
+        El::LockedView(Av, A, start, 0, count, A.Width());
+        El::DistMatrix<T, El::VC, El::STAR, El::BLOCK> B(grid, slice, 1);
+        B = Av;
+        local = B.LockedMatrix();
+    }
+}
+
+} // namespace detail
+
+/**
+ * Writes a dense distributed matrix as text, one row per line with values
+ * separated by spaces (the layout of El::Write with El::ASCII, but without
+ * the .txt suffix being added). Values are written with the shortest
+ * representation that reads back exactly.
+ *
+ * Rows are gathered in blocks so that each rank formats a contiguous slice
+ * of a block, and all ranks write their slices collectively.
+ *
+ * @param fname output file name.
+ * @param A matrix to write.
+ * @param blocksize number of rows per rank in each block.
+ */
+template<typename T, El::Distribution U, El::Distribution V>
+void WriteText(const std::string& fname, const El::DistMatrix<T, U, V>& A,
+    int blocksize = 10000) {
+
+    parallel_text_writer_t writer(fname, A.Grid().VCComm().comm);
+
+    const El::Int m = A.Height();
+    const El::Int block = static_cast<El::Int>(blocksize) * A.Grid().Size();
+
+    El::Matrix<T> local;
+    for(El::Int start = 0; start < m; start += block) {
+        El::Int count = std::min(block, m - start);
+        detail::gather_contiguous_slice(A, base::ROWS, start, count, local);
+
+        const T *buffer = local.LockedBuffer();
+        const El::Int ldim = local.LDim();
+        const El::Int width = local.Width();
+
+        std::string text;
+        detail::format_lines(local.Height(),
+            [buffer, ldim, width] (El::Int i, std::string& out) {
+                for(El::Int j = 0; j < width; j++) {
+                    if (j > 0)
+                        out.push_back(' ');
+                    AppendNumber(out, buffer[i + j * ldim]);
+                }
+                out.push_back('\n');
+            }, text);
+
+        writer.write_ordered(text);
+        local.Empty();
+    }
+
+    writer.close();
+}
+
+} } } // namespace skylark::utility::io
+
+#endif // SKYLARK_TEXT_WRITER_HPP
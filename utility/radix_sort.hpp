@@ -0,0 +1,106 @@
+#ifndef SKYLARK_RADIX_SORT_HPP
+#define SKYLARK_RADIX_SORT_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#ifdef SKYLARK_HAVE_OPENMP
+#include <omp.h>
+#endif
+
+namespace skylark {
+namespace utility {
+
+/**
+ * Stable least-significant-digit radix sort of data by an unsigned integer
+ * key. Each pass histograms its digit per thread, computes the scatter
+ * offsets in (digit, thread) order and scatters thread-local ranges, so the
+ * result is identical for any number of threads.
+ *
+ * Only as many 8-bit passes as needed for the largest key are performed.
+ *
+ * @param data elements to sort (sorted in place).
+ * @param key functor returning a std::uint64_t key for an element.
+ */
+template<typename T, typename KeyFunction>
+void RadixSort(std::vector<T>& data, KeyFunction key) {
+
+    const size_t n = data.size();
+    if (n < 2)
+        return;
+
+    const int digit_bits = 8;
+    const size_t radix = size_t(1) << digit_bits;
+
+    std::uint64_t max_key = 0;
+    for(size_t i = 0; i < n; i++)
+        max_key = std::max(max_key, static_cast<std::uint64_t>(key(data[i])));
+
+    int key_bits = 0;
+    while (key_bits < 64 && (max_key >> key_bits) != 0)
+        key_bits++;
+
+    if (key_bits == 0)
+        return;
+
+    std::vector<T> tmp(n);
+    std::vector<size_t> hist;
+
+    T *src = &data[0];
+    T *dst = &tmp[0];
+
+    for(int shift = 0; shift < key_bits; shift += digit_bits) {
+
+#       ifdef SKYLARK_HAVE_OPENMP
+#       pragma omp parallel
+#       endif
+        {
+            int tid = 0, nthreads = 1;
+#           ifdef SKYLARK_HAVE_OPENMP
+            tid = omp_get_thread_num();
+            nthreads = omp_get_num_threads();
+#           endif
+
+#           ifdef SKYLARK_HAVE_OPENMP
+#           pragma omp single
+#           endif
+            hist.assign(nthreads * radix, 0);
+
+            const size_t begin = (n * tid) / nthreads;
+            const size_t end = (n * (tid + 1)) / nthreads;
+            size_t *h = &hist[tid * radix];
+
+            for(size_t i = begin; i < end; i++)
+                h[(static_cast<std::uint64_t>(key(src[i])) >> shift)
+                    & (radix - 1)]++;
+
+#           ifdef SKYLARK_HAVE_OPENMP
+#           pragma omp barrier
+#           pragma omp single
+#           endif
+            {
+                size_t offset = 0;
+                for(size_t d = 0; d < radix; d++)
+                    for(int t = 0; t < nthreads; t++) {
+                        size_t count = hist[t * radix + d];
+                        hist[t * radix + d] = offset;
+                        offset += count;
+                    }
+            }
+
+            for(size_t i = begin; i < end; i++)
+                dst[h[(static_cast<std::uint64_t>(key(src[i])) >> shift)
+                        & (radix - 1)]++] = src[i];
+        }
+
+        std::swap(src, dst);
+    }
+
+    if (src != &data[0])
+        data.swap(tmp);
+}
+
+} }  // namespace skylark::utility
+
+#endif // SKYLARK_RADIX_SORT_HPP
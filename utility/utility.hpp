@@ -5,6 +5,7 @@
 #include "get_communicator.hpp"
 #include "typer.hpp"
 #include "hash.hpp"
+#include "radix_sort.hpp"
 #include "elem_extender.hpp"
 #include "hdfs.hpp"
 #include "io/io.hpp"